@@ -8,6 +8,8 @@ import android.util.Log
 import com.chimera.red.protocol.CobsFrame
 import com.chimera.red.protocol.CobsFrameDecoder
 import com.chimera.red.protocol.CobsMessageType
+import com.chimera.red.protocol.ChimeraMsg
+import com.chimera.red.protocol.RecordTranslator
 import com.hoho.android.usbserial.driver.UsbSerialPort
 import com.hoho.android.usbserial.driver.UsbSerialProber
 import com.hoho.android.usbserial.util.SerialInputOutputManager
@@ -17,16 +19,14 @@ import kotlinx.coroutines.flow.MutableSharedFlow
 import kotlinx.coroutines.flow.SharedFlow
 import kotlinx.coroutines.launch
 import java.io.IOException
-import java.nio.charset.Charset
 
 /**
- * USB Serial Manager with dual-mode protocol support.
+ * USB Serial Manager.
  * 
- * Supports:
- *   - Legacy JSON mode (newline-delimited text)
- *   - COBS binary mode (0x00-delimited binary frames)
- * 
- * Auto-detects mode based on incoming data format.
+ * The device interleaves newline-delimited text (JSON replies, logs) with
+ * 0x00-delimited COBS frames carrying binary records. Both are decoded by
+ * CobsFrameDecoder; records the screens use are translated back to their
+ * JSON messages and emitted on receivedData with the text lines.
  */
 class UsbSerialManager(private val context: Context) : SerialInputOutputManager.Listener {
 
@@ -34,7 +34,7 @@ class UsbSerialManager(private val context: Context) : SerialInputOutputManager.
     private var ioManager: SerialInputOutputManager? = null
     private val usbManager = context.getSystemService(Context.USB_SERVICE) as UsbManager
 
-    // Legacy JSON output (for compatibility)
+    // JSON messages and text lines
     private val _receivedData = MutableSharedFlow<String>(replay = 0, extraBufferCapacity = 64)
     val receivedData: SharedFlow<String> = _receivedData
 
@@ -51,21 +51,19 @@ class UsbSerialManager(private val context: Context) : SerialInputOutputManager.
 
     val ACTION_USB_PERMISSION = "com.chimera.red.USB_PERMISSION"
     
-    // Legacy JSON buffer
-    private val readBuffer = StringBuilder()
-    
     // COBS decoder
     private val cobsDecoder = CobsFrameDecoder(maxBufferSize = 32768) // 32KB for large packets
-    
-    // Protocol mode detection
-    private var useCobsMode = false
+    private val records = RecordTranslator()
     private var bytesReceived = 0L
 
     init {
-        // Setup COBS frame handler
+        // Setup COBS frame and text line handlers
         cobsDecoder.onFrame = { frame ->
             handleCobsFrame(frame)
         }
+        cobsDecoder.onText = { line ->
+            _receivedData.tryEmit(line)
+        }
     }
 
     fun tryConnect() {
@@ -135,9 +133,7 @@ class UsbSerialManager(private val context: Context) : SerialInputOutputManager.
             usbSerialPort?.rts = true // S3/CDC often needs this
 
             // Reset state
-            readBuffer.clear()
             cobsDecoder.reset()
-            useCobsMode = false
             bytesReceived = 0
 
             ioManager = SerialInputOutputManager(usbSerialPort, this)
@@ -193,112 +189,25 @@ class UsbSerialManager(private val context: Context) : SerialInputOutputManager.
     override fun onNewData(data: ByteArray?) {
         if (data == null || data.isEmpty()) return
         bytesReceived += data.size
-        
-        // Detect COBS mode: if we see 0x00 bytes in non-printable context
-        if (!useCobsMode && data.contains(0x00)) {
-            // Check if this looks like COBS (has 0x00 delimiter and non-ASCII)
-            val hasNonPrintable = data.any { it !in 0x20..0x7E && it != 0x0A.toByte() && it != 0x0D.toByte() && it != 0x00.toByte() }
-            if (hasNonPrintable) {
-                useCobsMode = true
-                Log.i("UsbSerial", "Switched to COBS binary mode")
-            }
-        }
-        
-        if (useCobsMode) {
-            // COBS mode: feed to decoder
-            cobsDecoder.feed(data)
-        } else {
-            // Legacy JSON mode
-            handleLegacyData(data)
-        }
-    }
-    
-    private fun handleLegacyData(data: ByteArray) {
-        val text = String(data, Charset.defaultCharset())
-        
-        synchronized(readBuffer) {
-            readBuffer.append(text)
-            
-            // High-capacity buffer for large JSON scan results (up to 64KB)
-            if (readBuffer.length > 65536) {
-                Log.w("UsbSerial", "Buffer overflow, clearing...")
-                readBuffer.clear()
-            }
-            
-            var index: Int
-            while (readBuffer.indexOf('\n').also { index = it } >= 0) {
-                val line = readBuffer.substring(0, index).trim()
-                readBuffer.delete(0, index + 1)
-                
-                if (line.isNotEmpty()) {
-                    _receivedData.tryEmit(line)
-                }
-            }
-        }
+        cobsDecoder.feed(data)
     }
     
     private fun handleCobsFrame(frame: CobsFrame) {
-        when (frame.type) {
-            CobsMessageType.JSON_COMMAND -> {
-                // Convert to string and emit as legacy JSON
-                val json = String(frame.payload, Charsets.UTF_8)
-                _receivedData.tryEmit(json)
-            }
-            CobsMessageType.SPECTRUM_DATA -> {
+        val type = frame.type.toInt() and 0xFF
+        val emit: (String) -> Unit = { _receivedData.tryEmit(it) }
+        when {
+            type == ChimeraMsg.BATCH -> records.translateBatch(frame.payload, emit)
+            records.translate(type, frame.payload, emit) -> {}
+            frame.type == CobsMessageType.SPECTRUM_DATA -> {
                 // High-frequency spectrum data
                 _spectrumData.tryEmit(frame.payload)
             }
-            CobsMessageType.HANDSHAKE_DATA -> {
-                // Parse binary handshake and convert to JSON for compatibility
-                handleBinaryHandshake(frame.payload)
-            }
             else -> {
                 // Emit as generic binary frame
                 _binaryFrames.tryEmit(frame)
             }
         }
     }
-    
-    private fun handleBinaryHandshake(payload: ByteArray) {
-        if (payload.size < 94) { // Minimum: 1+1+6+6+32+32+16
-            Log.w("UsbSerial", "Handshake payload too short: ${payload.size}")
-            return
-        }
-        
-        var offset = 0
-        val channel = payload[offset++].toInt() and 0xFF
-        val rssi = payload[offset++].toInt()
-        
-        val bssid = payload.sliceArray(offset until offset + 6)
-        offset += 6
-        val staMac = payload.sliceArray(offset until offset + 6)
-        offset += 6
-        val anonce = payload.sliceArray(offset until offset + 32)
-        offset += 32
-        val snonce = payload.sliceArray(offset until offset + 32)
-        offset += 32
-        val mic = payload.sliceArray(offset until offset + 16)
-        offset += 16
-        val eapol = payload.sliceArray(offset until payload.size)
-        
-        // Convert to JSON for compatibility with existing handlers
-        val json = buildString {
-            append("{\"type\": \"wifi_handshake\", \"ch\": $channel, \"rssi\": $rssi")
-            append(", \"bssid\": \"${bssid.toHexString(":")}\"")
-            append(", \"sta_mac\": \"${staMac.toHexString(":")}\"")
-            append(", \"anonce\": \"${anonce.toHexString()}\"")
-            append(", \"snonce\": \"${snonce.toHexString()}\"")
-            append(", \"mic\": \"${mic.toHexString()}\"")
-            append(", \"eapol\": \"${eapol.toHexString()}\"")
-            append(", \"key_version\": 2}")
-        }
-        
-        _receivedData.tryEmit(json)
-    }
-    
-    private fun ByteArray.toHexString(separator: String = ""): String {
-        return joinToString(separator) { String.format("%02X", it) }
-    }
 
     override fun onRunError(e: Exception?) {
         Log.e("UsbSerial", "Runner stopped", e)
@@ -314,7 +223,6 @@ class UsbSerialManager(private val context: Context) : SerialInputOutputManager.
      * Returns connection statistics.
      */
     fun getStats(): String {
-        val mode = if (useCobsMode) "COBS" else "JSON"
-        return "Mode: $mode, Bytes: $bytesReceived, ${cobsDecoder.getStats()}"
+        return "Bytes: $bytesReceived, ${cobsDecoder.getStats()}"
     }
 }
@@ -0,0 +1,286 @@
+/**
+ * Chimera binary records (firmware chimera_proto.h)
+ *
+ * The firmware sends its telemetry as fixed-layout little-endian records
+ * instead of JSON:
+ *   [Type:1][Version:1][Body][Tail]
+ *
+ * The tail is an optional variable-length field (SSID, device name, EAPOL
+ * frame, log text, CSI data) whose length is the last field of the body.
+ * Newer versions only append body fields, so older fields stay where they
+ * are. A BATCH record (0x30) carries several records, each prefixed by its
+ * length byte.
+ *
+ * RecordTranslator turns the records the app displays back into the JSON
+ * messages SerialDataHandler and the screens already parse.
+ *
+ * @author Chimera Red Team
+ */
+package com.chimera.red.protocol
+
+import com.google.gson.Gson
+import kotlin.math.sqrt
+
+/**
+ * Record types (chimera_msg_type_t)
+ */
+object ChimeraMsg {
+    const val CSI_DATA = 0x05
+    const val BATCH = 0x30
+    const val WIFI_AP = 0x40
+    const val WIFI_SCAN_DONE = 0x41
+    const val CLIENT_PROBE = 0x42
+    const val RECON_BEACON = 0x43
+    const val PULSE = 0x44
+    const val SNIFF_STATS = 0x45
+    const val SYS_STATUS = 0x46
+    const val BLE_DEVICE = 0x47
+    const val BLE_SCAN_DONE = 0x48
+    const val HANDSHAKE = 0x49
+    const val LOG = 0x4A
+    const val AP_UPDATE = 0x4D
+    const val PROBE_UPDATE = 0x4E
+    const val CSI_FEATURES = 0x51
+
+    // chimera_ap_update_t.flags / chimera_probe_update_t.flags
+    const val AP_GONE = 0x40
+    const val PROBE_NEW = 0x01
+}
+
+/**
+ * Record to legacy JSON translator
+ *
+ * Scan results arrive one record per network or device followed by a
+ * *_SCAN_DONE record; they are collected and sent as one
+ * wifi_scan_result / ble_scan_result message, as the firmware used to.
+ */
+class RecordTranslator {
+    private val gson = Gson()
+    private val networks = ArrayList<Map<String, Any>>()
+    private val devices = ArrayList<Map<String, Any>>()
+
+    companion object {
+        private const val MAX_SCAN_ENTRIES = 256
+        private const val LLTF_SUBCARRIERS = 64
+    }
+
+    /**
+     * Translates a BATCH record's contents.
+     *
+     * @param data The record after its type byte
+     * @param emit Receives each JSON message or text line
+     */
+    fun translateBatch(data: ByteArray, emit: (String) -> Unit) {
+        var pos = 1 // Skip the version
+        while (pos < data.size) {
+            val n = data[pos].toInt() and 0xFF
+            if (n < 2 || n > data.size - pos - 1) break
+            val type = data[pos + 1].toInt() and 0xFF
+            translate(type, data.copyOfRange(pos + 2, pos + 1 + n), emit)
+            pos += 1 + n
+        }
+    }
+
+    /**
+     * Translates one record.
+     *
+     * @param type Record type
+     * @param data The record after its type byte: [Version][Body][Tail]
+     * @param emit Receives each JSON message or text line
+     * @return false if the type is not one the app uses
+     */
+    fun translate(type: Int, data: ByteArray, emit: (String) -> Unit): Boolean {
+        if (data.isEmpty() || data[0].toInt() == 0) return true // Malformed
+        val r = Record(data)
+
+        when (type) {
+            ChimeraMsg.WIFI_AP -> {
+                val ssid = r.tail(10, 9) ?: return true
+                if (networks.size < MAX_SCAN_ENTRIES) {
+                    val net = mutableMapOf<String, Any>(
+                        "bssid" to r.mac(0),
+                        "channel" to r.u8(6),
+                        "rssi" to r.s8(7),
+                        "encryption" to r.u8(8)
+                    )
+                    if (ssid.isNotEmpty()) net["ssid"] = String(ssid, Charsets.UTF_8)
+                    networks.add(net)
+                }
+            }
+            ChimeraMsg.WIFI_SCAN_DONE -> {
+                if (!r.has(2)) return true
+                emit(gson.toJson(mapOf(
+                    "type" to "wifi_scan_result",
+                    "count" to networks.size,
+                    "networks" to networks.toList()
+                )))
+                networks.clear()
+            }
+            ChimeraMsg.CLIENT_PROBE -> {
+                val ssid = r.tail(9, 8) ?: return true
+                emit(gson.toJson(mapOf(
+                    "type" to "client_probe",
+                    "mac" to r.mac(0),
+                    "ssid" to String(ssid, Charsets.UTF_8),
+                    "rssi" to r.s8(6),
+                    "ch" to r.u8(7)
+                )))
+            }
+            ChimeraMsg.RECON_BEACON -> {
+                val ssid = r.tail(9, 8) ?: return true
+                if (ssid.isEmpty()) return true
+                emit(gson.toJson(mapOf(
+                    "type" to "recon",
+                    "ssid" to String(ssid, Charsets.UTF_8),
+                    "bssid" to r.mac(0),
+                    "rssi" to r.s8(6),
+                    "ch" to r.u8(7)
+                )))
+            }
+            ChimeraMsg.BLE_DEVICE -> {
+                val name = r.tail(11, 10) ?: return true
+                if (devices.size < MAX_SCAN_ENTRIES) {
+                    val dev = mutableMapOf<String, Any>(
+                        "address" to r.mac(0),
+                        "rssi" to r.s8(7)
+                    )
+                    if (name.isNotEmpty()) dev["name"] = String(name, Charsets.UTF_8)
+                    devices.add(dev)
+                }
+            }
+            ChimeraMsg.BLE_SCAN_DONE -> {
+                if (!r.has(2)) return true
+                emit(gson.toJson(mapOf(
+                    "type" to "ble_scan_result",
+                    "count" to devices.size,
+                    "devices" to devices.toList()
+                )))
+                devices.clear()
+            }
+            ChimeraMsg.PULSE -> {
+                if (!r.has(2)) return true
+                emit(gson.toJson(mapOf("type" to "pulse", "val" to r.u8(0), "ch" to r.u8(1))))
+            }
+            ChimeraMsg.SNIFF_STATS -> {
+                if (!r.has(16)) return true
+                emit(gson.toJson(mapOf(
+                    "type" to "sniff_stats",
+                    "count" to r.u32(0).coerceAtMost(Int.MAX_VALUE.toLong()),
+                    "m1" to r.u32(4),
+                    "m2" to r.u32(8),
+                    "complete" to r.u32(12)
+                )))
+            }
+            ChimeraMsg.SYS_STATUS -> {
+                if (!r.has(25)) return true
+                emit(gson.toJson(mapOf(
+                    "type" to "sys_status",
+                    "heap" to r.u32(0),
+                    "min_heap" to r.u32(4),
+                    "rssi" to r.s8(8),
+                    "tx_queued" to r.u32(9),
+                    "tx_written" to r.u32(13),
+                    "tx_dropped" to r.u32(17),
+                    "tx_high_water" to r.u32(21)
+                )))
+            }
+            ChimeraMsg.HANDSHAKE -> {
+                val eapol = r.tail(110, 108, wide = true) ?: return true
+                emit(gson.toJson(mapOf(
+                    "type" to "wifi_handshake",
+                    "ch" to r.u8(103),
+                    "rssi" to r.s8(102),
+                    "bssid" to r.mac(0),
+                    "sta_mac" to r.mac(6),
+                    "anonce" to r.hex(12, 32),
+                    "snonce" to r.hex(44, 32),
+                    "mic" to r.hex(76, 16),
+                    "eapol" to eapol.toHex(),
+                    "key_version" to r.u8(101)
+                )))
+            }
+            ChimeraMsg.LOG -> {
+                val text = r.tail(8, 7) ?: return true
+                if (text.isNotEmpty()) emit(String(text, Charsets.UTF_8))
+            }
+            ChimeraMsg.AP_UPDATE -> {
+                val ssid = r.tail(25, 24) ?: return true
+                if (r.u8(8) and ChimeraMsg.AP_GONE != 0 || ssid.isEmpty()) return true
+                emit(gson.toJson(mapOf(
+                    "type" to "recon",
+                    "ssid" to String(ssid, Charsets.UTF_8),
+                    "bssid" to r.mac(0),
+                    "rssi" to r.s8(9),
+                    "ch" to r.u8(6)
+                )))
+            }
+            ChimeraMsg.PROBE_UPDATE -> {
+                val ssid = r.tail(24, 23) ?: return true
+                if (r.u8(7) and ChimeraMsg.PROBE_NEW == 0) return true
+                emit(gson.toJson(mapOf(
+                    "type" to "client_probe",
+                    "mac" to r.mac(0),
+                    "ssid" to String(ssid, Charsets.UTF_8),
+                    "rssi" to r.s8(8),
+                    "ch" to r.u8(6)
+                )))
+            }
+            ChimeraMsg.CSI_FEATURES -> {
+                // Tail: mean amplitude per subcarrier over the motion window
+                val profile = r.tail(34, 32, wide = true) ?: return true
+                if (profile.isEmpty()) return true
+                emit(gson.toJson(mapOf(
+                    "type" to "csi",
+                    "csi_data" to profile.map { it.toInt() and 0xFF }
+                )))
+            }
+            ChimeraMsg.CSI_DATA -> {
+                // Tail: (imaginary, real) int8 pairs; plot the L-LTF amplitudes
+                val iq = r.tail(24, 22, wide = true) ?: return true
+                val n = minOf(iq.size / 2, LLTF_SUBCARRIERS)
+                if (n == 0) return true
+                val amp = (0 until n).map {
+                    val im = iq[2 * it].toInt()
+                    val re = iq[2 * it + 1].toInt()
+                    sqrt((im * im + re * re).toDouble()).toInt()
+                }
+                emit(gson.toJson(mapOf("type" to "csi", "csi_data" to amp)))
+            }
+            else -> return false
+        }
+        return true
+    }
+
+    /**
+     * Little-endian field access; offsets are into the body
+     */
+    private class Record(private val data: ByteArray) {
+        private val bodySize = data.size - 1
+
+        fun has(minBody: Int) = bodySize >= minBody
+
+        fun u8(off: Int) = data[1 + off].toInt() and 0xFF
+        fun s8(off: Int) = data[1 + off].toInt()
+        fun u16(off: Int) = u8(off) or (u8(off + 1) shl 8)
+        fun u32(off: Int) = u16(off).toLong() or (u16(off + 2).toLong() shl 16)
+
+        fun mac(off: Int) = (0 until 6).joinToString(":") { String.format("%02X", u8(off + it)) }
+        fun hex(off: Int, n: Int) = data.copyOfRange(1 + off, 1 + off + n).toHex()
+
+        /**
+         * The tail, or null if the body or the tail is short
+         *
+         * @param minBody Body size of version 1
+         * @param lenOff Offset of the tail length field
+         * @param wide Tail length is 16 bits
+         */
+        fun tail(minBody: Int, lenOff: Int, wide: Boolean = false): ByteArray? {
+            if (!has(minBody)) return null
+            val len = if (wide) u16(lenOff) else u8(lenOff)
+            if (len > bodySize - minBody) return null
+            return data.copyOfRange(data.size - len, data.size)
+        }
+    }
+}
+
+private fun ByteArray.toHex(): String = joinToString("") { String.format("%02X", it) }
@@ -4,23 +4,22 @@
  * COBS is a framing protocol that eliminates 0x00 bytes from the payload,
  * allowing 0x00 to serve as an unambiguous frame delimiter.
  * 
- * Frame Structure:
- *   [Type:1][COBS-Encoded Payload:N][Delimiter:0x00]
+ * Device -> app stream: newline-terminated text lines (JSON replies, logs)
+ * interleaved with binary frames bracketed by 0x00 on both sides:
+ *   [0x00][COBS([Type:1][Payload:N][Class:1][Seq:2 LE][CRC32:4 LE])][0x00]
  * 
- * Message Types:
- *   0x01 = JSON command (decode COBS, then parse JSON)
- *   0x02 = Spectrum data (256 RSSI values)
- *   0x03 = Raw packet (802.11 frame)
- *   0x04 = Handshake data (EAPOL fields)
- *   0x05 = CSI data (Channel State Information)
+ * The CRC-32 (as zlib) covers every decoded byte before it. Binary frames
+ * carry the records described in ChimeraRecords.kt.
  * 
- * Performance: Enables 60 FPS spectrum streaming without JSON overhead
+ * App -> device frames: [COBS([Type:1][Payload:N])][0x00]
+ *   0x01 = Text command (same as a command line)
  * 
  * @author Chimera Red Team
  */
 package com.chimera.red.protocol
 
 import android.util.Log
+import java.util.zip.CRC32
 
 /**
  * COBS Message Types
@@ -138,36 +137,51 @@ object CobsCodec {
             }
         }
         
-        // Remove trailing zero if present
-        return if (outputIndex > 0 && output[outputIndex - 1] == 0x00.toByte()) {
-            output.copyOfRange(0, outputIndex - 1)
-        } else {
-            output.copyOfRange(0, outputIndex)
-        }
+        // A trailing zero here is data (e.g. a CRC byte), not padding
+        return output.copyOfRange(0, outputIndex)
     }
 }
 
 /**
  * COBS Frame Decoder with buffering
  * 
- * Accumulates incoming bytes and extracts complete frames
- * delimited by 0x00 bytes.
+ * Splits the device stream into text lines and binary frames. A 0x00
+ * outside a frame opens one; anything else starts a text line. Frames
+ * with a bad CRC are dropped.
  */
 class CobsFrameDecoder(
     private val maxBufferSize: Int = 16384 // 16KB max buffer
 ) {
-    private val buffer = ArrayList<Byte>(1024)
+    private enum class State { IDLE, TEXT, BINARY, DISCARD }
+
+    companion object {
+        private const val TAG = "CobsFrameDecoder"
+        private const val TRAILER_LEN = 7 // [Class:1][Seq:2][CRC32:4]
+        private const val DELIMITER: Byte = 0x00
+        private const val NEWLINE: Byte = 0x0A
+    }
+
+    private val buffer = ByteArray(maxBufferSize)
+    private var length = 0
+    private var state = State.IDLE
     private var framesDecoded = 0L
+    private var badFrames = 0L
+    private var linesDecoded = 0L
     private var bytesProcessed = 0L
     
     /**
-     * Callback for decoded frames
+     * Callback for decoded frames (trailer removed)
      */
     var onFrame: ((CobsFrame) -> Unit)? = null
+
+    /**
+     * Callback for text lines (newline removed)
+     */
+    var onText: ((String) -> Unit)? = null
     
     /**
      * Feeds new data into the decoder.
-     * Complete frames will trigger the onFrame callback.
+     * Complete frames and lines trigger the onFrame and onText callbacks.
      * 
      * @param data New bytes to process
      */
@@ -175,46 +189,93 @@ class CobsFrameDecoder(
         bytesProcessed += data.size
         
         for (byte in data) {
-            if (byte == 0x00.toByte()) {
-                // Frame delimiter - process accumulated data
-                if (buffer.isNotEmpty()) {
-                    processFrame()
+            when (state) {
+                State.IDLE -> when (byte) {
+                    DELIMITER -> state = State.BINARY
+                    NEWLINE -> {}
+                    else -> {
+                        buffer[0] = byte
+                        length = 1
+                        state = State.TEXT
+                    }
                 }
-            } else {
-                buffer.add(byte)
-                
-                // Prevent buffer overflow
-                if (buffer.size > maxBufferSize) {
-                    Log.w("CobsFrameDecoder", "Buffer overflow, discarding ${buffer.size} bytes")
-                    buffer.clear()
+                State.TEXT -> when (byte) {
+                    NEWLINE -> {
+                        processLine()
+                        state = State.IDLE
+                    }
+                    DELIMITER -> {
+                        // Line cut short by a frame (device reset mid-line)
+                        processLine()
+                        state = State.BINARY
+                    }
+                    else -> append(byte)
+                }
+                State.BINARY -> when (byte) {
+                    DELIMITER -> {
+                        // Back-to-back delimiters are empty frames
+                        if (length > 0) {
+                            processFrame()
+                            state = State.IDLE
+                        }
+                    }
+                    else -> append(byte)
+                }
+                State.DISCARD -> if (byte == DELIMITER || byte == NEWLINE) {
+                    length = 0
+                    state = State.IDLE
                 }
             }
         }
     }
+
+    private fun append(byte: Byte) {
+        if (length < buffer.size) {
+            buffer[length++] = byte
+        } else {
+            // Prevent buffer overflow
+            Log.w(TAG, "Buffer overflow, discarding $length bytes")
+            length = 0
+            state = State.DISCARD
+        }
+    }
+
+    private fun processLine() {
+        val line = String(buffer, 0, length, Charsets.UTF_8).trim()
+        length = 0
+        if (line.isNotEmpty()) {
+            linesDecoded++
+            onText?.invoke(line)
+        }
+    }
     
     private fun processFrame() {
-        if (buffer.isEmpty()) return
-        
         try {
-            val encoded = buffer.toByteArray()
-            val decoded = CobsCodec.decode(encoded)
-            
-            if (decoded.isNotEmpty()) {
-                val type = decoded[0]
-                val payload = if (decoded.size > 1) {
-                    decoded.copyOfRange(1, decoded.size)
-                } else {
-                    byteArrayOf()
-                }
-                
-                framesDecoded++
-                onFrame?.invoke(CobsFrame(type, payload))
+            val decoded = CobsCodec.decode(buffer.copyOfRange(0, length))
+            val n = decoded.size - TRAILER_LEN
+            if (n < 1) {
+                badFrames++
+                return
+            }
+
+            var sent = 0L
+            for (i in 3 downTo 0) {
+                sent = (sent shl 8) or (decoded[n + 3 + i].toLong() and 0xFF)
             }
+            val crc = CRC32()
+            crc.update(decoded, 0, n + 3)
+            if (crc.value != sent) {
+                badFrames++
+                return
+            }
+
+            framesDecoded++
+            onFrame?.invoke(CobsFrame(decoded[0], decoded.copyOfRange(1, n)))
         } catch (e: Exception) {
-            Log.e("CobsFrameDecoder", "Failed to decode frame: ${e.message}")
+            Log.e(TAG, "Failed to decode frame: ${e.message}")
+        } finally {
+            length = 0
         }
-        
-        buffer.clear()
     }
     
     /**
@@ -222,14 +283,15 @@ class CobsFrameDecoder(
      * Call this after a connection reset to clear partial frames.
      */
     fun reset() {
-        buffer.clear()
+        length = 0
+        state = State.IDLE
     }
     
     /**
      * Returns statistics about decoder performance.
      */
     fun getStats(): String {
-        return "COBS: $framesDecoded frames, $bytesProcessed bytes"
+        return "COBS: $framesDecoded frames ($badFrames bad), $linesDecoded lines, $bytesProcessed bytes"
     }
 }
 
@@ -3,6 +3,8 @@ package com.chimera.red
 import org.junit.Assert.*
 import org.junit.Test
 import org.junit.Before
+import com.chimera.red.protocol.ChimeraMsg
+import com.chimera.red.protocol.RecordTranslator
 
 /**
  * Chimera Red - Android Unit Tests
@@ -324,4 +326,48 @@ class ChimeraUnitTests {
         val status = "Error: USB disconnected"
         assertTrue(status.contains("Error", ignoreCase = true))
     }
+
+    // ============== Binary Record Tests ==============
+
+    private fun bytes(vararg values: Int) = ByteArray(values.size) { values[it].toByte() }
+
+    @Test
+    fun `WiFi scan records become one scan result`() {
+        val out = mutableListOf<String>()
+        val translator = RecordTranslator()
+        // [version][bssid:6][channel][rssi][authmode][ssid_len]["Lab"]
+        val ap = bytes(1, 0xAA, 0xBB, 0xCC, 0x00, 0x11, 0x22, 6, -60, 3, 3) + "Lab".toByteArray()
+        assertTrue(translator.translate(ChimeraMsg.WIFI_AP, ap) { out.add(it) })
+        assertTrue(out.isEmpty())
+
+        translator.translate(ChimeraMsg.WIFI_SCAN_DONE, bytes(1, 1, 0)) { out.add(it) }
+        assertEquals(1, out.size)
+        assertTrue(out[0].contains("\"type\":\"wifi_scan_result\""))
+        assertTrue(out[0].contains("\"bssid\":\"AA:BB:CC:00:11:22\""))
+        assertTrue(out[0].contains("\"ssid\":\"Lab\""))
+        assertTrue(out[0].contains("\"rssi\":-60"))
+    }
+
+    @Test
+    fun `Batched pulse record is translated`() {
+        val out = mutableListOf<String>()
+        // [version][len][type][version][level][channel]
+        val batch = bytes(1, 4, ChimeraMsg.PULSE, 1, 42, 11)
+        RecordTranslator().translateBatch(batch) { out.add(it) }
+        assertEquals(1, out.size)
+        assertTrue(out[0].contains("\"val\":42"))
+        assertTrue(out[0].contains("\"ch\":11"))
+    }
+
+    @Test
+    fun `Short record is dropped`() {
+        val out = mutableListOf<String>()
+        assertTrue(RecordTranslator().translate(ChimeraMsg.HANDSHAKE, bytes(1, 0, 0)) { out.add(it) })
+        assertTrue(out.isEmpty())
+    }
+
+    @Test
+    fun `Unknown record type is not translated`() {
+        assertFalse(RecordTranslator().translate(0x7F, bytes(1)) { })
+    }
 }
@@ -0,0 +1,383 @@
+/**
+ * @file ap_table.c
+ * @brief Access point table for recon mode with delta-only reporting
+ */
+#include "ap_table.h"
+
+#include "chimera_proto.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_wifi.h"
+#include "serial_comm.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "ap_table";
+
+typedef struct {
+  bool used;
+  uint8_t bssid[6];
+  uint8_t ssid_len; // 0 = hidden (or not yet known)
+  uint8_t ssid[32];
+  uint8_t channel;
+  uint8_t authmode; // wifi_auth_mode_t
+  uint8_t dirty;    // CHIMERA_AP_* changes not yet reported
+  int8_t rssi_min;
+  int8_t rssi_max;
+  int8_t rssi_reported; // rssi_avg in the last update
+  int16_t rssi_ewma;    // dBm x 16
+  uint32_t beacons;
+  uint32_t first_seen_ms;
+  uint32_t last_seen_ms;
+  uint32_t reported_ms;
+} ap_entry_t;
+
+static ap_entry_t *g_slots = NULL;
+static uint32_t g_slot_count = 0;
+static uint32_t g_entries = 0;
+static uint32_t g_cursor = 0; // Next slot the report pass looks at
+static uint32_t g_last_pass_ms = 0;
+static atomic_bool g_reset_req = false;
+
+static atomic_uint_fast32_t g_updates = 0;
+static atomic_uint_fast32_t g_expired = 0;
+static atomic_uint_fast32_t g_full = 0;
+
+// ---------------- Hash table ----------------
+
+static uint32_t bssid_slot(const uint8_t *bssid) {
+  uint32_t h = 2166136261u; // FNV-1a
+  for (int i = 0; i < 6; i++) {
+    h = (h ^ bssid[i]) * 16777619u;
+  }
+  return h & (g_slot_count - 1);
+}
+
+/**
+ * @brief Find a BSSID's slot, or the empty slot it would go in
+ */
+static uint32_t find_slot(const uint8_t *bssid) {
+  uint32_t mask = g_slot_count - 1;
+  uint32_t i = bssid_slot(bssid);
+  while (g_slots[i].used && memcmp(g_slots[i].bssid, bssid, 6) != 0) {
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+/**
+ * @brief Empty a slot, shifting later entries of its probe run back
+ */
+static void remove_slot(uint32_t i) {
+  uint32_t mask = g_slot_count - 1;
+  uint32_t j = i;
+  for (;;) {
+    j = (j + 1) & mask;
+    if (!g_slots[j].used) {
+      break;
+    }
+    // Entry j may fill the hole unless its home slot lies in (i, j]
+    uint32_t home = bssid_slot(g_slots[j].bssid);
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      g_slots[i] = g_slots[j];
+      i = j;
+    }
+  }
+  g_slots[i].used = false;
+  g_entries--;
+}
+
+static void apply_reset(void) {
+  if (atomic_exchange(&g_reset_req, false)) {
+    memset(g_slots, 0, sizeof(ap_entry_t) * g_slot_count);
+    g_entries = 0;
+    g_cursor = 0;
+  }
+}
+
+esp_err_t ap_table_init(void) {
+  if (g_slots) {
+    return ESP_OK;
+  }
+
+  g_slot_count = AP_TABLE_SLOTS;
+  g_slots = heap_caps_calloc(g_slot_count, sizeof(ap_entry_t),
+                             MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!g_slots) {
+    g_slot_count = AP_TABLE_SLOTS_INTERNAL;
+    g_slots = heap_caps_calloc(g_slot_count, sizeof(ap_entry_t),
+                               MALLOC_CAP_8BIT);
+  }
+  if (!g_slots) {
+    g_slot_count = 0;
+    ESP_LOGE(TAG, "Failed to allocate AP table");
+    return ESP_ERR_NO_MEM;
+  }
+
+  g_entries = 0;
+  g_cursor = 0;
+  ESP_LOGI(TAG, "AP table: %lu slots", (unsigned long)g_slot_count);
+  return ESP_OK;
+}
+
+void ap_table_deinit(void) {
+  heap_caps_free(g_slots);
+  g_slots = NULL;
+  g_slot_count = 0;
+  g_entries = 0;
+}
+
+void ap_table_reset(void) { atomic_store(&g_reset_req, true); }
+
+// ---------------- Beacon parsing ----------------
+
+typedef struct {
+  const uint8_t *ssid;
+  uint8_t ssid_len;
+  uint8_t channel; // 0 if absent
+  uint8_t authmode;
+} beacon_info_t;
+
+static uint8_t rsn_authmode(const uint8_t *ie, int len, bool wpa1) {
+  // version(2) group(4) pairwise count(2) + 4n, AKM count(2) + 4m
+  bool psk = false, sae = false, eap = false;
+  if (len >= 8) {
+    int n = ie[6] | (ie[7] << 8);
+    int pos = 8 + 4 * n;
+    if (pos + 2 <= len) {
+      int m = ie[pos] | (ie[pos + 1] << 8);
+      pos += 2;
+      for (int k = 0; k < m && pos + 4 <= len; k++, pos += 4) {
+        switch (ie[pos + 3]) {
+        case 1: // 802.1X
+        case 5:
+          eap = true;
+          break;
+        case 8: // SAE
+          sae = true;
+          break;
+        default: // PSK, PSK-SHA256, FT-PSK
+          psk = true;
+          break;
+        }
+      }
+    }
+  }
+
+  if (sae) {
+    return psk ? WIFI_AUTH_WPA2_WPA3_PSK : WIFI_AUTH_WPA3_PSK;
+  }
+  if (eap && !psk) {
+    return WIFI_AUTH_WPA2_ENTERPRISE;
+  }
+  return wpa1 ? WIFI_AUTH_WPA_WPA2_PSK : WIFI_AUTH_WPA2_PSK;
+}
+
+static void parse_beacon(const uint8_t *frame, int len, beacon_info_t *info) {
+  static const uint8_t WPA_OUI[] = {0x00, 0x50, 0xF2, 0x01};
+  const uint8_t *rsn = NULL;
+  int rsn_len = 0;
+  bool wpa1 = false;
+
+  memset(info, 0, sizeof(*info));
+
+  // Fixed fields: timestamp(8) interval(2) capability(2)
+  int pos = 36;
+  while (pos + 2 <= len) {
+    uint8_t id = frame[pos];
+    uint8_t ie_len = frame[pos + 1];
+    const uint8_t *ie = frame + pos + 2;
+    if (pos + 2 + ie_len > len) {
+      break;
+    }
+    if (id == 0 && ie_len <= 32) {
+      info->ssid = ie;
+      info->ssid_len = ie_len;
+    } else if (id == 3 && ie_len == 1) {
+      info->channel = ie[0];
+    } else if (id == 48) {
+      rsn = ie;
+      rsn_len = ie_len;
+    } else if (id == 221 && ie_len >= 4 && memcmp(ie, WPA_OUI, 4) == 0) {
+      wpa1 = true;
+    }
+    pos += 2 + ie_len;
+  }
+
+  // All-zero SSIDs are hidden networks padding the real length
+  bool blank = true;
+  for (int i = 0; i < info->ssid_len; i++) {
+    blank = blank && info->ssid[i] == 0;
+  }
+  if (blank) {
+    info->ssid_len = 0;
+  }
+
+  bool privacy = frame[34] & 0x10;
+  if (rsn) {
+    info->authmode = rsn_authmode(rsn, rsn_len, wpa1);
+  } else if (wpa1) {
+    info->authmode = WIFI_AUTH_WPA_PSK;
+  } else if (privacy) {
+    info->authmode = WIFI_AUTH_WEP;
+  } else {
+    info->authmode = WIFI_AUTH_OPEN;
+  }
+}
+
+// ---------------- Updates ----------------
+
+void ap_table_beacon(const uint8_t *frame, int len, int8_t rssi,
+                     uint8_t channel, uint32_t now_ms) {
+  if (!g_slots || len < 36) {
+    return;
+  }
+  apply_reset();
+
+  beacon_info_t info;
+  parse_beacon(frame, len, &info);
+  if (info.channel) {
+    channel = info.channel; // Off-channel reception happens
+  }
+
+  const uint8_t *bssid = frame + 16;
+  uint32_t i = find_slot(bssid);
+  ap_entry_t *e = &g_slots[i];
+
+  if (!e->used) {
+    if (g_entries >= g_slot_count / 4 * 3) {
+      atomic_fetch_add(&g_full, 1);
+      return;
+    }
+    memset(e, 0, sizeof(*e));
+    e->used = true;
+    memcpy(e->bssid, bssid, 6);
+    if (info.ssid_len) {
+      e->ssid_len = info.ssid_len;
+      memcpy(e->ssid, info.ssid, info.ssid_len);
+    }
+    e->channel = channel;
+    e->authmode = info.authmode;
+    e->rssi_ewma = rssi * 16;
+    e->rssi_min = rssi;
+    e->rssi_max = rssi;
+    e->rssi_reported = rssi;
+    e->first_seen_ms = now_ms;
+    e->dirty = CHIMERA_AP_NEW;
+    g_entries++;
+  } else {
+    // A hidden beacon does not erase an SSID a probe response revealed
+    if (info.ssid_len &&
+        (info.ssid_len != e->ssid_len ||
+         memcmp(info.ssid, e->ssid, info.ssid_len) != 0)) {
+      e->ssid_len = info.ssid_len;
+      memcpy(e->ssid, info.ssid, info.ssid_len);
+      e->dirty |= CHIMERA_AP_SSID;
+    }
+    if (channel != e->channel) {
+      e->channel = channel;
+      e->dirty |= CHIMERA_AP_CHANNEL;
+    }
+    if (info.authmode != e->authmode) {
+      e->authmode = info.authmode;
+      e->dirty |= CHIMERA_AP_SECURITY;
+    }
+    e->rssi_ewma += (rssi * 16 - e->rssi_ewma) / 8;
+    if (rssi < e->rssi_min) {
+      e->rssi_min = rssi;
+    }
+    if (rssi > e->rssi_max) {
+      e->rssi_max = rssi;
+    }
+  }
+
+  e->beacons++;
+  e->last_seen_ms = now_ms;
+}
+
+static int8_t rssi_avg(const ap_entry_t *e) {
+  int v = e->rssi_ewma;
+  return (int8_t)((v >= 0 ? v + 8 : v - 8) / 16);
+}
+
+static void send_update(const ap_entry_t *e, uint8_t flags) {
+  chimera_ap_update_t rec = {
+      .channel = e->channel,
+      .authmode = e->authmode,
+      .flags = flags,
+      .rssi_avg = rssi_avg(e),
+      .rssi_min = e->rssi_min,
+      .rssi_max = e->rssi_max,
+      .beacons = e->beacons,
+      .first_seen_ms = e->first_seen_ms,
+      .last_seen_ms = e->last_seen_ms,
+      .ssid_len = e->ssid_len,
+  };
+  memcpy(rec.bssid, e->bssid, 6);
+  serial_send_record(CHIMERA_MSG_AP_UPDATE, CHIMERA_AP_UPDATE_VERSION, &rec,
+                     sizeof(rec), e->ssid, e->ssid_len);
+  atomic_fetch_add(&g_updates, 1);
+}
+
+void ap_table_report(uint32_t now_ms) {
+  if (!g_slots) {
+    return;
+  }
+  apply_reset();
+  if (now_ms - g_last_pass_ms < AP_TABLE_REPORT_MS) {
+    return;
+  }
+  g_last_pass_ms = now_ms;
+
+  // Resume where the last pass stopped so a burst of changes is spread
+  // over several passes instead of starving the end of the table
+  uint32_t mask = g_slot_count - 1;
+  int sent = 0;
+  for (uint32_t n = 0; n < g_slot_count && sent < AP_TABLE_REPORT_MAX; n++) {
+    uint32_t i = g_cursor;
+    g_cursor = (g_cursor + 1) & mask;
+    ap_entry_t *e = &g_slots[i];
+    if (!e->used) {
+      continue;
+    }
+
+    if (now_ms - e->last_seen_ms >= AP_TABLE_EXPIRE_MS) {
+      send_update(e, CHIMERA_AP_GONE);
+      remove_slot(i);
+      atomic_fetch_add(&g_expired, 1);
+      g_cursor = i; // An entry may have shifted into this slot
+      sent++;
+      continue;
+    }
+
+    int8_t avg = rssi_avg(e);
+    if (abs(avg - e->rssi_reported) >= AP_TABLE_RSSI_DELTA) {
+      e->dirty |= CHIMERA_AP_RSSI;
+    }
+    if (!e->dirty && now_ms - e->reported_ms >= AP_TABLE_REFRESH_MS &&
+        (int32_t)(e->last_seen_ms - e->reported_ms) > 0) {
+      e->dirty = CHIMERA_AP_REFRESH;
+    }
+    if (!e->dirty) {
+      continue;
+    }
+
+    send_update(e, e->dirty);
+    e->dirty = 0;
+    e->reported_ms = now_ms;
+    e->rssi_reported = avg;
+    sent++;
+  }
+}
+
+void ap_table_get_stats(ap_table_stats_t *stats) {
+  if (!stats) {
+    return;
+  }
+  stats->entries = g_entries;
+  stats->capacity = g_slot_count / 4 * 3;
+  stats->updates = atomic_load(&g_updates);
+  stats->expired = atomic_load(&g_expired);
+  stats->full = atomic_load(&g_full);
+}
@@ -0,0 +1,80 @@
+/**
+ * @file ap_table.h
+ * @brief Access point table for recon mode with delta-only reporting
+ *
+ * Beacons and probe responses update one entry per BSSID (SSID, channel,
+ * security, beacon count, RSSI average/min/max, first/last seen) in an
+ * open-addressed hash table, preferably in PSRAM. A periodic report sends
+ * an AP_UPDATE record only for entries that are new or changed since their
+ * last update, plus a low-rate refresh for APs still being heard and a
+ * final GONE update when an AP expires. Updates are small enough for the
+ * serial record aggregator to pack into batches.
+ *
+ * Owned by the sniffer packet worker: ap_table_beacon() and
+ * ap_table_report() must be called from that task only.
+ */
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AP_TABLE_SLOTS 512         // Power of two; PSRAM
+#define AP_TABLE_SLOTS_INTERNAL 64 // Without PSRAM
+#define AP_TABLE_REPORT_MS 1000    // Report pass interval
+#define AP_TABLE_REPORT_MAX 64     // Updates per pass; the rest wait
+#define AP_TABLE_REFRESH_MS 30000  // Refresh an unchanged, live AP
+#define AP_TABLE_EXPIRE_MS 300000  // Drop an AP not heard for this long
+#define AP_TABLE_RSSI_DELTA 4      // dB change of the average worth a report
+
+typedef struct {
+  uint32_t entries;  // APs in the table
+  uint32_t capacity; // Most APs the table holds (3/4 of the slots)
+  uint32_t updates;  // AP_UPDATE records sent
+  uint32_t expired;  // APs dropped after AP_TABLE_EXPIRE_MS
+  uint32_t full;     // Sightings of new APs lost to a full table
+} ap_table_stats_t;
+
+/**
+ * @brief Allocate the table (once)
+ */
+esp_err_t ap_table_init(void);
+
+/**
+ * @brief Free the table
+ */
+void ap_table_deinit(void);
+
+/**
+ * @brief Forget every AP (any task; applied by the packet worker)
+ */
+void ap_table_reset(void);
+
+/**
+ * @brief Account a beacon or probe response
+ * @param frame 802.11 management frame
+ * @param len Frame length
+ * @param rssi Receive RSSI (dBm)
+ * @param channel Receive channel (used if the frame has no DS parameter)
+ * @param now_ms Current time
+ */
+void ap_table_beacon(const uint8_t *frame, int len, int8_t rssi,
+                     uint8_t channel, uint32_t now_ms);
+
+/**
+ * @brief Send due updates (call often; paces itself)
+ */
+void ap_table_report(uint32_t now_ms);
+
+/**
+ * @brief Snapshot table counters
+ */
+void ap_table_get_stats(ap_table_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -24,6 +24,7 @@
 #include "host/util/util.h"
 #include "nimble/nimble_port.h"
 #include "nimble/nimble_port_freertos.h"
+#include "scope.h"
 #include "serial_comm.h"
 #include "services/gap/ble_svc_gap.h"
 #include "services/gatt/ble_svc_gatt.h"
@@ -241,6 +242,9 @@ esp_err_t ble_spam_start(const char *type, int count) {
     ESP_LOGE(TAG, "BLE not ready");
     return ESP_ERR_INVALID_STATE;
   }
+  if (!scope_tx_allowed(NULL)) {
+    return ESP_ERR_NOT_ALLOWED;
+  }
 
   if (count <= 0)
     count = 50; // Default
@@ -391,6 +395,15 @@ static int ble_gap_event_handler(struct ble_gap_event *event, void *arg) {
     if (!cb)
       break;
 
+    // NimBLE stores addresses little-endian; the scope holds them as printed
+    uint8_t addr[6];
+    for (int i = 0; i < 6; i++)
+      addr[i] = event->disc.addr.val[5 - i];
+    if (!scope_addr_allowed(addr)) {
+      scope_note_hidden();
+      break;
+    }
+
     ble_device_t dev = {0};
     memcpy(dev.addr, event->disc.addr.val, 6);
     dev.addr_type = event->disc.addr.type;
@@ -50,7 +50,8 @@ void ble_scanner_deinit(void);
 
 /**
  * @brief Start BLE scanning
- * @param callback Called for each discovered device (may be NULL)
+ * @param callback Called for each discovered device in the engagement scope
+ * (may be NULL)
  * @param complete_cb Called when scan completes (may be NULL)
  * @param duration_ms Scan duration in milliseconds (0 = indefinite)
  * @return ESP_OK on success
@@ -77,7 +78,8 @@ bool ble_is_scanning(void);
  *
  * @param type Spam type: "SAMSUNG", "APPLE", "GOOGLE", "BENDER" (default if NULL)
  * @param count Number of advertisement bursts
- * @return ESP_OK on success
+ * @return ESP_OK on success, ESP_ERR_NOT_ALLOWED while an engagement scope
+ * is enforced (advertising cannot be aimed at in-scope devices only)
  */
 esp_err_t ble_spam_start(const char *type, int count);
 
@@ -0,0 +1,401 @@
+/**
+ * @file chimera_proto.h
+ * @brief Binary telemetry record schema shared by firmware and host
+ *
+ * Every telemetry message is a fixed-layout, little-endian record sent as
+ * one COBS frame:
+ *
+ *   0x00 | COBS( [msg_type:1][schema_version:1][body][tail][trailer] ) | 0x00
+ *
+ * - msg_type is one of chimera_msg_type_t and doubles as the COBS frame type
+ * - schema_version is per message type; a version bump may only append
+ *   fields to the body, so decoders accept any body at least as long as
+ *   the layout they know and ignore the rest
+ * - tail is an optional variable-length field (SSID, name, EAPOL frame,
+ *   raw 802.11 frame, CSI data or amplitude profile)
+ *   whose length is carried in the body
+ *
+ * Small records may be packed into one CHIMERA_MSG_BATCH frame:
+ *
+ *   [CHIMERA_MSG_BATCH][1] + N x ( [len:1][msg_type][schema_version][...] )
+ *
+ * Every device -> host binary frame (records, batches, command frames) ends
+ * with a chimera_frame_trailer_t inside the COBS encoding. The sequence
+ * number counts frames per traffic class, so a gap means frames of that
+ * class were lost; critical frames can be requested again (see
+ * SERIAL_RX_FRAME_RETRANSMIT in the firmware's serial_comm.h).
+ *
+ * This header is plain C11/C++11 and is compiled unchanged by the host decoder
+ * (host/chimera_decode.h).
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHIMERA_PACKED __attribute__((packed))
+
+#ifdef __cplusplus
+#define CHIMERA_STATIC_ASSERT static_assert
+#else
+#define CHIMERA_STATIC_ASSERT _Static_assert
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "chimera_proto.h records are little-endian; add byte swapping"
+#endif
+
+// ---------------- Message types ----------------
+
+typedef enum {
+  CHIMERA_MSG_CSI_DATA = 0x05,       // Channel state information of a frame
+  CHIMERA_MSG_BATCH = 0x30,          // Container of length-prefixed records
+  CHIMERA_MSG_WIFI_AP = 0x40,        // One scanned access point
+  CHIMERA_MSG_WIFI_SCAN_DONE = 0x41, // End of a scan
+  CHIMERA_MSG_CLIENT_PROBE = 0x42,   // Probe request (superseded)
+  CHIMERA_MSG_RECON_BEACON = 0x43,   // Beacon (superseded by AP_UPDATE)
+  CHIMERA_MSG_PULSE = 0x44,          // Averaged RSSI activity meter
+  CHIMERA_MSG_SNIFF_STATS = 0x45,    // Sniffer packet/handshake counters
+  CHIMERA_MSG_SYS_STATUS = 0x46,     // Periodic heap and link status
+  CHIMERA_MSG_BLE_DEVICE = 0x47,     // One BLE advertiser
+  CHIMERA_MSG_BLE_SCAN_DONE = 0x48,  // End of a BLE scan
+  CHIMERA_MSG_HANDSHAKE = 0x49,      // Complete WPA 4-way handshake (M1+M2)
+  CHIMERA_MSG_LOG = 0x4A,            // One ESP_LOG message
+  CHIMERA_MSG_RAW_FRAME = 0x4B,      // Captured 802.11 frame (raw streaming)
+  CHIMERA_MSG_FILE_CHUNK = 0x4C,     // Part of a stored capture file
+  CHIMERA_MSG_AP_UPDATE = 0x4D,      // New or changed access point (recon)
+  CHIMERA_MSG_PROBE_UPDATE = 0x4E,   // Client/SSID probe counters
+  CHIMERA_MSG_HOP_STATS = 0x4F,      // Channel hopping plan and timing
+  CHIMERA_MSG_SURVEY = 0x50,         // Per-channel utilization snapshot
+  CHIMERA_MSG_CSI_FEATURES = 0x51,   // CSI features/motion of a transmitter
+  CHIMERA_MSG_RADIO_MODE = 0x52,     // Radio mode transition and its latency
+} chimera_msg_type_t;
+
+// ---------------- Frame trailer ----------------
+
+// Traffic classes (trailer cls field)
+#define CHIMERA_CLASS_CRITICAL 0  // Handshakes, command frames
+#define CHIMERA_CLASS_STATE 1     // Scan results, probes, beacons, BLE
+#define CHIMERA_CLASS_TELEMETRY 2 // Pulse, stats, sys_status, logs
+#define CHIMERA_CLASS_COUNT 3
+
+typedef struct CHIMERA_PACKED {
+  uint8_t cls;  // CHIMERA_CLASS_*
+  uint16_t seq; // Per-class frame counter, wraps
+  uint32_t crc; // CRC-32 (IEEE, as zlib) of every frame byte before it
+} chimera_frame_trailer_t;
+
+#define CHIMERA_FRAME_TRAILER_LEN 7
+
+// ---------------- Records ----------------
+
+typedef struct CHIMERA_PACKED {
+  uint8_t type;    // chimera_msg_type_t
+  uint8_t version; // Schema version of this message type
+} chimera_rec_hdr_t;
+
+#define CHIMERA_WIFI_AP_VERSION 1
+typedef struct CHIMERA_PACKED {
+  uint8_t bssid[6];
+  uint8_t channel;
+  int8_t rssi;
+  uint8_t authmode; // wifi_auth_mode_t
+  uint8_t ssid_len; // Tail: SSID bytes (0 = hidden)
+} chimera_wifi_ap_t;
+
+#define CHIMERA_WIFI_SCAN_DONE_VERSION 1
+typedef struct CHIMERA_PACKED {
+  uint16_t count; // Number of WIFI_AP records sent for this scan
+} chimera_wifi_scan_done_t;
+
+#define CHIMERA_CLIENT_PROBE_VERSION 1
+typedef struct CHIMERA_PACKED {
+  uint8_t mac[6]; // Probing station
+  int8_t rssi;
+  uint8_t channel;
+  uint8_t ssid_len; // Tail: requested SSID
+} chimera_client_probe_t;
+
+#define CHIMERA_RECON_BEACON_VERSION 1
+typedef struct CHIMERA_PACKED {
+  uint8_t bssid[6];
+  int8_t rssi;
+  uint8_t channel;
+  uint8_t ssid_len; // Tail: SSID
+} chimera_recon_beacon_t;
+
+#define CHIMERA_PULSE_VERSION 1
+typedef struct CHIMERA_PACKED {
+  uint8_t level; // 0-100, scaled from the average RSSI of recent packets
+  uint8_t channel;
+} chimera_pulse_t;
+
+#define CHIMERA_SNIFF_STATS_VERSION 3
+typedef struct CHIMERA_PACKED {
+  uint32_t packets;
+  uint32_t m1;
+  uint32_t m2;
+  uint32_t complete; // M2s paired with their M1 (HANDSHAKE records)
+  // v2: packet ring losses
+  uint32_t dropped_full; // Wanted frames lost to a full packet ring
+  uint32_t filtered;     // Frames skipped by the capture pre-filter
+  // v3: handshake tracker
+  uint32_t m3;
+  uint32_t m4;
+  uint32_t completed; // Exchanges followed through M4
+  uint32_t unmatched; // M2-M4 with no matching earlier message
+  uint32_t evicted;   // Exchanges waiting for M2 pushed out by others
+} chimera_sniff_stats_t;
+
+#define CHIMERA_BATCH_VERSION 1
+
+#define CHIMERA_SYS_STATUS_VERSION 4
+typedef struct CHIMERA_PACKED {
+  uint32_t heap;
+  uint32_t min_heap;
+  int8_t rssi; // Station link RSSI, 0 if not associated
+  uint32_t tx_queued;
+  uint32_t tx_written;
+  uint32_t tx_dropped;
+  uint32_t tx_high_water;
+  // v2
+  uint16_t agg_ratio_x100;     // Records per batch frame, x100
+  uint16_t agg_latency_avg_us; // Mean latency added by batching (saturates)
+  uint16_t agg_latency_max_us; // Worst latency added by batching (saturates)
+  // v3: messages lost per traffic class (rejected or evicted)
+  uint32_t drop_critical;
+  uint32_t drop_state;
+  uint32_t drop_telemetry;
+  // v4: host flow control
+  uint32_t fc_credit; // Bytes the device may still write, UINT32_MAX = off
+  uint32_t fc_stalls; // Times TX ran out of credit
+} chimera_sys_status_t;
+
+#define CHIMERA_BLE_DEVICE_VERSION 1
+typedef struct CHIMERA_PACKED {
+  uint8_t addr[6];
+  uint8_t addr_type;
+  int8_t rssi;
+  uint16_t manufacturer_id; // 0 if not advertised
+  uint8_t name_len;         // Tail: device name (0 = none)
+} chimera_ble_device_t;
+
+#define CHIMERA_BLE_SCAN_DONE_VERSION 1
+typedef struct CHIMERA_PACKED {
+  uint16_t count;
+} chimera_ble_scan_done_t;
+
+#define CHIMERA_HANDSHAKE_VERSION 1
+typedef struct CHIMERA_PACKED {
+  uint8_t bssid[6];
+  uint8_t sta[6];
+  uint8_t anonce[32];
+  uint8_t snonce[32];
+  uint8_t mic[16];
+  uint8_t replay_counter[8];
+  uint8_t key_desc_type;
+  uint8_t key_desc_version;
+  int8_t rssi;
+  uint8_t channel;
+  uint32_t timestamp_ms;
+  uint16_t eapol_len; // Tail: M2 EAPOL frame
+} chimera_handshake_t;
+
+#define CHIMERA_LOG_VERSION 1
+typedef struct CHIMERA_PACKED {
+  uint32_t timestamp_ms; // esp_log_timestamp()
+  uint8_t level;         // esp_log_level_t (1 = error .. 5 = verbose)
+  uint16_t suppressed;   // Messages rate-limited away since the last record
+  uint8_t text_len;      // Tail: "tag: message", no newline or colour codes
+} chimera_log_t;
+
+// chimera_raw_frame_t.flags
+#define CHIMERA_RAW_FCS 0x01       // Frame ends with its 4-byte FCS
+#define CHIMERA_RAW_HT 0x02        // HT/VHT frame: mcs is valid, rate is 0
+#define CHIMERA_RAW_40MHZ 0x04     // 40 MHz channel width
+#define CHIMERA_RAW_SHORT_GI 0x08  // Short guard interval
+#define CHIMERA_RAW_SHORT_PRE 0x10 // Short preamble (DSSS/CCK rates)
+
+#define CHIMERA_RAW_FRAME_VERSION 1
+typedef struct CHIMERA_PACKED {
+  uint32_t timestamp_us; // Receive time, device clock (wraps every ~71 min)
+  uint16_t orig_len;     // Frame length on air, FCS included
+  uint8_t channel;
+  int8_t rssi;        // dBm
+  int8_t noise_floor; // dBm
+  uint8_t rate;       // Legacy rate in 500 kb/s units (0 for HT)
+  uint8_t mcs;        // HT MCS index
+  uint8_t flags;      // CHIMERA_RAW_*
+  uint16_t cap_len;   // Tail: the first cap_len bytes of the frame
+} chimera_raw_frame_t;
+
+// chimera_file_chunk_t.flags
+#define CHIMERA_FILE_INDEX 0x01 // Chunk of capNNNN.idx, not capNNNN.pcapng
+
+#define CHIMERA_FILE_CHUNK_VERSION 1
+typedef struct CHIMERA_PACKED {
+  uint16_t file_id;  // Capture number
+  uint8_t flags;     // CHIMERA_FILE_*
+  uint32_t offset;   // Offset of this chunk in the file
+  uint32_t total;    // File size
+  uint16_t data_len; // Tail: file bytes
+} chimera_file_chunk_t;
+
+// chimera_ap_update_t.flags: why the entry was sent
+#define CHIMERA_AP_NEW 0x01      // First sighting
+#define CHIMERA_AP_SSID 0x02     // SSID changed (or revealed)
+#define CHIMERA_AP_CHANNEL 0x04  // Channel changed
+#define CHIMERA_AP_SECURITY 0x08 // Security changed
+#define CHIMERA_AP_RSSI 0x10     // Average RSSI moved since the last update
+#define CHIMERA_AP_REFRESH 0x20  // Unchanged, still being heard
+#define CHIMERA_AP_GONE 0x40     // Not heard for a while; entry dropped
+
+#define CHIMERA_AP_UPDATE_VERSION 1
+typedef struct CHIMERA_PACKED {
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t authmode; // wifi_auth_mode_t, derived from the beacon IEs
+  uint8_t flags;    // CHIMERA_AP_*
+  int8_t rssi_avg;  // Moving average, dBm
+  int8_t rssi_min;
+  int8_t rssi_max;
+  uint32_t beacons;       // Beacons and probe responses heard
+  uint32_t first_seen_ms; // Device uptime
+  uint32_t last_seen_ms;
+  uint8_t ssid_len; // Tail: SSID (0 = hidden)
+} chimera_ap_update_t;
+
+// chimera_probe_update_t.flags
+#define CHIMERA_PROBE_NEW 0x01     // First sighting of this client/SSID pair
+#define CHIMERA_PROBE_EVICTED 0x02 // Dropped from the table; final counters
+
+#define CHIMERA_PROBE_UPDATE_VERSION 1
+typedef struct CHIMERA_PACKED {
+  uint8_t mac[6];  // Probing station
+  uint8_t channel; // Channel of the latest probe
+  uint8_t flags;   // CHIMERA_PROBE_*
+  int8_t rssi_avg; // Moving average, dBm
+  int8_t rssi_min;
+  int8_t rssi_max;
+  uint32_t count;         // Probes for this SSID from this station
+  uint32_t first_seen_ms; // Device uptime
+  uint32_t last_seen_ms;
+  uint8_t ssid_len; // Tail: requested SSID
+} chimera_probe_update_t;
+
+#define CHIMERA_HOP_STATS_VERSION 1
+typedef struct CHIMERA_PACKED {
+  uint32_t hops;           // Channel switches since hopping started
+  uint16_t round_ms;       // Last round (every channel visited once)
+  uint16_t latency_us;     // Hop due to radio on the channel, average
+  uint16_t latency_max_us; // Worst hop latency
+  uint32_t lost_us;        // Hop due to first frame received, average
+  uint16_t dwell_ms[13];   // Next round's dwell on channels 1-13
+} chimera_hop_stats_t;
+
+#define CHIMERA_SURVEY_RSSI_BUCKETS 8
+#define CHIMERA_SURVEY_VERSION 1
+typedef struct CHIMERA_PACKED {
+  uint8_t channel;
+  int8_t noise_floor;   // Average rx_ctrl noise floor, dBm
+  uint16_t interval_ms; // Accumulation period of this snapshot
+  uint32_t mgmt;        // Frames by type
+  uint32_t ctrl;
+  uint32_t data;
+  uint32_t bytes;      // Frame bytes on air
+  uint32_t airtime_us; // Estimated from PHY rate and length
+  uint32_t retries;    // Frames with the retry bit set
+  // RSSI histogram: below -90 dBm, 10 dB buckets from -90, -30 and above
+  uint16_t rssi_hist[CHIMERA_SURVEY_RSSI_BUCKETS];
+} chimera_survey_t;
+
+// chimera_csi_t.flags
+#define CHIMERA_CSI_HT 0x01            // HT frame: mcs is valid
+#define CHIMERA_CSI_40MHZ 0x02         // 40 MHz channel width
+#define CHIMERA_CSI_SHORT_GI 0x04      // Short guard interval
+#define CHIMERA_CSI_FIRST_INVALID 0x08 // First 4 data bytes are not valid
+#define CHIMERA_CSI_TRUNCATED 0x10     // Data cut to the device buffer size
+
+#define CHIMERA_CSI_VERSION 1
+typedef struct CHIMERA_PACKED {
+  uint32_t timestamp_us; // Receive time, device clock (wraps every ~71 min)
+  uint8_t mac[6];        // Transmitter
+  uint8_t channel;
+  uint8_t secondary;  // Secondary channel: 0 none, 1 above, 2 below
+  int8_t rssi;        // dBm
+  int8_t noise_floor; // dBm
+  uint8_t mcs;        // HT MCS index
+  uint8_t flags;      // CHIMERA_CSI_*
+  uint16_t rx_seq;    // Driver receive sequence number
+  uint32_t dropped;   // CSI frames lost on the device so far
+  // Tail: one (imaginary, real) int8 pair per subcarrier, in driver order
+  // (L-LTF, then HT-LTF, then STBC HT-LTF, each as enabled)
+  uint16_t len;
+} chimera_csi_t;
+
+// chimera_csi_features_t.flags
+#define CHIMERA_CSI_MOTION 0x01 // Motion detected at the end of the interval
+#define CHIMERA_CSI_EVENT 0x02  // Sent early: motion started or stopped
+
+#define CHIMERA_CSI_FEATURES_VERSION 1
+typedef struct CHIMERA_PACKED {
+  uint32_t timestamp_us; // Last report included
+  uint8_t mac[6];        // Transmitter
+  uint8_t channel;
+  int8_t rssi;          // Average over the interval, dBm
+  int8_t noise_floor;   // Average over the interval, dBm
+  uint8_t flags;        // CHIMERA_CSI_MOTION, CHIMERA_CSI_EVENT
+  uint16_t reports;     // CSI reports in the interval
+  uint16_t score;       // Motion score: amplitude variance / power, x10000
+  uint16_t score_max;   // Highest score in the interval
+  uint16_t amp_mean;    // Mean subcarrier amplitude, Q4
+  uint16_t phase_rms;   // Sanitized phase residual, Q12 radians
+  uint32_t cycles;      // Feature extraction cost per report, CPU cycles
+  uint32_t dropped;     // CSI frames lost on the device so far
+  // Tail: mean amplitude of subcarriers -26..-1, 1..26 over the motion
+  // window, one uint8 each (integer part, saturating)
+  uint16_t len;
+} chimera_csi_features_t;
+
+// chimera_radio_mode_t.from/to
+#define CHIMERA_RADIO_IDLE 0
+#define CHIMERA_RADIO_SCAN 1
+#define CHIMERA_RADIO_MONITOR 2
+#define CHIMERA_RADIO_MONITOR_CSI 3 // Monitor plus CSI capture
+
+#define CHIMERA_RADIO_MODE_VERSION 1
+typedef struct CHIMERA_PACKED {
+  uint8_t from;        // CHIMERA_RADIO_*
+  uint8_t to;          // CHIMERA_RADIO_*
+  uint32_t latency_us; // Time the transition took
+} chimera_radio_mode_t;
+
+// Wire sizes are part of the schema; catch accidental layout changes
+CHIMERA_STATIC_ASSERT(sizeof(chimera_frame_trailer_t) ==
+                          CHIMERA_FRAME_TRAILER_LEN,
+                      "frame_trailer");
+CHIMERA_STATIC_ASSERT(sizeof(chimera_rec_hdr_t) == 2, "rec_hdr");
+CHIMERA_STATIC_ASSERT(sizeof(chimera_wifi_ap_t) == 10, "wifi_ap");
+CHIMERA_STATIC_ASSERT(sizeof(chimera_client_probe_t) == 9, "client_probe");
+CHIMERA_STATIC_ASSERT(sizeof(chimera_recon_beacon_t) == 9, "recon_beacon");
+CHIMERA_STATIC_ASSERT(sizeof(chimera_sniff_stats_t) == 44, "sniff_stats");
+CHIMERA_STATIC_ASSERT(sizeof(chimera_sys_status_t) == 51, "sys_status");
+CHIMERA_STATIC_ASSERT(sizeof(chimera_ble_device_t) == 11, "ble_device");
+CHIMERA_STATIC_ASSERT(sizeof(chimera_handshake_t) == 110, "handshake");
+CHIMERA_STATIC_ASSERT(sizeof(chimera_log_t) == 8, "log");
+CHIMERA_STATIC_ASSERT(sizeof(chimera_raw_frame_t) == 14, "raw_frame");
+CHIMERA_STATIC_ASSERT(sizeof(chimera_file_chunk_t) == 13, "file_chunk");
+CHIMERA_STATIC_ASSERT(sizeof(chimera_ap_update_t) == 25, "ap_update");
+CHIMERA_STATIC_ASSERT(sizeof(chimera_probe_update_t) == 24, "probe_update");
+CHIMERA_STATIC_ASSERT(sizeof(chimera_hop_stats_t) == 40, "hop_stats");
+CHIMERA_STATIC_ASSERT(sizeof(chimera_csi_t) == 24, "csi");
+CHIMERA_STATIC_ASSERT(sizeof(chimera_survey_t) == 44, "survey");
+CHIMERA_STATIC_ASSERT(sizeof(chimera_csi_features_t) == 34, "csi_features");
+CHIMERA_STATIC_ASSERT(sizeof(chimera_radio_mode_t) == 6, "radio_mode");
+
+#ifdef __cplusplus
+}
+#endif
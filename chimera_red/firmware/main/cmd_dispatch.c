@@ -0,0 +1,307 @@
+/**
+ * @file cmd_dispatch.c
+ * @brief Command registry and per-class asynchronous executor
+ *
+ * - Text lookup: binary search over the name-sorted table
+ * - Binary lookup: 256-entry opcode index built at init
+ * - One FreeRTOS queue + worker task per concurrency class; INLINE commands
+ *   (STOP, GET_INFO, input events) run on the RX task so they are never
+ *   stuck behind the radio operation they are meant to control
+ * - Jobs own a private copy of their arguments, so the RX buffer can be
+ *   reused as soon as dispatch returns
+ */
+#include "cmd_dispatch.h"
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "cmd";
+
+// ---------------- Configuration ----------------
+
+#define CMD_QUEUE_DEPTH 4
+#define CMD_WORKER_STACK 4096
+#define CMD_WORKER_PRIO 4
+#define CMD_NAME_MAX 32
+
+// ---------------- State ----------------
+
+typedef struct {
+  const cmd_def_t *def;
+  bool is_binary;
+  const char *payload;  // Text payload (into data[]), may be NULL
+  serial_bin_cmd_t bin; // Argument pointers rebased into data[]
+  uint8_t data[];       // Private copy of the line / argument values
+} cmd_job_t;
+
+static const cmd_def_t *g_table = NULL;
+static size_t g_table_count = 0;
+static const cmd_def_t *g_by_opcode[256];
+
+static QueueHandle_t g_queues[CMD_CLASS_COUNT];
+static volatile bool g_busy[CMD_CLASS_COUNT];
+
+static atomic_uint_fast32_t g_executed = 0;
+static atomic_uint_fast32_t g_rejected = 0;
+static atomic_uint_fast32_t g_unknown = 0;
+static atomic_uint_fast32_t g_cancelled = 0;
+
+static const char *const CLASS_NAMES[CMD_CLASS_COUNT] = {
+    "inline", "cmd_wifi", "cmd_ble", "cmd_nfc", "cmd_subghz"};
+
+// ---------------- Internal helpers ----------------
+
+static void send_ack(const cmd_job_t *job, esp_err_t ret) {
+  char json[160];
+  snprintf(json, sizeof(json),
+           "{\"type\":\"cmd_ack\",\"op\":%u,\"req\":%u,\"ok\":%s,"
+           "\"err\":\"%s\"}",
+           job->bin.opcode, job->bin.req_id, (ret == ESP_OK) ? "true" : "false",
+           (ret == ESP_OK) ? "" : esp_err_to_name(ret));
+  serial_send_json_raw(json);
+}
+
+static void run_job(cmd_job_t *job) {
+  cmd_args_t args = {
+      .payload = job->is_binary ? NULL : job->payload,
+      .bin = job->is_binary ? &job->bin : NULL,
+  };
+
+  esp_err_t ret = job->def->fn(&args);
+  atomic_fetch_add(&g_executed, 1);
+
+  if (job->is_binary) {
+    send_ack(job, ret);
+  }
+}
+
+static void cmd_worker_task(void *arg) {
+  cmd_class_t cls = (cmd_class_t)(intptr_t)arg;
+  QueueHandle_t q = g_queues[cls];
+
+  while (1) {
+    cmd_job_t *job = NULL;
+    if (xQueueReceive(q, &job, portMAX_DELAY) != pdTRUE || !job)
+      continue;
+
+    g_busy[cls] = true;
+    run_job(job);
+    g_busy[cls] = false;
+    free(job);
+  }
+}
+
+static void submit(cmd_job_t *job) {
+  cmd_class_t cls = job->def->cls;
+
+  if (cls == CMD_CLASS_INLINE || !g_queues[cls]) {
+    run_job(job);
+    free(job);
+    return;
+  }
+
+  if (xQueueSend(g_queues[cls], &job, 0) != pdTRUE) {
+    atomic_fetch_add(&g_rejected, 1);
+    ESP_LOGW(TAG, "%s busy, dropping %s", CLASS_NAMES[cls], job->def->name);
+    if (job->is_binary) {
+      send_ack(job, ESP_ERR_TIMEOUT);
+    } else {
+      serial_send_json("error", "\"Busy\"");
+    }
+    free(job);
+  }
+}
+
+static int cmd_name_cmp(const void *key, const void *elem) {
+  return strcmp((const char *)key, ((const cmd_def_t *)elem)->name);
+}
+
+// ---------------- Public API ----------------
+
+esp_err_t cmd_dispatch_init(const cmd_def_t *table, size_t count) {
+  if (!table || count == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  memset(g_by_opcode, 0, sizeof(g_by_opcode));
+  for (size_t i = 0; i < count; i++) {
+    if (i > 0 && strcmp(table[i - 1].name, table[i].name) >= 0) {
+      ESP_LOGE(TAG, "Command table not sorted at '%s'", table[i].name);
+      return ESP_ERR_INVALID_ARG;
+    }
+    if (table[i].opcode != 0) {
+      if (g_by_opcode[table[i].opcode]) {
+        ESP_LOGE(TAG, "Duplicate opcode 0x%02X", table[i].opcode);
+        return ESP_ERR_INVALID_ARG;
+      }
+      g_by_opcode[table[i].opcode] = &table[i];
+    }
+  }
+
+  g_table = table;
+  g_table_count = count;
+
+  for (int cls = CMD_CLASS_INLINE + 1; cls < CMD_CLASS_COUNT; cls++) {
+    if (g_queues[cls])
+      continue;
+    g_queues[cls] = xQueueCreate(CMD_QUEUE_DEPTH, sizeof(cmd_job_t *));
+    if (!g_queues[cls]) {
+      ESP_LOGE(TAG, "Failed to create %s queue", CLASS_NAMES[cls]);
+      return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(cmd_worker_task, CLASS_NAMES[cls], CMD_WORKER_STACK,
+                    (void *)(intptr_t)cls, CMD_WORKER_PRIO, NULL) != pdPASS) {
+      ESP_LOGE(TAG, "Failed to create %s worker", CLASS_NAMES[cls]);
+      vQueueDelete(g_queues[cls]);
+      g_queues[cls] = NULL;
+      return ESP_ERR_NO_MEM;
+    }
+  }
+
+  ESP_LOGI(TAG, "Command dispatcher ready (%u commands)", (unsigned)count);
+  return ESP_OK;
+}
+
+void cmd_dispatch_text(const char *line) {
+  if (!line || *line == '\0' || !g_table) {
+    return;
+  }
+
+  ESP_LOGD(TAG, "CMD: %s", line);
+
+  // Look up the name without copying the whole line first
+  char name[CMD_NAME_MAX];
+  size_t name_len = strcspn(line, ":");
+  if (name_len >= sizeof(name)) {
+    atomic_fetch_add(&g_unknown, 1);
+    serial_send_json("error", "\"Unknown command\"");
+    return;
+  }
+  memcpy(name, line, name_len);
+  name[name_len] = '\0';
+
+  const cmd_def_t *def =
+      bsearch(name, g_table, g_table_count, sizeof(cmd_def_t), cmd_name_cmp);
+  if (!def) {
+    atomic_fetch_add(&g_unknown, 1);
+    ESP_LOGW(TAG, "Unknown command: %s", name);
+    serial_send_json("error", "\"Unknown command\"");
+    return;
+  }
+
+  const char *payload = (line[name_len] == ':') ? line + name_len + 1 : NULL;
+  size_t payload_len = payload ? strlen(payload) : 0;
+
+  cmd_job_t *job = calloc(1, sizeof(cmd_job_t) + payload_len + 1);
+  if (!job) {
+    serial_send_json("error", "\"Out of memory\"");
+    return;
+  }
+  job->def = def;
+  if (payload) {
+    memcpy(job->data, payload, payload_len);
+    job->data[payload_len] = '\0';
+    job->payload = (const char *)job->data;
+  }
+  submit(job);
+}
+
+void cmd_dispatch_binary(const serial_bin_cmd_t *cmd) {
+  if (!cmd || !g_table) {
+    return;
+  }
+
+  const cmd_def_t *def = g_by_opcode[cmd->opcode];
+
+  size_t data_len = 0;
+  for (uint8_t i = 0; i < cmd->argc; i++) {
+    data_len += cmd->argv[i].len;
+  }
+
+  cmd_job_t *job = calloc(1, sizeof(cmd_job_t) + data_len);
+  if (!job) {
+    return;
+  }
+  job->def = def;
+  job->is_binary = true;
+  job->bin = *cmd;
+
+  // Deep-copy argument values; the RX buffer is reused after we return
+  size_t off = 0;
+  for (uint8_t i = 0; i < cmd->argc; i++) {
+    memcpy(job->data + off, cmd->argv[i].data, cmd->argv[i].len);
+    job->bin.argv[i].data = job->data + off;
+    off += cmd->argv[i].len;
+  }
+
+  if (!def) {
+    atomic_fetch_add(&g_unknown, 1);
+    ESP_LOGW(TAG, "Unknown opcode: 0x%02X", cmd->opcode);
+    send_ack(job, ESP_ERR_NOT_SUPPORTED);
+    free(job);
+    return;
+  }
+
+  ESP_LOGD(TAG, "BIN CMD: %s (req %u)", def->name, cmd->req_id);
+  submit(job);
+}
+
+void cmd_dispatch_cancel(void) {
+  for (int cls = CMD_CLASS_INLINE + 1; cls < CMD_CLASS_COUNT; cls++) {
+    if (!g_queues[cls])
+      continue;
+    cmd_job_t *job = NULL;
+    while (xQueueReceive(g_queues[cls], &job, 0) == pdTRUE) {
+      if (job) {
+        if (job->is_binary) {
+          send_ack(job, ESP_ERR_INVALID_STATE);
+        }
+        free(job);
+        atomic_fetch_add(&g_cancelled, 1);
+      }
+    }
+  }
+}
+
+bool cmd_dispatch_class_busy(cmd_class_t cls) {
+  if (cls <= CMD_CLASS_INLINE || cls >= CMD_CLASS_COUNT)
+    return false;
+  return g_busy[cls];
+}
+
+void cmd_dispatch_get_stats(cmd_dispatch_stats_t *stats) {
+  if (!stats)
+    return;
+  stats->executed = atomic_load(&g_executed);
+  stats->rejected = atomic_load(&g_rejected);
+  stats->unknown = atomic_load(&g_unknown);
+  stats->cancelled = atomic_load(&g_cancelled);
+}
+
+bool cmd_args_str(const cmd_args_t *args, char *out, size_t out_size) {
+  if (!args || !out || out_size == 0)
+    return false;
+
+  out[0] = '\0';
+  if (args->payload && *args->payload) {
+    strncpy(out, args->payload, out_size - 1);
+    out[out_size - 1] = '\0';
+    return true;
+  }
+
+  const serial_arg_t *s = serial_bin_arg(args->bin, SERIAL_ARG_STR, 0);
+  if (s && s->len > 0) {
+    size_t n = (s->len < out_size - 1) ? s->len : out_size - 1;
+    memcpy(out, s->data, n);
+    out[n] = '\0';
+    return true;
+  }
+  return false;
+}
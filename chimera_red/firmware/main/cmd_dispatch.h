@@ -0,0 +1,119 @@
+/**
+ * @file cmd_dispatch.h
+ * @brief Table-driven command registry and asynchronous executor
+ *
+ * Commands are looked up by name (binary search over a sorted table) or by
+ * binary opcode (direct index). Each command belongs to a concurrency class;
+ * every class except INLINE owns a worker task and queue, so a long radio
+ * operation only blocks commands of its own class and never the RX task.
+ */
+#pragma once
+
+#include "esp_err.h"
+#include "serial_comm.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Concurrency classes
+ *
+ * Commands in the same class run one at a time, in arrival order. Commands
+ * in different classes may run concurrently.
+ */
+typedef enum {
+  CMD_CLASS_INLINE = 0, // Runs on the RX task immediately (must be quick)
+  CMD_CLASS_WIFI,       // WiFi radio operations
+  CMD_CLASS_BLE,        // BLE radio operations
+  CMD_CLASS_NFC,        // PN532 operations
+  CMD_CLASS_SUBGHZ,     // CC1101 operations
+  CMD_CLASS_COUNT
+} cmd_class_t;
+
+/**
+ * @brief Arguments handed to a command handler
+ *
+ * Exactly one of payload / bin is set (payload may also be NULL for a text
+ * command without ':' arguments). Both stay valid for the whole call.
+ */
+typedef struct {
+  const char *payload;         // Text payload after ':' (text commands)
+  const serial_bin_cmd_t *bin; // Decoded binary command (binary commands)
+} cmd_args_t;
+
+typedef esp_err_t (*cmd_fn_t)(const cmd_args_t *args);
+
+/**
+ * @brief Command table entry
+ */
+typedef struct {
+  const char *name; // Text command name (table must be sorted by name)
+  uint8_t opcode;   // Binary opcode (0 = text only)
+  cmd_class_t cls;  // Concurrency class
+  cmd_fn_t fn;      // Handler
+} cmd_def_t;
+
+/**
+ * @brief Executor counters
+ */
+typedef struct {
+  uint32_t executed;  // Handlers run to completion
+  uint32_t rejected;  // Dropped because the class queue was full
+  uint32_t unknown;   // Unknown name/opcode
+  uint32_t cancelled; // Queued commands discarded by cmd_dispatch_cancel()
+} cmd_dispatch_stats_t;
+
+/**
+ * @brief Register the command table and start class workers
+ * @param table Command table, sorted by name (strcmp order)
+ * @param count Number of entries
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the table is unsorted
+ * or has duplicate opcodes
+ */
+esp_err_t cmd_dispatch_init(const cmd_def_t *table, size_t count);
+
+/**
+ * @brief Dispatch a text command ("NAME" or "NAME:payload")
+ *
+ * Suitable as a serial_cmd_handler_t. The line is copied before queuing.
+ */
+void cmd_dispatch_text(const char *line);
+
+/**
+ * @brief Dispatch a binary command
+ *
+ * Suitable as a serial_bin_handler_t. Arguments are deep-copied before
+ * queuing. A cmd_ack reply carrying the request id is sent on completion.
+ */
+void cmd_dispatch_binary(const serial_bin_cmd_t *cmd);
+
+/**
+ * @brief Discard every queued (not yet running) command
+ *
+ * Intended for STOP: running handlers are cancelled by their own stop flags.
+ */
+void cmd_dispatch_cancel(void);
+
+/**
+ * @brief Check whether a class worker is currently executing a command
+ */
+bool cmd_dispatch_class_busy(cmd_class_t cls);
+
+/**
+ * @brief Snapshot executor counters
+ */
+void cmd_dispatch_get_stats(cmd_dispatch_stats_t *stats);
+
+/**
+ * @brief Copy the text payload or first STR argument into a buffer
+ * @return true if an argument was present
+ */
+bool cmd_args_str(const cmd_args_t *args, char *out, size_t out_size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,455 @@
+/**
+ * @file csi.c
+ * @brief Channel state information capture
+ */
+#include "csi.h"
+
+#include "chimera_proto.h"
+#include "csi_dsp.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "serial_comm.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+
+static const char *TAG = "csi";
+
+// ---------------- Ring ----------------
+//
+// Same scheme as the packet ring: the driver task is the only producer and
+// the CSI worker the only consumer, so head/tail need no lock.
+
+#define CSI_SLOTS 32 // Power of two
+#define CSI_WORKER_STACK 4096 // Feature kernels keep their vectors here
+#define CSI_WORKER_PRIO 4 // Below the packet worker
+#define CSI_WORKER_CORE 1 // WiFi driver task runs on core 0
+
+typedef struct {
+  chimera_csi_t rec; // dropped is filled in when sent
+  int8_t data[CSI_MAX_LEN];
+} csi_slot_t;
+
+static csi_slot_t *g_slots = NULL;
+static atomic_uint g_head = 0; // Written by the driver task
+static atomic_uint g_tail = 0; // Written by the worker
+static TaskHandle_t g_task = NULL;
+static volatile bool g_worker_run = false;
+static atomic_bool g_accept = false;
+
+static atomic_uint_fast32_t g_received = 0;
+static atomic_uint_fast32_t g_filtered = 0;
+static atomic_uint_fast32_t g_decimated = 0;
+static atomic_uint_fast32_t g_dropped = 0;
+static atomic_uint_fast32_t g_truncated = 0;
+static atomic_uint_fast32_t g_sent = 0;
+static atomic_uint_fast32_t g_features = 0;
+static atomic_uint_fast32_t g_skipped = 0;
+
+// Source filter and decimation. Two slots, as for the packet filter:
+// csi_configure() fills the one not in use, publishes it and waits for
+// g_cfg_busy to clear before the other can be reused. The reader is the
+// driver callback, which outranks every writer, so yielding is enough.
+typedef struct {
+  uint16_t every;
+  uint8_t count;
+  uint8_t macs[CSI_SOURCES_MAX][6];
+} csi_cfg_t;
+
+static csi_cfg_t g_cfg_slot[2] = {{.every = 1}, {.every = 1}};
+static _Atomic(const csi_cfg_t *) g_cfg = &g_cfg_slot[0];
+static atomic_bool g_cfg_busy = false;
+static uint16_t g_tick = 0; // Driver task only
+
+// Output settings, read by the worker only; same two-slot scheme. The
+// worker runs below the command task that writes them, so the writer
+// sleeps rather than yields while g_out_busy is set.
+#define CSI_DEFAULT_OUTPUT                                                     \
+  {.mode = CSI_OUTPUT_FEATURES, .interval_ms = 500,                            \
+   .motion_on = CSI_MOTION_ON, .motion_off = CSI_MOTION_OFF}
+
+static csi_output_t g_out_slot[2] = {CSI_DEFAULT_OUTPUT, CSI_DEFAULT_OUTPUT};
+static _Atomic(const csi_output_t *) g_out = &g_out_slot[0];
+static atomic_bool g_out_busy = false;
+
+// Feature state per transmitter (worker only). Cleared by the worker when
+// csi_start() sets g_sources_reset, so a restart begins with empty windows.
+typedef struct {
+  uint16_t reports;
+  int32_t rssi_sum;
+  int32_t noise_sum;
+  uint32_t phase_sum;
+  uint64_t cycles_sum;
+  uint16_t score_max;
+  uint32_t start_us;
+  uint8_t channel;
+} csi_interval_t;
+
+typedef struct {
+  bool used;
+  uint8_t mac[6];
+  uint32_t last_us; // Last report
+  csi_interval_t iv;
+  csi_motion_t motion;
+} csi_source_t;
+
+static csi_source_t *g_sources = NULL;
+static atomic_bool g_sources_reset = false;
+
+// ---------------- Driver callback ----------------
+
+static bool source_allowed(const csi_cfg_t *cfg, const uint8_t *mac) {
+  if (cfg->count == 0) {
+    return true;
+  }
+  for (int i = 0; i < cfg->count; i++) {
+    if (memcmp(cfg->macs[i], mac, 6) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief CSI report from the driver (WiFi driver task)
+ *
+ * Bounds-checked copy into the ring and nothing else: no logging, no
+ * locks, no serial I/O.
+ */
+static void csi_rx_cb(void *ctx, wifi_csi_info_t *info) {
+  if (!info || !info->buf || !atomic_load(&g_accept)) {
+    return;
+  }
+  atomic_fetch_add(&g_received, 1);
+
+  atomic_store(&g_cfg_busy, true);
+  const csi_cfg_t *cfg = atomic_load(&g_cfg);
+  bool pass = source_allowed(cfg, info->mac);
+  uint16_t every = cfg->every;
+  atomic_store(&g_cfg_busy, false);
+
+  if (!pass) {
+    atomic_fetch_add(&g_filtered, 1);
+    return;
+  }
+  if (every > 1 && ++g_tick < every) {
+    atomic_fetch_add(&g_decimated, 1);
+    return;
+  }
+  g_tick = 0;
+
+  unsigned head = atomic_load_explicit(&g_head, memory_order_relaxed);
+  unsigned tail = atomic_load_explicit(&g_tail, memory_order_acquire);
+  if (head - tail >= CSI_SLOTS) {
+    atomic_fetch_add(&g_dropped, 1);
+    return;
+  }
+
+  csi_slot_t *slot = &g_slots[head & (CSI_SLOTS - 1)];
+  const wifi_pkt_rx_ctrl_t *rx = &info->rx_ctrl;
+  uint16_t len = info->len;
+  uint8_t flags = 0;
+  if (len > CSI_MAX_LEN) {
+    len = CSI_MAX_LEN;
+    flags |= CHIMERA_CSI_TRUNCATED;
+    atomic_fetch_add(&g_truncated, 1);
+  }
+  if (rx->sig_mode) {
+    flags |= CHIMERA_CSI_HT;
+    if (rx->cwb) {
+      flags |= CHIMERA_CSI_40MHZ;
+    }
+    if (rx->sgi) {
+      flags |= CHIMERA_CSI_SHORT_GI;
+    }
+  }
+  if (info->first_word_invalid) {
+    flags |= CHIMERA_CSI_FIRST_INVALID;
+  }
+
+  slot->rec = (chimera_csi_t){
+      .timestamp_us = rx->timestamp,
+      .channel = rx->channel,
+      .secondary = rx->secondary_channel,
+      .rssi = rx->rssi,
+      .noise_floor = rx->noise_floor,
+      .mcs = rx->sig_mode ? rx->mcs : 0,
+      .flags = flags,
+      .rx_seq = info->rx_seq,
+      .len = len,
+  };
+  memcpy(slot->rec.mac, info->mac, 6);
+  memcpy(slot->data, info->buf, len);
+
+  atomic_store_explicit(&g_head, head + 1, memory_order_release);
+  xTaskNotifyGive(g_task);
+}
+
+// ---------------- Features ----------------
+
+/**
+ * @brief Feature state of a transmitter; the least recently heard one is
+ * taken over when all are in use
+ */
+static csi_source_t *source_get(const uint8_t *mac, uint32_t now) {
+  csi_source_t *victim = &g_sources[0];
+  for (int i = 0; i < CSI_FEAT_SOURCES; i++) {
+    csi_source_t *s = &g_sources[i];
+    if (s->used && memcmp(s->mac, mac, 6) == 0) {
+      return s;
+    }
+    if (victim->used &&
+        (!s->used || now - s->last_us > now - victim->last_us)) {
+      victim = s;
+    }
+  }
+  memset(victim, 0, sizeof(*victim));
+  victim->used = true;
+  memcpy(victim->mac, mac, 6);
+  return victim;
+}
+
+static void features_send(csi_source_t *src, bool event) {
+  const csi_motion_t *m = &src->motion;
+  const csi_interval_t *iv = &src->iv;
+
+  // Window mean amplitude per subcarrier, as integer profile and Q4 mean
+  uint8_t profile[CSI_DSP_SC];
+  uint32_t total = 0;
+  for (int k = 0; k < CSI_DSP_SC; k++) {
+    uint32_t a = m->fill ? m->sum[k] / m->fill : 0;
+    total += a;
+    profile[k] = (a >> 4) > UINT8_MAX ? UINT8_MAX : (uint8_t)(a >> 4);
+  }
+
+  chimera_csi_features_t f = {
+      .timestamp_us = src->last_us,
+      .channel = iv->channel,
+      .rssi = (int8_t)(iv->rssi_sum / iv->reports),
+      .noise_floor = (int8_t)(iv->noise_sum / iv->reports),
+      .flags = (m->active ? CHIMERA_CSI_MOTION : 0) |
+               (event ? CHIMERA_CSI_EVENT : 0),
+      .reports = iv->reports,
+      .score = m->score,
+      .score_max = iv->score_max,
+      .amp_mean = (uint16_t)(total / CSI_DSP_SC),
+      .phase_rms = (uint16_t)(iv->phase_sum / iv->reports),
+      .cycles = (uint32_t)(iv->cycles_sum / iv->reports),
+      .dropped = atomic_load(&g_dropped),
+      .len = sizeof(profile),
+  };
+  memcpy(f.mac, src->mac, 6);
+  serial_send_record(CHIMERA_MSG_CSI_FEATURES, CHIMERA_CSI_FEATURES_VERSION,
+                     &f, sizeof(f), profile, sizeof(profile));
+  atomic_fetch_add(&g_features, 1);
+  memset(&src->iv, 0, sizeof(src->iv));
+}
+
+static void features_process(const csi_slot_t *slot, const csi_output_t *out) {
+  const chimera_csi_t *rec = &slot->rec;
+  uint32_t t0 = esp_cpu_get_cycle_count();
+
+  int8_t iq[CSI_DSP_SC][2];
+  if (rec->secondary != 0 ||
+      !csi_dsp_lltf(slot->data, rec->len,
+                    rec->flags & CHIMERA_CSI_FIRST_INVALID, iq)) {
+    atomic_fetch_add(&g_skipped, 1);
+    return;
+  }
+  uint16_t amp[CSI_DSP_SC];
+  int16_t phase[CSI_DSP_SC];
+  csi_dsp_polar(iq, amp, phase);
+  uint16_t phase_rms = csi_dsp_sanitize(phase);
+  csi_source_t *src = source_get(rec->mac, rec->timestamp_us);
+  bool changed = csi_motion_update(&src->motion, amp, out->motion_on,
+                                   out->motion_off);
+  uint32_t cycles = esp_cpu_get_cycle_count() - t0;
+
+  csi_interval_t *iv = &src->iv;
+  if (iv->reports == 0) {
+    iv->start_us = rec->timestamp_us;
+  }
+  iv->reports++;
+  iv->rssi_sum += rec->rssi;
+  iv->noise_sum += rec->noise_floor;
+  iv->phase_sum += phase_rms;
+  iv->cycles_sum += cycles;
+  if (src->motion.score > iv->score_max) {
+    iv->score_max = src->motion.score;
+  }
+  src->last_us = rec->timestamp_us;
+  iv->channel = rec->channel;
+
+  bool due = out->interval_ms &&
+             rec->timestamp_us - iv->start_us >= out->interval_ms * 1000u;
+  if (changed || due) {
+    features_send(src, changed);
+  }
+}
+
+// ---------------- Worker ----------------
+
+static void csi_worker_task(void *arg) {
+  while (g_worker_run) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+
+    if (atomic_exchange(&g_sources_reset, false)) {
+      memset(g_sources, 0, sizeof(csi_source_t) * CSI_FEAT_SOURCES);
+    }
+    atomic_store(&g_out_busy, true);
+    csi_output_t out = *atomic_load(&g_out);
+    atomic_store(&g_out_busy, false);
+
+    unsigned tail = atomic_load_explicit(&g_tail, memory_order_relaxed);
+    while (tail != atomic_load_explicit(&g_head, memory_order_acquire)) {
+      csi_slot_t *slot = &g_slots[tail & (CSI_SLOTS - 1)];
+      if (out.mode == CSI_OUTPUT_RAW) {
+        slot->rec.dropped = atomic_load(&g_dropped);
+        serial_send_record(CHIMERA_MSG_CSI_DATA, CHIMERA_CSI_VERSION,
+                           &slot->rec, sizeof(slot->rec), slot->data,
+                           slot->rec.len);
+        atomic_fetch_add(&g_sent, 1);
+      } else {
+        features_process(slot, &out);
+      }
+      tail++;
+      atomic_store_explicit(&g_tail, tail, memory_order_release);
+    }
+  }
+
+  g_task = NULL;
+  vTaskDelete(NULL);
+}
+
+static void *alloc_buffer(size_t size) {
+  void *p = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  return p ? p : heap_caps_malloc(size, MALLOC_CAP_8BIT);
+}
+
+esp_err_t csi_start(void) {
+  if (!g_slots) {
+    g_slots = alloc_buffer(sizeof(csi_slot_t) * CSI_SLOTS);
+    if (!g_slots) {
+      ESP_LOGE(TAG, "Failed to allocate CSI ring");
+      return ESP_ERR_NO_MEM;
+    }
+  }
+  if (!g_sources) {
+    g_sources = alloc_buffer(sizeof(csi_source_t) * CSI_FEAT_SOURCES);
+    if (!g_sources) {
+      ESP_LOGE(TAG, "Failed to allocate CSI feature state");
+      return ESP_ERR_NO_MEM;
+    }
+  }
+  atomic_store(&g_sources_reset, true);
+
+  if (!g_task) {
+    g_worker_run = true;
+    if (xTaskCreatePinnedToCore(csi_worker_task, "csi_worker",
+                                CSI_WORKER_STACK, NULL, CSI_WORKER_PRIO,
+                                &g_task, CSI_WORKER_CORE) != pdPASS) {
+      g_worker_run = false;
+      ESP_LOGE(TAG, "Failed to create CSI worker");
+      return ESP_ERR_NO_MEM;
+    }
+  }
+
+  esp_err_t ret = esp_wifi_set_csi_rx_cb(csi_rx_cb, NULL);
+  if (ret != ESP_OK) {
+    return ret;
+  }
+  atomic_store(&g_accept, true);
+  return ESP_OK;
+}
+
+void csi_stop(void) { atomic_store(&g_accept, false); }
+
+void csi_deinit(void) {
+  csi_stop();
+  if (g_task) {
+    g_worker_run = false;
+    xTaskNotifyGive(g_task);
+    int timeout = 50; // 500ms max wait
+    while (g_task && timeout > 0) {
+      vTaskDelay(pdMS_TO_TICKS(10));
+      timeout--;
+    }
+  }
+  if (!g_task && g_slots) {
+    heap_caps_free(g_slots);
+    g_slots = NULL;
+    atomic_store(&g_head, 0);
+    atomic_store(&g_tail, 0);
+  }
+  if (!g_task && g_sources) {
+    heap_caps_free(g_sources);
+    g_sources = NULL;
+  }
+}
+
+esp_err_t csi_configure(uint16_t every, const uint8_t *macs, size_t count) {
+  if (count > CSI_SOURCES_MAX || (count && !macs)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  const csi_cfg_t *cur = atomic_load(&g_cfg);
+  csi_cfg_t *next = (cur == &g_cfg_slot[0]) ? &g_cfg_slot[1] : &g_cfg_slot[0];
+  next->every = every ? every : 1;
+  next->count = (uint8_t)count;
+  if (count) {
+    memcpy(next->macs, macs, count * 6);
+  }
+  atomic_store(&g_cfg, next);
+
+  // Wait out a callback that may still read the previous settings
+  while (atomic_load(&g_cfg_busy)) {
+    taskYIELD();
+  }
+  ESP_LOGI(TAG, "CSI: 1 in %u, %u source(s)", next->every, next->count);
+  return ESP_OK;
+}
+
+esp_err_t csi_set_output(const csi_output_t *out) {
+  if (!out || out->mode > CSI_OUTPUT_RAW ||
+      out->motion_off > out->motion_on) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  const csi_output_t *cur = atomic_load(&g_out);
+  csi_output_t *next =
+      (cur == &g_out_slot[0]) ? &g_out_slot[1] : &g_out_slot[0];
+  *next = *out;
+  atomic_store(&g_out, next);
+
+  while (atomic_load(&g_out_busy)) {
+    vTaskDelay(1);
+  }
+  ESP_LOGI(TAG, "CSI output: %s, %u ms, motion %u/%u",
+           next->mode == CSI_OUTPUT_RAW ? "raw" : "features",
+           next->interval_ms, next->motion_on, next->motion_off);
+  return ESP_OK;
+}
+
+void csi_get_output(csi_output_t *out) {
+  if (out) {
+    *out = *atomic_load(&g_out);
+  }
+}
+
+void csi_get_stats(csi_stats_t *stats) {
+  if (!stats) {
+    return;
+  }
+  stats->received = atomic_load(&g_received);
+  stats->filtered = atomic_load(&g_filtered);
+  stats->decimated = atomic_load(&g_decimated);
+  stats->dropped = atomic_load(&g_dropped);
+  stats->truncated = atomic_load(&g_truncated);
+  stats->sent = atomic_load(&g_sent);
+  stats->features = atomic_load(&g_features);
+  stats->skipped = atomic_load(&g_skipped);
+}
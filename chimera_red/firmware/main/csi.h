@@ -0,0 +1,108 @@
+/**
+ * @file csi.h
+ * @brief Channel state information capture
+ *
+ * The driver's CSI callback copies each accepted report into a
+ * preallocated ring and returns; a worker task drains the ring. The
+ * callback never blocks or allocates: a report that finds the ring full is
+ * counted and dropped, and every record carries the running drop count.
+ *
+ * Raw reports are too much for the serial link at 100+ per second, so by
+ * default the worker sends features instead: per transmitter it runs the
+ * csi_dsp.h kernels on each report (amplitude, sanitized phase, motion
+ * score) and sends a CSI_FEATURES record (chimera_csi_features_t) every
+ * interval, plus one as soon as motion starts or stops. csi_set_output()
+ * switches to a CSI_DATA record per report (chimera_csi_t: timestamp,
+ * transmitter, RSSI, noise floor, PHY details and the raw subcarrier data),
+ * for recording vectors to replay through host/csi_bench.
+ *
+ * Reports can be limited to a set of transmitters and decimated to one in
+ * every N. The radio side (enabling CSI, holding the channel) belongs to
+ * wifi_manager.c, which calls csi_start()/csi_stop() as CSI is turned on
+ * and off.
+ */
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_SOURCES_MAX 8 // Transmitters in the source filter
+#define CSI_MAX_LEN 612   // Largest report (L-LTF + HT-LTF + STBC, 40 MHz)
+#define CSI_FEAT_SOURCES 4 // Transmitters with feature state at once
+
+typedef enum {
+  CSI_OUTPUT_FEATURES = 0, // CSI_FEATURES records
+  CSI_OUTPUT_RAW,          // CSI_DATA record per report
+} csi_output_mode_t;
+
+typedef struct {
+  csi_output_mode_t mode;
+  uint16_t interval_ms; // Features per transmitter; 0 = motion events only
+  uint16_t motion_on;   // Motion score thresholds (CSI_MOTION_SCALE = 1.0)
+  uint16_t motion_off;
+} csi_output_t;
+
+typedef struct {
+  uint32_t received;  // Reports from the driver
+  uint32_t filtered;  // Not from a selected transmitter
+  uint32_t decimated; // Skipped by decimation
+  uint32_t dropped;   // Lost because the ring was full
+  uint32_t truncated; // Cut to CSI_MAX_LEN
+  uint32_t sent;      // CSI_DATA records sent
+  uint32_t features;  // CSI_FEATURES records sent
+  uint32_t skipped;   // Reports without a 20 MHz L-LTF (features mode)
+} csi_stats_t;
+
+/**
+ * @brief Allocate the ring, start the worker and install the driver
+ * callback (first call), then accept reports
+ * @return ESP_OK, ESP_ERR_NO_MEM
+ */
+esp_err_t csi_start(void);
+
+/**
+ * @brief Stop accepting reports; queued ones are still sent
+ */
+void csi_stop(void);
+
+/**
+ * @brief Stop the worker and free the ring (WiFi driver deinitialized)
+ */
+void csi_deinit(void);
+
+/**
+ * @brief Set the source filter and decimation
+ * @param every Keep one report in every (0 or 1 = all)
+ * @param macs Transmitters to keep, 6 bytes each
+ * @param count Number of transmitters, 0 for all
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for more than CSI_SOURCES_MAX
+ */
+esp_err_t csi_configure(uint16_t every, const uint8_t *macs, size_t count);
+
+/**
+ * @brief Choose between feature records and raw reports
+ *
+ * Feature state starts over for every transmitter when CSI is restarted.
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for an unknown mode or motion_off
+ *         above motion_on
+ */
+esp_err_t csi_set_output(const csi_output_t *out);
+
+/**
+ * @brief Current output settings
+ */
+void csi_get_output(csi_output_t *out);
+
+/**
+ * @brief Snapshot capture counters
+ */
+void csi_get_stats(csi_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
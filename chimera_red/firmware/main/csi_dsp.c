@@ -0,0 +1,190 @@
+/**
+ * @file csi_dsp.c
+ * @brief Fixed-point CSI feature kernels
+ */
+#include "csi_dsp.h"
+
+#include <string.h>
+
+// ---------------- Layout ----------------
+
+#define LLTF_SC 64 // Driver order: subcarriers 0..31, then -32..-1
+#define SC_SUM_SQ 12402 // Sum of k^2 over -26..-1, 1..26
+
+// Subcarrier number of output index i
+static inline int sc_index(int i) { return i < 26 ? i - 26 : i - 25; }
+
+bool csi_dsp_lltf(const int8_t *buf, size_t len, bool first_invalid,
+                  int8_t iq[CSI_DSP_SC][2]) {
+  if (!buf || len < LLTF_SC * 2) {
+    return false;
+  }
+  for (int i = 0; i < CSI_DSP_SC; i++) {
+    int k = sc_index(i);
+    const int8_t *p = &buf[(k < 0 ? LLTF_SC + k : k) * 2];
+    iq[i][0] = p[0];
+    iq[i][1] = p[1];
+  }
+  if (first_invalid) {
+    iq[26][0] = iq[27][0]; // Subcarrier 1 was in the invalid word
+    iq[26][1] = iq[27][1];
+  }
+  return true;
+}
+
+// ---------------- Polar ----------------
+
+// atan(2^-i), Q12 radians
+static const int16_t CORDIC_ATAN[] = {3217, 1899, 1003, 509, 256, 128, 64,
+                                      32,   16,   8,    4,   2,   1};
+#define CORDIC_STEPS (int)(sizeof(CORDIC_ATAN) / sizeof(CORDIC_ATAN[0]))
+#define CORDIC_INV_GAIN 39797 // 1/K for CORDIC_STEPS, Q16
+
+void csi_dsp_polar(const int8_t iq[CSI_DSP_SC][2], uint16_t amp[CSI_DSP_SC],
+                   int16_t phase[CSI_DSP_SC]) {
+  for (int i = 0; i < CSI_DSP_SC; i++) {
+    int32_t y = iq[i][0] * 256; // Headroom for the shifts
+    int32_t x = iq[i][1] * 256;
+    if (x == 0 && y == 0) {
+      amp[i] = 0;
+      phase[i] = 0;
+      continue;
+    }
+
+    // Vectoring mode works in the right half plane; rotate by pi first
+    int32_t a = 0;
+    if (x < 0) {
+      a = (y >= 0) ? CSI_DSP_PI : -CSI_DSP_PI;
+      x = -x;
+      y = -y;
+    }
+    for (int s = 0; s < CORDIC_STEPS; s++) {
+      int32_t dx = y >> s;
+      int32_t dy = x >> s;
+      if (y > 0) {
+        x += dx;
+        y -= dy;
+        a += CORDIC_ATAN[s];
+      } else {
+        x -= dx;
+        y += dy;
+        a -= CORDIC_ATAN[s];
+      }
+    }
+
+    // x is |H| * 256 * K
+    amp[i] = (uint16_t)(((uint32_t)x * CORDIC_INV_GAIN) >> 20);
+    if (a > CSI_DSP_PI) {
+      a = CSI_DSP_PI;
+    } else if (a < -CSI_DSP_PI) {
+      a = -CSI_DSP_PI;
+    }
+    phase[i] = (int16_t)a;
+  }
+}
+
+// ---------------- Phase ----------------
+
+static uint32_t isqrt32(uint32_t v) {
+  uint32_t r = 0;
+  uint32_t bit = 1u << 30;
+  while (bit > v) {
+    bit >>= 2;
+  }
+  while (bit) {
+    if (v >= r + bit) {
+      v -= r + bit;
+      r = (r >> 1) + bit;
+    } else {
+      r >>= 1;
+    }
+    bit >>= 2;
+  }
+  return r;
+}
+
+uint16_t csi_dsp_sanitize(int16_t phase[CSI_DSP_SC]) {
+  int32_t u[CSI_DSP_SC];
+  int32_t offset = 0;
+  int64_t sum = 0;
+  int64_t sum_k = 0;
+
+  u[0] = phase[0];
+  for (int i = 0; i < CSI_DSP_SC; i++) {
+    if (i > 0) {
+      int32_t d = phase[i] - phase[i - 1];
+      if (d > CSI_DSP_PI) {
+        offset -= 2 * CSI_DSP_PI;
+      } else if (d < -CSI_DSP_PI) {
+        offset += 2 * CSI_DSP_PI;
+      }
+      u[i] = phase[i] + offset;
+    }
+    sum += u[i];
+    sum_k += (int64_t)u[i] * sc_index(i);
+  }
+
+  // Subcarriers are symmetric about 0, so the fit separates: the intercept
+  // is the mean and the slope is sum(k * u) / sum(k^2)
+  int32_t mean = (int32_t)(sum / CSI_DSP_SC);
+  int64_t slope = (sum_k * 256) / SC_SUM_SQ; // 8 extra fraction bits
+
+  uint32_t sq = 0;
+  for (int i = 0; i < CSI_DSP_SC; i++) {
+    int32_t r = u[i] - mean - (int32_t)((slope * sc_index(i)) / 256);
+    if (r > INT16_MAX) {
+      r = INT16_MAX;
+    } else if (r < -INT16_MAX) {
+      r = -INT16_MAX;
+    }
+    phase[i] = (int16_t)r;
+    uint32_t r2 = (uint32_t)(r * r) / CSI_DSP_SC;
+    sq = (sq > UINT32_MAX - r2) ? UINT32_MAX : sq + r2;
+  }
+  return (uint16_t)isqrt32(sq);
+}
+
+// ---------------- Motion ----------------
+
+void csi_motion_reset(csi_motion_t *m) { memset(m, 0, sizeof(*m)); }
+
+bool csi_motion_update(csi_motion_t *m, const uint16_t amp[CSI_DSP_SC],
+                       uint16_t on, uint16_t off) {
+  uint16_t *slot = m->amp[m->pos];
+  bool full = (m->fill == CSI_MOTION_WINDOW);
+  for (int k = 0; k < CSI_DSP_SC; k++) {
+    if (full) {
+      m->sum[k] -= slot[k];
+      m->sumsq[k] -= (uint32_t)slot[k] * slot[k];
+    }
+    slot[k] = amp[k];
+    m->sum[k] += amp[k];
+    m->sumsq[k] += (uint32_t)amp[k] * amp[k];
+  }
+  m->pos = (m->pos + 1) & (CSI_MOTION_WINDOW - 1);
+  if (!full) {
+    m->fill++;
+    if (m->fill < CSI_MOTION_WINDOW) {
+      return false;
+    }
+  }
+
+  // W^2 * variance and W^2 * mean^2, summed over subcarriers
+  uint64_t var = 0;
+  uint64_t power = 0;
+  for (int k = 0; k < CSI_DSP_SC; k++) {
+    uint64_t s2 = (uint64_t)m->sum[k] * m->sum[k];
+    var += (uint64_t)m->sumsq[k] * CSI_MOTION_WINDOW - s2;
+    power += s2;
+  }
+  uint64_t score = power ? var * CSI_MOTION_SCALE / power : 0;
+  m->score = score > UINT16_MAX ? UINT16_MAX : (uint16_t)score;
+
+  bool was = m->active;
+  if (!m->active && m->score >= on) {
+    m->active = true;
+  } else if (m->active && m->score < off) {
+    m->active = false;
+  }
+  return m->active != was;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file csi_dsp.h
+ * @brief Fixed-point CSI feature kernels
+ *
+ * Integer-only C with no ESP-IDF dependencies: the CSI worker runs these on
+ * every report, and host/csi_bench builds the same file to replay captured
+ * CSI_DATA records for reference output and per-report cost.
+ *
+ * Per report:
+ *   csi_dsp_lltf()     L-LTF subcarriers -26..26 (DC skipped) in order
+ *   csi_dsp_polar()    amplitude (Q4) and phase (Q12 radians) by CORDIC
+ *   csi_dsp_sanitize() unwrapped phase with the least-squares line removed;
+ *                      the slope is the timing offset, the intercept the
+ *                      carrier phase offset, neither of which is channel
+ *   csi_motion_update() sliding window of amplitude vectors; the motion
+ *                      score is the mean temporal variance over the mean
+ *                      power, so it does not depend on the link's gain
+ *
+ * Only 20 MHz reports (no secondary channel) have the L-LTF layout
+ * csi_dsp_lltf() expects.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CSI_DSP_SC 52          // Subcarriers -26..-1, 1..26
+#define CSI_DSP_PI 12868       // pi in Q12 radians
+#define CSI_MOTION_WINDOW 32   // Reports in the motion window; power of two
+#define CSI_MOTION_SCALE 10000 // Score units per 1.0 (variance / power)
+#define CSI_MOTION_ON 100      // Default thresholds: 1% / 0.5%
+#define CSI_MOTION_OFF 50
+
+typedef struct {
+  uint16_t amp[CSI_MOTION_WINDOW][CSI_DSP_SC]; // Q4, oldest at pos
+  uint32_t sum[CSI_DSP_SC];                    // Over the window
+  uint32_t sumsq[CSI_DSP_SC];
+  uint16_t pos;   // Next slot to write
+  uint16_t fill;  // Valid slots
+  uint16_t score; // Last score, CSI_MOTION_SCALE = 1.0, saturating
+  bool active;    // Motion detected
+} csi_motion_t;
+
+/**
+ * @brief Extract the L-LTF subcarriers of a 20 MHz report
+ * @param buf Report data, (imaginary, real) int8 pairs in driver order
+ * @param len Bytes in buf
+ * @param first_invalid First 4 bytes not valid: subcarrier 1 is copied
+ *        from subcarrier 2
+ * @param iq Output, (imaginary, real) per subcarrier -26..-1, 1..26
+ * @return false when buf is too short for the L-LTF
+ */
+bool csi_dsp_lltf(const int8_t *buf, size_t len, bool first_invalid,
+                  int8_t iq[CSI_DSP_SC][2]);
+
+/**
+ * @brief Amplitude and phase of each subcarrier
+ * @param amp Output, Q4
+ * @param phase Output, Q12 radians in [-pi, pi]
+ */
+void csi_dsp_polar(const int8_t iq[CSI_DSP_SC][2], uint16_t amp[CSI_DSP_SC],
+                   int16_t phase[CSI_DSP_SC]);
+
+/**
+ * @brief Unwrap phase across subcarriers and remove its linear fit
+ * @param phase In: csi_dsp_polar() output. Out: residual, Q12 radians
+ * @return RMS of the residual, Q12 radians
+ */
+uint16_t csi_dsp_sanitize(int16_t phase[CSI_DSP_SC]);
+
+/**
+ * @brief Empty the window and clear the detector
+ */
+void csi_motion_reset(csi_motion_t *m);
+
+/**
+ * @brief Add an amplitude vector, rescore and run the detector
+ *
+ * Motion starts when the score reaches on and stops when it falls below
+ * off (off <= on gives hysteresis). Nothing is detected until the window
+ * is full.
+ * @return true when the detector changed state
+ */
+bool csi_motion_update(csi_motion_t *m, const uint16_t amp[CSI_DSP_SC],
+                       uint16_t on, uint16_t off);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,180 @@
+/**
+ * @file hop_sched.c
+ * @brief Activity-weighted channel hopping schedule
+ */
+#include "hop_sched.h"
+
+#include "chimera_proto.h"
+#include "esp_timer.h"
+#include "serial_comm.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Per-channel activity, counted by the RX callback and the packet worker
+static atomic_uint_fast32_t g_frames[HOP_CHANNELS];
+static atomic_uint_fast32_t g_mgmt[HOP_CHANNELS];
+static atomic_uint_fast32_t g_eapol[HOP_CHANNELS];
+
+// Hopper task state
+static uint32_t g_score[HOP_CHANNELS]; // Yield per second of dwell, x16
+static uint16_t g_plan_ms[HOP_CHANNELS];
+static int g_index = -1; // Channel being dwelt on, -1 before the first
+static int64_t g_round_start_us = 0;
+static int64_t g_due_us = 0; // When the current dwell's hop was due
+static uint32_t g_snap_yield = 0;
+
+// First frame after a switch: armed by the hopper, taken by the callback
+static atomic_bool g_await_first = false;
+static volatile uint8_t g_await_channel = 0;
+static atomic_int g_first_lost_us = 0;
+
+static hop_sched_stats_t g_stats;
+
+static uint32_t channel_yield(int i) {
+  return atomic_load(&g_frames[i]) +
+         HOP_WEIGHT_MGMT * atomic_load(&g_mgmt[i]) +
+         HOP_WEIGHT_EAPOL * atomic_load(&g_eapol[i]);
+}
+
+void hop_sched_reset(void) {
+  atomic_store(&g_await_first, false);
+  for (int i = 0; i < HOP_CHANNELS; i++) {
+    // Prior until measured: the non-overlapping channels are busiest
+    bool favored = (i == 0 || i == 5 || i == 10);
+    g_score[i] = (favored ? 30 : 10) * 16;
+  }
+  g_index = -1;
+  memset(&g_stats, 0, sizeof(g_stats));
+}
+
+/**
+ * @brief Share out the next round: HOP_DWELL_MIN_MS each, the rest by score
+ */
+static void plan_round(void) {
+  int32_t budget = HOP_REVISIT_MS -
+                   HOP_CHANNELS * (int32_t)((g_stats.latency_us + 999) / 1000);
+  int32_t spare = budget - HOP_CHANNELS * HOP_DWELL_MIN_MS;
+  if (spare < 0) {
+    spare = 0;
+  }
+
+  uint64_t total = 0;
+  for (int i = 0; i < HOP_CHANNELS; i++) {
+    total += g_score[i];
+  }
+  for (int i = 0; i < HOP_CHANNELS; i++) {
+    uint32_t extra = total ? (uint32_t)(spare * (uint64_t)g_score[i] / total)
+                           : (uint32_t)spare / HOP_CHANNELS;
+    g_plan_ms[i] = (uint16_t)(HOP_DWELL_MIN_MS + extra);
+  }
+  memcpy(g_stats.dwell_ms, g_plan_ms, sizeof(g_plan_ms));
+}
+
+static void send_stats(void) {
+  chimera_hop_stats_t rec = {
+      .hops = g_stats.hops,
+      .round_ms = (uint16_t)g_stats.round_ms,
+      .latency_us = (uint16_t)(g_stats.latency_us > UINT16_MAX
+                                   ? UINT16_MAX
+                                   : g_stats.latency_us),
+      .latency_max_us = (uint16_t)(g_stats.latency_max_us > UINT16_MAX
+                                       ? UINT16_MAX
+                                       : g_stats.latency_max_us),
+      .lost_us = g_stats.lost_us,
+  };
+  memcpy(rec.dwell_ms, g_plan_ms, sizeof(rec.dwell_ms));
+  serial_send_record(CHIMERA_MSG_HOP_STATS, CHIMERA_HOP_STATS_VERSION, &rec,
+                     sizeof(rec), NULL, 0);
+}
+
+/**
+ * @brief Fold the dwell that just ended into its channel's score
+ */
+static void close_dwell(int64_t now_us) {
+  int i = g_index;
+  int64_t dwell_us = now_us - g_due_us;
+  if (dwell_us < 1000) {
+    dwell_us = 1000;
+  }
+
+  // No frame at all: the whole dwell was lost
+  int32_t lost_us = atomic_exchange(&g_await_first, false)
+                        ? (int32_t)dwell_us
+                        : atomic_load(&g_first_lost_us);
+  if (lost_us < 0) {
+    lost_us = 0;
+  }
+  g_stats.lost_us += (lost_us - (int32_t)g_stats.lost_us) / 8;
+
+  uint32_t yield = channel_yield(i) - g_snap_yield;
+  uint32_t rate = (uint32_t)((uint64_t)yield * 16 * 1000000 / dwell_us);
+  g_score[i] += ((int32_t)rate - (int32_t)g_score[i]) / 4;
+  if (g_score[i] < 16) {
+    g_score[i] = 16; // Keep a quiet channel in the running
+  }
+}
+
+uint32_t hop_sched_next(int64_t now_us, uint8_t *channel) {
+  if (g_index >= 0) {
+    close_dwell(now_us);
+  }
+
+  g_index++;
+  if (g_index >= HOP_CHANNELS || g_index == 0) {
+    if (g_index > 0) {
+      g_stats.round_ms = (uint32_t)((now_us - g_round_start_us) / 1000);
+      send_stats();
+    }
+    g_index = 0;
+    g_round_start_us = now_us;
+    plan_round();
+  }
+
+  *channel = (uint8_t)(g_index + 1);
+  return g_plan_ms[g_index];
+}
+
+void hop_sched_switched(int64_t due_us, int64_t done_us) {
+  uint32_t latency = (uint32_t)(done_us > due_us ? done_us - due_us : 0);
+  g_stats.hops++;
+  g_stats.latency_us += ((int32_t)latency - (int32_t)g_stats.latency_us) / 8;
+  if (latency > g_stats.latency_max_us) {
+    g_stats.latency_max_us = latency;
+  }
+
+  g_due_us = due_us;
+  g_snap_yield = channel_yield(g_index);
+  g_await_channel = (uint8_t)(g_index + 1);
+  atomic_store(&g_first_lost_us, (int32_t)latency);
+  atomic_store(&g_await_first, true);
+}
+
+void hop_sched_note_frame(uint8_t channel) {
+  if (channel < 1 || channel > HOP_CHANNELS) {
+    return;
+  }
+  atomic_fetch_add(&g_frames[channel - 1], 1);
+
+  if (atomic_load(&g_await_first) && channel == g_await_channel &&
+      atomic_exchange(&g_await_first, false)) {
+    atomic_store(&g_first_lost_us, (int32_t)(esp_timer_get_time() - g_due_us));
+  }
+}
+
+void hop_sched_note_event(uint8_t channel, hop_event_t event) {
+  if (channel < 1 || channel > HOP_CHANNELS) {
+    return;
+  }
+  if (event == HOP_EVENT_EAPOL) {
+    atomic_fetch_add(&g_eapol[channel - 1], 1);
+  } else {
+    atomic_fetch_add(&g_mgmt[channel - 1], 1);
+  }
+}
+
+void hop_sched_get_stats(hop_sched_stats_t *stats) {
+  if (stats) {
+    *stats = g_stats;
+  }
+}
@@ -0,0 +1,83 @@
+/**
+ * @file hop_sched.h
+ * @brief Activity-weighted channel hopping schedule
+ *
+ * Hopping runs in rounds that visit channels 1-13 once each, so every
+ * channel is revisited at least every HOP_REVISIT_MS. Each channel gets
+ * HOP_DWELL_MIN_MS; the rest of the round is shared out in proportion to
+ * the channel's measured yield per second of dwell (frames, weighted up for
+ * management and EAPOL frames). Dwell time includes the switch and the
+ * dead time before the first frame, so channels where a visit is mostly
+ * lost earn less.
+ *
+ * The hopper calls hop_sched_next() when a dwell expires and
+ * hop_sched_switched() once the radio is on the new channel; switch latency
+ * (due time to radio on the channel) and time lost per switch (due time to
+ * first frame) are measured and sent as a HOP_STATS record every round.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HOP_CHANNELS 13
+#define HOP_DWELL_MIN_MS 50 // Every channel, every round
+#define HOP_REVISIT_MS 2000 // Round length, switch time included
+#define HOP_WEIGHT_MGMT 4   // Yield of a beacon/probe vs any frame
+#define HOP_WEIGHT_EAPOL 64 // Yield of an EAPOL-Key frame
+
+typedef enum {
+  HOP_EVENT_MGMT,
+  HOP_EVENT_EAPOL,
+} hop_event_t;
+
+typedef struct {
+  uint32_t hops;                   // Switches since hopping started
+  uint32_t round_ms;               // Length of the last round
+  uint32_t latency_us;             // Hop latency, moving average
+  uint32_t latency_max_us;         // Worst hop latency since hopping started
+  uint32_t lost_us;                // Time lost per switch, moving average
+  uint16_t dwell_ms[HOP_CHANNELS]; // Current plan, channels 1-13
+} hop_sched_stats_t;
+
+/**
+ * @brief Restart from the default plan (1, 6 and 11 favored)
+ */
+void hop_sched_reset(void);
+
+/**
+ * @brief Close the current dwell and pick the next channel (hopper task)
+ * @param now_us esp_timer time
+ * @param channel Next channel
+ * @return Dwell on it, ms
+ */
+uint32_t hop_sched_next(int64_t now_us, uint8_t *channel);
+
+/**
+ * @brief Note that the radio is on the channel from hop_sched_next()
+ * @param due_us When the hop was due
+ * @param done_us When the switch completed
+ */
+void hop_sched_switched(int64_t due_us, int64_t done_us);
+
+/**
+ * @brief Count a captured frame (WiFi RX callback)
+ */
+void hop_sched_note_frame(uint8_t channel);
+
+/**
+ * @brief Count a parsed management or EAPOL frame (packet worker)
+ */
+void hop_sched_note_event(uint8_t channel, hop_event_t event);
+
+/**
+ * @brief Snapshot hopping statistics
+ */
+void hop_sched_get_stats(hop_sched_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,397 @@
+/**
+ * @file hs_table.c
+ * @brief WPA 4-way handshake tracker
+ */
+#include "hs_table.h"
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "serial_comm.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "hs_table";
+
+typedef struct {
+  uint8_t anonce[32];
+  uint64_t replay;
+} hs_m1_rec_t;
+
+typedef struct {
+  bool used;
+  uint8_t bssid[6];
+  uint8_t sta[6];
+  uint8_t stage; // HS_STAGE_* reached by this exchange
+  uint8_t key_desc_type;
+  uint8_t key_desc_version;
+  uint8_t m1_count; // Valid entries in m1
+  uint8_t m1_next;  // Entry the next new M1 replaces
+  uint8_t paired;   // Entry the M2 paired with
+  hs_m1_rec_t m1[HS_TABLE_M1_KEEP];
+  uint64_t replay_m2;
+  uint64_t replay_m3;
+  uint32_t first_ms; // First M1 of the exchange
+  uint32_t last_ms;
+} hs_entry_t;
+
+// Sequence lock: the worker makes seq odd, writes the entry and makes it
+// even again; a reader copies the entry and keeps the copy only if seq
+// was even and unchanged across it.
+typedef struct {
+  atomic_uint seq;
+  hs_entry_t e;
+} hs_slot_t;
+
+static hs_slot_t *g_slots = NULL;
+static uint32_t g_slot_count = 0;
+static atomic_bool g_reset_req = false;
+
+static atomic_uint_fast32_t g_m1 = 0;
+static atomic_uint_fast32_t g_m2 = 0;
+static atomic_uint_fast32_t g_m3 = 0;
+static atomic_uint_fast32_t g_m4 = 0;
+static atomic_uint_fast32_t g_paired = 0;
+static atomic_uint_fast32_t g_completed = 0;
+static atomic_uint_fast32_t g_unmatched = 0;
+static atomic_uint_fast32_t g_evicted = 0;
+
+// ---------------- Sequence locks ----------------
+
+static void write_begin(hs_slot_t *s) {
+  unsigned v = atomic_load_explicit(&s->seq, memory_order_relaxed);
+  atomic_store_explicit(&s->seq, v + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+static void write_end(hs_slot_t *s) {
+  unsigned v = atomic_load_explicit(&s->seq, memory_order_relaxed);
+  atomic_store_explicit(&s->seq, v + 1, memory_order_release);
+}
+
+/**
+ * @brief Consistent copy of a slot; false if the worker kept writing it
+ */
+static bool read_slot(hs_slot_t *s, hs_entry_t *out) {
+  for (int tries = 0; tries < 8; tries++) {
+    unsigned v = atomic_load_explicit(&s->seq, memory_order_acquire);
+    if (v & 1) {
+      taskYIELD();
+      continue;
+    }
+    memcpy(out, &s->e, sizeof(*out));
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&s->seq, memory_order_relaxed) == v) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// ---------------- Hash table ----------------
+
+static hs_slot_t *set_of(const uint8_t *bssid, const uint8_t *sta) {
+  uint32_t h = 2166136261u; // FNV-1a
+  for (int i = 0; i < 6; i++) {
+    h = (h ^ bssid[i]) * 16777619u;
+  }
+  for (int i = 0; i < 6; i++) {
+    h = (h ^ sta[i]) * 16777619u;
+  }
+  uint32_t sets = g_slot_count / HS_TABLE_WAYS;
+  return &g_slots[(h & (sets - 1)) * HS_TABLE_WAYS];
+}
+
+static hs_slot_t *lookup(const uint8_t *bssid, const uint8_t *sta) {
+  hs_slot_t *set = set_of(bssid, sta);
+  for (int w = 0; w < HS_TABLE_WAYS; w++) {
+    const hs_entry_t *e = &set[w].e;
+    if (e->used && memcmp(e->bssid, bssid, 6) == 0 &&
+        memcmp(e->sta, sta, 6) == 0) {
+      return &set[w];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Slot for a new exchange: free, expired or least recently heard
+ */
+static hs_slot_t *claim(const uint8_t *bssid, const uint8_t *sta,
+                        uint32_t now_ms) {
+  hs_slot_t *set = set_of(bssid, sta);
+  hs_slot_t *victim = &set[0];
+  for (int w = 0; w < HS_TABLE_WAYS; w++) {
+    const hs_entry_t *e = &set[w].e;
+    if (!e->used || now_ms - e->last_ms > HS_TABLE_EXPIRE_MS) {
+      return &set[w];
+    }
+    if (now_ms - e->last_ms > now_ms - victim->e.last_ms) {
+      victim = &set[w];
+    }
+  }
+  if (victim->e.stage == HS_STAGE_M1) {
+    atomic_fetch_add(&g_evicted, 1); // Its M2 can no longer pair
+  }
+  return victim;
+}
+
+static void apply_reset(void) {
+  if (atomic_exchange(&g_reset_req, false)) {
+    for (uint32_t i = 0; i < g_slot_count; i++) {
+      write_begin(&g_slots[i]);
+      memset(&g_slots[i].e, 0, sizeof(hs_entry_t));
+      write_end(&g_slots[i]);
+    }
+  }
+}
+
+esp_err_t hs_table_init(void) {
+  if (g_slots) {
+    return ESP_OK;
+  }
+
+  g_slot_count = HS_TABLE_SLOTS;
+  g_slots = heap_caps_calloc(g_slot_count, sizeof(hs_slot_t),
+                             MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!g_slots) {
+    g_slot_count = HS_TABLE_SLOTS_INTERNAL;
+    g_slots =
+        heap_caps_calloc(g_slot_count, sizeof(hs_slot_t), MALLOC_CAP_8BIT);
+  }
+  if (!g_slots) {
+    g_slot_count = 0;
+    ESP_LOGE(TAG, "Failed to allocate handshake table");
+    return ESP_ERR_NO_MEM;
+  }
+  ESP_LOGI(TAG, "Handshake table: %lu slots", (unsigned long)g_slot_count);
+  return ESP_OK;
+}
+
+void hs_table_deinit(void) {
+  heap_caps_free(g_slots);
+  g_slots = NULL;
+  g_slot_count = 0;
+}
+
+void hs_table_reset(void) {
+  atomic_store(&g_reset_req, true);
+  atomic_store(&g_m1, 0);
+  atomic_store(&g_m2, 0);
+  atomic_store(&g_m3, 0);
+  atomic_store(&g_m4, 0);
+  atomic_store(&g_paired, 0);
+  atomic_store(&g_completed, 0);
+  atomic_store(&g_unmatched, 0);
+  atomic_store(&g_evicted, 0);
+}
+
+// ---------------- Pairing ----------------
+
+static uint64_t replay_value(const uint8_t *rc) {
+  uint64_t v = 0;
+  for (int i = 0; i < 8; i++) {
+    v = (v << 8) | rc[i];
+  }
+  return v;
+}
+
+static int find_m1(const hs_entry_t *e, uint64_t replay) {
+  for (int i = 0; i < e->m1_count; i++) {
+    if (e->m1[i].replay == replay) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void track_m1(const hs_key_msg_t *msg, uint64_t replay,
+                     hs_slot_t *s, uint32_t now_ms) {
+  if (!s) {
+    s = claim(msg->bssid, msg->sta, now_ms);
+  }
+  write_begin(s);
+  hs_entry_t *e = &s->e;
+  if (!e->used || e->stage != HS_STAGE_M1 ||
+      memcmp(e->bssid, msg->bssid, 6) != 0 ||
+      memcmp(e->sta, msg->sta, 6) != 0) {
+    // New exchange (or a new one after the last got past M1)
+    memset(e, 0, sizeof(*e));
+    e->used = true;
+    memcpy(e->bssid, msg->bssid, 6);
+    memcpy(e->sta, msg->sta, 6);
+    e->stage = HS_STAGE_M1;
+    e->first_ms = now_ms;
+  }
+
+  // Retransmissions carry a new counter; keep the last few
+  int i = find_m1(e, replay);
+  if (i < 0) {
+    i = e->m1_next;
+    e->m1_next = (e->m1_next + 1) % HS_TABLE_M1_KEEP;
+    if (e->m1_count < HS_TABLE_M1_KEEP) {
+      e->m1_count++;
+    }
+  }
+  memcpy(e->m1[i].anonce, msg->nonce, 32);
+  e->m1[i].replay = replay;
+  e->key_desc_type = msg->key_desc_type;
+  e->key_desc_version = msg->key_desc_version;
+  e->last_ms = now_ms;
+  write_end(s);
+}
+
+bool hs_table_update(const hs_key_msg_t *msg, uint32_t now_ms, hs_m1_t *m1) {
+  if (!g_slots || !msg) {
+    return false;
+  }
+  apply_reset();
+
+  uint64_t replay = replay_value(msg->replay_counter);
+  hs_slot_t *s = lookup(msg->bssid, msg->sta);
+  hs_entry_t *e = s ? &s->e : NULL;
+
+  switch (msg->msg) {
+  case HS_MSG_M1:
+    atomic_fetch_add(&g_m1, 1);
+    track_m1(msg, replay, s, now_ms);
+    return false;
+
+  case HS_MSG_M2: {
+    atomic_fetch_add(&g_m2, 1);
+    if (e && (e->stage & HS_STAGE_M2) && replay == e->replay_m2) {
+      return false; // Retransmitted; already paired
+    }
+    int i = e && e->stage == HS_STAGE_M1 ? find_m1(e, replay) : -1;
+    if (i < 0) {
+      atomic_fetch_add(&g_unmatched, 1);
+      return false;
+    }
+    write_begin(s);
+    e->stage |= HS_STAGE_M2;
+    e->paired = (uint8_t)i;
+    e->replay_m2 = replay;
+    e->last_ms = now_ms;
+    write_end(s);
+
+    if (m1) {
+      memcpy(m1->anonce, e->m1[i].anonce, 32);
+      memcpy(m1->replay_counter, msg->replay_counter, 8);
+      m1->key_desc_type = e->key_desc_type;
+      m1->key_desc_version = e->key_desc_version;
+    }
+    atomic_fetch_add(&g_paired, 1);
+    return true;
+  }
+
+  case HS_MSG_M3:
+    // M3 counts up from M2; a retransmitted M3 counts up again
+    atomic_fetch_add(&g_m3, 1);
+    if (!e || !(e->stage & HS_STAGE_M2) || (e->stage & HS_STAGE_M4) ||
+        replay <= e->replay_m2 ||
+        memcmp(msg->nonce, e->m1[e->paired].anonce, 32) != 0) {
+      atomic_fetch_add(&g_unmatched, 1);
+      return false;
+    }
+    write_begin(s);
+    e->stage |= HS_STAGE_M3;
+    e->replay_m3 = replay;
+    e->last_ms = now_ms;
+    write_end(s);
+    return false;
+
+  case HS_MSG_M4:
+    atomic_fetch_add(&g_m4, 1);
+    if (e && (e->stage & HS_STAGE_M4) && replay == e->replay_m3) {
+      return false; // Retransmitted
+    }
+    if (!e || !(e->stage & HS_STAGE_M3) || replay != e->replay_m3) {
+      atomic_fetch_add(&g_unmatched, 1);
+      return false;
+    }
+    write_begin(s);
+    e->stage |= HS_STAGE_M4;
+    e->last_ms = now_ms;
+    write_end(s);
+    atomic_fetch_add(&g_completed, 1);
+    return false;
+  }
+  return false;
+}
+
+// ---------------- Reporting ----------------
+
+static int stage_number(uint8_t stage) {
+  int n = 0;
+  while (stage) {
+    n++;
+    stage >>= 1;
+  }
+  return n;
+}
+
+esp_err_t hs_table_report(uint32_t now_ms) {
+  hs_table_stats_t st;
+  hs_table_get_stats(&st);
+
+  size_t cap = 256 + HS_TABLE_REPORT_MAX * 112;
+  char *json = malloc(cap);
+  if (!json) {
+    return ESP_ERR_NO_MEM;
+  }
+  int pos = snprintf(
+      json, cap,
+      "{\"slots\":%lu,\"m1\":%lu,\"m2\":%lu,\"m3\":%lu,\"m4\":%lu,"
+      "\"paired\":%lu,\"completed\":%lu,\"unmatched\":%lu,\"evicted\":%lu,"
+      "\"exchanges\":[",
+      (unsigned long)st.slots, (unsigned long)st.m1, (unsigned long)st.m2,
+      (unsigned long)st.m3, (unsigned long)st.m4, (unsigned long)st.paired,
+      (unsigned long)st.completed, (unsigned long)st.unmatched,
+      (unsigned long)st.evicted);
+
+  int listed = 0;
+  bool stale = atomic_load(&g_reset_req);
+  for (uint32_t i = 0; !stale && i < g_slot_count; i++) {
+    if (listed == HS_TABLE_REPORT_MAX) {
+      break;
+    }
+    hs_entry_t e;
+    if (!read_slot(&g_slots[i], &e) || !e.used ||
+        now_ms - e.last_ms > HS_TABLE_EXPIRE_MS) {
+      continue;
+    }
+    pos += snprintf(json + pos, cap - pos,
+                    "%s{\"bssid\":\"%02X:%02X:%02X:%02X:%02X:%02X\","
+                    "\"sta\":\"%02X:%02X:%02X:%02X:%02X:%02X\","
+                    "\"stage\":%d,\"age_ms\":%lu}",
+                    listed ? "," : "", e.bssid[0], e.bssid[1], e.bssid[2],
+                    e.bssid[3], e.bssid[4], e.bssid[5], e.sta[0], e.sta[1],
+                    e.sta[2], e.sta[3], e.sta[4], e.sta[5],
+                    stage_number(e.stage),
+                    (unsigned long)(now_ms - e.first_ms));
+    listed++;
+  }
+  snprintf(json + pos, cap - pos, "]}");
+
+  serial_send_json("handshakes", json);
+  free(json);
+  return ESP_OK;
+}
+
+void hs_table_get_stats(hs_table_stats_t *stats) {
+  if (!stats) {
+    return;
+  }
+  stats->m1 = atomic_load(&g_m1);
+  stats->m2 = atomic_load(&g_m2);
+  stats->m3 = atomic_load(&g_m3);
+  stats->m4 = atomic_load(&g_m4);
+  stats->paired = atomic_load(&g_paired);
+  stats->completed = atomic_load(&g_completed);
+  stats->unmatched = atomic_load(&g_unmatched);
+  stats->evicted = atomic_load(&g_evicted);
+  stats->slots = g_slot_count;
+}
@@ -0,0 +1,117 @@
+/**
+ * @file hs_table.h
+ * @brief WPA 4-way handshake tracker
+ *
+ * One entry per (BSSID, station) exchange in a hashed, 4-way set
+ * associative table, preferably in PSRAM, so a busy site with dozens of
+ * clients associating at once does not push M1s out before their M2s
+ * arrive. Messages are paired by replay counter: an M2 pairs with the M1
+ * (of the last few retransmissions) carrying the same counter, M3 must
+ * follow the paired M2 with the same ANonce, and M4 must echo M3's
+ * counter. Each entry records how far its exchange has got.
+ *
+ * A full set gives up its least recently heard entry. Entries older than
+ * HS_TABLE_EXPIRE_MS are free; an evicted exchange that was still waiting
+ * for its M2 is counted, as are M2-M4 frames that match nothing.
+ *
+ * hs_table_update() is called from the sniffer packet worker only. Each
+ * slot has a sequence lock, so hs_table_report() can read the table from
+ * any task without a mutex and without stalling the worker.
+ */
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HS_TABLE_SLOTS 1024        // Power of two; PSRAM
+#define HS_TABLE_SLOTS_INTERNAL 64 // Without PSRAM
+#define HS_TABLE_WAYS 4            // Slots per hash set
+#define HS_TABLE_M1_KEEP 2         // Retransmitted M1s kept per exchange
+#define HS_TABLE_EXPIRE_MS 10000   // Exchange abandoned after this long
+#define HS_TABLE_REPORT_MAX 32     // Exchanges listed by hs_table_report()
+
+// Exchange progress
+#define HS_STAGE_M1 0x01
+#define HS_STAGE_M2 0x02 // Paired with an M1: crackable
+#define HS_STAGE_M3 0x04
+#define HS_STAGE_M4 0x08 // Complete
+
+typedef enum {
+  HS_MSG_M1 = 1, // AP -> STA, ANonce
+  HS_MSG_M2,     // STA -> AP, SNonce and MIC
+  HS_MSG_M3,     // AP -> STA, install
+  HS_MSG_M4,     // STA -> AP, confirmation
+} hs_msg_t;
+
+typedef struct {
+  hs_msg_t msg;
+  const uint8_t *bssid;
+  const uint8_t *sta;
+  const uint8_t *replay_counter; // 8 bytes, big-endian
+  const uint8_t *nonce;          // 32 bytes
+  uint8_t key_desc_type;
+  uint8_t key_desc_version;
+} hs_key_msg_t;
+
+// The M1 an M2 paired with
+typedef struct {
+  uint8_t anonce[32];
+  uint8_t replay_counter[8];
+  uint8_t key_desc_type;
+  uint8_t key_desc_version;
+} hs_m1_t;
+
+typedef struct {
+  uint32_t m1; // Key messages seen
+  uint32_t m2;
+  uint32_t m3;
+  uint32_t m4;
+  uint32_t paired;    // M2s matched to their M1
+  uint32_t completed; // Exchanges followed through M4
+  uint32_t unmatched; // M2-M4 with no matching earlier message
+  uint32_t evicted;   // Exchanges waiting for M2 pushed out by others
+  uint32_t slots;     // Table size
+} hs_table_stats_t;
+
+/**
+ * @brief Allocate the table (once)
+ * @return ESP_OK, ESP_ERR_NO_MEM
+ */
+esp_err_t hs_table_init(void);
+
+/**
+ * @brief Free the table (no worker or reader may be using it)
+ */
+void hs_table_deinit(void);
+
+/**
+ * @brief Forget every exchange and zero the counters (any task; entries are
+ * cleared by the packet worker)
+ */
+void hs_table_reset(void);
+
+/**
+ * @brief Track a key message
+ * @param m1 Set to the paired M1 when the result is true
+ * @return true when msg is an M2 that completes a new M1+M2 pair
+ */
+bool hs_table_update(const hs_key_msg_t *msg, uint32_t now_ms, hs_m1_t *m1);
+
+/**
+ * @brief Send the counters and the live exchanges as "handshakes" JSON
+ */
+esp_err_t hs_table_report(uint32_t now_ms);
+
+/**
+ * @brief Snapshot counters
+ */
+void hs_table_get_stats(hs_table_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -18,19 +18,29 @@
 
 #include "ble_scanner.h"
 #include "buttons.h"
+#include "chimera_proto.h"
+#include "cmd_dispatch.h"
+#include "csi.h"
 #include "display.h"
 #include "gui.h"
+#include "hs_table.h"
 #include "nfc_pn532.h"
+#include "pcap_store.h"
+#include "probe_table.h"
+#include "scope.h"
 #include "serial_comm.h"
+#include "serial_log.h"
 #include "subghz_cc1101.h"
 #include "wifi_manager.h"
 
 #include "driver/spi_master.h"
 #include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_wifi.h" // Required for wifi_ap_record_t and esp_wifi_sta_get_ap_info
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -46,7 +56,6 @@ static size_t g_replay_len = 0;
 #define REPLAY_BUFFER_SIZE (32 * 1024)
 
 // Forward declarations
-static void handle_command(const char *cmd);
 static void wifi_scan_callback(const wifi_scan_result_t *result);
 static void ble_scan_callback(const ble_device_t *device);
 static void ble_scan_complete_callback(void);
@@ -56,26 +65,67 @@ static void ble_scan_complete_callback(void);
 static ble_device_t g_ble_devices[MAX_BLE_DEVICES];
 static int g_ble_device_count = 0;
 
-// JSON buffer size for BLE scan results
-#define BLE_JSON_BUFFER_SIZE 16384
-#define BLE_JSON_ENTRY_RESERVE 256 // Reserve space per entry
-
 // --- Command Handlers ---
 
-static void cmd_scan_wifi(void) {
+static esp_err_t cmd_scan_wifi(const cmd_args_t *args) {
+  (void)args;
   gui_log("Scanning WiFi...");
-  wifi_scan_start(wifi_scan_callback);
+  return wifi_scan_start(wifi_scan_callback);
 }
 
-static void cmd_scan_ble(void) {
+static esp_err_t cmd_scan_ble(const cmd_args_t *args) {
+  (void)args;
   gui_log("Scanning BLE...");
   g_ble_device_count = 0;
-  ble_scan_start(ble_scan_callback, ble_scan_complete_callback,
-                 5000); // 5 second scan
+  return ble_scan_start(ble_scan_callback, ble_scan_complete_callback,
+                        5000); // 5 second scan
 }
 
-static void cmd_sniff_start(const char *payload) {
-  int channel = (payload && *payload) ? atoi(payload) : 0;
+// Features that share the sniffer (recon, CSI) join a running session
+// instead of restarting it. A session one of them started belongs to the
+// features in g_sniff_users and stops when the last one leaves; one started
+// by SNIFF_START has no users and is only stopped explicitly. Joined and
+// left on the WiFi worker, reset by STOP on the command task.
+#define SNIFF_USER_RECON 0x01u
+#define SNIFF_USER_CSI 0x02u
+static atomic_uint g_sniff_users = 0;
+
+static void sniff_join(unsigned user, bool started) {
+  if (started) {
+    atomic_store(&g_sniff_users, user);
+    return;
+  }
+  unsigned cur = atomic_load(&g_sniff_users);
+  while (cur && !atomic_compare_exchange_weak(&g_sniff_users, &cur,
+                                              cur | user)) {
+  }
+}
+
+static void sniff_leave(unsigned user) {
+  unsigned prev = atomic_fetch_and(&g_sniff_users, ~user);
+  if (prev == user) {
+    wifi_sniffer_stop(); // Last user left
+  }
+}
+
+static esp_err_t cmd_sniff_start(const cmd_args_t *args) {
+  int channel = 0;
+  uint32_t mask = 0;
+
+  if (args->payload && *args->payload) {
+    channel = atoi(args->payload);
+  } else if (serial_arg_u32(
+                 serial_bin_arg(args->bin, SERIAL_ARG_CHAN_MASK, 0), &mask)) {
+    // A single channel pins the radio; anything else hops
+    mask &= 0x3FFE; // Channels 1-13
+    if (mask != 0 && (mask & (mask - 1)) == 0) {
+      channel = __builtin_ctz(mask);
+    }
+  }
+  if (channel < 0 || channel > 13) {
+    serial_send_json("error", "\"Invalid channel\"");
+    return ESP_ERR_INVALID_ARG;
+  }
 
   char msg[32];
   if (channel == 0) {
@@ -85,18 +135,239 @@ static void cmd_sniff_start(const char *payload) {
   }
   gui_log(msg);
 
-  wifi_sniffer_start(channel);
+  atomic_store(&g_sniff_users, 0); // Explicit session from here on
+  return wifi_sniffer_start((uint8_t)channel);
 }
 
-static void cmd_sniff_stop(void) {
+static esp_err_t cmd_sniff_stop(const cmd_args_t *args) {
+  (void)args;
+  atomic_store(&g_sniff_users, 0);
   wifi_sniffer_stop();
   gui_log("Sniff stopped");
+  return ESP_OK;
+}
+
+// SNIFF_RAW:<snaplen>[,<every>] streams every <every>-th captured frame as a
+// RAW_FRAME record; snaplen 0 turns it off. Binary: U32 snaplen, [U32 every].
+static esp_err_t cmd_sniff_raw(const cmd_args_t *args) {
+  uint32_t snaplen = 0;
+  uint32_t every = 1;
+
+  if (args->payload && *args->payload) {
+    char *end = NULL;
+    snaplen = strtoul(args->payload, &end, 10);
+    if (end && *end == ',') {
+      every = strtoul(end + 1, NULL, 10);
+    }
+  } else if (!serial_arg_u32(serial_bin_arg(args->bin, SERIAL_ARG_U32, 0),
+                             &snaplen)) {
+    return ESP_ERR_INVALID_ARG;
+  } else {
+    serial_arg_u32(serial_bin_arg(args->bin, SERIAL_ARG_U32, 1), &every);
+  }
+
+  if (snaplen > UINT16_MAX || every > UINT16_MAX) {
+    serial_send_json("error", "\"Invalid raw stream setting\"");
+    return ESP_ERR_INVALID_ARG;
+  }
+  return wifi_set_raw_stream((uint16_t)snaplen, (uint16_t)every);
+}
+
+// HANDSHAKES lists the handshake tracker's counters and live exchanges;
+// HANDSHAKES:clear forgets them. Binary: [U32 1 = clear].
+static esp_err_t cmd_handshakes(const cmd_args_t *args) {
+  uint32_t clear = 0;
+  if (args->payload && *args->payload) {
+    clear = strcmp(args->payload, "clear") == 0;
+  } else if (args->bin) {
+    serial_arg_u32(serial_bin_arg(args->bin, SERIAL_ARG_U32, 0), &clear);
+  }
+
+  if (clear) {
+    wifi_clear_handshake_cache();
+    serial_send_json("status", "\"Handshakes cleared\"");
+    return ESP_OK;
+  }
+  return hs_table_report((uint32_t)(esp_timer_get_time() / 1000));
+}
+
+// SURVEY:<interval_ms> sends per-channel SURVEY snapshots while sniffing;
+// 0 or no argument stops it. Binary: U32 interval.
+static esp_err_t cmd_survey(const cmd_args_t *args) {
+  uint32_t interval_ms = 0;
+
+  if (args->payload && *args->payload) {
+    interval_ms = strtoul(args->payload, NULL, 10);
+  } else if (args->bin) {
+    serial_arg_u32(serial_bin_arg(args->bin, SERIAL_ARG_U32, 0), &interval_ms);
+  }
+
+  esp_err_t ret = wifi_set_survey(interval_ms);
+  if (ret != ESP_OK) {
+    serial_send_json("error", "\"Survey interval out of range\"");
+  }
+  return ret;
+}
+
+// FILTER:<expr> compiles and installs a packet filter (see pkt_filter.h);
+// no expression clears it. Binary: BLOB precompiled program or STR expr.
+static esp_err_t cmd_filter(const cmd_args_t *args) {
+  // Static: too big for the RX task stack, only used from this handler
+  static pkt_filter_t filter;
+  static char expr[1024];
+  const serial_arg_t *blob =
+      args->bin ? serial_bin_arg(args->bin, SERIAL_ARG_BLOB, 0) : NULL;
+
+  if (blob) {
+    if (pkt_filter_load(blob->data, blob->len, &filter) != ESP_OK) {
+      serial_send_json("error", "\"Invalid filter program\"");
+      return ESP_ERR_INVALID_ARG;
+    }
+  } else {
+    if (!cmd_args_str(args, expr, sizeof(expr)) || expr[0] == '\0') {
+      gui_log("Filter cleared");
+      return wifi_set_filter(NULL);
+    }
+    if (strlen(expr) == sizeof(expr) - 1) {
+      serial_send_json("error", "\"Filter expression too long\"");
+      return ESP_ERR_INVALID_ARG;
+    }
+
+    char err[48];
+    if (pkt_filter_compile(expr, &filter, err, sizeof(err)) != ESP_OK) {
+      char msg[64];
+      snprintf(msg, sizeof(msg), "\"Filter: %s\"", err);
+      serial_send_json("error", msg);
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+
+  char msg[48];
+  snprintf(msg, sizeof(msg), "{\"code\":%u,\"sets\":%u}", filter.code_len,
+           filter.set_count);
+  serial_send_json("filter", msg);
+  gui_log("Filter set");
+  return wifi_set_filter(&filter);
+}
+
+// Binary form: MAC_LIST of addresses, U32 OUIs (0xAABBCC), STR SSIDs
+static esp_err_t cmd_scope_add_bin(const serial_bin_cmd_t *cmd) {
+  esp_err_t ret = ESP_ERR_INVALID_ARG;
+
+  const serial_arg_t *macs = serial_bin_arg(cmd, SERIAL_ARG_MAC_LIST, 0);
+  size_t n = serial_arg_mac_count(macs);
+  for (size_t i = 0; i < n; i++) {
+    if ((ret = scope_add_addr(macs->data + i * 6)) != ESP_OK) {
+      return ret;
+    }
+  }
+
+  uint32_t v;
+  for (uint8_t i = 0;
+       serial_arg_u32(serial_bin_arg(cmd, SERIAL_ARG_U32, i), &v); i++) {
+    uint8_t oui[3] = {(uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v};
+    if ((ret = scope_add_oui(oui)) != ESP_OK) {
+      return ret;
+    }
+  }
+
+  const serial_arg_t *s;
+  for (uint8_t i = 0; (s = serial_bin_arg(cmd, SERIAL_ARG_STR, i)); i++) {
+    if ((ret = scope_add_ssid(s->data, s->len)) != ESP_OK) {
+      return ret;
+    }
+  }
+  return ret;
 }
 
-static void cmd_deauth(const char *payload) {
+// SCOPE_ADD:addr,<mac> | oui,<AA:BB:CC> | ssid,<name> extends the engagement
+// scope (see scope.h); once it has any entry it is enforced.
+static esp_err_t cmd_scope_add(const cmd_args_t *args) {
+  esp_err_t ret = ESP_ERR_INVALID_ARG;
+
+  if (args->bin) {
+    ret = cmd_scope_add_bin(args->bin);
+  } else if (args->payload) {
+    const char *comma = strchr(args->payload, ',');
+    const char *value = comma ? comma + 1 : "";
+    size_t kind_len = comma ? (size_t)(comma - args->payload) : 0;
+    uint8_t mac[6];
+
+    if (kind_len == 4 && strncmp(args->payload, "ssid", 4) == 0) {
+      ret = scope_add_ssid((const uint8_t *)value, strlen(value));
+    } else if (kind_len == 3 && strncmp(args->payload, "oui", 3) == 0) {
+      if (sscanf(value, "%hhx:%hhx:%hhx", &mac[0], &mac[1], &mac[2]) == 3) {
+        ret = scope_add_oui(mac);
+      }
+    } else if ((kind_len == 4 && strncmp(args->payload, "addr", 4) == 0) ||
+               (kind_len == 5 && strncmp(args->payload, "bssid", 5) == 0)) {
+      if (sscanf(value, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx", &mac[0], &mac[1],
+                 &mac[2], &mac[3], &mac[4], &mac[5]) == 6) {
+        ret = scope_add_addr(mac);
+      }
+    }
+  }
+
+  if (ret == ESP_ERR_NO_MEM) {
+    serial_send_json("error", "\"Scope table full\"");
+  } else if (ret != ESP_OK) {
+    serial_send_json("error", "\"Invalid scope entry\"");
+  }
+  return ret;
+}
+
+static esp_err_t cmd_scope_clear(const cmd_args_t *args) {
+  (void)args;
+  scope_clear();
+  gui_log("Scope cleared");
+  return ESP_OK;
+}
+
+static esp_err_t cmd_scope_list(const cmd_args_t *args) {
+  (void)args;
+  return scope_report();
+}
+
+// Binary form: MAC_LIST of APs, [U32 channel], [U32 packets per AP]
+static esp_err_t cmd_deauth_list(const serial_bin_cmd_t *cmd) {
+  const serial_arg_t *macs = serial_bin_arg(cmd, SERIAL_ARG_MAC_LIST, 0);
+  size_t n = serial_arg_mac_count(macs);
+  if (n == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  uint32_t channel = 0;
+  uint32_t count = 50;
+  serial_arg_u32(serial_bin_arg(cmd, SERIAL_ARG_U32, 0), &channel);
+  serial_arg_u32(serial_bin_arg(cmd, SERIAL_ARG_U32, 1), &count);
+  if (channel > 13 || count == 0 || count > 1000) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  char msg[32];
+  snprintf(msg, sizeof(msg), "DEAUTH x%d ch%lu", (int)n,
+           (unsigned long)channel);
+  gui_log_color(msg, COLOR_RED);
+
+  int ok = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (wifi_send_deauth_burst(NULL, macs->data + i * 6, (uint8_t)channel, 7,
+                               (int)count) == ESP_OK) {
+      ok++;
+    }
+  }
+  return (ok > 0) ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t cmd_deauth(const cmd_args_t *args) {
+  if (args->bin) {
+    return cmd_deauth_list(args->bin);
+  }
+
+  const char *payload = args->payload;
   if (!payload || strlen(payload) < 17) {
     serial_send_json("error", "\"Invalid or missing MAC address\"");
-    return;
+    return ESP_ERR_INVALID_ARG;
   }
 
   uint8_t mac[6];
@@ -109,7 +380,7 @@ static void cmd_deauth(const char *payload) {
 
   if (fields < 6) {
     serial_send_json("error", "\"Invalid MAC format\"");
-    return;
+    return ESP_ERR_INVALID_ARG;
   }
 
   // If only 6 fields were parsed, channel remains 0 (hopping)
@@ -134,22 +405,27 @@ static void cmd_deauth(const char *payload) {
 
   ESP_LOGI(TAG, "Deauth burst complete: %s",
            (ret == ESP_OK) ? "SUCCESS" : "FAILED");
+  return ret;
 }
 
-static void cmd_ble_spam(const char *payload) {
-  const char *type = (payload && *payload) ? payload : NULL;
+static esp_err_t cmd_ble_spam(const cmd_args_t *args) {
+  char type_buf[16];
+  const char *type = cmd_args_str(args, type_buf, sizeof(type_buf))
+                         ? type_buf
+                         : NULL;
 
   char msg[32];
   snprintf(msg, sizeof(msg), "BLE Spam: %s", type ? type : "BENDER");
   gui_log_color(msg, COLOR_ORANGE);
 
-  ble_spam_start(type, 50);
+  return ble_spam_start(type, 50);
 }
 
-static void cmd_set_freq(const char *payload) {
-  if (!payload || !*payload) {
+static esp_err_t cmd_set_freq(const cmd_args_t *args) {
+  char payload[16];
+  if (!cmd_args_str(args, payload, sizeof(payload))) {
     serial_send_json("error", "\"Missing frequency\"");
-    return;
+    return ESP_ERR_INVALID_ARG;
   }
 
   float freq = atof(payload);
@@ -159,12 +435,15 @@ static void cmd_set_freq(const char *payload) {
     char msg[32];
     snprintf(msg, sizeof(msg), "Freq: %.2f MHz", freq);
     gui_log(msg);
-  } else {
-    serial_send_json("error", "\"Invalid frequency\"");
+    return ESP_OK;
   }
+
+  serial_send_json("error", "\"Invalid frequency\"");
+  return ESP_ERR_INVALID_ARG;
 }
 
-static void cmd_subghz_record(void) {
+static esp_err_t cmd_subghz_record(const cmd_args_t *args) {
+  (void)args;
   if (!g_replay_buffer) {
     g_replay_buffer = heap_caps_malloc(REPLAY_BUFFER_SIZE,
                                        MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
@@ -175,22 +454,26 @@ static void cmd_subghz_record(void) {
 
   if (g_replay_buffer) {
     gui_log("Recording Sub-GHz...");
-    cc1101_record_start(g_replay_buffer, REPLAY_BUFFER_SIZE);
-  } else {
-    serial_send_json("error", "\"Memory allocation failed\"");
+    return cc1101_record_start(g_replay_buffer, REPLAY_BUFFER_SIZE);
   }
+
+  serial_send_json("error", "\"Memory allocation failed\"");
+  return ESP_ERR_NO_MEM;
 }
 
-static void cmd_subghz_replay(void) {
+static esp_err_t cmd_subghz_replay(const cmd_args_t *args) {
+  (void)args;
   if (g_replay_len > 0 && g_replay_buffer) {
     gui_log("Replaying signal...");
-    cc1101_replay(g_replay_buffer, g_replay_len);
-  } else {
-    serial_send_json("error", "\"Buffer empty\"");
+    return cc1101_replay(g_replay_buffer, g_replay_len);
   }
+
+  serial_send_json("error", "\"Buffer empty\"");
+  return ESP_ERR_INVALID_STATE;
 }
 
-static void cmd_nfc_scan(void) {
+static esp_err_t cmd_nfc_scan(const cmd_args_t *args) {
+  (void)args;
   gui_log("Scanning NFC...");
 
   nfc_tag_t tag;
@@ -211,68 +494,203 @@ static void cmd_nfc_scan(void) {
     char msg[32];
     snprintf(msg, sizeof(msg), "NFC: %s", uid_str);
     gui_log_color(msg, COLOR_CYAN);
-  } else {
-    serial_send_json("status", "\"No tag found\"");
+    return ESP_OK;
   }
+
+  serial_send_json("status", "\"No tag found\"");
+  return ESP_ERR_NOT_FOUND;
 }
 
-static void cmd_get_info(void) {
+static esp_err_t cmd_get_info(const cmd_args_t *args) {
+  (void)args;
   char json[512];
   uint32_t free_heap = esp_get_free_heap_size();
   uint32_t total_heap = heap_caps_get_total_size(MALLOC_CAP_8BIT);
   uint32_t psram = heap_caps_get_total_size(MALLOC_CAP_SPIRAM);
+  wifi_radio_stats_t radio;
+  wifi_get_radio_stats(&radio);
 
   snprintf(json, sizeof(json),
            "{\"type\":\"sys_info\",\"chip\":\"ESP32-S3\",\"version\":\"%s\","
            "\"free_heap\":%lu,\"total_heap\":%lu,\"psram\":%lu,"
-           "\"nfc\":%s,\"cc1101\":%s}",
+           "\"nfc\":%s,\"cc1101\":%s,\"radio\":\"%s\","
+           "\"radio_last_us\":%lu,\"radio_avg_us\":%lu,\"radio_max_us\":%lu}",
            FIRMWARE_VERSION, (unsigned long)free_heap,
            (unsigned long)total_heap, (unsigned long)psram,
            pn532_is_present() ? "true" : "false",
-           cc1101_is_present() ? "true" : "false");
+           cc1101_is_present() ? "true" : "false",
+           wifi_radio_mode_name(radio.mode), (unsigned long)radio.last_us,
+           (unsigned long)radio.avg_us, (unsigned long)radio.max_us);
 
   serial_send_json_raw(json);
+  return ESP_OK;
 }
 
-static void cmd_recon_start(void) {
+static esp_err_t cmd_recon_start(const cmd_args_t *args) {
+  (void)args;
   wifi_start_recon_mode();
-  wifi_sniffer_start(0); // Start hopping
+  bool start = !wifi_is_sniffing();
+  esp_err_t ret = start ? wifi_sniffer_start(0) : ESP_OK; // Start hopping
+  if (ret == ESP_OK) {
+    sniff_join(SNIFF_USER_RECON, start);
+  }
   gui_log("Recon mode active");
+  return ret;
 }
 
-static void cmd_recon_stop(void) {
+static esp_err_t cmd_recon_stop(const cmd_args_t *args) {
+  (void)args;
   wifi_stop_recon_mode();
-  wifi_sniffer_stop();
+  sniff_leave(SNIFF_USER_RECON);
   gui_log("Recon stopped");
+  return ESP_OK;
 }
 
 // --- CSI (Channel State Information) Commands ---
-static bool g_csi_active = false;
+static bool csi_active(void) {
+  return wifi_get_radio_mode() == WIFI_RADIO_MONITOR_CSI;
+}
 
-static void cmd_csi_start(void) {
-  if (g_csi_active) {
+static esp_err_t cmd_csi_start(const cmd_args_t *args) {
+  (void)args;
+  if (csi_active()) {
     serial_send_json("status", "\"CSI already active\"");
-    return;
+    return ESP_OK;
   }
 
-  // CSI requires promiscuous mode with specific filter
-  wifi_sniffer_start(0); // Start on current channel
-  g_csi_active = true;
+  // Sniffs on the current channel; an active sniffer is kept running
+  bool start = !wifi_is_sniffing();
+  esp_err_t ret = wifi_set_csi(true);
+  if (ret != ESP_OK) {
+    serial_send_json("error", "\"CSI start failed\"");
+    return ret;
+  }
+  sniff_join(SNIFF_USER_CSI, start);
   gui_log_color("CSI Radar Active", COLOR_CYAN);
   serial_send_json("status", "\"CSI started\"");
+  return ESP_OK;
 }
 
-static void cmd_csi_stop(void) {
-  if (g_csi_active) {
-    wifi_sniffer_stop();
-    g_csi_active = false;
+static esp_err_t cmd_csi_stop(const cmd_args_t *args) {
+  (void)args;
+  if (csi_active()) {
+    wifi_set_csi(false);
+    sniff_leave(SNIFF_USER_CSI);
     gui_log("CSI stopped");
     serial_send_json("status", "\"CSI stopped\"");
+
+    csi_stats_t st;
+    csi_get_stats(&st);
+    char json[200];
+    snprintf(json, sizeof(json),
+             "{\"received\":%lu,\"filtered\":%lu,\"decimated\":%lu,"
+             "\"dropped\":%lu,\"truncated\":%lu,\"sent\":%lu,"
+             "\"features\":%lu,\"skipped\":%lu}",
+             (unsigned long)st.received, (unsigned long)st.filtered,
+             (unsigned long)st.decimated, (unsigned long)st.dropped,
+             (unsigned long)st.truncated, (unsigned long)st.sent,
+             (unsigned long)st.features, (unsigned long)st.skipped);
+    serial_send_json("csi_stats", json);
+  }
+  return ESP_OK;
+}
+
+// CSI_CONFIG:<every>[,<mac>...] keeps one CSI report in every <every> from
+// the listed transmitters (none = all). Binary: [U32 every], [MAC_LIST].
+static esp_err_t cmd_csi_config(const cmd_args_t *args) {
+  uint32_t every = 1;
+  uint8_t macs[CSI_SOURCES_MAX][6];
+  size_t count = 0;
+
+  if (args->payload && *args->payload) {
+    char *p = NULL;
+    every = strtoul(args->payload, &p, 10);
+    while (p && *p == ',') {
+      uint8_t mac[6];
+      if (count == CSI_SOURCES_MAX ||
+          sscanf(p + 1, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx", &mac[0], &mac[1],
+                 &mac[2], &mac[3], &mac[4], &mac[5]) != 6) {
+        serial_send_json("error", "\"Invalid CSI source\"");
+        return ESP_ERR_INVALID_ARG;
+      }
+      memcpy(macs[count++], mac, 6);
+      p = strchr(p + 1, ',');
+    }
+  } else if (args->bin) {
+    serial_arg_u32(serial_bin_arg(args->bin, SERIAL_ARG_U32, 0), &every);
+    const serial_arg_t *list =
+        serial_bin_arg(args->bin, SERIAL_ARG_MAC_LIST, 0);
+    count = serial_arg_mac_count(list);
+    if (count > CSI_SOURCES_MAX) {
+      serial_send_json("error", "\"Too many CSI sources\"");
+      return ESP_ERR_INVALID_ARG;
+    }
+    if (count) {
+      memcpy(macs, list->data, count * 6);
+    }
+  }
+
+  if (every > UINT16_MAX) {
+    serial_send_json("error", "\"Invalid CSI decimation\"");
+    return ESP_ERR_INVALID_ARG;
+  }
+  return csi_configure((uint16_t)every, macs[0], count);
+}
+
+// CSI_OUTPUT:raw | CSI_OUTPUT:features[,<interval_ms>[,<on>[,<off>]]]
+// chooses CSI_DATA records or CSI_FEATURES records every <interval_ms> (0 =
+// motion events only) with motion score thresholds <on>/<off>; omitted
+// values are kept. Binary: U32 mode (0 features, 1 raw), [U32 interval],
+// [U32 on], [U32 off].
+static esp_err_t cmd_csi_output(const cmd_args_t *args) {
+  csi_output_t out;
+  csi_get_output(&out);
+  uint32_t v[4] = {out.mode, out.interval_ms, out.motion_on, out.motion_off};
+
+  if (args->payload && *args->payload) {
+    const char *p = args->payload;
+    if (strncmp(p, "raw", 3) == 0) {
+      v[0] = CSI_OUTPUT_RAW;
+      p += 3;
+    } else if (strncmp(p, "features", 8) == 0) {
+      v[0] = CSI_OUTPUT_FEATURES;
+      p += 8;
+    } else {
+      serial_send_json("error", "\"Unknown CSI output\"");
+      return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 1; i < 4 && *p == ','; i++) {
+      char *end = NULL;
+      v[i] = strtoul(p + 1, &end, 10);
+      p = end;
+    }
+  } else if (!serial_arg_u32(serial_bin_arg(args->bin, SERIAL_ARG_U32, 0),
+                             &v[0])) {
+    return ESP_ERR_INVALID_ARG;
+  } else {
+    for (uint8_t i = 1; i < 4; i++) {
+      serial_arg_u32(serial_bin_arg(args->bin, SERIAL_ARG_U32, i), &v[i]);
+    }
+  }
+
+  if (v[1] > UINT16_MAX || v[2] > UINT16_MAX || v[3] > UINT16_MAX) {
+    serial_send_json("error", "\"Invalid CSI output setting\"");
+    return ESP_ERR_INVALID_ARG;
+  }
+  out = (csi_output_t){.mode = (csi_output_mode_t)v[0],
+                       .interval_ms = (uint16_t)v[1],
+                       .motion_on = (uint16_t)v[2],
+                       .motion_off = (uint16_t)v[3]};
+  esp_err_t ret = csi_set_output(&out);
+  if (ret != ESP_OK) {
+    serial_send_json("error", "\"Invalid CSI output setting\"");
   }
+  return ret;
 }
 
 // --- NFC Emulation ---
-static void cmd_nfc_emulate(void) {
+static esp_err_t cmd_nfc_emulate(const cmd_args_t *args) {
+  (void)args;
   // Check if we have a UID to emulate
   gui_log("NFC Emulate...");
 
@@ -284,6 +702,7 @@ static void cmd_nfc_emulate(void) {
   // Note: Full HCE would require PN532 firmware modification
   // This is a placeholder for future NFC-DEP P2P mode
   gui_log_color("Emulate: Limited", COLOR_ORANGE);
+  return ESP_ERR_NOT_SUPPORTED;
 }
 
 // --- Sub-GHz Analyzer (RSSI sweep) ---
@@ -300,7 +719,7 @@ static void analyzer_task(void *arg) {
     char json[64];
     snprintf(json, sizeof(json), "{\"type\":\"analyzer_data\",\"rssi\":%d}",
              rssi);
-    serial_send_json_raw(json);
+    serial_send_json_raw_class(SERIAL_CLASS_TELEMETRY, json);
 
     vTaskDelay(pdMS_TO_TICKS(50)); // 20 Hz update rate
   }
@@ -309,15 +728,16 @@ static void analyzer_task(void *arg) {
   vTaskDelete(NULL);
 }
 
-static void cmd_analyzer_start(void) {
+static esp_err_t cmd_analyzer_start(const cmd_args_t *args) {
+  (void)args;
   if (g_analyzer_active) {
     serial_send_json("status", "\"Analyzer already running\"");
-    return;
+    return ESP_OK;
   }
 
   if (!cc1101_is_present()) {
     serial_send_json("error", "\"CC1101 not detected\"");
-    return;
+    return ESP_ERR_NOT_FOUND;
   }
 
   g_analyzer_active = true;
@@ -326,15 +746,18 @@ static void cmd_analyzer_start(void) {
   xTaskCreate(analyzer_task, "analyzer", 2048, NULL, 3, &g_analyzer_task);
   gui_log_color("Analyzer Running", COLOR_CYAN);
   serial_send_json("status", "\"Analyzer started\"");
+  return ESP_OK;
 }
 
-static void cmd_analyzer_stop(void) {
+static esp_err_t cmd_analyzer_stop(const cmd_args_t *args) {
+  (void)args;
   if (g_analyzer_active) {
     g_analyzer_active = false;
     cc1101_idle();
     gui_log("Analyzer stopped");
     serial_send_json("status", "\"Analyzer stopped\"");
   }
+  return ESP_OK;
 }
 
 // --- Sub-GHz Brute Force (12-bit fixed codes) ---
@@ -382,7 +805,7 @@ static void brute_force_task(void *arg) {
       snprintf(json, sizeof(json),
                "{\"type\":\"brute_progress\",\"current\":%d,\"total\":4096}",
                code);
-      serial_send_json_raw(json);
+      serial_send_json_raw_class(SERIAL_CLASS_TELEMETRY, json);
     }
 
     vTaskDelay(pdMS_TO_TICKS(20)); // ~50 codes/sec
@@ -399,39 +822,265 @@ static void brute_force_task(void *arg) {
   vTaskDelete(NULL);
 }
 
-static void cmd_subghz_brute(void) {
+static esp_err_t cmd_subghz_brute(const cmd_args_t *args) {
+  (void)args;
   if (g_brute_active) {
     serial_send_json("status", "\"Brute force already running\"");
-    return;
+    return ESP_OK;
   }
 
   if (!cc1101_is_present()) {
     serial_send_json("error", "\"CC1101 not detected\"");
-    return;
+    return ESP_ERR_NOT_FOUND;
   }
 
   g_brute_active = true;
   xTaskCreate(brute_force_task, "brute", 4096, NULL, 3, &g_brute_task);
+  return ESP_OK;
 }
 
 // --- Generic STOP command ---
-static void cmd_stop_all(void) {
-  // Stop all active operations
-  if (g_csi_active)
-    cmd_csi_stop();
+// Runs inline on the RX task, so it takes effect while a long operation is
+// still executing on a worker.
+static esp_err_t cmd_stop_all(const cmd_args_t *args) {
+  // Drop anything still waiting behind the running operations
+  cmd_dispatch_cancel();
+
+  // Signal running operations to stop
+  if (ble_spam_is_active())
+    ble_spam_stop();
+  if (ble_is_scanning())
+    ble_scan_stop();
+  if (csi_active())
+    cmd_csi_stop(args);
   if (g_analyzer_active)
-    cmd_analyzer_stop();
+    cmd_analyzer_stop(args);
   if (g_brute_active) {
     g_brute_active = false;
     gui_log("Brute force aborted");
   }
+  wifi_scan_stop();
+  wifi_stop_recon_mode();
+  atomic_store(&g_sniff_users, 0);
   wifi_sniffer_stop();
 
   gui_log("All operations stopped");
   serial_send_json("status", "\"All stopped\"");
+  return ESP_OK;
+}
+
+// CAPTURE_START[:<file_kb>,<total_kb>,<snaplen>] records every frame the
+// sniffer sees to the storage partition (0 or missing = default).
+// Binary: [U32 file_kb], [U32 total_kb], [U32 snaplen].
+static esp_err_t cmd_capture_start(const cmd_args_t *args) {
+  uint32_t v[3] = {0, 0, 0};
+
+  if (args->payload && *args->payload) {
+    const char *p = args->payload;
+    for (int i = 0; i < 3 && *p; i++) {
+      char *end = NULL;
+      v[i] = strtoul(p, &end, 10);
+      if (!end || *end != ',')
+        break;
+      p = end + 1;
+    }
+  } else if (args->bin) {
+    for (int i = 0; i < 3; i++)
+      serial_arg_u32(serial_bin_arg(args->bin, SERIAL_ARG_U32, i), &v[i]);
+  }
+
+  if (v[0] > 4096 || v[1] > 4096 || v[2] > UINT16_MAX) {
+    serial_send_json("error", "\"Invalid capture limits\"");
+    return ESP_ERR_INVALID_ARG;
+  }
+  pcap_store_config_t cfg = {
+      .file_max = v[0] * 1024,
+      .total_max = v[1] * 1024,
+      .snaplen = (uint16_t)v[2],
+  };
+  esp_err_t ret = pcap_store_start(&cfg);
+  if (ret == ESP_OK)
+    gui_log("Capture to flash");
+  return ret;
+}
+
+static esp_err_t cmd_capture_stop(const cmd_args_t *args) {
+  (void)args;
+  pcap_store_stop();
+  gui_log("Capture stopped");
+  return ESP_OK;
+}
+
+static esp_err_t cmd_capture_list(const cmd_args_t *args) {
+  (void)args;
+  return pcap_store_list();
+}
+
+// CAPTURE_PULL:<id>[,<offset>[,idx]] sends capNNNN.pcapng (or .idx) as
+// FILE_CHUNK records. Binary: U32 id, [U32 offset], [U32 1 = index].
+static esp_err_t cmd_capture_pull(const cmd_args_t *args) {
+  uint32_t id = 0;
+  uint32_t offset = 0;
+  uint32_t index = 0;
+
+  if (args->payload && *args->payload) {
+    char *end = NULL;
+    id = strtoul(args->payload, &end, 10);
+    if (end && *end == ',') {
+      offset = strtoul(end + 1, &end, 10);
+      if (end && *end == ',')
+        index = strcmp(end + 1, "idx") == 0;
+    }
+  } else if (!serial_arg_u32(serial_bin_arg(args->bin, SERIAL_ARG_U32, 0),
+                             &id)) {
+    return ESP_ERR_INVALID_ARG;
+  } else {
+    serial_arg_u32(serial_bin_arg(args->bin, SERIAL_ARG_U32, 1), &offset);
+    serial_arg_u32(serial_bin_arg(args->bin, SERIAL_ARG_U32, 2), &index);
+  }
+
+  if (id == 0 || id > UINT16_MAX) {
+    serial_send_json("error", "\"Invalid capture id\"");
+    return ESP_ERR_INVALID_ARG;
+  }
+  return pcap_store_pull((uint16_t)id, index != 0, offset);
+}
+
+static esp_err_t cmd_capture_clear(const cmd_args_t *args) {
+  (void)args;
+  return pcap_store_clear();
+}
+
+// SET_AGG:<latency_us>[,<flush_bytes>] or U32 latency, [U32 bytes]
+static esp_err_t cmd_set_agg(const cmd_args_t *args) {
+  uint32_t latency_us = 0;
+  uint32_t flush_bytes = 0;
+
+  if (args->payload && *args->payload) {
+    char *end = NULL;
+    latency_us = strtoul(args->payload, &end, 10);
+    if (end && *end == ',') {
+      flush_bytes = strtoul(end + 1, NULL, 10);
+    }
+  } else if (!serial_arg_u32(serial_bin_arg(args->bin, SERIAL_ARG_U32, 0),
+                             &latency_us)) {
+    return ESP_ERR_INVALID_ARG;
+  } else {
+    serial_arg_u32(serial_bin_arg(args->bin, SERIAL_ARG_U32, 1), &flush_bytes);
+  }
+
+  if (latency_us > 100000) {
+    serial_send_json("error", "\"Latency bound too large\"");
+    return ESP_ERR_INVALID_ARG;
+  }
+  serial_set_aggregation(latency_us, flush_bytes);
+  return ESP_OK;
+}
+
+// SET_PROBES:<limit>[,batch|first] caps the probe table (0 keeps the
+// limit) and picks its reporting mode. Binary: U32 limit, [U32 mode].
+static esp_err_t cmd_set_probes(const cmd_args_t *args) {
+  uint32_t limit = 0;
+  uint32_t mode = PROBE_REPORT_BATCH;
+
+  if (args->payload && *args->payload) {
+    char *end = NULL;
+    limit = strtoul(args->payload, &end, 10);
+    if (end && *end == ',') {
+      if (strcmp(end + 1, "first") == 0) {
+        mode = PROBE_REPORT_FIRST;
+      } else if (strcmp(end + 1, "batch") != 0) {
+        serial_send_json("error", "\"Unknown probe report mode\"");
+        return ESP_ERR_INVALID_ARG;
+      }
+    }
+  } else if (!serial_arg_u32(serial_bin_arg(args->bin, SERIAL_ARG_U32, 0),
+                             &limit)) {
+    return ESP_ERR_INVALID_ARG;
+  } else {
+    serial_arg_u32(serial_bin_arg(args->bin, SERIAL_ARG_U32, 1), &mode);
+  }
+
+  if (mode > PROBE_REPORT_FIRST) {
+    serial_send_json("error", "\"Unknown probe report mode\"");
+    return ESP_ERR_INVALID_ARG;
+  }
+  probe_table_configure(limit, (probe_report_mode_t)mode);
+  return ESP_OK;
+}
+
+// LOG_LEVEL:<level>[,<tag>] (level: none/error/warn/info/debug/verbose,
+// a letter or 0-5). Binary: U32 level, optional STR tag.
+static esp_err_t cmd_log_level(const cmd_args_t *args) {
+  esp_log_level_t level;
+  char tag[24] = "";
+
+  if (args->payload && *args->payload) {
+    char buf[40];
+    cmd_args_str(args, buf, sizeof(buf));
+    char *comma = strchr(buf, ',');
+    if (comma) {
+      *comma = '\0';
+      strncpy(tag, comma + 1, sizeof(tag) - 1);
+    }
+    if (!serial_log_parse_level(buf, &level)) {
+      serial_send_json("error", "\"Unknown log level\"");
+      return ESP_ERR_INVALID_ARG;
+    }
+  } else {
+    uint32_t v;
+    if (!serial_arg_u32(serial_bin_arg(args->bin, SERIAL_ARG_U32, 0), &v) ||
+        v > ESP_LOG_VERBOSE) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    level = (esp_log_level_t)v;
+    const serial_arg_t *t = serial_bin_arg(args->bin, SERIAL_ARG_STR, 0);
+    if (t && t->len < sizeof(tag)) {
+      memcpy(tag, t->data, t->len);
+      tag[t->len] = '\0';
+    }
+  }
+
+  return serial_log_set_level(tag, level);
+}
+
+static esp_err_t cmd_sys_reset(const cmd_args_t *args) {
+  (void)args;
+  gui_log("Rebooting...");
+  vTaskDelay(pdMS_TO_TICKS(500));
+  esp_restart();
+  return ESP_OK;
+}
+
+static esp_err_t cmd_input_up(const cmd_args_t *args) {
+  (void)args;
+  gui_handle_input(INPUT_UP);
+  return ESP_OK;
+}
+
+static esp_err_t cmd_input_down(const cmd_args_t *args) {
+  (void)args;
+  gui_handle_input(INPUT_DOWN);
+  return ESP_OK;
+}
+
+static esp_err_t cmd_input_select(const cmd_args_t *args) {
+  (void)args;
+  gui_handle_input(INPUT_SELECT);
+  return ESP_OK;
+}
+
+static esp_err_t cmd_input_back(const cmd_args_t *args) {
+  (void)args;
+  gui_handle_input(INPUT_BACK);
+  return ESP_OK;
 }
 
 // --- Status / Heartbeat Task ---
+static inline uint16_t sat_u16(uint32_t v) {
+  return (v > UINT16_MAX) ? UINT16_MAX : (uint16_t)v;
+}
+
 static void status_task(void *arg) {
   (void)arg;
 
@@ -447,94 +1096,84 @@ static void status_task(void *arg) {
       rssi = ap_info.rssi;
     }
 
-    char json[128];
-    snprintf(
-        json, sizeof(json),
-        "{\"type\":\"sys_status\",\"heap\":%lu,\"min_heap\":%lu,\"rssi\":%d}",
-        (unsigned long)free_heap, (unsigned long)min_heap, rssi);
-    serial_send_json_raw(json);
+    serial_tx_stats_t tx;
+    serial_get_tx_stats(&tx);
+
+    serial_agg_stats_t agg;
+    serial_get_agg_stats(&agg);
+    uint32_t ratio_x100 =
+        agg.batches ? (uint32_t)((uint64_t)agg.records * 100 / agg.batches)
+                    : 0;
+
+    chimera_sys_status_t rec = {
+        .heap = free_heap,
+        .min_heap = min_heap,
+        .rssi = (int8_t)rssi,
+        .tx_queued = tx.bytes_queued,
+        .tx_written = tx.bytes_written,
+        .tx_dropped = tx.frames_dropped,
+        .tx_high_water = tx.ring_high_water,
+        .agg_ratio_x100 = sat_u16(ratio_x100),
+        .agg_latency_avg_us = sat_u16(agg.latency_avg_us),
+        .agg_latency_max_us = sat_u16(agg.latency_max_us),
+        .drop_critical = tx.class_dropped[SERIAL_CLASS_CRITICAL],
+        .drop_state = tx.class_dropped[SERIAL_CLASS_STATE],
+        .drop_telemetry = tx.class_dropped[SERIAL_CLASS_TELEMETRY],
+        .fc_credit = tx.fc_enabled ? tx.fc_credit : UINT32_MAX,
+        .fc_stalls = tx.fc_stalls,
+    };
+    serial_send_record(CHIMERA_MSG_SYS_STATUS, CHIMERA_SYS_STATUS_VERSION,
+                       &rec, sizeof(rec), NULL, 0);
   }
 }
 
-// --- Serial Command Handler ---
-static void handle_command(const char *cmd) {
-  if (!cmd || *cmd == '\0') {
-    return;
-  }
-
-  ESP_LOGI(TAG, "CMD: %s", cmd);
-
-  char cmd_buf[128];
-  strncpy(cmd_buf, cmd, sizeof(cmd_buf) - 1);
-  cmd_buf[sizeof(cmd_buf) - 1] = '\0';
-
-  char *payload = strchr(cmd_buf, ':');
-  char *command = cmd_buf;
-
-  if (payload) {
-    *payload = '\0';
-    payload++;
-  }
-
-  if (strcmp(command, "SCAN_WIFI") == 0) {
-    cmd_scan_wifi();
-  } else if (strcmp(command, "SCAN_BLE") == 0) {
-    cmd_scan_ble();
-  } else if (strcmp(command, "SNIFF_START") == 0) {
-    cmd_sniff_start(payload);
-  } else if (strcmp(command, "SNIFF_STOP") == 0) {
-    cmd_sniff_stop();
-  } else if (strcmp(command, "DEAUTH") == 0) {
-    cmd_deauth(payload);
-  } else if (strcmp(command, "BLE_SPAM") == 0) {
-    cmd_ble_spam(payload);
-  } else if (strcmp(command, "SET_FREQ") == 0) {
-    cmd_set_freq(payload);
-  } else if (strcmp(command, "RX_RECORD") == 0) {
-    cmd_subghz_record();
-  } else if (strcmp(command, "TX_REPLAY") == 0) {
-    cmd_subghz_replay();
-  } else if (strcmp(command, "NFC_SCAN") == 0) {
-    cmd_nfc_scan();
-  } else if (strcmp(command, "GET_INFO") == 0) {
-    cmd_get_info();
-  } else if (strcmp(command, "RECON_START") == 0) {
-    cmd_recon_start();
-  } else if (strcmp(command, "RECON_STOP") == 0) {
-    cmd_recon_stop();
-  } else if (strcmp(command, "CSI_START") == 0) {
-    cmd_csi_start();
-  } else if (strcmp(command, "CSI_STOP") == 0) {
-    cmd_csi_stop();
-  } else if (strcmp(command, "NFC_EMULATE") == 0) {
-    cmd_nfc_emulate();
-  } else if (strcmp(command, "ANALYZER_START") == 0) {
-    cmd_analyzer_start();
-  } else if (strcmp(command, "ANALYZER_STOP") == 0) {
-    cmd_analyzer_stop();
-  } else if (strcmp(command, "SUBGHZ_BRUTE") == 0) {
-    cmd_subghz_brute();
-  } else if (strcmp(command, "STOP") == 0) {
-    cmd_stop_all();
-  } else if (strcmp(command, "SYS_RESET") == 0) {
-    gui_log("Rebooting...");
-    vTaskDelay(pdMS_TO_TICKS(500));
-    esp_restart();
-  } else if (strncmp(command, "INPUT_", 6) == 0) {
-    if (strcmp(command, "INPUT_UP") == 0) {
-      gui_handle_input(INPUT_UP);
-    } else if (strcmp(command, "INPUT_DOWN") == 0) {
-      gui_handle_input(INPUT_DOWN);
-    } else if (strcmp(command, "INPUT_SELECT") == 0) {
-      gui_handle_input(INPUT_SELECT);
-    } else if (strcmp(command, "INPUT_BACK") == 0) {
-      gui_handle_input(INPUT_BACK);
-    }
-  } else {
-    ESP_LOGW(TAG, "Unknown command: %s", command);
-    serial_send_json("error", "\"Unknown command\"");
-  }
-}
+// --- Command Table ---
+// Sorted by name (cmd_dispatch_init verifies). Opcodes are the binary
+// command ids accepted in SERIAL_RX_FRAME_COMMAND frames.
+static const cmd_def_t g_commands[] = {
+    {"ANALYZER_START", 0x53, CMD_CLASS_SUBGHZ, cmd_analyzer_start},
+    {"ANALYZER_STOP", 0x54, CMD_CLASS_INLINE, cmd_analyzer_stop},
+    {"BLE_SPAM", 0x31, CMD_CLASS_BLE, cmd_ble_spam},
+    {"CAPTURE_CLEAR", 0x1A, CMD_CLASS_WIFI, cmd_capture_clear},
+    {"CAPTURE_LIST", 0x18, CMD_CLASS_WIFI, cmd_capture_list},
+    {"CAPTURE_PULL", 0x19, CMD_CLASS_WIFI, cmd_capture_pull},
+    {"CAPTURE_START", 0x16, CMD_CLASS_WIFI, cmd_capture_start},
+    {"CAPTURE_STOP", 0x17, CMD_CLASS_WIFI, cmd_capture_stop},
+    {"CSI_CONFIG", 0x25, CMD_CLASS_INLINE, cmd_csi_config},
+    {"CSI_OUTPUT", 0x26, CMD_CLASS_INLINE, cmd_csi_output},
+    {"CSI_START", 0x14, CMD_CLASS_WIFI, cmd_csi_start},
+    {"CSI_STOP", 0x15, CMD_CLASS_WIFI, cmd_csi_stop},
+    {"DEAUTH", 0x20, CMD_CLASS_WIFI, cmd_deauth},
+    {"FILTER", 0x23, CMD_CLASS_INLINE, cmd_filter},
+    {"GET_INFO", 0x01, CMD_CLASS_INLINE, cmd_get_info},
+    {"HANDSHAKES", 0x1B, CMD_CLASS_INLINE, cmd_handshakes},
+    {"INPUT_BACK", 0x63, CMD_CLASS_INLINE, cmd_input_back},
+    {"INPUT_DOWN", 0x61, CMD_CLASS_INLINE, cmd_input_down},
+    {"INPUT_SELECT", 0x62, CMD_CLASS_INLINE, cmd_input_select},
+    {"INPUT_UP", 0x60, CMD_CLASS_INLINE, cmd_input_up},
+    {"LOG_LEVEL", 0x05, CMD_CLASS_INLINE, cmd_log_level},
+    {"NFC_EMULATE", 0x41, CMD_CLASS_NFC, cmd_nfc_emulate},
+    {"NFC_SCAN", 0x40, CMD_CLASS_NFC, cmd_nfc_scan},
+    {"RECON_START", 0x12, CMD_CLASS_WIFI, cmd_recon_start},
+    {"RECON_STOP", 0x13, CMD_CLASS_WIFI, cmd_recon_stop},
+    {"RX_RECORD", 0x51, CMD_CLASS_SUBGHZ, cmd_subghz_record},
+    {"SCAN_BLE", 0x30, CMD_CLASS_BLE, cmd_scan_ble},
+    {"SCAN_WIFI", 0x10, CMD_CLASS_WIFI, cmd_scan_wifi},
+    {"SCOPE_ADD", 0x06, CMD_CLASS_INLINE, cmd_scope_add},
+    {"SCOPE_CLEAR", 0x07, CMD_CLASS_INLINE, cmd_scope_clear},
+    {"SCOPE_LIST", 0x08, CMD_CLASS_INLINE, cmd_scope_list},
+    {"SET_AGG", 0x04, CMD_CLASS_INLINE, cmd_set_agg},
+    {"SET_FREQ", 0x50, CMD_CLASS_SUBGHZ, cmd_set_freq},
+    {"SET_PROBES", 0x09, CMD_CLASS_INLINE, cmd_set_probes},
+    {"SNIFF_RAW", 0x22, CMD_CLASS_INLINE, cmd_sniff_raw},
+    {"SNIFF_START", 0x21, CMD_CLASS_WIFI, cmd_sniff_start},
+    {"SNIFF_STOP", 0x11, CMD_CLASS_WIFI, cmd_sniff_stop},
+    {"STOP", 0x02, CMD_CLASS_INLINE, cmd_stop_all},
+    {"SUBGHZ_BRUTE", 0x55, CMD_CLASS_SUBGHZ, cmd_subghz_brute},
+    {"SURVEY", 0x24, CMD_CLASS_INLINE, cmd_survey},
+    {"SYS_RESET", 0x03, CMD_CLASS_INLINE, cmd_sys_reset},
+    {"TX_REPLAY", 0x52, CMD_CLASS_SUBGHZ, cmd_subghz_replay},
+};
 
 // --- Callbacks ---
 static void wifi_scan_callback(const wifi_scan_result_t *result) {
@@ -572,57 +1211,24 @@ static void ble_scan_callback(const ble_device_t *device) {
 }
 
 static void ble_scan_complete_callback(void) {
-  char *json = malloc(BLE_JSON_BUFFER_SIZE);
-  if (!json) {
-    ESP_LOGE(TAG, "Failed to allocate BLE JSON buffer");
-    return;
-  }
-
-  int pos = snprintf(json, BLE_JSON_BUFFER_SIZE,
-                     "{\"type\":\"ble_scan_result\",\"count\":%d,\"devices\":[",
-                     g_ble_device_count);
-
   for (int i = 0; i < g_ble_device_count; i++) {
-    if (pos >= BLE_JSON_BUFFER_SIZE - BLE_JSON_ENTRY_RESERVE) {
-      ESP_LOGW(TAG, "BLE JSON buffer nearly full, truncating at %d devices", i);
-      break;
-    }
-
-    char addr_str[18];
-    snprintf(addr_str, sizeof(addr_str), "%02X:%02X:%02X:%02X:%02X:%02X",
-             g_ble_devices[i].addr[0], g_ble_devices[i].addr[1],
-             g_ble_devices[i].addr[2], g_ble_devices[i].addr[3],
-             g_ble_devices[i].addr[4], g_ble_devices[i].addr[5]);
-
-    char escaped_name[65];
-    serial_escape_json(g_ble_devices[i].has_name ? g_ble_devices[i].name
-                                                 : "Unknown",
-                       escaped_name, sizeof(escaped_name));
-
-    int written = snprintf(json + pos, BLE_JSON_BUFFER_SIZE - pos,
-                           "%s{\"name\":\"%s\",\"address\":\"%s\",\"rssi\":%d}",
-                           (i > 0) ? "," : "", escaped_name, addr_str,
-                           g_ble_devices[i].rssi);
-
-    if (written > 0 && pos + written < BLE_JSON_BUFFER_SIZE) {
-      pos += written;
-    } else {
-      break;
-    }
+    const ble_device_t *dev = &g_ble_devices[i];
+    chimera_ble_device_t rec = {
+        .addr_type = dev->addr_type,
+        .rssi = dev->rssi,
+        .manufacturer_id = dev->manufacturer_id,
+        .name_len = dev->has_name ? (uint8_t)strnlen(dev->name,
+                                                     sizeof(dev->name))
+                                  : 0,
+    };
+    memcpy(rec.addr, dev->addr, 6);
+    serial_send_record(CHIMERA_MSG_BLE_DEVICE, CHIMERA_BLE_DEVICE_VERSION, &rec,
+                       sizeof(rec), dev->name, rec.name_len);
   }
 
-  if (pos < BLE_JSON_BUFFER_SIZE - 3) {
-    json[pos++] = ']';
-    json[pos++] = '}';
-    json[pos] = '\0';
-  } else {
-    json[BLE_JSON_BUFFER_SIZE - 3] = ']';
-    json[BLE_JSON_BUFFER_SIZE - 2] = '}';
-    json[BLE_JSON_BUFFER_SIZE - 1] = '\0';
-  }
-
-  serial_send_json_raw(json);
-  free(json);
+  chimera_ble_scan_done_t done = {.count = (uint16_t)g_ble_device_count};
+  serial_send_record(CHIMERA_MSG_BLE_SCAN_DONE, CHIMERA_BLE_SCAN_DONE_VERSION,
+                     &done, sizeof(done), NULL, 0);
 }
 
 // --- Main Entry Point ---
@@ -653,7 +1259,15 @@ void app_main(void) {
            (unsigned long)heap_caps_get_total_size(MALLOC_CAP_SPIRAM));
 
   serial_init();
-  serial_set_cmd_handler(handle_command);
+  // From here on ESP_LOG output travels as framed LOG records
+  serial_log_init();
+  ret = cmd_dispatch_init(g_commands,
+                          sizeof(g_commands) / sizeof(g_commands[0]));
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "Command dispatcher init failed: %s", esp_err_to_name(ret));
+  }
+  serial_set_cmd_handler(cmd_dispatch_text);
+  serial_set_bin_cmd_handler(cmd_dispatch_binary);
   ESP_LOGI(TAG, "Serial initialized");
 
   ret = wifi_manager_init();
@@ -708,7 +1322,7 @@ void app_main(void) {
   serial_send_json("status", "\"CHIMERA_READY\"");
 
   BaseType_t task_ret =
-      xTaskCreate(status_task, "status_task", 2048, NULL, 5, NULL);
+      xTaskCreate(status_task, "status_task", 3072, NULL, 5, NULL);
   if (task_ret != pdPASS) {
     ESP_LOGE(TAG, "Failed to create status task");
   }
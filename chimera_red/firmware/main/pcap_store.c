@@ -0,0 +1,727 @@
+/**
+ * @file pcap_store.c
+ * @brief On-device pcapng capture to the storage partition
+ *
+ * The packet worker builds each Enhanced Packet Block straight into a
+ * byte ring (PSRAM) and moves on. The writer task drains the ring into a
+ * one-sector buffer and writes it out only in whole sectors, so flash
+ * writes stay aligned and large; a partial sector is written only when the
+ * capture goes idle or the file is closed, and the next write then tops up
+ * to the following sector boundary.
+ */
+#include "pcap_store.h"
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_spiffs.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
+#include "freertos/task.h"
+#include "serial_comm.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static const char *TAG = "pcap_store";
+
+// ---------------- Configuration ----------------
+
+#define STORE_BASE "/store"
+#define STORE_PARTITION "storage"
+
+#define STORE_SECTOR 4096
+#define STORE_QUEUE_SIZE (32 * 1024) // Blocks waiting for the writer
+#define STORE_IDLE_FLUSH_MS 2000     // Write a partial sector after this
+#define STORE_INDEX_EVERY 32         // Index one block in every N
+#define STORE_INDEX_MAX 256          // Index entries per file
+#define STORE_FILE_ID_MAX 9999
+#define STORE_FS_FILL_PCT 80         // Keep SPIFFS below this fill level
+
+#define WRITER_STACK 4096
+#define WRITER_PRIO 3
+#define WRITER_STOP_WAIT_MS 5000
+
+// Pull pacing: chunk size and state-class backlog to stay under
+#define PULL_CHUNK 512
+#define PULL_BACKLOG_MAX (8 * 1024)
+
+// pcapng block types and the radiotap link type
+#define PCAPNG_SHB 0x0A0D0D0A
+#define PCAPNG_IDB 0x00000001
+#define PCAPNG_EPB 0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4D
+#define LINKTYPE_IEEE802_11_RADIOTAP 127
+
+#define EPB_OVERHEAD 32 // Block header, fields and trailing length
+#define RADIOTAP_MAX 24
+
+// ---------------- State ----------------
+
+static bool g_mounted = false;
+static volatile bool g_active = false;     // Accepting packets
+static volatile bool g_writer_run = false; // Writer keeps going
+static TaskHandle_t g_writer_task = NULL;
+static RingbufHandle_t g_queue = NULL;
+static pcap_store_config_t g_cfg;
+
+// Writer-owned file state
+static int g_fd = -1;
+static uint16_t g_file_id = 0;
+static uint32_t g_file_size = 0; // Bytes written to this file
+static uint32_t g_file_packets = 0;
+static bool g_write_failed = false;
+static uint8_t s_sector[STORE_SECTOR];
+static size_t g_fill = 0;
+static pcap_store_index_t s_index[STORE_INDEX_MAX];
+static size_t g_index_count = 0;
+
+static atomic_uint_fast32_t g_packets = 0;
+static atomic_uint_fast32_t g_dropped = 0;
+static atomic_uint_fast32_t g_bytes_written = 0;
+static atomic_uint_fast32_t g_write_errors = 0;
+static atomic_uint_fast32_t g_files_deleted = 0;
+
+// ---------------- Helpers ----------------
+
+static void put_le16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static void file_path(char *out, size_t size, uint16_t id, bool index) {
+  snprintf(out, size, STORE_BASE "/cap%04u.%s", id, index ? "idx" : "pcapng");
+}
+
+/**
+ * @brief Radiotap header for a frame (same layout as the host tools build)
+ */
+static size_t radiotap_build(const chimera_raw_frame_t *f, uint8_t *out) {
+  bool ht = (f->flags & CHIMERA_RAW_HT) != 0;
+  // FLAGS, CHANNEL, DBM_ANTSIGNAL, DBM_ANTNOISE + RATE or MCS
+  uint32_t present = 0x0000006A | (ht ? (1u << 19) : (1u << 2));
+
+  size_t n = 8;
+  out[n++] = ((f->flags & CHIMERA_RAW_FCS) ? 0x10 : 0) |
+             ((f->flags & CHIMERA_RAW_SHORT_PRE) ? 0x02 : 0);
+  out[n++] = ht ? 0 : f->rate;
+
+  bool cck = !ht && (f->rate == 2 || f->rate == 4 || f->rate == 11 ||
+                     f->rate == 22);
+  put_le16(out + n,
+           (f->channel == 14) ? 2484 : (uint16_t)(2407 + 5 * f->channel));
+  put_le16(out + n + 2, 0x0080 | (cck ? 0x0020 : 0x0040));
+  n += 4;
+  out[n++] = (uint8_t)f->rssi;
+  out[n++] = (uint8_t)f->noise_floor;
+
+  if (ht) {
+    out[n++] = 0x07; // Known: bandwidth, MCS index, guard interval
+    out[n++] = ((f->flags & CHIMERA_RAW_40MHZ) ? 0x01 : 0) |
+               ((f->flags & CHIMERA_RAW_SHORT_GI) ? 0x04 : 0);
+    out[n++] = f->mcs;
+  }
+
+  out[0] = 0;
+  out[1] = 0;
+  put_le16(out + 2, (uint16_t)n);
+  put_le32(out + 4, present);
+  return n;
+}
+
+/**
+ * @brief Wall-clock receive time of a frame
+ *
+ * rx_ctrl timestamps count microseconds since boot (32 bits); the age of
+ * the frame is subtracted from the current time of day.
+ */
+static uint64_t frame_time_us(uint32_t rx_timestamp) {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  uint64_t now = (uint64_t)tv.tv_sec * 1000000 + (uint64_t)tv.tv_usec;
+  uint32_t age = (uint32_t)esp_timer_get_time() - rx_timestamp;
+  return (age < 1000000 && age < now) ? now - age : now;
+}
+
+// ---------------- Writer: sectors and files ----------------
+
+static void write_failed(const char *what) {
+  if (!g_write_failed) {
+    ESP_LOGE(TAG, "%s failed on cap%04u, capture stopped", what, g_file_id);
+  }
+  g_write_failed = true;
+  g_active = false;
+  atomic_fetch_add(&g_write_errors, 1);
+}
+
+/**
+ * @brief Write out whatever is in the sector buffer
+ */
+static void sector_flush(void) {
+  if (g_fill == 0 || g_fd < 0 || g_write_failed) {
+    g_fill = 0;
+    return;
+  }
+  ssize_t n = write(g_fd, s_sector, g_fill);
+  if (n != (ssize_t)g_fill) {
+    write_failed("Write");
+  } else {
+    g_file_size += g_fill;
+    atomic_fetch_add(&g_bytes_written, g_fill);
+  }
+  g_fill = 0;
+}
+
+/**
+ * @brief Append bytes; writes happen only at sector boundaries of the file
+ */
+static void sector_append(const uint8_t *data, size_t len) {
+  while (len > 0 && !g_write_failed) {
+    size_t target = STORE_SECTOR - (g_file_size % STORE_SECTOR);
+    size_t n = target - g_fill;
+    if (n > len)
+      n = len;
+    memcpy(s_sector + g_fill, data, n);
+    g_fill += n;
+    data += n;
+    len -= n;
+    if (g_fill == target) {
+      sector_flush();
+    }
+  }
+}
+
+/**
+ * @brief Find stored captures
+ * @param ids Output: capture numbers found (may be NULL)
+ * @param max Capacity of ids
+ * @param total Output: bytes used by captures and their indexes
+ * @return Number of captures (may exceed max)
+ */
+static size_t store_scan(uint16_t *ids, size_t max, uint32_t *total) {
+  size_t count = 0;
+  *total = 0;
+
+  DIR *dir = opendir(STORE_BASE);
+  if (!dir)
+    return 0;
+
+  struct dirent *e;
+  while ((e = readdir(dir)) != NULL) {
+    unsigned id;
+    char ext[8];
+    if (sscanf(e->d_name, "cap%4u.%7s", &id, ext) != 2)
+      continue;
+
+    char path[32];
+    struct stat st;
+    snprintf(path, sizeof(path), STORE_BASE "/%s", e->d_name);
+    if (stat(path, &st) == 0)
+      *total += (uint32_t)st.st_size;
+
+    if (strcmp(ext, "pcapng") == 0) {
+      if (ids && count < max)
+        ids[count] = (uint16_t)id;
+      count++;
+    }
+  }
+  closedir(dir);
+  return count;
+}
+
+static uint16_t store_oldest(const uint16_t *ids, size_t n) {
+  uint16_t oldest = ids[0];
+  for (size_t i = 1; i < n; i++) {
+    if (ids[i] < oldest)
+      oldest = ids[i];
+  }
+  return oldest;
+}
+
+/**
+ * @brief Delete the oldest captures until a new file fits the budget
+ * @return false if a capture could not be deleted (writing is stopped)
+ */
+static bool store_trim(void) {
+  int last = -1;
+  for (;;) {
+    uint16_t ids[64];
+    uint32_t total;
+    size_t n = store_scan(ids, 64, &total);
+    if (n == 0)
+      return true;
+
+    size_t fs_total = 0, fs_used = 0;
+    esp_spiffs_info(STORE_PARTITION, &fs_total, &fs_used);
+    bool over_budget = total + g_cfg.file_max > g_cfg.total_max;
+    bool fs_full =
+        fs_used + g_cfg.file_max > fs_total * STORE_FS_FILL_PCT / 100;
+    if (!over_budget && !fs_full)
+      return true;
+
+    // The same oldest file twice means the last delete did not take;
+    // retrying would never end
+    uint16_t victim = store_oldest(ids, (n < 64) ? n : 64);
+    char path[32];
+    file_path(path, sizeof(path), victim, false);
+    if (victim == last) {
+      ESP_LOGE(TAG, "cap%04u is still there after deleting it", victim);
+      write_failed("Trim");
+      return false;
+    }
+    if (unlink(path) != 0) {
+      ESP_LOGE(TAG, "Cannot delete cap%04u: %s", victim, strerror(errno));
+      write_failed("Trim");
+      return false;
+    }
+    last = victim;
+    file_path(path, sizeof(path), victim, true);
+    unlink(path); // The index is optional
+    atomic_fetch_add(&g_files_deleted, 1);
+    ESP_LOGI(TAG, "Deleted cap%04u to stay within budget", victim);
+  }
+}
+
+static void file_close(void) {
+  if (g_fd < 0)
+    return;
+
+  sector_flush();
+  close(g_fd);
+  g_fd = -1;
+
+  if (g_index_count > 0) {
+    char path[32];
+    file_path(path, sizeof(path), g_file_id, true);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+      size_t len = g_index_count * sizeof(pcap_store_index_t);
+      if (write(fd, s_index, len) != (ssize_t)len)
+        ESP_LOGW(TAG, "Index write failed for cap%04u", g_file_id);
+      close(fd);
+    }
+  }
+  ESP_LOGI(TAG, "Closed cap%04u (%lu bytes, %lu packets)", g_file_id,
+           (unsigned long)g_file_size, (unsigned long)g_file_packets);
+}
+
+/**
+ * @brief Open the next capture file and write its section header
+ */
+static esp_err_t file_open_next(void) {
+  if (!store_trim())
+    return ESP_FAIL;
+
+  uint16_t ids[64];
+  uint32_t total;
+  size_t n = store_scan(ids, 64, &total);
+  uint16_t next = g_file_id + 1;
+  for (size_t i = 0; i < n && i < 64; i++) {
+    if (ids[i] >= next)
+      next = ids[i] + 1;
+  }
+  if (next > STORE_FILE_ID_MAX)
+    next = 1;
+
+  char path[32];
+  file_path(path, sizeof(path), next, false);
+  g_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (g_fd < 0) {
+    write_failed("Open");
+    return ESP_FAIL;
+  }
+  file_path(path, sizeof(path), next, true);
+  unlink(path);
+
+  g_file_id = next;
+  g_file_size = 0;
+  g_file_packets = 0;
+  g_fill = 0;
+  g_index_count = 0;
+
+  // Section Header Block (no options, section length unknown)
+  uint8_t shb[28];
+  put_le32(shb, PCAPNG_SHB);
+  put_le32(shb + 4, sizeof(shb));
+  put_le32(shb + 8, PCAPNG_BYTE_ORDER_MAGIC);
+  put_le16(shb + 12, 1); // Version 1.0
+  put_le16(shb + 14, 0);
+  put_le32(shb + 16, 0xFFFFFFFF);
+  put_le32(shb + 20, 0xFFFFFFFF);
+  put_le32(shb + 24, sizeof(shb));
+  sector_append(shb, sizeof(shb));
+
+  // Interface Description Block (microsecond timestamps by default)
+  uint8_t idb[20];
+  put_le32(idb, PCAPNG_IDB);
+  put_le32(idb + 4, sizeof(idb));
+  put_le16(idb + 8, LINKTYPE_IEEE802_11_RADIOTAP);
+  put_le16(idb + 10, 0);
+  put_le32(idb + 12, g_cfg.snaplen + RADIOTAP_MAX);
+  put_le32(idb + 16, sizeof(idb));
+  sector_append(idb, sizeof(idb));
+
+  ESP_LOGI(TAG, "Capturing to cap%04u", g_file_id);
+  return g_write_failed ? ESP_FAIL : ESP_OK;
+}
+
+/**
+ * @brief Append one queued Enhanced Packet Block
+ */
+static void store_block(const uint8_t *blk, size_t len) {
+  if (g_fd < 0 || (g_file_packets > 0 &&
+                   g_file_size + g_fill + len > g_cfg.file_max)) {
+    file_close();
+    if (file_open_next() != ESP_OK)
+      return;
+  }
+
+  if (g_file_packets % STORE_INDEX_EVERY == 0 &&
+      g_index_count < STORE_INDEX_MAX) {
+    pcap_store_index_t *e = &s_index[g_index_count++];
+    e->offset = g_file_size + g_fill;
+    e->packet = g_file_packets;
+    uint32_t hi, lo;
+    memcpy(&hi, blk + 12, 4);
+    memcpy(&lo, blk + 16, 4);
+    e->ts_us = ((uint64_t)hi << 32) | lo;
+  }
+
+  sector_append(blk, len);
+  g_file_packets++;
+}
+
+static void writer_task(void *arg) {
+  TickType_t last_data = xTaskGetTickCount();
+
+  for (;;) {
+    size_t len = 0;
+    uint8_t *blk = xRingbufferReceive(g_queue, &len, pdMS_TO_TICKS(200));
+    if (blk) {
+      if (!g_write_failed)
+        store_block(blk, len);
+      vRingbufferReturnItem(g_queue, blk);
+      last_data = xTaskGetTickCount();
+      continue;
+    }
+
+    // Queue empty
+    if (!g_writer_run)
+      break;
+    if (g_fill > 0 &&
+        xTaskGetTickCount() - last_data > pdMS_TO_TICKS(STORE_IDLE_FLUSH_MS)) {
+      sector_flush();
+    }
+  }
+
+  file_close();
+  g_writer_task = NULL;
+  vTaskDelete(NULL);
+}
+
+// ---------------- Public API ----------------
+
+esp_err_t pcap_store_mount(void) {
+  if (g_mounted)
+    return ESP_OK;
+
+  esp_vfs_spiffs_conf_t conf = {
+      .base_path = STORE_BASE,
+      .partition_label = STORE_PARTITION,
+      .max_files = 4,
+      .format_if_mount_failed = true,
+  };
+  esp_err_t ret = esp_vfs_spiffs_register(&conf);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "Mount failed: %s", esp_err_to_name(ret));
+    return ret;
+  }
+  g_mounted = true;
+  return ESP_OK;
+}
+
+esp_err_t pcap_store_start(const pcap_store_config_t *cfg) {
+  if (g_active || g_writer_task)
+    return ESP_ERR_INVALID_STATE;
+
+  esp_err_t ret = pcap_store_mount();
+  if (ret != ESP_OK)
+    return ret;
+
+  if (!g_queue) {
+    g_queue = xRingbufferCreateWithCaps(STORE_QUEUE_SIZE, RINGBUF_TYPE_NOSPLIT,
+                                        MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!g_queue)
+      g_queue = xRingbufferCreate(STORE_QUEUE_SIZE / 2, RINGBUF_TYPE_NOSPLIT);
+    if (!g_queue) {
+      ESP_LOGE(TAG, "Failed to allocate capture queue");
+      return ESP_ERR_NO_MEM;
+    }
+  }
+
+  // Blocks from a previous capture that raced with its stop
+  size_t len;
+  void *stale;
+  while ((stale = xRingbufferReceive(g_queue, &len, 0)) != NULL) {
+    vRingbufferReturnItem(g_queue, stale);
+  }
+
+  g_cfg.file_max = (cfg && cfg->file_max) ? cfg->file_max
+                                          : PCAP_STORE_FILE_MAX_DEFAULT;
+  g_cfg.total_max = (cfg && cfg->total_max) ? cfg->total_max
+                                            : PCAP_STORE_TOTAL_MAX_DEFAULT;
+  g_cfg.snaplen =
+      (cfg && cfg->snaplen) ? cfg->snaplen : PCAP_STORE_SNAPLEN_DEFAULT;
+  if (g_cfg.file_max < 2 * STORE_SECTOR)
+    g_cfg.file_max = 2 * STORE_SECTOR;
+  if (g_cfg.total_max < g_cfg.file_max)
+    g_cfg.total_max = g_cfg.file_max;
+
+  g_write_failed = false;
+  g_fd = -1;
+  atomic_store(&g_packets, 0);
+  atomic_store(&g_dropped, 0);
+  atomic_store(&g_bytes_written, 0);
+  atomic_store(&g_write_errors, 0);
+
+  g_writer_run = true;
+  if (xTaskCreate(writer_task, "pcap_writer", WRITER_STACK, NULL, WRITER_PRIO,
+                  &g_writer_task) != pdPASS) {
+    g_writer_run = false;
+    ESP_LOGE(TAG, "Failed to create writer task");
+    return ESP_ERR_NO_MEM;
+  }
+  g_active = true;
+
+  ESP_LOGI(TAG, "Capture started (file %lu, total %lu, snaplen %u)",
+           (unsigned long)g_cfg.file_max, (unsigned long)g_cfg.total_max,
+           g_cfg.snaplen);
+  return ESP_OK;
+}
+
+void pcap_store_stop(void) {
+  g_active = false;
+  if (!g_writer_task)
+    return;
+
+  g_writer_run = false;
+  int timeout = WRITER_STOP_WAIT_MS / 10;
+  while (g_writer_task && timeout > 0) {
+    vTaskDelay(pdMS_TO_TICKS(10));
+    timeout--;
+  }
+  if (g_writer_task)
+    ESP_LOGW(TAG, "Writer still flushing after %d ms", WRITER_STOP_WAIT_MS);
+}
+
+bool pcap_store_active(void) { return g_active; }
+
+bool pcap_store_packet(const chimera_raw_frame_t *meta, const uint8_t *frame,
+                       size_t len) {
+  if (!g_active || !meta || !frame)
+    return false;
+
+  if (len > g_cfg.snaplen)
+    len = g_cfg.snaplen;
+
+  uint8_t rt[RADIOTAP_MAX];
+  size_t rt_len = radiotap_build(meta, rt);
+  size_t data_len = rt_len + len;
+  size_t padded = (data_len + 3) & ~(size_t)3;
+  size_t blk_len = EPB_OVERHEAD + padded;
+
+  void *mem;
+  if (xRingbufferSendAcquire(g_queue, &mem, blk_len, 0) != pdTRUE) {
+    atomic_fetch_add(&g_dropped, 1);
+    return false;
+  }
+
+  uint8_t *blk = mem;
+  uint64_t ts = frame_time_us(meta->timestamp_us);
+  put_le32(blk, PCAPNG_EPB);
+  put_le32(blk + 4, (uint32_t)blk_len);
+  put_le32(blk + 8, 0); // Interface 0
+  put_le32(blk + 12, (uint32_t)(ts >> 32));
+  put_le32(blk + 16, (uint32_t)ts);
+  put_le32(blk + 20, (uint32_t)data_len);
+  put_le32(blk + 24, (uint32_t)(rt_len + meta->orig_len));
+  memcpy(blk + 28, rt, rt_len);
+  memcpy(blk + 28 + rt_len, frame, len);
+  memset(blk + 28 + data_len, 0, padded - data_len);
+  put_le32(blk + 28 + padded, (uint32_t)blk_len);
+
+  xRingbufferSendComplete(g_queue, mem);
+  atomic_fetch_add(&g_packets, 1);
+  return true;
+}
+
+esp_err_t pcap_store_list(void) {
+  esp_err_t ret = pcap_store_mount();
+  if (ret != ESP_OK)
+    return ret;
+
+  uint16_t ids[64];
+  uint32_t total;
+  size_t n = store_scan(ids, 64, &total);
+  if (n > 64)
+    n = 64;
+
+  size_t cap = 160 + n * 48;
+  char *json = malloc(cap);
+  if (!json)
+    return ESP_ERR_NO_MEM;
+
+  size_t fs_total = 0, fs_used = 0;
+  esp_spiffs_info(STORE_PARTITION, &fs_total, &fs_used);
+  int pos = snprintf(json, cap,
+                     "{\"active\":%s,\"current\":%u,\"fs_total\":%u,"
+                     "\"fs_used\":%u,\"files\":[",
+                     g_active ? "true" : "false", g_file_id,
+                     (unsigned)fs_total, (unsigned)fs_used);
+
+  for (size_t i = 0; i < n; i++) {
+    char path[32];
+    struct stat st;
+    uint32_t size = 0, index = 0;
+    file_path(path, sizeof(path), ids[i], false);
+    if (stat(path, &st) == 0)
+      size = (uint32_t)st.st_size;
+    file_path(path, sizeof(path), ids[i], true);
+    if (stat(path, &st) == 0)
+      index = (uint32_t)st.st_size;
+    pos += snprintf(json + pos, cap - pos,
+                    "%s{\"id\":%u,\"size\":%lu,\"index\":%lu}",
+                    i ? "," : "", ids[i], (unsigned long)size,
+                    (unsigned long)index);
+  }
+  snprintf(json + pos, cap - pos, "]}");
+
+  serial_send_json("capture_files", json);
+  free(json);
+  return ESP_OK;
+}
+
+/**
+ * @brief Wait until the state class has room for more chunks
+ */
+static void pull_pace(void) {
+  for (int i = 0; i < 500; i++) {
+    serial_tx_stats_t st;
+    serial_get_tx_stats(&st);
+    if (st.class_used[SERIAL_CLASS_STATE] < PULL_BACKLOG_MAX)
+      return;
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+}
+
+esp_err_t pcap_store_pull(uint16_t file_id, bool index, uint32_t offset) {
+  esp_err_t ret = pcap_store_mount();
+  if (ret != ESP_OK)
+    return ret;
+  if (g_writer_task && file_id == g_file_id)
+    return ESP_ERR_INVALID_STATE; // Still being written
+
+  char path[32];
+  file_path(path, sizeof(path), file_id, index);
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return ESP_ERR_NOT_FOUND;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || offset > (uint32_t)st.st_size ||
+      lseek(fd, offset, SEEK_SET) < 0) {
+    close(fd);
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  uint8_t *buf = malloc(PULL_CHUNK);
+  if (!buf) {
+    close(fd);
+    return ESP_ERR_NO_MEM;
+  }
+
+  chimera_file_chunk_t rec = {
+      .file_id = file_id,
+      .flags = index ? CHIMERA_FILE_INDEX : 0,
+      .total = (uint32_t)st.st_size,
+  };
+  for (;;) {
+    ssize_t n = read(fd, buf, PULL_CHUNK);
+    if (n < 0) {
+      ret = ESP_FAIL;
+      break;
+    }
+    pull_pace();
+    rec.offset = offset;
+    rec.data_len = (uint16_t)n;
+    // A zero-length chunk at offset == total marks the end
+    serial_send_record(CHIMERA_MSG_FILE_CHUNK, CHIMERA_FILE_CHUNK_VERSION,
+                       &rec, sizeof(rec), buf, (size_t)n);
+    if (n == 0)
+      break;
+    offset += (uint32_t)n;
+  }
+
+  free(buf);
+  close(fd);
+  return ret;
+}
+
+esp_err_t pcap_store_clear(void) {
+  if (g_active || g_writer_task)
+    return ESP_ERR_INVALID_STATE;
+
+  esp_err_t ret = pcap_store_mount();
+  if (ret != ESP_OK)
+    return ret;
+
+  // store_scan() reports at most 64 captures per pass
+  uint16_t ids[64];
+  uint32_t total;
+  size_t n = store_scan(ids, 64, &total);
+  for (int pass = 0; n > 0 && pass < 16; pass++) {
+    for (size_t i = 0; i < n && i < 64; i++) {
+      char path[32];
+      file_path(path, sizeof(path), ids[i], false);
+      unlink(path);
+      file_path(path, sizeof(path), ids[i], true);
+      unlink(path);
+    }
+    n = store_scan(ids, 64, &total);
+  }
+  g_file_id = 0;
+  return (n == 0) ? ESP_OK : ESP_FAIL;
+}
+
+void pcap_store_get_stats(pcap_store_stats_t *stats) {
+  if (!stats)
+    return;
+
+  stats->mounted = g_mounted;
+  stats->active = g_active;
+  stats->file_id = g_file_id;
+  stats->packets = atomic_load(&g_packets);
+  stats->dropped = atomic_load(&g_dropped);
+  stats->bytes_written = atomic_load(&g_bytes_written);
+  stats->write_errors = atomic_load(&g_write_errors);
+  stats->files_deleted = atomic_load(&g_files_deleted);
+  stats->fs_total = 0;
+  stats->fs_used = 0;
+  if (g_mounted)
+    esp_spiffs_info(STORE_PARTITION, &stats->fs_total, &stats->fs_used);
+}
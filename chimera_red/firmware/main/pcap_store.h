@@ -0,0 +1,120 @@
+/**
+ * @file pcap_store.h
+ * @brief On-device pcapng capture to the storage partition
+ *
+ * Captured frames are appended as pcapng Enhanced Packet Blocks (radiotap
+ * link type) to files on a SPIFFS filesystem in the "storage" partition.
+ * The packet path only copies each block into a queue; a writer task
+ * batches blocks into sector-aligned writes, rotates files at a size limit
+ * and deletes the oldest files to stay under a total budget. Each closed
+ * capture gets a small sidecar index of block offsets for seeking.
+ *
+ * Files are named capNNNN.pcapng (index capNNNN.idx) and can be listed and
+ * pulled over serial later (CAPTURE_LIST / CAPTURE_PULL).
+ */
+#pragma once
+
+#include "chimera_proto.h"
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Defaults used when a config field is 0
+#define PCAP_STORE_FILE_MAX_DEFAULT (128 * 1024)
+#define PCAP_STORE_TOTAL_MAX_DEFAULT (640 * 1024)
+#define PCAP_STORE_SNAPLEN_DEFAULT 512
+
+typedef struct {
+  uint32_t file_max;  // Rotate when a file reaches this many bytes
+  uint32_t total_max; // Delete the oldest captures to stay under this
+  uint16_t snaplen;   // Bytes kept per frame
+} pcap_store_config_t;
+
+// One entry of a capture's sidecar index (capNNNN.idx)
+typedef struct __attribute__((packed)) {
+  uint32_t offset; // File offset of an Enhanced Packet Block
+  uint32_t packet; // Packet number of that block (0-based, per file)
+  uint64_t ts_us;  // Its timestamp
+} pcap_store_index_t;
+
+typedef struct {
+  bool mounted;
+  bool active;
+  uint16_t file_id;       // File being written (when active)
+  uint32_t packets;       // Blocks queued since start
+  uint32_t dropped;       // Blocks lost because the queue was full
+  uint32_t bytes_written; // Bytes written to flash since start
+  uint32_t write_errors;  // Failed writes (capture stops on the first one)
+  uint32_t files_deleted; // Old captures removed to stay under total_max
+  size_t fs_total;        // Filesystem size
+  size_t fs_used;         // Filesystem bytes in use
+} pcap_store_stats_t;
+
+/**
+ * @brief Mount the storage filesystem (formats it on first use)
+ *
+ * Called by pcap_store_start(); may take a few seconds the first time.
+ */
+esp_err_t pcap_store_mount(void);
+
+/**
+ * @brief Start a capture into a new file
+ * @param cfg Limits, or NULL for the defaults
+ * @return ESP_OK, ESP_ERR_INVALID_STATE if already running
+ */
+esp_err_t pcap_store_start(const pcap_store_config_t *cfg);
+
+/**
+ * @brief Flush queued blocks, close the file and stop the writer
+ */
+void pcap_store_stop(void);
+
+/**
+ * @brief Check whether a capture is running
+ */
+bool pcap_store_active(void);
+
+/**
+ * @brief Queue one frame (never blocks)
+ * @param meta Frame metadata as in a RAW_FRAME record (cap_len ignored)
+ * @param frame Frame bytes
+ * @param len Bytes available in frame (cut to the snaplen)
+ * @return false if the capture is not running or the queue is full
+ */
+bool pcap_store_packet(const chimera_raw_frame_t *meta, const uint8_t *frame,
+                       size_t len);
+
+/**
+ * @brief Report the stored captures as a "capture_files" JSON message
+ */
+esp_err_t pcap_store_list(void);
+
+/**
+ * @brief Send a stored capture to the host as FILE_CHUNK records
+ *
+ * Paces itself on the serial TX queue; blocks until the file is sent.
+ *
+ * @param file_id Capture number (NNNN in capNNNN.pcapng)
+ * @param index Send the sidecar index instead of the capture
+ * @param offset Byte offset to resume from
+ */
+esp_err_t pcap_store_pull(uint16_t file_id, bool index, uint32_t offset);
+
+/**
+ * @brief Delete every stored capture (not while a capture is running)
+ */
+esp_err_t pcap_store_clear(void);
+
+/**
+ * @brief Snapshot capture counters
+ */
+void pcap_store_get_stats(pcap_store_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,112 @@
+/**
+ * @file pkt_dispatch.c
+ * @brief Frame subscribers fed from one parse pass of the sniffer
+ */
+#include "pkt_dispatch.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+
+typedef struct {
+  uint32_t mask;
+  pkt_frame_cb_t cb;
+  void *ctx;
+} pkt_sub_t;
+
+typedef struct {
+  int count;
+  pkt_sub_t subs[PKT_DISPATCH_MAX];
+} pkt_sub_table_t;
+
+// Two tables, as for the packet filter: a writer edits the one not in use,
+// publishes it and waits for g_busy to clear, after which the worker can
+// no longer be reading the old one. Writers take g_write_lock.
+//
+// Both waits block rather than yield. The worker runs at a lower priority
+// than the command task that writes from STOP; a writer spinning on
+// taskYIELD() on the worker's core would never let it clear g_busy.
+static pkt_sub_table_t g_table[2];
+static _Atomic(const pkt_sub_table_t *) g_subs = &g_table[0];
+static atomic_bool g_busy = false;
+static atomic_flag g_write_lock = ATOMIC_FLAG_INIT;
+static atomic_uint g_mask = 0;
+
+static pkt_sub_table_t *edit_begin(void) {
+  while (atomic_flag_test_and_set(&g_write_lock)) {
+    vTaskDelay(1);
+  }
+  const pkt_sub_table_t *cur = atomic_load(&g_subs);
+  pkt_sub_table_t *next = (cur == &g_table[0]) ? &g_table[1] : &g_table[0];
+  *next = *cur;
+  return next;
+}
+
+static void edit_commit(pkt_sub_table_t *next) {
+  uint32_t mask = 0;
+  for (int i = 0; i < next->count; i++) {
+    mask |= next->subs[i].mask;
+  }
+  atomic_store(&g_subs, next);
+  atomic_store(&g_mask, mask);
+
+  while (atomic_load(&g_busy)) {
+    vTaskDelay(1);
+  }
+  atomic_flag_clear(&g_write_lock);
+}
+
+static int find(const pkt_sub_table_t *t, pkt_frame_cb_t cb, void *ctx) {
+  for (int i = 0; i < t->count; i++) {
+    if (t->subs[i].cb == cb && t->subs[i].ctx == ctx) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+esp_err_t pkt_dispatch_subscribe(uint32_t mask, pkt_frame_cb_t cb, void *ctx) {
+  mask &= PKT_FRAME_ALL;
+  if (!cb || !mask) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  pkt_sub_table_t *t = edit_begin();
+  int i = find(t, cb, ctx);
+  if (i < 0) {
+    if (t->count == PKT_DISPATCH_MAX) {
+      atomic_flag_clear(&g_write_lock); // Nothing published
+      return ESP_ERR_NO_MEM;
+    }
+    i = t->count++;
+  }
+  t->subs[i] = (pkt_sub_t){.mask = mask, .cb = cb, .ctx = ctx};
+  edit_commit(t);
+  return ESP_OK;
+}
+
+esp_err_t pkt_dispatch_unsubscribe(pkt_frame_cb_t cb, void *ctx) {
+  pkt_sub_table_t *t = edit_begin();
+  int i = find(t, cb, ctx);
+  if (i < 0) {
+    atomic_flag_clear(&g_write_lock);
+    return ESP_ERR_NOT_FOUND;
+  }
+  t->subs[i] = t->subs[--t->count];
+  edit_commit(t);
+  return ESP_OK;
+}
+
+uint32_t pkt_dispatch_mask(void) { return atomic_load(&g_mask); }
+
+void pkt_dispatch_frame(const pkt_frame_t *frame) {
+  atomic_store(&g_busy, true);
+  const pkt_sub_table_t *t = atomic_load(&g_subs);
+  for (int i = 0; i < t->count; i++) {
+    if (t->subs[i].mask & frame->frame_class) {
+      t->subs[i].cb(frame, t->subs[i].ctx);
+    }
+  }
+  atomic_store(&g_busy, false);
+}
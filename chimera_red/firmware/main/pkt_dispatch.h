@@ -0,0 +1,85 @@
+/**
+ * @file pkt_dispatch.h
+ * @brief Frame subscribers fed from one parse pass of the sniffer
+ *
+ * Capture features do not own the sniffer; they subscribe to the frame
+ * classes they want and all run off the same radio session. The packet
+ * worker parses each captured frame once (class, header length, BSSID and
+ * station) and hands the result to every subscriber whose mask includes the
+ * frame's class. The union of all masks is what the RX callback keeps, so
+ * a class nobody subscribes to is dropped before it takes a ring slot.
+ *
+ * Subscribers are called from the packet worker, one frame at a time, and
+ * must not block. Subscribing and unsubscribing are safe from any task
+ * except a subscriber callback; once unsubscribe returns, the callback is
+ * not running and will not be called again.
+ */
+#pragma once
+
+#include "esp_err.h"
+#include "esp_wifi.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Frame classes; each frame is in exactly one
+#define PKT_FRAME_PROBE_REQ (1u << 0) // Probe requests
+#define PKT_FRAME_BEACON (1u << 1)    // Beacons and probe responses
+#define PKT_FRAME_MGMT (1u << 2)      // Other management frames
+#define PKT_FRAME_EAPOL (1u << 3)     // Data frames carrying EAPOL
+#define PKT_FRAME_DATA (1u << 4)      // Other data frames
+#define PKT_FRAME_OTHER (1u << 5)     // Misc frames and runts
+#define PKT_FRAME_ALL 0x3Fu
+
+#define PKT_DISPATCH_MAX 8 // Subscribers
+
+typedef struct {
+  // Laid out as wifi_promiscuous_pkt_t; sig_len is the captured length
+  const wifi_pkt_rx_ctrl_t *rx_ctrl;
+  const uint8_t *payload;
+  uint16_t len;                     // Captured bytes
+  uint16_t orig_len;                // Length on air
+  wifi_promiscuous_pkt_type_t type; // Driver packet type
+  uint32_t frame_class;             // One PKT_FRAME_* bit
+  uint8_t subtype;                  // 802.11 subtype
+  uint8_t header_len;               // 802.11 header, 0 for runts
+  const uint8_t *bssid;             // NULL when not known
+  const uint8_t *sta;               // Data frames: the station side
+} pkt_frame_t;
+
+typedef void (*pkt_frame_cb_t)(const pkt_frame_t *frame, void *ctx);
+
+/**
+ * @brief Subscribe to frame classes, or change an existing mask
+ *
+ * Blocks until the packet worker is done with the previous subscriber
+ * table, so it must not be called from a subscriber.
+ * @param mask PKT_FRAME_* bits
+ * @param cb Called for each matching frame
+ * @param ctx Passed to cb; (cb, ctx) identifies the subscriber
+ * @return ESP_OK, ESP_ERR_INVALID_ARG, ESP_ERR_NO_MEM when
+ *         PKT_DISPATCH_MAX subscribers exist
+ */
+esp_err_t pkt_dispatch_subscribe(uint32_t mask, pkt_frame_cb_t cb, void *ctx);
+
+/**
+ * @brief Remove a subscriber (blocks as pkt_dispatch_subscribe() does)
+ * @return ESP_OK, ESP_ERR_NOT_FOUND
+ */
+esp_err_t pkt_dispatch_unsubscribe(pkt_frame_cb_t cb, void *ctx);
+
+/**
+ * @brief Union of all subscriber masks (WiFi RX callback)
+ */
+uint32_t pkt_dispatch_mask(void);
+
+/**
+ * @brief Deliver a parsed frame to its subscribers (packet worker)
+ */
+void pkt_dispatch_frame(const pkt_frame_t *frame);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,591 @@
+/**
+ * @file pkt_filter.c
+ * @brief Compiled 802.11 frame filters for the sniffer fast path
+ */
+#include "pkt_filter.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// ---------------- Matching ----------------
+
+static const uint8_t LLC_SNAP_EAPOL[] = {0xAA, 0xAA, 0x03, 0x00,
+                                         0x00, 0x00, 0x88, 0x8E};
+
+/**
+ * @brief Address field of a frame, or NULL if the frame has none
+ */
+static const uint8_t *frame_addr(const uint8_t *frame, int len, int field) {
+  if (field == PF_FIELD_BSSID) {
+    uint8_t type = (frame[0] >> 2) & 0x03;
+    if (type == 0) {
+      field = PF_FIELD_ADDR3;
+    } else if (type == 2) {
+      switch (frame[1] & 0x03) { // ToDS / FromDS
+      case 0:
+        field = PF_FIELD_ADDR3;
+        break;
+      case 1:
+        field = PF_FIELD_ADDR1;
+        break;
+      case 2:
+        field = PF_FIELD_ADDR2;
+        break;
+      default:
+        return NULL; // WDS: no BSSID
+      }
+    } else {
+      return NULL;
+    }
+  }
+
+  int off = 4 + (field - PF_FIELD_ADDR1) * 6;
+  return (off + 6 <= len) ? frame + off : NULL;
+}
+
+static bool set_contains(const pkt_filter_t *f, uint8_t set,
+                         const uint8_t *mac) {
+  int lo = 0;
+  int hi = f->set_len[set] - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    int c = memcmp(mac, f->set_mac[set][mid], 6);
+    if (c == 0)
+      return true;
+    if (c < 0)
+      hi = mid - 1;
+    else
+      lo = mid + 1;
+  }
+  return false;
+}
+
+static bool addr_match(const pkt_filter_t *f, const uint8_t *frame, int len,
+                       uint8_t field, const uint8_t *mac, int set) {
+  int first = field, last = field;
+  if (field == PF_FIELD_ANY) {
+    first = PF_FIELD_ADDR1;
+    last = PF_FIELD_ADDR3;
+  }
+  for (int i = first; i <= last; i++) {
+    const uint8_t *a = frame_addr(frame, len, i);
+    if (!a)
+      continue;
+    if (set >= 0 ? set_contains(f, (uint8_t)set, a) : memcmp(a, mac, 6) == 0)
+      return true;
+  }
+  return false;
+}
+
+static bool is_eapol(const uint8_t *frame, int len) {
+  if (len < 24 || ((frame[0] >> 2) & 0x03) != 2)
+    return false;
+
+  int hdr = 24;
+  if ((frame[1] & 0x03) == 0x03)
+    hdr += 6; // Addr4
+  if (frame[0] & 0x80)
+    hdr += 2; // QoS
+  if ((frame[0] & 0x80) && (frame[1] & 0x80))
+    hdr += 4; // HT Control
+  return len >= hdr + (int)sizeof(LLC_SNAP_EAPOL) &&
+         memcmp(frame + hdr, LLC_SNAP_EAPOL, sizeof(LLC_SNAP_EAPOL)) == 0;
+}
+
+bool pkt_filter_match(const pkt_filter_t *f, const uint8_t *frame, int len,
+                      int8_t rssi) {
+  if (len < 2)
+    return false;
+
+  const uint8_t *pc = f->code;
+  const uint8_t *end = f->code + f->code_len;
+  bool acc = true;
+
+  while (pc < end) {
+    switch (*pc) {
+    case PF_OP_TRUE:
+      acc = true;
+      pc += 1;
+      break;
+    case PF_OP_FC:
+      acc = (frame[0] & pc[1]) == pc[2];
+      pc += 3;
+      break;
+    case PF_OP_ADDR:
+      acc = addr_match(f, frame, len, pc[1], pc + 2, -1);
+      pc += 8;
+      break;
+    case PF_OP_ADDR_IN:
+      acc = addr_match(f, frame, len, pc[1], NULL, pc[2]);
+      pc += 3;
+      break;
+    case PF_OP_RSSI_GE:
+      acc = rssi >= (int8_t)pc[1];
+      pc += 2;
+      break;
+    case PF_OP_EAPOL:
+      acc = is_eapol(frame, len);
+      pc += 1;
+      break;
+    case PF_OP_NOT:
+      acc = !acc;
+      pc += 1;
+      break;
+    case PF_OP_JT:
+      pc += 2 + (acc ? pc[1] : 0);
+      break;
+    case PF_OP_JF:
+      pc += 2 + (acc ? 0 : pc[1]);
+      break;
+    default:
+      return false; // Not reachable for loaded programs
+    }
+  }
+  return acc;
+}
+
+const uint8_t *pkt_frame_bssid(const uint8_t *frame, int len) {
+  return (len >= 2) ? frame_addr(frame, len, PF_FIELD_BSSID) : NULL;
+}
+
+// ---------------- Loading ----------------
+
+static int op_len(uint8_t op) {
+  switch (op) {
+  case PF_OP_TRUE:
+  case PF_OP_EAPOL:
+  case PF_OP_NOT:
+    return 1;
+  case PF_OP_RSSI_GE:
+  case PF_OP_JT:
+  case PF_OP_JF:
+    return 2;
+  case PF_OP_FC:
+  case PF_OP_ADDR_IN:
+    return 3;
+  case PF_OP_ADDR:
+    return 8;
+  default:
+    return 0;
+  }
+}
+
+static int mac_cmp(const void *a, const void *b) { return memcmp(a, b, 6); }
+
+/**
+ * @brief Verify code against the sets already loaded into f
+ */
+static esp_err_t verify(const pkt_filter_t *f) {
+  // Instruction start positions, to check jump targets
+  uint8_t starts[(PF_CODE_MAX + 1 + 7) / 8] = {0};
+  size_t pc = 0;
+  while (pc < f->code_len) {
+    int n = op_len(f->code[pc]);
+    if (n == 0 || pc + n > f->code_len)
+      return ESP_ERR_INVALID_ARG;
+    starts[pc / 8] |= 1 << (pc % 8);
+    pc += n;
+  }
+  starts[pc / 8] |= 1 << (pc % 8); // End of code is a valid target
+
+  for (pc = 0; pc < f->code_len; pc += op_len(f->code[pc])) {
+    const uint8_t *i = f->code + pc;
+    switch (i[0]) {
+    case PF_OP_JT:
+    case PF_OP_JF: {
+      size_t target = pc + 2 + i[1];
+      if (target > f->code_len || !(starts[target / 8] & (1 << (target % 8))))
+        return ESP_ERR_INVALID_ARG;
+      break;
+    }
+    case PF_OP_ADDR:
+      if (i[1] > PF_FIELD_BSSID)
+        return ESP_ERR_INVALID_ARG;
+      break;
+    case PF_OP_ADDR_IN:
+      if (i[1] > PF_FIELD_BSSID || i[2] >= f->set_count)
+        return ESP_ERR_INVALID_ARG;
+      break;
+    default:
+      break;
+    }
+  }
+  return ESP_OK;
+}
+
+esp_err_t pkt_filter_load(const uint8_t *data, size_t len, pkt_filter_t *out) {
+  if (!data || !out || len < 2)
+    return ESP_ERR_INVALID_ARG;
+
+  memset(out, 0, sizeof(*out));
+  size_t pos = 0;
+  out->code_len = data[pos++];
+  if (pos + out->code_len + 1 > len)
+    return ESP_ERR_INVALID_ARG;
+  memcpy(out->code, data + pos, out->code_len);
+  pos += out->code_len;
+
+  out->set_count = data[pos++];
+  if (out->set_count > PF_SETS_MAX)
+    return ESP_ERR_INVALID_ARG;
+  for (int s = 0; s < out->set_count; s++) {
+    if (pos >= len)
+      return ESP_ERR_INVALID_ARG;
+    uint8_t n = data[pos++];
+    if (n > PF_SET_MAX || pos + n * 6 > len)
+      return ESP_ERR_INVALID_ARG;
+    memcpy(out->set_mac[s], data + pos, n * 6);
+    qsort(out->set_mac[s], n, 6, mac_cmp);
+    out->set_len[s] = n;
+    pos += n * 6;
+  }
+  if (pos != len)
+    return ESP_ERR_INVALID_ARG;
+
+  return verify(out);
+}
+
+size_t pkt_filter_save(const pkt_filter_t *f, uint8_t *out, size_t cap) {
+  size_t need = 2 + f->code_len;
+  for (int s = 0; s < f->set_count; s++)
+    need += 1 + f->set_len[s] * 6;
+  if (need > cap)
+    return 0;
+
+  size_t pos = 0;
+  out[pos++] = f->code_len;
+  memcpy(out + pos, f->code, f->code_len);
+  pos += f->code_len;
+  out[pos++] = f->set_count;
+  for (int s = 0; s < f->set_count; s++) {
+    out[pos++] = f->set_len[s];
+    memcpy(out + pos, f->set_mac[s], f->set_len[s] * 6);
+    pos += f->set_len[s] * 6;
+  }
+  return pos;
+}
+
+// ---------------- Compiler ----------------
+
+typedef struct {
+  const char *src;
+  const char *p;   // Next unread character
+  const char *tok; // Current token
+  size_t tok_len;
+  pkt_filter_t *f;
+  int depth;       // Nesting of parentheses and "not"
+  const char *err; // First error, NULL if none
+  const char *err_at;
+} pf_parser_t;
+
+static const struct {
+  const char *name;
+  uint8_t mask;
+  uint8_t value;
+} FRAME_KINDS[] = {
+    {"mgmt", 0x0C, 0x00},         {"ctrl", 0x0C, 0x04},
+    {"data", 0x0C, 0x08},         {"assoc_req", 0xFC, 0x00},
+    {"assoc_resp", 0xFC, 0x10},   {"reassoc_req", 0xFC, 0x20},
+    {"reassoc_resp", 0xFC, 0x30}, {"probe_req", 0xFC, 0x40},
+    {"probe_resp", 0xFC, 0x50},   {"beacon", 0xFC, 0x80},
+    {"disassoc", 0xFC, 0xA0},     {"auth", 0xFC, 0xB0},
+    {"deauth", 0xFC, 0xC0},       {"action", 0xFC, 0xD0},
+    {"qos_data", 0xFC, 0x88},
+};
+
+static const struct {
+  const char *name;
+  uint8_t field;
+} FIELDS[] = {
+    {"addr", PF_FIELD_ANY},    {"addr1", PF_FIELD_ADDR1},
+    {"addr2", PF_FIELD_ADDR2}, {"addr3", PF_FIELD_ADDR3},
+    {"bssid", PF_FIELD_BSSID},
+};
+
+static void fail(pf_parser_t *ps, const char *msg) {
+  if (!ps->err) {
+    ps->err = msg;
+    ps->err_at = ps->tok;
+  }
+}
+
+static void next(pf_parser_t *ps) {
+  while (isspace((unsigned char)*ps->p))
+    ps->p++;
+  ps->tok = ps->p;
+
+  const char *p = ps->p;
+  if (*p == '\0') {
+    ps->tok_len = 0;
+  } else if (strchr("(){},", *p)) {
+    ps->tok_len = 1;
+  } else if ((p[0] == '>' || p[0] == '<') && p[1] == '=') {
+    ps->tok_len = 2;
+  } else if ((p[0] == '&' && p[1] == '&') || (p[0] == '|' && p[1] == '|')) {
+    ps->tok_len = 2;
+  } else if (strchr("<>!", *p)) {
+    ps->tok_len = 1;
+  } else {
+    while (isalnum((unsigned char)*p) || *p == '_' || *p == ':' || *p == '-')
+      p++;
+    ps->tok_len = (size_t)(p - ps->p);
+    if (ps->tok_len == 0)
+      ps->tok_len = 1; // Unknown character; reported by the caller
+  }
+  ps->p += ps->tok_len;
+}
+
+static bool is(const pf_parser_t *ps, const char *word) {
+  return strlen(word) == ps->tok_len &&
+         strncasecmp(ps->tok, word, ps->tok_len) == 0;
+}
+
+static void emit(pf_parser_t *ps, const uint8_t *bytes, size_t n) {
+  if (ps->f->code_len + n > PF_CODE_MAX) {
+    fail(ps, "filter too long");
+    return;
+  }
+  memcpy(ps->f->code + ps->f->code_len, bytes, n);
+  ps->f->code_len += (uint8_t)n;
+}
+
+static bool parse_int(const pf_parser_t *ps, long min, long max, long *out) {
+  char buf[12];
+  if (ps->tok_len == 0 || ps->tok_len >= sizeof(buf))
+    return false;
+  memcpy(buf, ps->tok, ps->tok_len);
+  buf[ps->tok_len] = '\0';
+  char *end;
+  long v = strtol(buf, &end, 10);
+  if (*end != '\0' || v < min || v > max)
+    return false;
+  *out = v;
+  return true;
+}
+
+static bool parse_mac(const pf_parser_t *ps, uint8_t mac[6]) {
+  char buf[18];
+  if (ps->tok_len != 17)
+    return false;
+  memcpy(buf, ps->tok, 17);
+  buf[17] = '\0';
+  int used = 0;
+  return sscanf(buf, "%2hhx:%2hhx:%2hhx:%2hhx:%2hhx:%2hhx%n", &mac[0],
+                &mac[1], &mac[2], &mac[3], &mac[4], &mac[5], &used) == 6 &&
+         used == 17;
+}
+
+static void parse_expr(pf_parser_t *ps);
+
+static void parse_addr(pf_parser_t *ps, uint8_t field) {
+  uint8_t mac[6];
+  if (!is(ps, "{")) {
+    if (!parse_mac(ps, mac)) {
+      fail(ps, "expected MAC address");
+      return;
+    }
+    next(ps);
+    uint8_t ins[8] = {PF_OP_ADDR, field};
+    memcpy(ins + 2, mac, 6);
+    emit(ps, ins, sizeof(ins));
+    return;
+  }
+
+  pkt_filter_t *f = ps->f;
+  if (f->set_count >= PF_SETS_MAX) {
+    fail(ps, "too many address sets");
+    return;
+  }
+  uint8_t set = f->set_count++;
+  next(ps);
+  for (;;) {
+    if (!parse_mac(ps, mac)) {
+      fail(ps, "expected MAC address");
+      return;
+    }
+    if (f->set_len[set] >= PF_SET_MAX) {
+      fail(ps, "address set too large");
+      return;
+    }
+    memcpy(f->set_mac[set][f->set_len[set]++], mac, 6);
+    next(ps);
+    if (is(ps, "}"))
+      break;
+    if (!is(ps, ",")) {
+      fail(ps, "expected ',' or '}'");
+      return;
+    }
+    next(ps);
+  }
+  next(ps);
+  qsort(f->set_mac[set], f->set_len[set], 6, mac_cmp);
+  uint8_t ins[3] = {PF_OP_ADDR_IN, field, set};
+  emit(ps, ins, sizeof(ins));
+}
+
+static void parse_rssi(pf_parser_t *ps) {
+  bool ge = is(ps, ">=") || is(ps, ">");
+  bool gt = is(ps, ">");
+  bool le = is(ps, "<=");
+  if (!ge && !le && !is(ps, "<")) {
+    fail(ps, "expected comparison");
+    return;
+  }
+  next(ps);
+  long dbm;
+  if (!parse_int(ps, -127, 127, &dbm)) {
+    fail(ps, "expected dBm value");
+    return;
+  }
+  next(ps);
+
+  // Everything becomes rssi >= n, negated for < and <=
+  long n = (gt || le) ? dbm + 1 : dbm;
+  if (n > 127)
+    n = 127;
+  uint8_t ins[2] = {PF_OP_RSSI_GE, (uint8_t)(int8_t)n};
+  emit(ps, ins, sizeof(ins));
+  if (!ge) {
+    uint8_t op = PF_OP_NOT;
+    emit(ps, &op, 1);
+  }
+}
+
+#define PF_DEPTH_MAX 8
+
+static void parse_factor(pf_parser_t *ps) {
+  if (ps->err)
+    return;
+  if (ps->depth >= PF_DEPTH_MAX) {
+    fail(ps, "nested too deeply");
+    return;
+  }
+
+  if (is(ps, "not") || is(ps, "!")) {
+    next(ps);
+    ps->depth++;
+    parse_factor(ps);
+    ps->depth--;
+    uint8_t op = PF_OP_NOT;
+    emit(ps, &op, 1);
+    return;
+  }
+  if (is(ps, "(")) {
+    next(ps);
+    ps->depth++;
+    parse_expr(ps);
+    ps->depth--;
+    if (!is(ps, ")")) {
+      fail(ps, "expected ')'");
+      return;
+    }
+    next(ps);
+    return;
+  }
+  if (is(ps, "all") || is(ps, "eapol")) {
+    uint8_t op = is(ps, "all") ? PF_OP_TRUE : PF_OP_EAPOL;
+    next(ps);
+    emit(ps, &op, 1);
+    return;
+  }
+  if (is(ps, "rssi")) {
+    next(ps);
+    parse_rssi(ps);
+    return;
+  }
+  if (is(ps, "type") || is(ps, "subtype")) {
+    bool sub = is(ps, "subtype");
+    next(ps);
+    long v;
+    if (!parse_int(ps, 0, sub ? 15 : 3, &v)) {
+      fail(ps, sub ? "expected subtype 0-15" : "expected type 0-3");
+      return;
+    }
+    next(ps);
+    uint8_t ins[3] = {PF_OP_FC, sub ? 0xF0 : 0x0C,
+                      (uint8_t)(sub ? v << 4 : v << 2)};
+    emit(ps, ins, sizeof(ins));
+    return;
+  }
+  for (size_t i = 0; i < sizeof(FRAME_KINDS) / sizeof(FRAME_KINDS[0]); i++) {
+    if (is(ps, FRAME_KINDS[i].name)) {
+      next(ps);
+      uint8_t ins[3] = {PF_OP_FC, FRAME_KINDS[i].mask, FRAME_KINDS[i].value};
+      emit(ps, ins, sizeof(ins));
+      return;
+    }
+  }
+  for (size_t i = 0; i < sizeof(FIELDS) / sizeof(FIELDS[0]); i++) {
+    if (is(ps, FIELDS[i].name)) {
+      next(ps);
+      parse_addr(ps, FIELDS[i].field);
+      return;
+    }
+  }
+  fail(ps, ps->tok_len ? "unknown term" : "unexpected end");
+}
+
+/**
+ * @brief Parse operands joined by one operator, short-circuiting with jumps
+ *
+ * "a or b" compiles to: a; JT end; b; end. The accumulator already holds
+ * the result when a jump is taken.
+ */
+static void parse_chain(pf_parser_t *ps, bool is_or) {
+  uint8_t patch[PF_CODE_MAX / 2 + 1]; // Each jump takes two bytes of code
+  size_t npatch = 0;
+
+  if (is_or)
+    parse_chain(ps, false);
+  else
+    parse_factor(ps);
+
+  while (!ps->err && (is_or ? (is(ps, "or") || is(ps, "||"))
+                            : (is(ps, "and") || is(ps, "&&")))) {
+    next(ps);
+    uint8_t ins[2] = {is_or ? PF_OP_JT : PF_OP_JF, 0};
+    emit(ps, ins, sizeof(ins));
+    if (ps->err)
+      return;
+    patch[npatch++] = ps->f->code_len - 1;
+    if (is_or)
+      parse_chain(ps, false);
+    else
+      parse_factor(ps);
+  }
+
+  if (ps->err)
+    return;
+  for (size_t i = 0; i < npatch; i++) {
+    ps->f->code[patch[i]] = (uint8_t)(ps->f->code_len - patch[i] - 1);
+  }
+}
+
+static void parse_expr(pf_parser_t *ps) { parse_chain(ps, true); }
+
+esp_err_t pkt_filter_compile(const char *expr, pkt_filter_t *out, char *err,
+                             size_t err_len) {
+  pf_parser_t ps = {.src = expr ? expr : "", .f = out};
+  ps.p = ps.src;
+  memset(out, 0, sizeof(*out));
+
+  next(&ps);
+  if (ps.tok_len == 0) {
+    out->code[out->code_len++] = PF_OP_TRUE;
+    return ESP_OK;
+  }
+
+  parse_expr(&ps);
+  if (!ps.err && ps.tok_len != 0)
+    fail(&ps, "unexpected input");
+
+  if (ps.err) {
+    if (err && err_len)
+      snprintf(err, err_len, "%s at %d", ps.err, (int)(ps.err_at - ps.src));
+    return ESP_ERR_INVALID_ARG;
+  }
+  return ESP_OK;
+}
@@ -0,0 +1,121 @@
+/**
+ * @file pkt_filter.h
+ * @brief Compiled 802.11 frame filters for the sniffer fast path
+ *
+ * A filter expression such as
+ *
+ *   bssid {AA:BB:CC:00:00:01, AA:BB:CC:00:00:02} and (eapol or beacon)
+ *     and rssi >= -80
+ *
+ * is compiled once into a few bytes of bytecode that the WiFi RX callback
+ * runs on every frame before anything is copied, so frames outside the
+ * scope of a job cost a handful of comparisons.
+ *
+ * Expression language (case-insensitive):
+ *
+ *   expr   := term { ("or" | "||") term }
+ *   term   := factor { ("and" | "&&") factor }
+ *   factor := ("not" | "!") factor | "(" expr ")" | pred
+ *   pred   := mgmt | ctrl | data | beacon | probe_req | probe_resp
+ *           | assoc_req | assoc_resp | reassoc_req | reassoc_resp
+ *           | auth | deauth | disassoc | action | qos_data
+ *           | type <0-3> | subtype <0-15>
+ *           | <field> <mac> | <field> "{" <mac> { "," <mac> } "}"
+ *           | rssi (">=" | ">" | "<=" | "<") <dBm>
+ *           | eapol | all
+ *   field  := addr1 | addr2 | addr3 | addr (any of the three) | bssid
+ *
+ * Bytecode (also accepted as-is from the host, see pkt_filter_load()):
+ *
+ *   [code_len:1][code][set_count:1] { [n:1][n x 6-byte MAC] }
+ *
+ * Each instruction sets or tests one boolean accumulator; the program's
+ * result is the accumulator after the last instruction. Jumps only go
+ * forward, so every program terminates in at most code_len steps.
+ */
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Opcodes
+#define PF_OP_TRUE 0x01    // acc = true
+#define PF_OP_FC 0x02      // [mask][value]: acc = (fc0 & mask) == value
+#define PF_OP_ADDR 0x03    // [field][mac:6]: acc = field == mac
+#define PF_OP_ADDR_IN 0x04 // [field][set]: acc = field in set
+#define PF_OP_RSSI_GE 0x05 // [dBm:int8]: acc = rssi >= dBm
+#define PF_OP_EAPOL 0x06   // acc = data frame carrying EAPOL
+#define PF_OP_NOT 0x10     // acc = !acc
+#define PF_OP_JT 0x11      // [off]: if acc, skip off bytes
+#define PF_OP_JF 0x12      // [off]: if !acc, skip off bytes
+
+// Address fields
+#define PF_FIELD_ANY 0 // Any of addr1..addr3
+#define PF_FIELD_ADDR1 1
+#define PF_FIELD_ADDR2 2
+#define PF_FIELD_ADDR3 3
+#define PF_FIELD_BSSID 4 // By frame type and To/From DS bits
+
+// Limits
+#define PF_CODE_MAX 255
+#define PF_SETS_MAX 4
+#define PF_SET_MAX 32
+
+typedef struct {
+  uint8_t code_len;
+  uint8_t code[PF_CODE_MAX];
+  uint8_t set_count;
+  uint8_t set_len[PF_SETS_MAX];
+  uint8_t set_mac[PF_SETS_MAX][PF_SET_MAX][6]; // Sorted for binary search
+} pkt_filter_t;
+
+/**
+ * @brief Compile a filter expression
+ * @param expr Expression; NULL or empty compiles to "all"
+ * @param out Compiled program
+ * @param err Output: error message (may be NULL)
+ * @param err_len Size of err
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG with err set
+ */
+esp_err_t pkt_filter_compile(const char *expr, pkt_filter_t *out, char *err,
+                             size_t err_len);
+
+/**
+ * @brief Load and verify a serialized program
+ *
+ * Rejects unknown opcodes, truncated operands, jumps that leave the code
+ * or land inside an instruction, and references to missing sets.
+ */
+esp_err_t pkt_filter_load(const uint8_t *data, size_t len, pkt_filter_t *out);
+
+/**
+ * @brief Serialize a program (the format pkt_filter_load() accepts)
+ * @return Bytes written, or 0 if cap is too small
+ */
+size_t pkt_filter_save(const pkt_filter_t *f, uint8_t *out, size_t cap);
+
+/**
+ * @brief Run a filter on a frame
+ * @param frame 802.11 frame starting at the frame control field
+ * @param len Frame length
+ * @param rssi Receive RSSI in dBm
+ * @return true if the frame matches
+ */
+bool pkt_filter_match(const pkt_filter_t *f, const uint8_t *frame, int len,
+                      int8_t rssi);
+
+/**
+ * @brief BSSID of a frame (by frame type and To/From DS bits)
+ * @return Pointer into frame, or NULL for control, WDS and short frames
+ */
+const uint8_t *pkt_frame_bssid(const uint8_t *frame, int len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,421 @@
+/**
+ * @file probe_table.c
+ * @brief Probe request aggregation: one entry per (client, SSID) pair
+ */
+#include "probe_table.h"
+
+#include "chimera_proto.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "serial_comm.h"
+#include <stdatomic.h>
+#include <string.h>
+
+static const char *TAG = "probe_table";
+
+#define NIL 0xFFFF      // End of a chain or list
+#define PAIR_HEARD 0x80 // dirty: heard since the last update
+
+typedef struct {
+  uint16_t next; // Hash chain, or free list
+  uint16_t refs; // Pairs naming this SSID
+  uint8_t len;
+  uint8_t bytes[32];
+} ssid_slot_t;
+
+typedef struct {
+  uint16_t next;  // Hash chain, or free list
+  uint16_t older; // LRU list
+  uint16_t newer;
+  uint16_t ssid; // SSID pool index
+  bool used;
+  uint8_t mac[6];
+  uint8_t channel;
+  uint8_t dirty; // CHIMERA_PROBE_* / PAIR_HEARD not yet reported
+  int8_t rssi_min;
+  int8_t rssi_max;
+  int16_t rssi_ewma; // dBm x 16
+  uint32_t count;
+  uint32_t first_seen_ms;
+  uint32_t last_seen_ms;
+} probe_pair_t;
+
+// One allocation: pairs, SSID pool (as many slots as pairs, so interning
+// cannot fail once a pair is free) and the bucket heads of both
+static void *g_block = NULL;
+static probe_pair_t *g_pairs = NULL;
+static ssid_slot_t *g_ssids = NULL;
+static uint16_t *g_pair_head = NULL;
+static uint16_t *g_ssid_head = NULL;
+static uint32_t g_cap = 0;
+
+static uint32_t g_limit = 0;
+static uint32_t g_count = 0;
+static uint32_t g_ssid_count = 0;
+static uint16_t g_pair_free = NIL;
+static uint16_t g_ssid_free = NIL;
+static uint16_t g_lru_old = NIL;
+static uint16_t g_lru_new = NIL;
+
+static uint32_t g_cursor = 0;    // Next pair the batch pass looks at
+static uint32_t g_pass_left = 0; // Pairs the current pass has yet to visit
+static uint32_t g_last_pass_ms = 0;
+
+static atomic_bool g_reset_req = false;
+static atomic_uint g_limit_req = 0;
+static atomic_int g_mode = PROBE_REPORT_BATCH;
+
+static atomic_uint_fast32_t g_probes = 0;
+static atomic_uint_fast32_t g_updates = 0;
+static atomic_uint_fast32_t g_evicted = 0;
+
+// ---------------- Hashing ----------------
+
+static uint32_t fnv1a(uint32_t h, const uint8_t *p, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  return h;
+}
+
+static uint32_t ssid_bucket(const uint8_t *ssid, uint8_t len) {
+  return fnv1a(2166136261u, ssid, len) & (g_cap - 1);
+}
+
+static uint32_t pair_bucket(const uint8_t *mac, uint16_t ssid) {
+  uint8_t idx[2] = {(uint8_t)ssid, (uint8_t)(ssid >> 8)};
+  return fnv1a(fnv1a(2166136261u, mac, 6), idx, 2) & (g_cap - 1);
+}
+
+// ---------------- SSID pool ----------------
+
+static uint16_t ssid_find(const uint8_t *ssid, uint8_t len) {
+  uint16_t s = g_ssid_head[ssid_bucket(ssid, len)];
+  while (s != NIL &&
+         (g_ssids[s].len != len || memcmp(g_ssids[s].bytes, ssid, len) != 0)) {
+    s = g_ssids[s].next;
+  }
+  return s;
+}
+
+/**
+ * @brief Take a reference to an SSID, adding it to the pool if new
+ */
+static uint16_t ssid_intern(const uint8_t *ssid, uint8_t len) {
+  uint16_t s = ssid_find(ssid, len);
+  if (s == NIL) {
+    s = g_ssid_free;
+    g_ssid_free = g_ssids[s].next;
+
+    uint32_t b = ssid_bucket(ssid, len);
+    g_ssids[s].len = len;
+    memcpy(g_ssids[s].bytes, ssid, len);
+    g_ssids[s].refs = 0;
+    g_ssids[s].next = g_ssid_head[b];
+    g_ssid_head[b] = s;
+    g_ssid_count++;
+  }
+  g_ssids[s].refs++;
+  return s;
+}
+
+static void ssid_release(uint16_t s) {
+  if (--g_ssids[s].refs) {
+    return;
+  }
+
+  uint16_t *link = &g_ssid_head[ssid_bucket(g_ssids[s].bytes, g_ssids[s].len)];
+  while (*link != s) {
+    link = &g_ssids[*link].next;
+  }
+  *link = g_ssids[s].next;
+  g_ssids[s].next = g_ssid_free;
+  g_ssid_free = s;
+  g_ssid_count--;
+}
+
+// ---------------- Pairs ----------------
+
+static void lru_unlink(uint16_t i) {
+  probe_pair_t *p = &g_pairs[i];
+  if (p->older != NIL) {
+    g_pairs[p->older].newer = p->newer;
+  } else {
+    g_lru_old = p->newer;
+  }
+  if (p->newer != NIL) {
+    g_pairs[p->newer].older = p->older;
+  } else {
+    g_lru_new = p->older;
+  }
+}
+
+static void lru_push(uint16_t i) {
+  g_pairs[i].older = g_lru_new;
+  g_pairs[i].newer = NIL;
+  if (g_lru_new != NIL) {
+    g_pairs[g_lru_new].newer = i;
+  } else {
+    g_lru_old = i;
+  }
+  g_lru_new = i;
+}
+
+static void clear_all(void) {
+  for (uint32_t i = 0; i < g_cap; i++) {
+    g_pairs[i].used = false;
+    g_pairs[i].next = (i + 1 < g_cap) ? (uint16_t)(i + 1) : NIL;
+    g_ssids[i].refs = 0;
+    g_ssids[i].next = (i + 1 < g_cap) ? (uint16_t)(i + 1) : NIL;
+    g_pair_head[i] = NIL;
+    g_ssid_head[i] = NIL;
+  }
+  g_pair_free = 0;
+  g_ssid_free = 0;
+  g_lru_old = NIL;
+  g_lru_new = NIL;
+  g_count = 0;
+  g_ssid_count = 0;
+  g_cursor = 0;
+  g_pass_left = 0;
+}
+
+static int8_t rssi_avg(const probe_pair_t *p) {
+  int v = p->rssi_ewma;
+  return (int8_t)((v >= 0 ? v + 8 : v - 8) / 16);
+}
+
+static void send_update(const probe_pair_t *p, uint8_t flags) {
+  const ssid_slot_t *s = &g_ssids[p->ssid];
+  chimera_probe_update_t rec = {
+      .channel = p->channel,
+      .flags = flags,
+      .rssi_avg = rssi_avg(p),
+      .rssi_min = p->rssi_min,
+      .rssi_max = p->rssi_max,
+      .count = p->count,
+      .first_seen_ms = p->first_seen_ms,
+      .last_seen_ms = p->last_seen_ms,
+      .ssid_len = s->len,
+  };
+  memcpy(rec.mac, p->mac, 6);
+  serial_send_record(CHIMERA_MSG_PROBE_UPDATE, CHIMERA_PROBE_UPDATE_VERSION,
+                     &rec, sizeof(rec), s->bytes, s->len);
+  atomic_fetch_add(&g_updates, 1);
+}
+
+static void pair_remove(uint16_t i) {
+  probe_pair_t *p = &g_pairs[i];
+  uint16_t *link = &g_pair_head[pair_bucket(p->mac, p->ssid)];
+  while (*link != i) {
+    link = &g_pairs[*link].next;
+  }
+  *link = p->next;
+
+  lru_unlink(i);
+  ssid_release(p->ssid);
+  p->used = false;
+  p->next = g_pair_free;
+  g_pair_free = i;
+  g_count--;
+}
+
+/**
+ * @brief Drop the least recently heard pair, flushing unsent counters
+ */
+static void evict_oldest(void) {
+  uint16_t i = g_lru_old;
+  probe_pair_t *p = &g_pairs[i];
+  if (p->dirty && atomic_load(&g_mode) == PROBE_REPORT_BATCH) {
+    send_update(p, (p->dirty & ~PAIR_HEARD) | CHIMERA_PROBE_EVICTED);
+  }
+  pair_remove(i);
+  atomic_fetch_add(&g_evicted, 1);
+}
+
+static void apply_requests(void) {
+  if (atomic_exchange(&g_reset_req, false)) {
+    clear_all();
+  }
+  uint32_t limit = atomic_exchange(&g_limit_req, 0);
+  if (limit) {
+    g_limit = (limit < g_cap) ? limit : g_cap;
+    while (g_count > g_limit) {
+      evict_oldest();
+    }
+  }
+}
+
+esp_err_t probe_table_init(void) {
+  if (g_block) {
+    return ESP_OK;
+  }
+
+  uint32_t caps[] = {PROBE_TABLE_PAIRS, PROBE_TABLE_PAIRS_INTERNAL};
+  uint32_t where[] = {MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT, MALLOC_CAP_8BIT};
+  for (int k = 0; k < 2 && !g_block; k++) {
+    g_cap = caps[k];
+    g_block = heap_caps_malloc(
+        g_cap * (sizeof(probe_pair_t) + sizeof(ssid_slot_t) +
+                 2 * sizeof(uint16_t)),
+        where[k]);
+  }
+  if (!g_block) {
+    g_cap = 0;
+    ESP_LOGE(TAG, "Failed to allocate probe table");
+    return ESP_ERR_NO_MEM;
+  }
+
+  g_pairs = g_block;
+  g_ssids = (ssid_slot_t *)(g_pairs + g_cap);
+  g_pair_head = (uint16_t *)(g_ssids + g_cap);
+  g_ssid_head = g_pair_head + g_cap;
+  g_limit = g_cap;
+  atomic_store(&g_reset_req, false);
+  clear_all();
+  ESP_LOGI(TAG, "Probe table: %lu pairs", (unsigned long)g_cap);
+  return ESP_OK;
+}
+
+void probe_table_deinit(void) {
+  heap_caps_free(g_block);
+  g_block = NULL;
+  g_pairs = NULL;
+  g_ssids = NULL;
+  g_pair_head = NULL;
+  g_ssid_head = NULL;
+  g_cap = 0;
+  g_count = 0;
+  g_ssid_count = 0;
+}
+
+void probe_table_reset(void) { atomic_store(&g_reset_req, true); }
+
+void probe_table_configure(uint32_t limit, probe_report_mode_t mode) {
+  atomic_store(&g_mode, mode);
+  if (limit) {
+    atomic_store(&g_limit_req, limit);
+  }
+}
+
+// ---------------- Updates ----------------
+
+void probe_table_request(const uint8_t mac[6], const uint8_t *ssid,
+                         uint8_t ssid_len, int8_t rssi, uint8_t channel,
+                         uint32_t now_ms) {
+  if (!g_block || ssid_len == 0 || ssid_len > 32) {
+    return;
+  }
+  apply_requests();
+  atomic_fetch_add(&g_probes, 1);
+
+  bool batch = atomic_load(&g_mode) == PROBE_REPORT_BATCH;
+  uint16_t s = ssid_find(ssid, ssid_len);
+  uint16_t i = NIL;
+  if (s != NIL) {
+    i = g_pair_head[pair_bucket(mac, s)];
+    while (i != NIL &&
+           (g_pairs[i].ssid != s || memcmp(g_pairs[i].mac, mac, 6) != 0)) {
+      i = g_pairs[i].next;
+    }
+  }
+
+  if (i != NIL) {
+    probe_pair_t *p = &g_pairs[i];
+    p->rssi_ewma += (rssi * 16 - p->rssi_ewma) / 8;
+    if (rssi < p->rssi_min) {
+      p->rssi_min = rssi;
+    }
+    if (rssi > p->rssi_max) {
+      p->rssi_max = rssi;
+    }
+    p->channel = channel;
+    p->count++;
+    p->last_seen_ms = now_ms;
+    if (batch) {
+      p->dirty |= PAIR_HEARD;
+    }
+    lru_unlink(i);
+    lru_push(i);
+    return;
+  }
+
+  // Evict before interning: the evicted pair may hold the SSID's last
+  // reference, and a free pair guarantees a free SSID slot
+  if (g_count >= g_limit) {
+    evict_oldest();
+  }
+  s = ssid_intern(ssid, ssid_len);
+  i = g_pair_free;
+  g_pair_free = g_pairs[i].next;
+
+  probe_pair_t *p = &g_pairs[i];
+  uint32_t b = pair_bucket(mac, s);
+  memset(p, 0, sizeof(*p));
+  p->used = true;
+  memcpy(p->mac, mac, 6);
+  p->ssid = s;
+  p->channel = channel;
+  p->rssi_ewma = rssi * 16;
+  p->rssi_min = rssi;
+  p->rssi_max = rssi;
+  p->count = 1;
+  p->first_seen_ms = now_ms;
+  p->last_seen_ms = now_ms;
+  p->next = g_pair_head[b];
+  g_pair_head[b] = i;
+  lru_push(i);
+  g_count++;
+
+  if (batch) {
+    p->dirty = CHIMERA_PROBE_NEW;
+  } else {
+    send_update(p, CHIMERA_PROBE_NEW);
+  }
+}
+
+void probe_table_report(uint32_t now_ms) {
+  if (!g_block) {
+    return;
+  }
+  apply_requests();
+  if (atomic_load(&g_mode) != PROBE_REPORT_BATCH) {
+    return;
+  }
+
+  if (g_pass_left == 0) {
+    if (now_ms - g_last_pass_ms < PROBE_TABLE_REPORT_MS) {
+      return;
+    }
+    g_last_pass_ms = now_ms;
+    g_pass_left = g_cap;
+  }
+
+  // A pass visits every pair once, spread over as many worker ticks as
+  // it takes to stay under PROBE_TABLE_REPORT_MAX updates per tick
+  int sent = 0;
+  while (g_pass_left > 0 && sent < PROBE_TABLE_REPORT_MAX) {
+    probe_pair_t *p = &g_pairs[g_cursor];
+    g_cursor = (g_cursor + 1) & (g_cap - 1);
+    g_pass_left--;
+    if (!p->used || !p->dirty) {
+      continue;
+    }
+    send_update(p, p->dirty & ~PAIR_HEARD);
+    p->dirty = 0;
+    sent++;
+  }
+}
+
+void probe_table_get_stats(probe_table_stats_t *stats) {
+  if (!stats) {
+    return;
+  }
+  stats->entries = g_count;
+  stats->limit = g_limit;
+  stats->capacity = g_cap;
+  stats->ssids = g_ssid_count;
+  stats->probes = atomic_load(&g_probes);
+  stats->updates = atomic_load(&g_updates);
+  stats->evicted = atomic_load(&g_evicted);
+}
@@ -0,0 +1,98 @@
+/**
+ * @file probe_table.h
+ * @brief Probe request aggregation: one entry per (client, SSID) pair
+ *
+ * Directed probe requests update an entry keyed by the probing station and
+ * the requested SSID (probe count, first/last seen, RSSI average/min/max).
+ * SSIDs are interned in a shared, reference-counted pool so a station
+ * probing the same network on every channel, or many stations probing one
+ * network, store its name once. The table keeps at most a configurable
+ * number of pairs; the least recently heard pair makes room for a new one.
+ *
+ * Two reporting modes, both as PROBE_UPDATE records:
+ * - Batch (default): entries heard since the last pass are sent every
+ *   PROBE_TABLE_REPORT_MS, with their running counters.
+ * - First sighting: a pair is sent once, when it is first heard.
+ *
+ * Owned by the sniffer packet worker: probe_table_request() and
+ * probe_table_report() must be called from that task only.
+ */
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROBE_TABLE_PAIRS 512         // Power of two; PSRAM
+#define PROBE_TABLE_PAIRS_INTERNAL 64 // Without PSRAM
+#define PROBE_TABLE_REPORT_MS 5000    // Batch interval
+#define PROBE_TABLE_REPORT_MAX 32     // Updates per worker tick
+
+typedef enum {
+  PROBE_REPORT_BATCH = 0, // Periodic batches of the pairs heard
+  PROBE_REPORT_FIRST = 1, // First sighting of each pair only
+} probe_report_mode_t;
+
+typedef struct {
+  uint32_t entries;  // Pairs in the table
+  uint32_t limit;    // Most pairs kept (LRU cap)
+  uint32_t capacity; // Largest allowed limit
+  uint32_t ssids;    // Distinct SSIDs in the pool
+  uint32_t probes;   // Probe requests accounted
+  uint32_t updates;  // PROBE_UPDATE records sent
+  uint32_t evicted;  // Pairs dropped to make room
+} probe_table_stats_t;
+
+/**
+ * @brief Allocate the table (once)
+ */
+esp_err_t probe_table_init(void);
+
+/**
+ * @brief Free the table
+ */
+void probe_table_deinit(void);
+
+/**
+ * @brief Forget every pair (any task; applied by the packet worker)
+ */
+void probe_table_reset(void);
+
+/**
+ * @brief Set the LRU cap and reporting mode (any task)
+ * @param limit Most pairs kept; 0 keeps the current limit, larger than the
+ *        capacity is clamped
+ * @param mode Reporting mode
+ */
+void probe_table_configure(uint32_t limit, probe_report_mode_t mode);
+
+/**
+ * @brief Account a directed probe request
+ * @param mac Probing station
+ * @param ssid Requested SSID (1-32 bytes)
+ * @param ssid_len SSID length
+ * @param rssi Receive RSSI (dBm)
+ * @param channel Receive channel
+ * @param now_ms Current time
+ */
+void probe_table_request(const uint8_t mac[6], const uint8_t *ssid,
+                         uint8_t ssid_len, int8_t rssi, uint8_t channel,
+                         uint32_t now_ms);
+
+/**
+ * @brief Send due updates (call often; paces itself)
+ */
+void probe_table_report(uint32_t now_ms);
+
+/**
+ * @brief Snapshot table counters
+ */
+void probe_table_get_stats(probe_table_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
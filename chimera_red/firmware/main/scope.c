@@ -0,0 +1,412 @@
+/**
+ * @file scope.c
+ * @brief Engagement scope: which networks and devices the tool may touch
+ *
+ * The scope lives in one of two tables. An edit builds the other table and
+ * swaps the published pointer, then waits until no reader is inside the
+ * old one before it may be reused, so lookups never take a lock. Learned
+ * BSSIDs are only written by the WiFi driver task; each hash bucket is
+ * published after its entry is complete.
+ */
+#include "scope.h"
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "pkt_filter.h"
+#include "serial_comm.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "scope";
+
+// ---------------- Tables ----------------
+
+// Open-addressed hash buckets hold entry index + 1 (0 = empty); twice as
+// many buckets as entries keeps probe chains short.
+#define ADDR_BUCKETS (SCOPE_ADDR_MAX * 2)
+#define OUI_BUCKETS (SCOPE_OUI_MAX * 2)
+#define SSID_BUCKETS (SCOPE_SSID_MAX * 2)
+#define LEARNED_BUCKETS (SCOPE_LEARNED_MAX * 2)
+
+#define SSID_KEY 33 // [len][32 bytes, zero padded]
+
+typedef _Atomic uint8_t bucket_t;
+
+typedef struct {
+  uint8_t addr[SCOPE_ADDR_MAX][6];
+  uint8_t oui[SCOPE_OUI_MAX][3];
+  uint8_t ssid[SCOPE_SSID_MAX][SSID_KEY];
+  uint8_t addr_count;
+  uint8_t oui_count;
+  uint8_t ssid_count;
+  bucket_t addr_hash[ADDR_BUCKETS];
+  bucket_t oui_hash[OUI_BUCKETS];
+  bucket_t ssid_hash[SSID_BUCKETS];
+
+  // Written by the WiFi driver task only
+  uint8_t learned[SCOPE_LEARNED_MAX][6];
+  atomic_uint learned_count;
+  bucket_t learned_hash[LEARNED_BUCKETS];
+} scope_table_t;
+
+static scope_table_t g_tables[2];
+static _Atomic(scope_table_t *) g_scope = NULL; // NULL while empty
+// Readers include the command workers, which run below the command task
+// that edits, so writers sleep rather than yield until the count drains
+static atomic_int g_readers = 0;
+
+static atomic_uint_fast32_t g_dropped = 0;
+static atomic_uint_fast32_t g_hidden = 0;
+static atomic_uint_fast32_t g_refused = 0;
+
+static uint32_t key_hash(const uint8_t *key, size_t len) {
+  uint32_t h = 2166136261u; // FNV-1a
+  for (size_t i = 0; i < len; i++) {
+    h = (h ^ key[i]) * 16777619u;
+  }
+  return h;
+}
+
+static int table_find(const bucket_t *buckets, uint32_t n_buckets,
+                      const uint8_t *keys, size_t key_len,
+                      const uint8_t *key) {
+  uint32_t mask = n_buckets - 1;
+  uint32_t i = key_hash(key, key_len) & mask;
+  for (uint32_t probes = 0; probes < n_buckets; probes++) {
+    uint8_t b = atomic_load_explicit(&buckets[i], memory_order_acquire);
+    if (b == 0) {
+      return -1;
+    }
+    if (memcmp(keys + (b - 1) * key_len, key, key_len) == 0) {
+      return b - 1;
+    }
+    i = (i + 1) & mask;
+  }
+  return -1;
+}
+
+static void table_insert(bucket_t *buckets, uint32_t n_buckets,
+                         const uint8_t *key, size_t key_len, uint8_t index) {
+  uint32_t mask = n_buckets - 1;
+  uint32_t i = key_hash(key, key_len) & mask;
+  while (atomic_load_explicit(&buckets[i], memory_order_relaxed) != 0) {
+    i = (i + 1) & mask;
+  }
+  atomic_store_explicit(&buckets[i], index + 1, memory_order_release);
+}
+
+// Configured addresses and OUIs only: what the operator named
+static bool addr_configured(const scope_table_t *t, const uint8_t *mac) {
+  return table_find(t->addr_hash, ADDR_BUCKETS, &t->addr[0][0], 6, mac) >= 0 ||
+         table_find(t->oui_hash, OUI_BUCKETS, &t->oui[0][0], 3, mac) >= 0;
+}
+
+// Also BSSIDs learned from in-scope SSIDs; these only widen capture
+static bool addr_in(const scope_table_t *t, const uint8_t *mac) {
+  return addr_configured(t, mac) ||
+         table_find(t->learned_hash, LEARNED_BUCKETS, &t->learned[0][0], 6,
+                    mac) >= 0;
+}
+
+static bool ssid_in(const scope_table_t *t, const uint8_t *ssid, size_t len) {
+  uint8_t key[SSID_KEY] = {0};
+  if (len == 0 || len > 32) {
+    return false;
+  }
+  key[0] = (uint8_t)len;
+  memcpy(key + 1, ssid, len);
+  return table_find(t->ssid_hash, SSID_BUCKETS, &t->ssid[0][0], SSID_KEY,
+                    key) >= 0;
+}
+
+static void learn(scope_table_t *t, const uint8_t *bssid) {
+  if (table_find(t->learned_hash, LEARNED_BUCKETS, &t->learned[0][0], 6,
+                 bssid) >= 0) {
+    return;
+  }
+  unsigned n = atomic_load_explicit(&t->learned_count, memory_order_relaxed);
+  if (n >= SCOPE_LEARNED_MAX) {
+    return;
+  }
+  memcpy(t->learned[n], bssid, 6);
+  atomic_store_explicit(&t->learned_count, n + 1, memory_order_release);
+  table_insert(t->learned_hash, LEARNED_BUCKETS, bssid, 6, (uint8_t)n);
+}
+
+// ---------------- Readers ----------------
+
+static scope_table_t *scope_enter(void) {
+  atomic_fetch_add(&g_readers, 1);
+  return atomic_load(&g_scope);
+}
+
+static void scope_leave(void) { atomic_fetch_sub(&g_readers, 1); }
+
+bool scope_enforced(void) { return atomic_load(&g_scope) != NULL; }
+
+bool scope_addr_allowed(const uint8_t mac[6]) {
+  const scope_table_t *t = scope_enter();
+  bool ok = !t || addr_in(t, mac);
+  scope_leave();
+  return ok;
+}
+
+bool scope_ssid_allowed(const uint8_t *ssid, size_t len) {
+  const scope_table_t *t = scope_enter();
+  bool ok = !t || ssid_in(t, ssid, len);
+  scope_leave();
+  return ok;
+}
+
+static bool frame_in_scope(scope_table_t *t, const uint8_t *frame, int len) {
+  const uint8_t *bssid = pkt_frame_bssid(frame, len);
+  if (bssid && addr_in(t, bssid)) {
+    return true;
+  }
+
+  // Otherwise only beacons and probes naming an in-scope SSID
+  if (len < 24 || (frame[0] & 0x0C) != 0) {
+    return false;
+  }
+  uint8_t subtype = frame[0] >> 4;
+  int pos;
+  if (subtype == 4) {
+    pos = 24; // Probe request
+  } else if (subtype == 5 || subtype == 8) {
+    pos = 36; // Probe response, beacon: after fixed fields
+  } else {
+    return false;
+  }
+  if (pos + 2 > len || frame[pos] != 0 || pos + 2 + frame[pos + 1] > len ||
+      !ssid_in(t, frame + pos + 2, frame[pos + 1])) {
+    return false;
+  }
+
+  if (subtype != 4 && bssid) {
+    learn(t, bssid);
+  }
+  return true;
+}
+
+bool scope_frame_allowed(const uint8_t *frame, int len) {
+  scope_table_t *t = scope_enter();
+  bool ok = !t || frame_in_scope(t, frame, len);
+  scope_leave();
+  if (!ok) {
+    atomic_fetch_add(&g_dropped, 1);
+  }
+  return ok;
+}
+
+void scope_note_hidden(void) { atomic_fetch_add(&g_hidden, 1); }
+
+bool scope_tx_allowed(const uint8_t *target) {
+  const scope_table_t *t = scope_enter();
+  // Never learned BSSIDs: anyone can broadcast an allowlisted SSID
+  bool ok = !t || (target && addr_configured(t, target));
+  scope_leave();
+
+  if (!ok) {
+    atomic_fetch_add(&g_refused, 1);
+    if (target) {
+      ESP_LOGW(TAG, "Refused transmit to %02X:%02X:%02X:%02X:%02X:%02X "
+                    "(out of scope)",
+               target[0], target[1], target[2], target[3], target[4],
+               target[5]);
+    } else {
+      ESP_LOGW(TAG, "Refused untargeted transmit (scope enforced)");
+    }
+  }
+  return ok;
+}
+
+// ---------------- Editing ----------------
+
+/**
+ * @brief Copy the configured entries into the spare table
+ */
+static scope_table_t *edit_begin(void) {
+  const scope_table_t *cur = atomic_load(&g_scope);
+  scope_table_t *next = (cur == &g_tables[0]) ? &g_tables[1] : &g_tables[0];
+
+  memset(next, 0, sizeof(*next));
+  if (cur) {
+    memcpy(next->addr, cur->addr, sizeof(next->addr));
+    memcpy(next->oui, cur->oui, sizeof(next->oui));
+    memcpy(next->ssid, cur->ssid, sizeof(next->ssid));
+    next->addr_count = cur->addr_count;
+    next->oui_count = cur->oui_count;
+    next->ssid_count = cur->ssid_count;
+  }
+  return next;
+}
+
+/**
+ * @brief Hash the spare table, publish it and wait out old readers
+ */
+static void edit_commit(scope_table_t *next) {
+  for (uint8_t i = 0; i < next->addr_count; i++) {
+    table_insert(next->addr_hash, ADDR_BUCKETS, next->addr[i], 6, i);
+  }
+  for (uint8_t i = 0; i < next->oui_count; i++) {
+    table_insert(next->oui_hash, OUI_BUCKETS, next->oui[i], 3, i);
+  }
+  for (uint8_t i = 0; i < next->ssid_count; i++) {
+    table_insert(next->ssid_hash, SSID_BUCKETS, next->ssid[i], SSID_KEY, i);
+  }
+
+  bool empty = next->addr_count + next->oui_count + next->ssid_count == 0;
+  atomic_store(&g_scope, empty ? NULL : next);
+  while (atomic_load(&g_readers) != 0) {
+    vTaskDelay(1);
+  }
+}
+
+esp_err_t scope_add_addr(const uint8_t mac[6]) {
+  if (!mac) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  const scope_table_t *cur = atomic_load(&g_scope);
+  if (cur && table_find(cur->addr_hash, ADDR_BUCKETS, &cur->addr[0][0], 6,
+                        mac) >= 0) {
+    return ESP_OK;
+  }
+  if (cur && cur->addr_count >= SCOPE_ADDR_MAX) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  scope_table_t *next = edit_begin();
+  memcpy(next->addr[next->addr_count++], mac, 6);
+  edit_commit(next);
+  return ESP_OK;
+}
+
+esp_err_t scope_add_oui(const uint8_t oui[3]) {
+  if (!oui) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  const scope_table_t *cur = atomic_load(&g_scope);
+  if (cur &&
+      table_find(cur->oui_hash, OUI_BUCKETS, &cur->oui[0][0], 3, oui) >= 0) {
+    return ESP_OK;
+  }
+  if (cur && cur->oui_count >= SCOPE_OUI_MAX) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  scope_table_t *next = edit_begin();
+  memcpy(next->oui[next->oui_count++], oui, 3);
+  edit_commit(next);
+  return ESP_OK;
+}
+
+esp_err_t scope_add_ssid(const uint8_t *ssid, size_t len) {
+  if (!ssid || len == 0 || len > 32) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  const scope_table_t *cur = atomic_load(&g_scope);
+  if (cur && ssid_in(cur, ssid, len)) {
+    return ESP_OK;
+  }
+  if (cur && cur->ssid_count >= SCOPE_SSID_MAX) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  scope_table_t *next = edit_begin();
+  uint8_t *key = next->ssid[next->ssid_count++];
+  key[0] = (uint8_t)len;
+  memcpy(key + 1, ssid, len);
+  edit_commit(next);
+  return ESP_OK;
+}
+
+void scope_clear(void) {
+  atomic_store(&g_scope, NULL);
+  while (atomic_load(&g_readers) != 0) {
+    vTaskDelay(1);
+  }
+  ESP_LOGI(TAG, "Scope cleared");
+}
+
+// ---------------- Reporting ----------------
+
+// Addresses of len bytes each (6, or 3 for OUIs); cap is sized by the caller
+static int json_addrs(char *out, size_t cap, const char *name,
+                      const uint8_t *addrs, unsigned n, size_t len) {
+  int pos = snprintf(out, cap, ",\"%s\":[", name);
+  for (unsigned i = 0; i < n; i++) {
+    const uint8_t *a = addrs + i * len;
+    pos += snprintf(out + pos, cap - pos, "%s\"", i ? "," : "");
+    for (size_t b = 0; b < len; b++) {
+      pos += snprintf(out + pos, cap - pos, b ? ":%02X" : "%02X", a[b]);
+    }
+    pos += snprintf(out + pos, cap - pos, "\"");
+  }
+  pos += snprintf(out + pos, cap - pos, "]");
+  return pos;
+}
+
+esp_err_t scope_report(void) {
+  size_t cap = 256 + (SCOPE_ADDR_MAX + SCOPE_OUI_MAX + SCOPE_LEARNED_MAX) * 20 +
+               SCOPE_SSID_MAX * (32 * 6 + 4);
+  char *json = malloc(cap);
+  if (!json) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  const scope_table_t *t = scope_enter();
+  int pos = snprintf(json, cap,
+                     "{\"enforced\":%s,\"dropped\":%lu,\"hidden\":%lu,"
+                     "\"refused\":%lu",
+                     t ? "true" : "false",
+                     (unsigned long)atomic_load(&g_dropped),
+                     (unsigned long)atomic_load(&g_hidden),
+                     (unsigned long)atomic_load(&g_refused));
+  if (t) {
+    pos += json_addrs(json + pos, cap - pos, "addrs", &t->addr[0][0],
+                      t->addr_count, 6);
+    pos += json_addrs(json + pos, cap - pos, "ouis", &t->oui[0][0],
+                      t->oui_count, 3);
+    pos += json_addrs(json + pos, cap - pos, "learned", &t->learned[0][0],
+                      atomic_load(&t->learned_count), 6);
+
+    pos += snprintf(json + pos, cap - pos, ",\"ssids\":[");
+    for (unsigned i = 0; i < t->ssid_count; i++) {
+      char raw[33];
+      char esc[32 * 6 + 1];
+      memcpy(raw, t->ssid[i] + 1, t->ssid[i][0]);
+      raw[t->ssid[i][0]] = '\0';
+      serial_escape_json(raw, esc, sizeof(esc));
+      pos += snprintf(json + pos, cap - pos, "%s\"%s\"", i ? "," : "", esc);
+    }
+    pos += snprintf(json + pos, cap - pos, "]");
+  }
+  scope_leave();
+  snprintf(json + pos, cap - pos, "}");
+
+  serial_send_json("scope", json);
+  free(json);
+  return ESP_OK;
+}
+
+void scope_get_stats(scope_stats_t *stats) {
+  if (!stats) {
+    return;
+  }
+  memset(stats, 0, sizeof(*stats));
+  const scope_table_t *t = scope_enter();
+  if (t) {
+    stats->enforced = true;
+    stats->addrs = t->addr_count;
+    stats->ouis = t->oui_count;
+    stats->ssids = t->ssid_count;
+    stats->learned = (uint8_t)atomic_load(&t->learned_count);
+  }
+  scope_leave();
+  stats->frames_dropped = atomic_load(&g_dropped);
+  stats->results_hidden = atomic_load(&g_hidden);
+  stats->tx_refused = atomic_load(&g_refused);
+}
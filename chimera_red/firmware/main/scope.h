@@ -0,0 +1,132 @@
+/**
+ * @file scope.h
+ * @brief Engagement scope: which networks and devices the tool may touch
+ *
+ * The scope is an allowlist of device addresses (AP BSSIDs, BLE device
+ * addresses), OUIs (first three address bytes) and SSIDs, loaded over
+ * serial. While it has any entry it is enforced everywhere:
+ *
+ * - The WiFi RX callback drops frames whose BSSID is out of scope before
+ *   they are copied, so nothing downstream (parsing, raw streaming,
+ *   on-device capture) sees them.
+ * - Scan results (WiFi and BLE) outside the scope are not reported.
+ * - Transmits are allowed only at a configured address or OUI; all
+ *   others are refused, as are untargeted ones (BLE advertising).
+ *
+ * An AP whose beacon or probe response carries an in-scope SSID has its
+ * BSSID added to the scope automatically (up to SCOPE_LEARNED_MAX); these
+ * are forgotten whenever the scope is edited. Learned BSSIDs only widen
+ * capture and reporting. They never allow a transmit, since any AP can
+ * broadcast an allowlisted SSID.
+ *
+ * With an empty scope nothing is filtered or refused.
+ *
+ * Lookups are hashed and lock-free, safe from the WiFi driver task. Edits
+ * are made from the command task only.
+ */
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Capacities
+#define SCOPE_ADDR_MAX 64
+#define SCOPE_OUI_MAX 16
+#define SCOPE_SSID_MAX 16
+#define SCOPE_LEARNED_MAX 32
+
+typedef struct {
+  bool enforced;
+  uint8_t addrs;           // Configured entries
+  uint8_t ouis;
+  uint8_t ssids;
+  uint8_t learned;         // BSSIDs learned from in-scope SSIDs
+  uint32_t frames_dropped; // Frames dropped in the RX callback
+  uint32_t results_hidden; // Scan results not reported
+  uint32_t tx_refused;     // Transmits refused
+} scope_stats_t;
+
+/**
+ * @brief Add a device address (AP BSSID or BLE address, as printed)
+ * @return ESP_OK, ESP_ERR_NO_MEM if the table is full
+ */
+esp_err_t scope_add_addr(const uint8_t mac[6]);
+
+/**
+ * @brief Add an OUI (every address starting with these three bytes)
+ */
+esp_err_t scope_add_oui(const uint8_t oui[3]);
+
+/**
+ * @brief Add an SSID (exact, case-sensitive match)
+ * @param ssid SSID bytes (not NUL-terminated)
+ * @param len 1 to 32
+ */
+esp_err_t scope_add_ssid(const uint8_t *ssid, size_t len);
+
+/**
+ * @brief Remove every entry (stops enforcement)
+ */
+void scope_clear(void);
+
+/**
+ * @brief Check whether the scope is being enforced (has any entry)
+ */
+bool scope_enforced(void);
+
+/**
+ * @brief Check an address against the address, OUI and learned tables
+ * @return true if in scope, or if the scope is not enforced
+ */
+bool scope_addr_allowed(const uint8_t mac[6]);
+
+/**
+ * @brief Check an SSID against the SSID table
+ * @return true if in scope, or if the scope is not enforced
+ */
+bool scope_ssid_allowed(const uint8_t *ssid, size_t len);
+
+/**
+ * @brief Decide whether a received 802.11 frame is in scope
+ *
+ * In scope: the frame's BSSID is allowed, or it is a beacon, probe
+ * response or probe request for an allowed SSID. Beacons and probe
+ * responses of an allowed SSID also teach the scope their BSSID.
+ * Called from the WiFi RX callback; counts drops.
+ */
+bool scope_frame_allowed(const uint8_t *frame, int len);
+
+/**
+ * @brief Report a scan result that was withheld (for the counters)
+ */
+void scope_note_hidden(void);
+
+/**
+ * @brief Gate a transmit
+ *
+ * Checks the configured address and OUI tables only, not learned BSSIDs.
+ *
+ * @param target Address the transmit is aimed at, or NULL if untargeted
+ * @return true if allowed; refusals are counted and logged
+ */
+bool scope_tx_allowed(const uint8_t *target);
+
+/**
+ * @brief Report the scope as a "scope" JSON message
+ */
+esp_err_t scope_report(void);
+
+/**
+ * @brief Snapshot scope counters
+ */
+void scope_get_stats(scope_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
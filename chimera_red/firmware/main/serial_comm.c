@@ -5,9 +5,22 @@
  * Features:
  * - Conditional USB Serial JTAG support for ESP32-S3 (with UART fallback for
  * other chips)
- * - Thread-safe TX operations with mutex to prevent interleaved output
+ * - Non-blocking TX: producers copy whole messages into one of three
+ * preallocated multi-producer rings (critical / state / telemetry); a
+ * dedicated task drains them highest class first in large writes. The
+ * telemetry ring sheds its oldest messages under congestion.
+ * - Optional credit-based flow control: once the host grants credit, the
+ * device never writes more bytes than the host has room for; the rings
+ * absorb (and the telemetry ring sheds) whatever does not fit
+ * - Streaming COBS encoder over scatter lists: no per-frame malloc and no
+ * frame size ceiling (oversized frames bypass the ring)
+ * - Every binary frame carries a per-class sequence number and a ROM CRC-32;
+ * recent critical frames are retained for host retransmit requests
  * - Graceful task shutdown with flag and wait loop
  * - Heap-allocated buffers for large messages to avoid stack overflows
+ * - TX counters (queued / written / dropped) for link health reporting
+ * - Small telemetry records are coalesced into one container frame until a
+ * size threshold or a latency bound (esp_timer) is reached
  * - Robust JSON escaping handling control characters, UTF-8, and truncation
  * - Flush support (UART-specific; no-op on USB JTAG with short delay)
  * - Detailed error logging and safe initialization checks
@@ -18,19 +31,24 @@
  * - Atomic-like TX protection
  * - Pre-calculated buffer sizes for printf/JSON
  * - Full JSON escape including \b, \f, \uXXXX for non-printable
- * - Clean RX buffer handling with strdup for handler (prevents reentrancy
- * issues)
+ * - Bulk RX reads feeding a framing state machine that accepts both legacy
+ * newline-terminated text commands and COBS-framed binary commands with
+ * typed arguments (decoded in place, no per-command heap allocation)
  * - Added serial_is_initialized() implementation
  */
 #include "serial_comm.h"
 
+#include "chimera_proto.h"
 #include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "soc/soc_caps.h"
 
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -47,18 +65,54 @@ static const char *TAG = "serial";
 
 // Default UART port (when USB Serial JTAG not used)
 #define UART_PORT UART_NUM_0
+#define UART_BAUD_RATE 115200
 
-// RX line buffer
+// RX frame accumulator (one text line or one encoded COBS frame)
 #define RX_BUF_SIZE 8192
 
+// Bytes requested per driver read
+#define RX_READ_CHUNK 512
+
 // RX task
 #define RX_TASK_STACK 4096
 #define RX_TASK_PRIO 10
 
+// TX rings, one per traffic class (sizes must be powers of two)
+#define TX_RING_CRITICAL_SIZE (8 * 1024)
+#define TX_RING_STATE_SIZE (16 * 1024)
+#define TX_RING_TELEMETRY_SIZE (8 * 1024)
+
+// Per-message header inside a ring: payload length (LE)
+#define TX_MSG_HDR 2
+
+// TX drain task. The stage size is also the largest message a ring takes;
+// bigger messages are written directly by the caller.
+#define TX_TASK_STACK 3072
+#define TX_TASK_PRIO 9
+#define TX_STAGE_SIZE 4096
+#define TX_IDLE_TIMEOUT pdMS_TO_TICKS(100)
+#define TX_DRAIN_TIMEOUT pdMS_TO_TICKS(1000) // Flush before a direct write
+
 // Write timeouts (ticks)
 #define SERIAL_WRITE_TIMEOUT pdMS_TO_TICKS(100)
 #define SERIAL_READ_TIMEOUT pdMS_TO_TICKS(50)
 
+// Record aggregation: records up to AGG_MAX_RECORD bytes are packed into one
+// CHIMERA_MSG_BATCH frame of at most AGG_BUF_SIZE bytes
+#define AGG_BUF_SIZE 512
+#define AGG_MAX_RECORD 96
+#define AGG_DEFAULT_LATENCY_US 5000
+#define AGG_DEFAULT_FLUSH_BYTES 448
+
+// Retransmit window: the last RETX_SLOTS critical frames (slot = seq mod
+// RETX_SLOTS) whose encoded size fits a slot
+#define RETX_SLOTS 8
+#define RETX_SLOT_SIZE 512
+
+// Flow control: give up on a host that has granted nothing for this long
+// while the device is starved of credit, and fall back to free-running TX
+#define FC_STALE_US (5 * 1000 * 1000)
+
 // Upper bound for dynamic allocations (printf, JSON)
 #define SERIAL_MAX_DYNAMIC_ALLOC 16384
 
@@ -73,34 +127,260 @@ static const char *TAG = "serial";
 // ---------------- Global state ----------------
 
 static serial_cmd_handler_t g_cmd_handler = NULL;
-
-static char g_rx_buffer[RX_BUF_SIZE];
-static int g_rx_pos = 0;
+static serial_bin_handler_t g_bin_handler = NULL;
+
+// RX framing state machine
+typedef enum {
+  RX_STATE_IDLE = 0, // Between frames
+  RX_STATE_TEXT,     // Accumulating a newline-terminated text command
+  RX_STATE_BINARY,   // Accumulating a 0x00-delimited COBS frame
+  RX_STATE_DISCARD,  // Overflowed; skip to the next delimiter
+} rx_state_t;
+
+static uint8_t g_rx_buffer[RX_BUF_SIZE];
+static size_t g_rx_pos = 0;
+static rx_state_t g_rx_state = RX_STATE_IDLE;
+
+static atomic_uint_fast32_t g_rx_bytes = 0;
+static atomic_uint_fast32_t g_rx_text_cmds = 0;
+static atomic_uint_fast32_t g_rx_bin_cmds = 0;
+static atomic_uint_fast32_t g_rx_bad_frames = 0;
+static atomic_uint_fast32_t g_rx_overflows = 0;
 
 static TaskHandle_t g_rx_task = NULL;
 static volatile bool g_running = false;
 static volatile bool g_initialized = false;
 
-static SemaphoreHandle_t g_tx_mutex = NULL;
+// Serialises driver writes between the drain task and oversized frames that
+// bypass the ring. Producers that fit in the ring never take it.
+static SemaphoreHandle_t g_tx_write_mutex = NULL;
+
+// TX rings. Positions are free-running counters; the index is
+// pos & (size - 1). Each message is stored as [len:2][payload] so the drain
+// task and drop-oldest eviction can find message boundaries.
+// head:   next byte to reserve (advanced by producers)
+// commit: end of fully copied data (drain task may read up to here)
+// tail:   oldest queued byte (advanced by the drain task, or by eviction)
+// commit only moves when no producer is mid-copy, so it always lands on a
+// message boundary and neither the drain task nor eviction sees a torn
+// message. All rings share g_tx_lock.
+typedef struct {
+  uint8_t *buf;
+  uint32_t size;
+  bool drop_oldest; // Evict queued messages instead of rejecting new ones
+  uint32_t head;
+  uint32_t commit;
+  uint32_t tail;
+  uint32_t inflight;
+  uint16_t seq; // Next frame sequence number for this class
+  atomic_uint_fast32_t dropped;
+} tx_ring_t;
+
+static uint8_t s_tx_buf_critical[TX_RING_CRITICAL_SIZE];
+static uint8_t s_tx_buf_state[TX_RING_STATE_SIZE];
+static uint8_t s_tx_buf_telemetry[TX_RING_TELEMETRY_SIZE];
+
+static tx_ring_t g_tx_rings[SERIAL_CLASS_COUNT] = {
+    [SERIAL_CLASS_CRITICAL] = {s_tx_buf_critical, TX_RING_CRITICAL_SIZE},
+    [SERIAL_CLASS_STATE] = {s_tx_buf_state, TX_RING_STATE_SIZE},
+    [SERIAL_CLASS_TELEMETRY] = {s_tx_buf_telemetry, TX_RING_TELEMETRY_SIZE,
+                                true},
+};
+static portMUX_TYPE g_tx_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Drain staging buffer: whole messages are copied out of the rings,
+// highest class first, and handed to the driver from here
+static uint8_t s_tx_stage[TX_STAGE_SIZE];
+static size_t s_tx_stage_len = 0;
+static size_t s_tx_stage_off = 0;
+
+static TaskHandle_t g_tx_task = NULL;
+static volatile bool g_tx_running = false;
+
+static atomic_uint_fast32_t g_tx_bytes_queued = 0;
+static atomic_uint_fast32_t g_tx_bytes_written = 0;
+static atomic_uint_fast32_t g_tx_frames_dropped = 0;
+static atomic_uint_fast32_t g_tx_high_water = 0;
+
+// Aggregation batches, one per class:
+// [CHIMERA_MSG_BATCH][version] + N x [len:1][record]
+typedef struct {
+  uint8_t buf[AGG_BUF_SIZE];
+  size_t len;
+  volatile uint32_t count; // Records in the open batch
+  int64_t first_us;        // When the open batch started
+} agg_batch_t;
+
+static agg_batch_t g_agg[SERIAL_CLASS_COUNT];
+static portMUX_TYPE g_agg_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t g_agg_timer = NULL;
+static volatile uint32_t g_agg_latency_us = AGG_DEFAULT_LATENCY_US;
+static volatile uint32_t g_agg_flush_bytes = AGG_DEFAULT_FLUSH_BYTES;
+
+static atomic_uint_fast32_t g_agg_records = 0;
+static atomic_uint_fast32_t g_agg_batches = 0;
+static atomic_uint_fast32_t g_agg_latency_sum_us = 0;
+static atomic_uint_fast32_t g_agg_latency_max_us = 0;
+
+// Credit-based flow control. Disabled until the host sends its first
+// SERIAL_RX_FRAME_CREDIT; then g_fc_credit is the number of bytes the device
+// may still write. Guarded by g_fc_lock.
+static bool g_fc_enabled = false;
+static uint32_t g_fc_credit = 0;
+static int64_t g_fc_last_grant_us = 0;
+static portMUX_TYPE g_fc_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static atomic_uint_fast32_t g_fc_grants = 0;
+static atomic_uint_fast32_t g_fc_stalls = 0;
+
+// A binary frame being queued: payload scatter list plus its integrity
+// trailer [class:1][seq:2 LE][crc32:4 LE] (inside the COBS encoding). The
+// payload CRC and encoded length are computed before the ring lock is
+// taken; tx_frame_seal() adds the trailer under the lock in O(1).
+typedef struct {
+  size_t out; // Encoded bytes so far (code bytes included)
+  uint8_t code;
+} cobs_len_t;
+
+typedef struct {
+  const serial_iov_t *iov;
+  size_t iov_cnt;
+  uint32_t crc;       // CRC-32 of the payload
+  cobs_len_t enc;     // Encoded length state after the payload
+  size_t total;       // Encoded frame size with both delimiters (sealed)
+  uint16_t seq;       // Sequence number (sealed)
+  uint8_t trailer[CHIMERA_FRAME_TRAILER_LEN];
+} tx_frame_t;
+
+static void tx_frame_seal(tx_frame_t *f, uint8_t cls, uint16_t seq);
+
+_Static_assert(SERIAL_CLASS_CRITICAL == CHIMERA_CLASS_CRITICAL &&
+                   SERIAL_CLASS_STATE == CHIMERA_CLASS_STATE &&
+                   SERIAL_CLASS_TELEMETRY == CHIMERA_CLASS_TELEMETRY,
+               "serial_class_t must match the frame trailer class ids");
+
+// Retained critical frames, encoded as they went on the wire
+typedef struct {
+  uint16_t seq;
+  uint16_t len; // 0 = empty
+  uint8_t data[RETX_SLOT_SIZE];
+} retx_slot_t;
+
+static retx_slot_t s_retx[RETX_SLOTS];
+static portMUX_TYPE g_retx_lock = portMUX_INITIALIZER_UNLOCKED;
+static atomic_uint_fast32_t g_retx_sent = 0;
+static atomic_uint_fast32_t g_retx_missed = 0;
+
+static bool retx_handle_request(const uint8_t *body, size_t len);
+static void agg_flush(serial_class_t cls);
+static void agg_flush_all(void);
+static void agg_timer_cb(void *arg);
+static void agg_timer_delete(void);
 
 // ---------------- Internal helpers ----------------
 
-static inline int serial_read_byte(uint8_t *out_byte) {
-  if (!out_byte)
+static inline int serial_read_bulk(uint8_t *buf, size_t max_len) {
+  if (!buf || max_len == 0)
     return 0;
 
+  // Both drivers return as soon as any data is available (up to max_len)
 #if SERIAL_USE_USB_JTAG
-  return usb_serial_jtag_read_bytes(out_byte, 1, SERIAL_READ_TIMEOUT);
+  return usb_serial_jtag_read_bytes(buf, max_len, SERIAL_READ_TIMEOUT);
 #else
-  return uart_read_bytes(UART_PORT, out_byte, 1, SERIAL_READ_TIMEOUT);
+  return uart_read_bytes(UART_PORT, buf, max_len, SERIAL_READ_TIMEOUT);
 #endif
 }
 
-static inline void serial_write_bytes_internal(const uint8_t *data,
-                                               size_t len) {
-  if (!data || len == 0)
+// ---------------- Flow control ----------------
+
+/**
+ * @brief Take up to len bytes of credit
+ * @return Bytes the caller may write now (len when flow control is off)
+ */
+static size_t fc_acquire(size_t len) {
+  portENTER_CRITICAL(&g_fc_lock);
+  if (g_fc_enabled) {
+    if (len > g_fc_credit)
+      len = g_fc_credit;
+    g_fc_credit -= (uint32_t)len;
+  }
+  portEXIT_CRITICAL(&g_fc_lock);
+  return len;
+}
+
+// Return credit for bytes the driver did not accept
+static void fc_refund(size_t len) {
+  if (len == 0)
     return;
+  portENTER_CRITICAL(&g_fc_lock);
+  if (g_fc_enabled)
+    g_fc_credit += (uint32_t)len;
+  portEXIT_CRITICAL(&g_fc_lock);
+}
 
+/**
+ * @brief Check whether TX is blocked on credit
+ *
+ * A host that has granted nothing for FC_STALE_US (closed the port, or
+ * crashed) turns flow control off so a new host can read without first
+ * sending credit.
+ */
+static bool fc_starved(void) {
+  bool expired = false;
+
+  portENTER_CRITICAL(&g_fc_lock);
+  if (g_fc_enabled && g_fc_credit == 0 &&
+      esp_timer_get_time() - g_fc_last_grant_us > FC_STALE_US) {
+    g_fc_enabled = false;
+    expired = true;
+  }
+  bool starved = g_fc_enabled && g_fc_credit == 0;
+  portEXIT_CRITICAL(&g_fc_lock);
+
+  if (expired) {
+    ESP_LOGW(TAG, "Host stopped granting credit; flow control off");
+  }
+  return starved;
+}
+
+/**
+ * @brief Apply a credit frame from the host
+ *
+ * Body: [flags:1][bytes:4 LE]. RESET replaces the balance (start of a
+ * session), OFF disables flow control, otherwise bytes are added.
+ */
+static bool fc_handle_credit(const uint8_t *body, size_t len) {
+  if (len < 5)
+    return false;
+
+  uint8_t flags = body[0];
+  uint32_t bytes = (uint32_t)body[1] | ((uint32_t)body[2] << 8) |
+                   ((uint32_t)body[3] << 16) | ((uint32_t)body[4] << 24);
+
+  portENTER_CRITICAL(&g_fc_lock);
+  if (flags & SERIAL_CREDIT_OFF) {
+    g_fc_enabled = false;
+  } else {
+    uint32_t base = (flags & SERIAL_CREDIT_RESET) ? 0 : g_fc_credit;
+    g_fc_credit = (bytes > UINT32_MAX - base) ? UINT32_MAX : base + bytes;
+    g_fc_enabled = true;
+    g_fc_last_grant_us = esp_timer_get_time();
+  }
+  portEXIT_CRITICAL(&g_fc_lock);
+
+  atomic_fetch_add(&g_fc_grants, 1);
+  TaskHandle_t tx_task = g_tx_task;
+  if (tx_task) {
+    xTaskNotifyGive(tx_task);
+  }
+  return true;
+}
+
+/**
+ * @brief Write to the driver, ignoring credit
+ * @return Bytes written; short only if the driver timed out
+ */
+static size_t serial_write_driver(const uint8_t *data, size_t len) {
 #if SERIAL_USE_USB_JTAG
   size_t written = 0;
   while (written < len) {
@@ -110,49 +390,614 @@ static inline void serial_write_bytes_internal(const uint8_t *data,
       break; // Timeout or error
     written += (size_t)ret;
   }
+  return written;
 #else
-  uart_write_bytes(UART_PORT, (const char *)data, len);
+  int ret = uart_write_bytes(UART_PORT, (const char *)data, len);
+  return (ret > 0) ? (size_t)ret : 0;
 #endif
 }
 
-static inline void serial_write_cstr_internal(const char *s) {
-  if (!s)
+/**
+ * @brief Write to the driver within the current credit
+ * @return Bytes written; may be short (timeout, or credit exhausted)
+ */
+static size_t serial_write_bytes_internal(const uint8_t *data, size_t len) {
+  if (!data || len == 0)
+    return 0;
+
+  size_t allowed = fc_acquire(len);
+  if (allowed == 0)
+    return 0;
+
+  size_t written = serial_write_driver(data, allowed);
+  fc_refund(allowed - written);
+  return written;
+}
+
+// A message written straight to the driver by the blocking direct-write
+// paths. Credit for all of it is taken before the first byte, so flow
+// control never cuts it short. If the driver stalls partway, the rest is
+// skipped and the message is ended with a terminator (held in the credit
+// too) so the host resyncs on the next one.
+typedef struct {
+  size_t credit;  // Credit still held, terminator included
+  size_t written; // Bytes of the message written
+  bool cut;       // The driver stalled; the rest is skipped
+} tx_direct_t;
+
+/**
+ * @brief Take credit for a len-byte direct write, waiting (bounded)
+ * @return false if the host did not grant it within SERIAL_WRITE_TIMEOUT
+ */
+static bool tx_direct_begin(tx_direct_t *d, size_t len) {
+  TickType_t start = xTaskGetTickCount();
+
+  *d = (tx_direct_t){.credit = len + 1};
+  for (;;) {
+    portENTER_CRITICAL(&g_fc_lock);
+    bool ok = !g_fc_enabled || g_fc_credit >= d->credit;
+    if (ok && g_fc_enabled)
+      g_fc_credit -= (uint32_t)d->credit;
+    portEXIT_CRITICAL(&g_fc_lock);
+
+    if (ok)
+      return true;
+    if (xTaskGetTickCount() - start >= SERIAL_WRITE_TIMEOUT)
+      return false;
+    vTaskDelay(1);
+  }
+}
+
+static void tx_direct_write(tx_direct_t *d, const uint8_t *data, size_t len) {
+  TickType_t last_progress = xTaskGetTickCount();
+
+  while (len > 0 && !d->cut) {
+    size_t n = serial_write_driver(data, len);
+    d->written += n;
+    d->credit -= n;
+    data += n;
+    len -= n;
+    if (n > 0) {
+      last_progress = xTaskGetTickCount();
+    } else if (xTaskGetTickCount() - last_progress >= SERIAL_WRITE_TIMEOUT) {
+      d->cut = true;
+    } else {
+      vTaskDelay(1);
+    }
+  }
+}
+
+/**
+ * @brief Finish a direct write and return the credit it did not use
+ *
+ * @param term Ends a cut message: 0x00 for a frame, '\n' for a text line
+ * @return false if the message was cut (it has been counted as dropped)
+ */
+static bool tx_direct_end(tx_direct_t *d, uint8_t term) {
+  if (d->cut) {
+    if (d->written > 0 && serial_write_driver(&term, 1) == 1)
+      d->credit--;
+    atomic_fetch_add(&g_tx_frames_dropped, 1);
+  }
+  fc_refund(d->credit);
+  return !d->cut;
+}
+
+// ---------------- TX rings ----------------
+
+static void tx_ring_copy_in(tx_ring_t *r, uint32_t pos, const void *data,
+                            size_t len) {
+  const uint8_t *src = (const uint8_t *)data;
+  while (len > 0) {
+    uint32_t idx = pos & (r->size - 1);
+    size_t chunk = r->size - idx;
+    if (chunk > len)
+      chunk = len;
+    memcpy(&r->buf[idx], src, chunk);
+    pos += (uint32_t)chunk;
+    src += chunk;
+    len -= chunk;
+  }
+}
+
+static void tx_ring_copy_out(const tx_ring_t *r, uint32_t pos, void *out,
+                             size_t len) {
+  uint8_t *dst = (uint8_t *)out;
+  while (len > 0) {
+    uint32_t idx = pos & (r->size - 1);
+    size_t chunk = r->size - idx;
+    if (chunk > len)
+      chunk = len;
+    memcpy(dst, &r->buf[idx], chunk);
+    pos += (uint32_t)chunk;
+    dst += chunk;
+    len -= chunk;
+  }
+}
+
+static inline uint16_t tx_ring_msg_len(const tx_ring_t *r, uint32_t pos) {
+  uint8_t hdr[TX_MSG_HDR];
+  tx_ring_copy_out(r, pos, hdr, sizeof(hdr));
+  return (uint16_t)(hdr[0] | (hdr[1] << 8));
+}
+
+// Caller holds g_tx_lock
+static uint32_t tx_rings_used_locked(void) {
+  uint32_t used = 0;
+  for (int c = 0; c < SERIAL_CLASS_COUNT; c++) {
+    used += g_tx_rings[c].head - g_tx_rings[c].tail;
+  }
+  return used;
+}
+
+static bool tx_rings_idle(void) {
+  portENTER_CRITICAL(&g_tx_lock);
+  bool idle = true;
+  for (int c = 0; c < SERIAL_CLASS_COUNT; c++) {
+    if (g_tx_rings[c].commit != g_tx_rings[c].tail) {
+      idle = false;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&g_tx_lock);
+  return idle;
+}
+
+/**
+ * @brief Reserve space for one complete message in a class ring
+ *
+ * Never blocks. On a drop-oldest ring, committed messages are evicted from
+ * the tail until the new one fits. Every successful reserve must be paired
+ * with tx_ring_commit() once the payload has been written.
+ *
+ * With a frame, len is ignored: the frame is sealed with the class's next
+ * sequence number under the ring lock, so sequence order matches ring order
+ * (and therefore wire order within the class). A frame that is rejected
+ * still consumes its number, so the host sees the loss as a gap.
+ *
+ * @param len Payload length (at most TX_STAGE_SIZE)
+ * @param pos_out Position of the payload (after the message header)
+ * @param frame Binary frame to seal, or NULL for raw bytes
+ */
+static bool tx_ring_reserve(tx_ring_t *r, size_t len, uint32_t *pos_out,
+                            tx_frame_t *frame) {
+  uint32_t evicted = 0;
+  bool ok = false;
+  uint32_t used = 0;
+
+  portENTER_CRITICAL(&g_tx_lock);
+  if (frame) {
+    tx_frame_seal(frame, (uint8_t)(r - g_tx_rings), r->seq++);
+    len = frame->total;
+  }
+  uint32_t total = (uint32_t)(len + TX_MSG_HDR);
+  if (len <= TX_STAGE_SIZE) {
+    while (r->drop_oldest && total > r->size - (r->head - r->tail) &&
+           r->tail != r->commit) {
+      r->tail += TX_MSG_HDR + tx_ring_msg_len(r, r->tail);
+      evicted++;
+    }
+    ok = total <= r->size - (r->head - r->tail);
+  }
+  if (ok) {
+    uint32_t pos = r->head;
+    r->head += total;
+    r->inflight++;
+    const uint8_t hdr[TX_MSG_HDR] = {(uint8_t)len, (uint8_t)(len >> 8)};
+    tx_ring_copy_in(r, pos, hdr, sizeof(hdr));
+    used = tx_rings_used_locked();
+    *pos_out = pos + TX_MSG_HDR;
+  }
+  portEXIT_CRITICAL(&g_tx_lock);
+
+  uint32_t lost = evicted + (ok ? 0 : 1);
+  if (lost) {
+    atomic_fetch_add(&r->dropped, lost);
+    atomic_fetch_add(&g_tx_frames_dropped, lost);
+  }
+  if (used > atomic_load(&g_tx_high_water)) {
+    atomic_store(&g_tx_high_water, used);
+  }
+  return ok;
+}
+
+static void tx_ring_commit(tx_ring_t *r, size_t len) {
+  portENTER_CRITICAL(&g_tx_lock);
+  if (--r->inflight == 0) {
+    r->commit = r->head;
+  }
+  portEXIT_CRITICAL(&g_tx_lock);
+
+  atomic_fetch_add(&g_tx_bytes_queued, len);
+
+  TaskHandle_t tx_task = g_tx_task;
+  if (tx_task) {
+    xTaskNotifyGive(tx_task);
+  }
+}
+
+/**
+ * @brief Refill the stage with whole messages, highest class first
+ *
+ * A lower class is only visited once every higher class is empty, and
+ * filling stops at the first message that does not fit, so a class never
+ * overtakes a higher one. Copying under the lock keeps eviction from
+ * recycling a message while it is being staged.
+ */
+static size_t tx_stage_fill(void) {
+  size_t n = 0;
+
+  portENTER_CRITICAL(&g_tx_lock);
+  for (int c = 0; c < SERIAL_CLASS_COUNT; c++) {
+    tx_ring_t *r = &g_tx_rings[c];
+    while (r->tail != r->commit) {
+      uint16_t len = tx_ring_msg_len(r, r->tail);
+      if (n + len > TX_STAGE_SIZE)
+        goto done;
+      tx_ring_copy_out(r, r->tail + TX_MSG_HDR, &s_tx_stage[n], len);
+      n += len;
+      r->tail += TX_MSG_HDR + len;
+    }
+  }
+done:
+  portEXIT_CRITICAL(&g_tx_lock);
+  return n;
+}
+
+/**
+ * @brief Hand queued data to the driver
+ *
+ * Caller must hold g_tx_write_mutex. Without drain_all at most one stage is
+ * written, and a stalled driver or exhausted credit just ends the call.
+ * With drain_all the stage and every ring are written out completely,
+ * waiting for credit and the driver, so the next byte on the wire starts a
+ * message. That fails once no progress is made for SERIAL_WRITE_TIMEOUT,
+ * or after TX_DRAIN_TIMEOUT while producers keep the rings busy.
+ *
+ * @return false if drain_all could not reach a message boundary
+ */
+static bool tx_ring_drain_locked(bool drain_all) {
+  TickType_t start = xTaskGetTickCount();
+  TickType_t last_progress = start;
+
+  do {
+    if (s_tx_stage_off == s_tx_stage_len) {
+      if (drain_all && xTaskGetTickCount() - start >= TX_DRAIN_TIMEOUT)
+        return false;
+      s_tx_stage_len = tx_stage_fill();
+      s_tx_stage_off = 0;
+      if (s_tx_stage_len == 0)
+        return true;
+    }
+
+    size_t written = serial_write_bytes_internal(
+        &s_tx_stage[s_tx_stage_off], s_tx_stage_len - s_tx_stage_off);
+    if (written == 0) {
+      // Host is not reading; keep the data and let producers drop instead
+      if (!drain_all)
+        return true;
+      if (xTaskGetTickCount() - last_progress >= SERIAL_WRITE_TIMEOUT)
+        return false;
+      vTaskDelay(1);
+      continue;
+    }
+
+    atomic_fetch_add(&g_tx_bytes_written, written);
+    s_tx_stage_off += written;
+    last_progress = xTaskGetTickCount();
+  } while (drain_all);
+  return true;
+}
+
+/**
+ * @brief Write a message that is too large for the rings
+ *
+ * Flushes everything already queued first so the message lands on a
+ * boundary; if that cannot be done, or the host does not grant credit for
+ * all of it, the message is dropped rather than spliced into a
+ * half-written one or cut short. Blocks the caller; never used for
+ * records from the WiFi callback (those are far below TX_STAGE_SIZE).
+ */
+static void tx_write_direct(const serial_iov_t *iov, size_t iov_cnt) {
+  if (xSemaphoreTake(g_tx_write_mutex, SERIAL_WRITE_TIMEOUT) != pdTRUE) {
+    atomic_fetch_add(&g_tx_frames_dropped, 1);
+    ESP_LOGW(TAG, "TX write mutex timeout (direct write)");
+    return;
+  }
+  if (!tx_ring_drain_locked(true)) {
+    xSemaphoreGive(g_tx_write_mutex);
+    atomic_fetch_add(&g_tx_frames_dropped, 1);
+    ESP_LOGW(TAG, "TX queue did not drain (direct write)");
     return;
-  serial_write_bytes_internal((const uint8_t *)s, strlen(s));
+  }
+
+
+  size_t total = 0;
+  for (size_t i = 0; i < iov_cnt; i++) {
+    total += iov[i].len;
+  }
+
+  tx_direct_t d;
+  if (!tx_direct_begin(&d, total)) {
+    xSemaphoreGive(g_tx_write_mutex);
+    atomic_fetch_add(&g_tx_frames_dropped, 1);
+    ESP_LOGW(TAG, "TX credit timeout (direct write, %u bytes)",
+             (unsigned)total);
+    return;
+  }
+  for (size_t i = 0; i < iov_cnt; i++) {
+    tx_direct_write(&d, iov[i].data, iov[i].len);
+  }
+  // Frames start with their delimiter; anything else is a text line
+  const uint8_t *first = (const uint8_t *)iov[0].data;
+  bool frame = iov[0].len > 0 && first[0] == 0x00;
+  tx_direct_end(&d, frame ? 0x00 : '\n');
+  xSemaphoreGive(g_tx_write_mutex);
+
+  atomic_fetch_add(&g_tx_bytes_queued, total);
+  atomic_fetch_add(&g_tx_bytes_written, d.written);
 }
 
-static void serial_rx_task(void *arg) {
+/**
+ * @brief Copy a message (given as a scatter list) into a class ring
+ *
+ * Never blocks for messages up to TX_STAGE_SIZE: if the message does not
+ * fit it is dropped and counted (or, on the telemetry ring, older messages
+ * are evicted). Safe to call from any task, including the WiFi callback.
+ */
+static bool tx_push(serial_class_t cls, const serial_iov_t *iov,
+                    size_t iov_cnt) {
+  // Keep wire order: anything still waiting in this class's batch goes first
+  agg_flush(cls);
+
+  size_t total = 0;
+  for (size_t i = 0; i < iov_cnt; i++) {
+    total += iov[i].len;
+  }
+  if (total == 0)
+    return true;
+
+  if (total > TX_STAGE_SIZE) {
+    tx_write_direct(iov, iov_cnt);
+    return true;
+  }
+
+  tx_ring_t *r = &g_tx_rings[cls];
+  uint32_t pos;
+  if (!tx_ring_reserve(r, total, &pos, NULL))
+    return false;
+
+  for (size_t i = 0; i < iov_cnt; i++) {
+    tx_ring_copy_in(r, pos, iov[i].data, iov[i].len);
+    pos += (uint32_t)iov[i].len;
+  }
+
+  tx_ring_commit(r, total);
+  return true;
+}
+
+static inline bool tx_push_buf(serial_class_t cls, const void *data,
+                               size_t len) {
+  serial_iov_t iov = {data, len};
+  return tx_push(cls, &iov, 1);
+}
+
+static void serial_tx_task(void *arg) {
   (void)arg;
-  g_running = true;
+  g_tx_running = true;
 
-  while (g_initialized && g_running) {
-    uint8_t byte = 0;
-    int len = serial_read_byte(&byte);
+  bool stalled = false;
 
-    if (len > 0) {
+  while (g_initialized) {
+    if (s_tx_stage_off == s_tx_stage_len && tx_rings_idle()) {
+      ulTaskNotifyTake(pdTRUE, TX_IDLE_TIMEOUT);
+      continue;
+    }
+
+    // Out of credit: sleep until the host grants more (the RX task
+    // notifies us). Meanwhile the rings fill and telemetry sheds.
+    if (fc_starved()) {
+      if (!stalled)
+        atomic_fetch_add(&g_fc_stalls, 1);
+      stalled = true;
+      ulTaskNotifyTake(pdTRUE, TX_IDLE_TIMEOUT);
+      continue;
+    }
+    stalled = false;
+
+    uint32_t written_before = atomic_load(&g_tx_bytes_written);
+    xSemaphoreTake(g_tx_write_mutex, portMAX_DELAY);
+    tx_ring_drain_locked(false);
+    xSemaphoreGive(g_tx_write_mutex);
+
+    if (atomic_load(&g_tx_bytes_written) == written_before) {
+      vTaskDelay(pdMS_TO_TICKS(10)); // Driver stalled
+    }
+  }
+
+  g_tx_running = false;
+  g_tx_task = NULL;
+  vTaskDelete(NULL);
+}
+
+// ---------------- RX framing ----------------
+
+static void rx_dispatch_text(char *line) {
+  atomic_fetch_add(&g_rx_text_cmds, 1);
+  if (g_cmd_handler) {
+    g_cmd_handler(line);
+  }
+}
+
+/**
+ * @brief Parse a decoded binary command frame
+ *
+ * Layout (little-endian):
+ *   [op:1][req_id:2][argc:1] then argc x [arg_type:1][len:2][value:len]
+ */
+static bool rx_parse_bin_cmd(const uint8_t *p, size_t len,
+                             serial_bin_cmd_t *cmd) {
+  if (len < 4)
+    return false;
+
+  memset(cmd, 0, sizeof(*cmd));
+  cmd->opcode = p[0];
+  cmd->req_id = (uint16_t)(p[1] | (p[2] << 8));
+  uint8_t argc = p[3];
+  if (argc > SERIAL_MAX_BIN_ARGS)
+    return false;
+
+  size_t off = 4;
+  for (uint8_t i = 0; i < argc; i++) {
+    if (off + 3 > len)
+      return false;
+    serial_arg_t *arg = &cmd->argv[i];
+    arg->type = p[off];
+    arg->len = (uint16_t)(p[off + 1] | (p[off + 2] << 8));
+    off += 3;
+    if (arg->len > len - off)
+      return false;
+    arg->data = p + off;
+    off += arg->len;
+  }
+  cmd->argc = argc;
+  return off == len;
+}
+
+static void rx_dispatch_binary(uint8_t *frame, size_t enc_len) {
+  size_t len = cobs_decode(frame, enc_len, frame);
+  if (len == 0) {
+    atomic_fetch_add(&g_rx_bad_frames, 1);
+    return;
+  }
+
+  uint8_t type = frame[0];
+  uint8_t *body = frame + 1;
+  size_t body_len = len - 1;
+
+  switch (type) {
+  case SERIAL_RX_FRAME_TEXT:
+    // Legacy text command carried inside a COBS frame (no length limit
+    // other than RX_BUF_SIZE). Strip trailing newlines and terminate.
+    while (body_len > 0 &&
+           (body[body_len - 1] == '\n' || body[body_len - 1] == '\r')) {
+      body_len--;
+    }
+    if (body_len == 0)
+      return;
+    body[body_len] = '\0'; // Safe: decoded length < encoded length
+    rx_dispatch_text((char *)body);
+    break;
+
+  case SERIAL_RX_FRAME_CREDIT:
+    if (!fc_handle_credit(body, body_len)) {
+      atomic_fetch_add(&g_rx_bad_frames, 1);
+    }
+    break;
+
+  case SERIAL_RX_FRAME_RETRANSMIT:
+    if (!retx_handle_request(body, body_len)) {
+      atomic_fetch_add(&g_rx_bad_frames, 1);
+    }
+    break;
+
+  case SERIAL_RX_FRAME_COMMAND: {
+    serial_bin_cmd_t cmd;
+    if (!rx_parse_bin_cmd(body, body_len, &cmd)) {
+      atomic_fetch_add(&g_rx_bad_frames, 1);
+      return;
+    }
+    atomic_fetch_add(&g_rx_bin_cmds, 1);
+    if (g_bin_handler) {
+      g_bin_handler(&cmd);
+    }
+    break;
+  }
+
+  default:
+    atomic_fetch_add(&g_rx_bad_frames, 1);
+    break;
+  }
+}
+
+/**
+ * @brief Feed received bytes through the framing state machine
+ *
+ * Text commands are printable lines ended by CR or LF. Binary commands are
+ * COBS frames bracketed by 0x00 on both sides: the leading delimiter tells
+ * the parser a frame follows, so text and binary traffic can be mixed.
+ */
+static void rx_feed(const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    uint8_t byte = data[i];
+
+    switch (g_rx_state) {
+    case RX_STATE_IDLE:
+      if (byte == 0x00) {
+        g_rx_state = RX_STATE_BINARY;
+        g_rx_pos = 0;
+      } else if (byte != '\n' && byte != '\r') {
+        g_rx_state = RX_STATE_TEXT;
+        g_rx_buffer[0] = byte;
+        g_rx_pos = 1;
+      }
+      break;
+
+    case RX_STATE_TEXT:
       if (byte == '\n' || byte == '\r') {
+        g_rx_buffer[g_rx_pos] = '\0';
+        rx_dispatch_text((char *)g_rx_buffer);
+        g_rx_state = RX_STATE_IDLE;
+      } else if (byte == 0x00) {
+        // Host abandoned the line and started a binary frame
+        g_rx_state = RX_STATE_BINARY;
+        g_rx_pos = 0;
+      } else if (g_rx_pos < RX_BUF_SIZE - 1) {
+        g_rx_buffer[g_rx_pos++] = byte;
+      } else {
+        atomic_fetch_add(&g_rx_overflows, 1);
+        g_rx_state = RX_STATE_DISCARD;
+      }
+      break;
+
+    case RX_STATE_BINARY:
+      if (byte == 0x00) {
         if (g_rx_pos > 0) {
-          g_rx_buffer[g_rx_pos] = '\0';
-
-          // strdup to allow handler to block without risking buffer overwrite
-          char *cmd_copy = strdup(g_rx_buffer);
-          if (cmd_copy) {
-            if (g_cmd_handler) {
-              g_cmd_handler(cmd_copy);
-            }
-            free(cmd_copy);
-          } else {
-            ESP_LOGE(TAG, "Failed to strdup command");
-          }
-
-          g_rx_pos = 0;
+          rx_dispatch_binary(g_rx_buffer, g_rx_pos);
+          g_rx_state = RX_STATE_IDLE;
         }
-      } else if (g_rx_pos < RX_BUF_SIZE - 1) {
-        g_rx_buffer[g_rx_pos++] = (char)byte;
+        // An empty frame (0x00 0x00) keeps us waiting for frame data
+      } else if (g_rx_pos < RX_BUF_SIZE) {
+        g_rx_buffer[g_rx_pos++] = byte;
       } else {
-        ESP_LOGW(TAG, "RX buffer overflow, resetting");
+        atomic_fetch_add(&g_rx_overflows, 1);
+        g_rx_state = RX_STATE_DISCARD;
+      }
+      break;
+
+    case RX_STATE_DISCARD:
+      if (byte == 0x00) {
+        g_rx_state = RX_STATE_BINARY;
         g_rx_pos = 0;
+      } else if (byte == '\n' || byte == '\r') {
+        g_rx_state = RX_STATE_IDLE;
       }
+      break;
+    }
+  }
+}
+
+static void serial_rx_task(void *arg) {
+  (void)arg;
+  g_running = true;
+
+  static uint8_t chunk[RX_READ_CHUNK];
+
+  while (g_initialized && g_running) {
+    int len = serial_read_bulk(chunk, sizeof(chunk));
+    if (len > 0) {
+      atomic_fetch_add(&g_rx_bytes, (uint32_t)len);
+      rx_feed(chunk, (size_t)len);
     }
   }
 
@@ -168,9 +1013,9 @@ esp_err_t serial_init(void) {
     return ESP_OK;
   }
 
-  g_tx_mutex = xSemaphoreCreateMutex();
-  if (!g_tx_mutex) {
-    ESP_LOGE(TAG, "Failed to create TX mutex");
+  g_tx_write_mutex = xSemaphoreCreateMutex();
+  if (!g_tx_write_mutex) {
+    ESP_LOGE(TAG, "Failed to create TX write mutex");
     return ESP_ERR_NO_MEM;
   }
 
@@ -182,14 +1027,14 @@ esp_err_t serial_init(void) {
   esp_err_t ret = usb_serial_jtag_driver_install(&usb_cfg);
   if (ret != ESP_OK) {
     ESP_LOGE(TAG, "USB Serial JTAG init failed: %s", esp_err_to_name(ret));
-    vSemaphoreDelete(g_tx_mutex);
-    g_tx_mutex = NULL;
+    vSemaphoreDelete(g_tx_write_mutex);
+    g_tx_write_mutex = NULL;
     return ret;
   }
   ESP_LOGI(TAG, "USB Serial JTAG initialized");
 #else
   uart_config_t uart_config = {
-      .baud_rate = 115200,
+      .baud_rate = UART_BAUD_RATE,
       .data_bits = UART_DATA_8_BITS,
       .parity = UART_PARITY_DISABLE,
       .stop_bits = UART_STOP_BITS_1,
@@ -200,8 +1045,8 @@ esp_err_t serial_init(void) {
   esp_err_t ret = uart_param_config(UART_PORT, &uart_config);
   if (ret != ESP_OK) {
     ESP_LOGE(TAG, "UART param config failed: %s", esp_err_to_name(ret));
-    vSemaphoreDelete(g_tx_mutex);
-    g_tx_mutex = NULL;
+    vSemaphoreDelete(g_tx_write_mutex);
+    g_tx_write_mutex = NULL;
     return ret;
   }
 
@@ -209,8 +1054,8 @@ esp_err_t serial_init(void) {
                      UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
   if (ret != ESP_OK) {
     ESP_LOGE(TAG, "UART set pin failed: %s", esp_err_to_name(ret));
-    vSemaphoreDelete(g_tx_mutex);
-    g_tx_mutex = NULL;
+    vSemaphoreDelete(g_tx_write_mutex);
+    g_tx_write_mutex = NULL;
     return ret;
   }
 
@@ -218,28 +1063,67 @@ esp_err_t serial_init(void) {
       uart_driver_install(UART_PORT, RX_BUF_SIZE * 2, RX_BUF_SIZE, 0, NULL, 0);
   if (ret != ESP_OK) {
     ESP_LOGE(TAG, "UART driver install failed: %s", esp_err_to_name(ret));
-    vSemaphoreDelete(g_tx_mutex);
-    g_tx_mutex = NULL;
+    vSemaphoreDelete(g_tx_write_mutex);
+    g_tx_write_mutex = NULL;
     return ret;
   }
   ESP_LOGI(TAG, "UART initialized on port %d", UART_PORT);
 #endif
 
+  const esp_timer_create_args_t agg_timer_args = {
+      .callback = agg_timer_cb,
+      .name = "serial_agg",
+  };
+  if (esp_timer_create(&agg_timer_args, &g_agg_timer) != ESP_OK) {
+    // Not fatal: records are simply sent one frame each
+    ESP_LOGW(TAG, "Aggregation timer unavailable");
+    g_agg_timer = NULL;
+  }
+
   g_initialized = true;
   g_rx_pos = 0;
+  g_rx_state = RX_STATE_IDLE;
+  for (int c = 0; c < SERIAL_CLASS_COUNT; c++) {
+    tx_ring_t *r = &g_tx_rings[c];
+    r->head = r->commit = r->tail = r->inflight = 0;
+    r->seq = 0;
+  }
+  s_tx_stage_len = s_tx_stage_off = 0;
+  g_fc_enabled = false;
+  g_fc_credit = 0;
 
-  BaseType_t task_ok = xTaskCreate(serial_rx_task, "serial_rx", RX_TASK_STACK,
-                                   NULL, RX_TASK_PRIO, &g_rx_task);
+  BaseType_t task_ok = xTaskCreate(serial_tx_task, "serial_tx", TX_TASK_STACK,
+                                   NULL, TX_TASK_PRIO, &g_tx_task);
+  if (task_ok != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create TX task");
+    g_initialized = false;
+    agg_timer_delete();
+#if SERIAL_USE_USB_JTAG
+    usb_serial_jtag_driver_uninstall();
+#else
+    uart_driver_delete(UART_PORT);
+#endif
+    vSemaphoreDelete(g_tx_write_mutex);
+    g_tx_write_mutex = NULL;
+    return ESP_ERR_NO_MEM;
+  }
+
+  task_ok = xTaskCreate(serial_rx_task, "serial_rx", RX_TASK_STACK, NULL,
+                        RX_TASK_PRIO, &g_rx_task);
   if (task_ok != pdPASS) {
     ESP_LOGE(TAG, "Failed to create RX task");
     g_initialized = false;
+    agg_timer_delete();
+    vTaskDelete(g_tx_task);
+    g_tx_task = NULL;
+    g_tx_running = false;
 #if SERIAL_USE_USB_JTAG
     usb_serial_jtag_driver_uninstall();
 #else
     uart_driver_delete(UART_PORT);
 #endif
-    vSemaphoreDelete(g_tx_mutex);
-    g_tx_mutex = NULL;
+    vSemaphoreDelete(g_tx_write_mutex);
+    g_tx_write_mutex = NULL;
     return ESP_ERR_NO_MEM;
   }
 
@@ -252,8 +1136,11 @@ void serial_deinit(void) {
     return;
   }
 
+  agg_flush_all();
   g_initialized = false;
 
+  agg_timer_delete();
+
   // Wait for RX task to exit (with timeout)
   int timeout_ms = 500;
   while (g_running && timeout_ms > 0) {
@@ -267,15 +1154,26 @@ void serial_deinit(void) {
     g_rx_task = NULL;
   }
 
+  // TX task exits on its next idle timeout at the latest
+  timeout_ms = 500;
+  while (g_tx_running && timeout_ms > 0) {
+    vTaskDelay(pdMS_TO_TICKS(10));
+    timeout_ms -= 10;
+  }
+  if (g_tx_task) {
+    vTaskDelete(g_tx_task);
+    g_tx_task = NULL;
+  }
+
 #if SERIAL_USE_USB_JTAG
   usb_serial_jtag_driver_uninstall();
 #else
   uart_driver_delete(UART_PORT);
 #endif
 
-  if (g_tx_mutex) {
-    vSemaphoreDelete(g_tx_mutex);
-    g_tx_mutex = NULL;
+  if (g_tx_write_mutex) {
+    vSemaphoreDelete(g_tx_write_mutex);
+    g_tx_write_mutex = NULL;
   }
 
   ESP_LOGI(TAG, "Serial communication deinitialized");
@@ -284,7 +1182,12 @@ void serial_deinit(void) {
 bool serial_is_initialized(void) { return g_initialized; }
 
 void serial_send_json(const char *type, const char *data) {
-  if (!g_initialized || !type)
+  serial_send_json_class(SERIAL_CLASS_CRITICAL, type, data);
+}
+
+void serial_send_json_class(serial_class_t cls, const char *type,
+                            const char *data) {
+  if (!g_initialized || !type || cls >= SERIAL_CLASS_COUNT)
     return;
   const char *payload = data ? data : "null";
 
@@ -303,42 +1206,31 @@ void serial_send_json(const char *type, const char *data) {
   snprintf(buf, (size_t)needed + 1, "{\"type\":\"%s\",\"data\":%s}\n", type,
            payload);
 
-  if (xSemaphoreTake(g_tx_mutex, SERIAL_WRITE_TIMEOUT) == pdTRUE) {
-    serial_write_bytes_internal((const uint8_t *)buf, (size_t)needed);
-    xSemaphoreGive(g_tx_mutex);
-  } else {
-    ESP_LOGW(TAG, "TX mutex timeout in send_json");
-  }
+  tx_push_buf(cls, buf, (size_t)needed);
 
   free(buf);
 }
 
 void serial_send_json_raw(const char *json_str) {
-  if (!g_initialized || !json_str)
+  serial_send_json_raw_class(SERIAL_CLASS_CRITICAL, json_str);
+}
+
+void serial_send_json_raw_class(serial_class_t cls, const char *json_str) {
+  if (!g_initialized || !json_str || cls >= SERIAL_CLASS_COUNT)
     return;
   size_t len = strlen(json_str);
   if (len == 0)
     return;
 
-  if (xSemaphoreTake(g_tx_mutex, SERIAL_WRITE_TIMEOUT) == pdTRUE) {
-    serial_write_bytes_internal((const uint8_t *)json_str, len);
-    serial_write_bytes_internal((const uint8_t *)"\n", 1);
-    xSemaphoreGive(g_tx_mutex);
-  } else {
-    ESP_LOGW(TAG, "TX mutex timeout in send_json_raw");
-  }
+  serial_iov_t iov[2] = {{json_str, len}, {"\n", 1}};
+  tx_push(cls, iov, 2);
 }
 
 void serial_send_raw(const uint8_t *data, size_t len) {
   if (!g_initialized || !data || len == 0)
     return;
 
-  if (xSemaphoreTake(g_tx_mutex, SERIAL_WRITE_TIMEOUT) == pdTRUE) {
-    serial_write_bytes_internal(data, len);
-    xSemaphoreGive(g_tx_mutex);
-  } else {
-    ESP_LOGW(TAG, "TX mutex timeout in send_raw");
-  }
+  tx_push_buf(SERIAL_CLASS_CRITICAL, data, len);
 }
 
 void serial_printf(const char *format, ...) {
@@ -369,12 +1261,7 @@ void serial_printf(const char *format, ...) {
   vsnprintf(buf, (size_t)needed + 1, format, args);
   va_end(args);
 
-  if (xSemaphoreTake(g_tx_mutex, SERIAL_WRITE_TIMEOUT) == pdTRUE) {
-    serial_write_bytes_internal((const uint8_t *)buf, (size_t)needed);
-    xSemaphoreGive(g_tx_mutex);
-  } else {
-    ESP_LOGW(TAG, "TX mutex timeout in printf");
-  }
+  tx_push_buf(SERIAL_CLASS_TELEMETRY, buf, (size_t)needed);
 
   free(buf);
 }
@@ -383,6 +1270,59 @@ void serial_set_cmd_handler(serial_cmd_handler_t handler) {
   g_cmd_handler = handler;
 }
 
+void serial_set_bin_cmd_handler(serial_bin_handler_t handler) {
+  g_bin_handler = handler;
+}
+
+void serial_get_rx_stats(serial_rx_stats_t *stats) {
+  if (!stats)
+    return;
+  stats->bytes = atomic_load(&g_rx_bytes);
+  stats->text_cmds = atomic_load(&g_rx_text_cmds);
+  stats->bin_cmds = atomic_load(&g_rx_bin_cmds);
+  stats->bad_frames = atomic_load(&g_rx_bad_frames);
+  stats->overflows = atomic_load(&g_rx_overflows);
+}
+
+const serial_arg_t *serial_bin_arg(const serial_bin_cmd_t *cmd, uint8_t type,
+                                   uint8_t nth) {
+  if (!cmd)
+    return NULL;
+  for (uint8_t i = 0; i < cmd->argc; i++) {
+    if (cmd->argv[i].type == type) {
+      if (nth == 0)
+        return &cmd->argv[i];
+      nth--;
+    }
+  }
+  return NULL;
+}
+
+bool serial_arg_u32(const serial_arg_t *arg, uint32_t *out) {
+  if (!arg || !out || arg->len == 0 || arg->len > 4)
+    return false;
+  if (arg->type != SERIAL_ARG_U32 && arg->type != SERIAL_ARG_I32 &&
+      arg->type != SERIAL_ARG_CHAN_MASK)
+    return false;
+  uint32_t v = 0;
+  for (uint16_t i = 0; i < arg->len; i++) {
+    v |= (uint32_t)arg->data[i] << (8 * i);
+  }
+  // Sign-extend short I32 encodings
+  if (arg->type == SERIAL_ARG_I32 && arg->len < 4 &&
+      (arg->data[arg->len - 1] & 0x80)) {
+    v |= 0xFFFFFFFFu << (8 * arg->len);
+  }
+  *out = v;
+  return true;
+}
+
+size_t serial_arg_mac_count(const serial_arg_t *arg) {
+  if (!arg || arg->type != SERIAL_ARG_MAC_LIST || arg->len % 6 != 0)
+    return 0;
+  return arg->len / 6;
+}
+
 size_t serial_escape_json(const char *input, char *output, size_t max_len) {
   if (!input || !output || max_len == 0)
     return 0;
@@ -453,10 +1393,6 @@ done:
 
 // ---------------- COBS ----------------
 
-// Static scratch buffer for COBS encoding/decoding
-// Size covers max packet ~4KB + overhead
-static uint8_t s_cobs_scratch[4300];
-
 size_t cobs_encode(const uint8_t *input, size_t length, uint8_t *output) {
   size_t read_index = 0;
   size_t write_index = 1;
@@ -483,62 +1419,556 @@ size_t cobs_encode(const uint8_t *input, size_t length, uint8_t *output) {
   return write_index;
 }
 
-void serial_send_cobs(uint8_t type, const uint8_t *data, size_t len) {
-  if (!g_initialized || !data)
-    return;
+size_t cobs_decode(const uint8_t *input, size_t length, uint8_t *output) {
+  size_t read_index = 0;
+  size_t write_index = 0;
+
+  while (read_index < length) {
+    uint8_t code = input[read_index++];
+    if (code == 0 || read_index + code - 1 > length)
+      return 0; // Malformed
+
+    for (uint8_t i = 1; i < code; i++) {
+      output[write_index++] = input[read_index++];
+    }
+    if (code < 0xFF && read_index < length) {
+      output[write_index++] = 0x00;
+    }
+  }
+  return write_index;
+}
+
+// Incremental encoded-length count; start from {1, 1} (leading code byte)
+static void cobs_len_feed(cobs_len_t *l, const void *data, size_t n) {
+  const uint8_t *p = (const uint8_t *)data;
+  while (n > 0) {
+    size_t room = 0xFF - l->code;
+    size_t run = (n < room) ? n : room;
+    const uint8_t *z = memchr(p, 0, run);
+    size_t lit = z ? (size_t)(z - p) : run;
+
+    l->out += lit;
+    l->code += (uint8_t)lit;
+    p += lit;
+    n -= lit;
+
+    if (z) {
+      // Zero is replaced by the next block's code byte
+      l->out++;
+      l->code = 1;
+      p++;
+      n--;
+    } else if (l->code == 0xFF) {
+      l->out++;
+      l->code = 1;
+    }
+  }
+}
+
+size_t cobs_encoded_len(const serial_iov_t *iov, size_t iov_cnt) {
+  cobs_len_t l = {1, 1};
+  for (size_t i = 0; i < iov_cnt; i++) {
+    cobs_len_feed(&l, iov[i].data, iov[i].len);
+  }
+  return l.out;
+}
+
+/**
+ * Streaming COBS encoder. Input is fed in arbitrary pieces; each completed
+ * code block (at most 254 data bytes) is handed to the sink as soon as it
+ * closes, so no whole-frame buffer is ever needed.
+ */
+typedef void (*cobs_sink_t)(void *ctx, const uint8_t *data, size_t len);
+
+typedef struct {
+  uint8_t block[0xFF]; // [code][up to 254 data bytes]
+  uint8_t code;
+  cobs_sink_t sink;
+  void *ctx;
+} cobs_stream_t;
+
+// Frames are bracketed by delimiters on both sides so the host can tell a
+// binary frame from interleaved text lines by its first byte
+static void cobs_stream_begin(cobs_stream_t *cs, cobs_sink_t sink, void *ctx) {
+  static const uint8_t delim = 0x00;
+  cs->code = 1;
+  cs->sink = sink;
+  cs->ctx = ctx;
+  cs->sink(cs->ctx, &delim, 1);
+}
+
+static inline void cobs_stream_close_block(cobs_stream_t *cs) {
+  cs->block[0] = cs->code;
+  cs->sink(cs->ctx, cs->block, cs->code);
+  cs->code = 1;
+}
+
+static void cobs_stream_feed(cobs_stream_t *cs, const void *data, size_t n) {
+  const uint8_t *p = (const uint8_t *)data;
+  while (n > 0) {
+    size_t room = 0xFF - cs->code;
+    size_t run = (n < room) ? n : room;
+    const uint8_t *z = memchr(p, 0, run);
+    size_t lit = z ? (size_t)(z - p) : run;
+
+    memcpy(&cs->block[cs->code], p, lit);
+    cs->code += (uint8_t)lit;
+    p += lit;
+    n -= lit;
+
+    if (z) {
+      cobs_stream_close_block(cs);
+      p++;
+      n--;
+    } else if (cs->code == 0xFF) {
+      cobs_stream_close_block(cs);
+    }
+  }
+}
+
+static void cobs_stream_end(cobs_stream_t *cs) {
+  static const uint8_t delim = 0x00;
+  cobs_stream_close_block(cs);
+  cs->sink(cs->ctx, &delim, 1);
+}
+
+// Sink: sequential writes into a reserved TX ring region
+typedef struct {
+  tx_ring_t *ring;
+  uint32_t pos;
+} tx_ring_cursor_t;
+
+static void cobs_sink_ring(void *ctx, const uint8_t *data, size_t len) {
+  tx_ring_cursor_t *cur = (tx_ring_cursor_t *)ctx;
+  tx_ring_copy_in(cur->ring, cur->pos, data, len);
+  cur->pos += (uint32_t)len;
+}
+
+// Sink: straight to the driver (caller holds g_tx_write_mutex)
+static void cobs_sink_direct(void *ctx, const uint8_t *data, size_t len) {
+  tx_direct_write((tx_direct_t *)ctx, data, len);
+}
+
+static void cobs_stream_iov(cobs_stream_t *cs, const serial_iov_t *iov,
+                            size_t iov_cnt) {
+  for (size_t i = 0; i < iov_cnt; i++) {
+    cobs_stream_feed(cs, iov[i].data, iov[i].len);
+  }
+}
 
-  // Overhead calculation: len + len/254 + 2 (type+delim)
-  size_t max_out = len + (len / 254) + 5;
-  if (max_out > sizeof(s_cobs_scratch)) {
-    ESP_LOGE(TAG, "Packet too large for COBS buffer (%d > %d)", max_out,
-             sizeof(s_cobs_scratch));
+// ---------------- Frame integrity ----------------
+
+// CRC and encoded length of the payload; done before any lock is taken
+static void tx_frame_prepare(tx_frame_t *f, const serial_iov_t *iov,
+                             size_t iov_cnt) {
+  f->iov = iov;
+  f->iov_cnt = iov_cnt;
+  f->crc = 0;
+  f->enc = (cobs_len_t){1, 1};
+  for (size_t i = 0; i < iov_cnt; i++) {
+    f->crc = esp_rom_crc32_le(f->crc, (const uint8_t *)iov[i].data,
+                              (uint32_t)iov[i].len);
+    cobs_len_feed(&f->enc, iov[i].data, iov[i].len);
+  }
+}
+
+// Append class, sequence number and CRC; cheap enough for a spinlock
+static void tx_frame_seal(tx_frame_t *f, uint8_t cls, uint16_t seq) {
+  uint8_t *t = f->trailer;
+  t[0] = cls;
+  t[1] = (uint8_t)seq;
+  t[2] = (uint8_t)(seq >> 8);
+  uint32_t crc = esp_rom_crc32_le(f->crc, t, 3);
+  t[3] = (uint8_t)crc;
+  t[4] = (uint8_t)(crc >> 8);
+  t[5] = (uint8_t)(crc >> 16);
+  t[6] = (uint8_t)(crc >> 24);
+
+  cobs_len_t enc = f->enc;
+  cobs_len_feed(&enc, t, sizeof(f->trailer));
+  f->total = enc.out + 2; // Leading and trailing delimiters
+  f->seq = seq;
+}
+
+static void tx_frame_encode(const tx_frame_t *f, cobs_sink_t sink,
+                            void *ctx) {
+  cobs_stream_t cs;
+  cobs_stream_begin(&cs, sink, ctx);
+  cobs_stream_iov(&cs, f->iov, f->iov_cnt);
+  cobs_stream_feed(&cs, f->trailer, sizeof(f->trailer));
+  cobs_stream_end(&cs);
+}
+
+// Keep a copy of an encoded critical frame that was just written to a ring
+static void retx_store(const tx_frame_t *f, const tx_ring_t *r,
+                       uint32_t pos) {
+  if (f->total > RETX_SLOT_SIZE)
     return;
+
+  retx_slot_t *slot = &s_retx[f->seq % RETX_SLOTS];
+  portENTER_CRITICAL(&g_retx_lock);
+  tx_ring_copy_out(r, pos, slot->data, f->total);
+  slot->seq = f->seq;
+  slot->len = (uint16_t)f->total;
+  portEXIT_CRITICAL(&g_retx_lock);
+}
+
+/**
+ * @brief Encode a frame into its class ring
+ * @return Bytes to pass to tx_ring_commit(), or 0 if the frame was dropped
+ */
+static size_t tx_frame_queue(serial_class_t cls, tx_frame_t *f) {
+  tx_ring_cursor_t cur = {&g_tx_rings[cls], 0};
+  if (!tx_ring_reserve(cur.ring, 0, &cur.pos, f))
+    return 0;
+
+  uint32_t start = cur.pos;
+  tx_frame_encode(f, cobs_sink_ring, &cur);
+  if (cls == SERIAL_CLASS_CRITICAL) {
+    retx_store(f, cur.ring, start);
   }
+  return f->total;
+}
 
-  if (xSemaphoreTake(g_tx_mutex, SERIAL_WRITE_TIMEOUT) == pdTRUE) {
-    // 1. Prepare temp buffer for [Type][Data]
-    // Reuse end of scratch buffer or use small stack buffer if small enough
-    // For safety, we'll alloc a temp buffer for the raw input concatenation
-    // or we can misuse the scratch buffer: [Encoding...][Raw...]
-    // Given the memory constraints, let's alloc a small header+payload buffer
-    // if it fits on stack, else heap. Or simply encode in parts?
-    // COBS requires full pass.
+/**
+ * @brief Re-send retained critical frames
+ *
+ * Body: [seq:2 LE][count:1]. The frames go out byte-for-byte as first sent
+ * (same sequence number), so the host can drop duplicates. Frames no longer
+ * in the window are counted as missed.
+ */
+static bool retx_handle_request(const uint8_t *body, size_t len) {
+  static uint8_t frame[RETX_SLOT_SIZE]; // RX task only
 
-    uint8_t *raw_buf = malloc(len + 1);
-    if (raw_buf) {
-      raw_buf[0] = type;
-      memcpy(raw_buf + 1, data, len);
+  if (len < 2)
+    return false;
 
-      size_t encoded_len = cobs_encode(raw_buf, len + 1, s_cobs_scratch);
+  uint16_t seq = (uint16_t)(body[0] | (body[1] << 8));
+  unsigned count = (len >= 3 && body[2] > 0) ? body[2] : 1;
+  if (count > RETX_SLOTS)
+    count = RETX_SLOTS;
 
-      serial_write_bytes_internal(s_cobs_scratch, encoded_len);
+  for (unsigned i = 0; i < count; i++, seq++) {
+    retx_slot_t *slot = &s_retx[seq % RETX_SLOTS];
+    uint16_t n = 0;
 
-      uint8_t delim = 0x00;
-      serial_write_bytes_internal(&delim, 1);
+    portENTER_CRITICAL(&g_retx_lock);
+    if (slot->len && slot->seq == seq) {
+      n = slot->len;
+      memcpy(frame, slot->data, n);
+    }
+    portEXIT_CRITICAL(&g_retx_lock);
 
-      free(raw_buf);
+    if (n && tx_push_buf(SERIAL_CLASS_CRITICAL, frame, n)) {
+      atomic_fetch_add(&g_retx_sent, 1);
     } else {
-      ESP_LOGE(TAG, "COBS alloc failed");
+      atomic_fetch_add(&g_retx_missed, 1);
     }
+  }
+  return true;
+}
 
-    xSemaphoreGive(g_tx_mutex);
-  } else {
-    ESP_LOGW(TAG, "TX mutex timeout in COBS");
+// ---------------- Record aggregation ----------------
+
+/**
+ * @brief Close a class's open batch and move it into its ring as one frame
+ *
+ * Caller holds g_agg_lock. The frame is reserved and encoded under the lock
+ * so batches reach the ring in the order they were closed; the caller
+ * commits it with tx_ring_commit() after releasing the lock.
+ */
+static void agg_close_locked(serial_class_t cls, size_t *commit_len) {
+  agg_batch_t *b = &g_agg[cls];
+  *commit_len = 0;
+  if (b->count == 0)
+    return;
+
+  serial_iov_t iov = {b->buf, b->len};
+  tx_frame_t f;
+  tx_frame_prepare(&f, &iov, 1);
+  *commit_len = tx_frame_queue(cls, &f);
+
+  uint32_t latency = (uint32_t)(esp_timer_get_time() - b->first_us);
+  atomic_fetch_add(&g_agg_batches, 1);
+  atomic_fetch_add(&g_agg_latency_sum_us, latency);
+  if (latency > atomic_load(&g_agg_latency_max_us)) {
+    atomic_store(&g_agg_latency_max_us, latency);
+  }
+
+  b->len = 0;
+  b->count = 0;
+}
+
+static void agg_timer_delete(void) {
+  if (g_agg_timer) {
+    esp_timer_stop(g_agg_timer);
+    esp_timer_delete(g_agg_timer);
+    g_agg_timer = NULL;
   }
 }
 
+static void agg_flush(serial_class_t cls) {
+  if (g_agg[cls].count == 0)
+    return;
+
+  size_t commit_len;
+  portENTER_CRITICAL(&g_agg_lock);
+  agg_close_locked(cls, &commit_len);
+  portEXIT_CRITICAL(&g_agg_lock);
+
+  if (commit_len)
+    tx_ring_commit(&g_tx_rings[cls], commit_len);
+}
+
+static void agg_flush_all(void) {
+  for (int c = 0; c < SERIAL_CLASS_COUNT; c++) {
+    agg_flush((serial_class_t)c);
+  }
+}
+
+// Latency bound expired for the oldest open batch (esp_timer task)
+static void agg_timer_cb(void *arg) {
+  (void)arg;
+  agg_flush_all();
+}
+
+/**
+ * @brief Append one record to its class's open batch
+ * @return false if the record cannot be batched and must be sent alone
+ */
+static bool agg_append(serial_class_t cls, const serial_iov_t *iov,
+                       size_t iov_cnt, size_t rec_len) {
+  if (g_agg_latency_us == 0 || !g_agg_timer || rec_len > AGG_MAX_RECORD)
+    return false;
+
+  agg_batch_t *b = &g_agg[cls];
+  size_t commit_len = 0;
+  size_t flushed_len = 0;
+  bool arm = false;
+
+  portENTER_CRITICAL(&g_agg_lock);
+  if (b->len + 1 + rec_len > AGG_BUF_SIZE) {
+    agg_close_locked(cls, &flushed_len);
+  }
+  if (b->count == 0) {
+    b->buf[0] = CHIMERA_MSG_BATCH;
+    b->buf[1] = CHIMERA_BATCH_VERSION;
+    b->len = 2;
+    b->first_us = esp_timer_get_time();
+    arm = true;
+  }
+  b->buf[b->len++] = (uint8_t)rec_len;
+  for (size_t i = 0; i < iov_cnt; i++) {
+    memcpy(&b->buf[b->len], iov[i].data, iov[i].len);
+    b->len += iov[i].len;
+  }
+  b->count++;
+  if (b->len >= g_agg_flush_bytes) {
+    agg_close_locked(cls, &commit_len);
+    arm = false;
+  }
+  portEXIT_CRITICAL(&g_agg_lock);
+
+  atomic_fetch_add(&g_agg_records, 1);
+  if (flushed_len)
+    tx_ring_commit(&g_tx_rings[cls], flushed_len);
+  if (commit_len)
+    tx_ring_commit(&g_tx_rings[cls], commit_len);
+
+  // If the timer is still armed for an earlier batch it fires sooner than
+  // this batch's deadline and flushes it then, so a failed start is fine
+  if (arm)
+    esp_timer_start_once(g_agg_timer, g_agg_latency_us);
+  return true;
+}
+
+// Traffic class of each telemetry record type
+static serial_class_t record_class(uint8_t type) {
+  switch (type) {
+  case CHIMERA_MSG_HANDSHAKE:
+    return SERIAL_CLASS_CRITICAL;
+  case CHIMERA_MSG_PULSE:
+  case CHIMERA_MSG_SNIFF_STATS:
+  case CHIMERA_MSG_HOP_STATS:
+  case CHIMERA_MSG_SURVEY:
+  case CHIMERA_MSG_RADIO_MODE:
+  case CHIMERA_MSG_SYS_STATUS:
+  case CHIMERA_MSG_LOG:       // Rate limited; newest lines matter most
+  case CHIMERA_MSG_RAW_FRAME: // Bulk; shed before anything else is lost
+  case CHIMERA_MSG_CSI_DATA:
+    return SERIAL_CLASS_TELEMETRY;
+  default:
+    return SERIAL_CLASS_STATE; // Scan tables, probes, beacons
+  }
+}
+
+void serial_send_cobs_iov_class(serial_class_t cls, const serial_iov_t *iov,
+                                size_t iov_cnt) {
+  if (!g_initialized || !iov || iov_cnt == 0 || cls >= SERIAL_CLASS_COUNT)
+    return;
+
+  agg_flush(cls);
+
+  tx_frame_t f;
+  tx_frame_prepare(&f, iov, iov_cnt);
+
+  // Upper bound of the sealed size: the trailer can add one code byte
+  if (f.enc.out + CHIMERA_FRAME_TRAILER_LEN + 1 + 2 <= TX_STAGE_SIZE) {
+    size_t total = tx_frame_queue(cls, &f);
+    if (total)
+      tx_ring_commit(&g_tx_rings[cls], total);
+    return;
+  }
+
+  // Oversized frame: stream it straight to the driver in code blocks. Flush
+  // the rings first so the frame lands on a message boundary; if they do
+  // not drain, drop the frame instead of splicing it into a staged one.
+  // This path blocks the caller and must not be used from the WiFi
+  // callback.
+  bool locked = xSemaphoreTake(g_tx_write_mutex, SERIAL_WRITE_TIMEOUT) == pdTRUE;
+  bool drained = locked && tx_ring_drain_locked(true);
+
+  portENTER_CRITICAL(&g_tx_lock);
+  tx_frame_seal(&f, (uint8_t)cls, g_tx_rings[cls].seq++);
+  portEXIT_CRITICAL(&g_tx_lock);
+
+  tx_direct_t d;
+  bool credited = drained && tx_direct_begin(&d, f.total);
+  if (!credited) {
+    if (locked)
+      xSemaphoreGive(g_tx_write_mutex);
+    atomic_fetch_add(&g_tx_rings[cls].dropped, 1);
+    atomic_fetch_add(&g_tx_frames_dropped, 1);
+    ESP_LOGW(TAG, "TX %s (COBS %u bytes)",
+             !locked    ? "write mutex timeout"
+             : !drained ? "queue did not drain"
+                        : "credit timeout",
+             (unsigned)f.total);
+    return;
+  }
+
+  tx_frame_encode(&f, cobs_sink_direct, &d);
+  if (!tx_direct_end(&d, 0x00))
+    atomic_fetch_add(&g_tx_rings[cls].dropped, 1);
+  xSemaphoreGive(g_tx_write_mutex);
+
+  atomic_fetch_add(&g_tx_bytes_queued, f.total);
+  atomic_fetch_add(&g_tx_bytes_written, d.written);
+}
+
+void serial_send_cobs_iov(const serial_iov_t *iov, size_t iov_cnt) {
+  serial_send_cobs_iov_class(SERIAL_CLASS_CRITICAL, iov, iov_cnt);
+}
+
+void serial_send_cobs(uint8_t type, const uint8_t *data, size_t len) {
+  if (!data && len > 0)
+    return;
+
+  serial_iov_t iov[2] = {{&type, 1}, {data, len}};
+  serial_send_cobs_iov(iov, 2);
+}
+
+void serial_send_record(uint8_t type, uint8_t version, const void *body,
+                        size_t body_len, const void *tail, size_t tail_len) {
+  if (!g_initialized)
+    return;
+
+  const uint8_t hdr[2] = {type, version};
+  serial_iov_t iov[3] = {
+      {hdr, sizeof(hdr)}, {body, body_len}, {tail, tail ? tail_len : 0}};
+  size_t rec_len = sizeof(hdr) + body_len + iov[2].len;
+  serial_class_t cls = record_class(type);
+
+  if (!agg_append(cls, iov, 3, rec_len)) {
+    serial_send_cobs_iov_class(cls, iov, 3);
+  }
+}
+
+void serial_set_aggregation(uint32_t max_latency_us, size_t flush_bytes) {
+  if (flush_bytes == 0 || flush_bytes > AGG_BUF_SIZE)
+    flush_bytes = AGG_BUF_SIZE;
+
+  g_agg_flush_bytes = (uint32_t)flush_bytes;
+  g_agg_latency_us = max_latency_us;
+  if (max_latency_us == 0) {
+    agg_flush_all();
+  }
+  ESP_LOGI(TAG, "Aggregation: %lu us / %u bytes", (unsigned long)max_latency_us,
+           (unsigned)flush_bytes);
+}
+
+void serial_get_agg_stats(serial_agg_stats_t *stats) {
+  if (!stats)
+    return;
+
+  stats->records = atomic_load(&g_agg_records);
+  stats->batches = atomic_load(&g_agg_batches);
+  stats->latency_avg_us =
+      stats->batches ? atomic_load(&g_agg_latency_sum_us) / stats->batches : 0;
+  stats->latency_max_us = atomic_load(&g_agg_latency_max_us);
+  stats->max_latency_us = g_agg_latency_us;
+  stats->flush_bytes = g_agg_flush_bytes;
+}
+
 void serial_flush(void) {
   if (!g_initialized)
     return;
 
+  agg_flush_all();
+
+  // Wait (bounded) for the drain task to empty the TX rings
+  int timeout_ms = 200;
+  while (timeout_ms > 0) {
+    portENTER_CRITICAL(&g_tx_lock);
+    bool empty = (tx_rings_used_locked() == 0);
+    portEXIT_CRITICAL(&g_tx_lock);
+    if (empty && s_tx_stage_off == s_tx_stage_len)
+      break;
+    vTaskDelay(pdMS_TO_TICKS(5));
+    timeout_ms -= 5;
+  }
+
 #if SERIAL_USE_USB_JTAG
-  // No explicit flush; short delay to allow TX
+  // No explicit driver flush; short delay to allow TX
   vTaskDelay(pdMS_TO_TICKS(10));
 #else
   uart_wait_tx_done(UART_PORT, SERIAL_WRITE_TIMEOUT);
 #endif
 }
 
+void serial_get_tx_stats(serial_tx_stats_t *stats) {
+  if (!stats)
+    return;
+
+  portENTER_CRITICAL(&g_tx_lock);
+  uint32_t used = 0;
+  for (int c = 0; c < SERIAL_CLASS_COUNT; c++) {
+    stats->class_used[c] = g_tx_rings[c].head - g_tx_rings[c].tail;
+    used += stats->class_used[c];
+  }
+  portEXIT_CRITICAL(&g_tx_lock);
+
+  stats->bytes_queued = atomic_load(&g_tx_bytes_queued);
+  stats->bytes_written = atomic_load(&g_tx_bytes_written);
+  stats->frames_dropped = atomic_load(&g_tx_frames_dropped);
+  stats->ring_used = used;
+  stats->ring_high_water = atomic_load(&g_tx_high_water);
+  stats->ring_size = TX_RING_CRITICAL_SIZE + TX_RING_STATE_SIZE +
+                     TX_RING_TELEMETRY_SIZE;
+  for (int c = 0; c < SERIAL_CLASS_COUNT; c++) {
+    stats->class_dropped[c] = atomic_load(&g_tx_rings[c].dropped);
+  }
+
+  portENTER_CRITICAL(&g_fc_lock);
+  stats->fc_enabled = g_fc_enabled;
+  stats->fc_credit = g_fc_credit;
+  portEXIT_CRITICAL(&g_fc_lock);
+  stats->fc_grants = atomic_load(&g_fc_grants);
+  stats->fc_stalls = atomic_load(&g_fc_stalls);
+  stats->retx_sent = atomic_load(&g_retx_sent);
+  stats->retx_missed = atomic_load(&g_retx_missed);
+}
+
 void serial_process(void) {
   // No-op: RX is task-based
   // Yield to allow other tasks
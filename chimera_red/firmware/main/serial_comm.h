@@ -20,6 +20,138 @@ extern "C" {
 // Command handler callback type
 typedef void (*serial_cmd_handler_t)(const char *cmd);
 
+// Host -> device COBS frame types (first decoded byte)
+#define SERIAL_RX_FRAME_TEXT 0x01       // Payload is a legacy text command
+#define SERIAL_RX_FRAME_COMMAND 0x10    // Payload is a binary command
+#define SERIAL_RX_FRAME_CREDIT 0x11     // Payload is a flow-control grant
+#define SERIAL_RX_FRAME_RETRANSMIT 0x12 // Re-send retained critical frames
+
+/**
+ * Retransmit frame: [0x12][seq:2 LE][count:1]
+ *
+ * Asks for count (default 1, at most 8) critical-class frames starting at
+ * seq. Only the most recent critical frames up to 512 encoded bytes are
+ * retained; they are re-sent unchanged, sequence number included.
+ */
+
+/**
+ * Credit frame: [0x11][flags:1][bytes:4 LE]
+ *
+ * Flow control is off until the host sends its first credit frame. From
+ * then on the device writes at most the granted number of bytes and waits
+ * for further grants; a host typically opens with RESET and its receive
+ * buffer size, then grants back what it has consumed. Bytes that do not fit
+ * stay queued in the TX rings, where telemetry is shed oldest-first.
+ */
+#define SERIAL_CREDIT_RESET 0x01 // Replace the balance instead of adding
+#define SERIAL_CREDIT_OFF 0x02   // Disable flow control (free-running TX)
+
+// Maximum typed arguments in one binary command
+#define SERIAL_MAX_BIN_ARGS 8
+
+/**
+ * @brief Typed argument kinds for binary commands
+ *
+ * Integers are little-endian and may be sent in 1-4 bytes.
+ */
+typedef enum {
+  SERIAL_ARG_U32 = 0x01,       // Unsigned integer
+  SERIAL_ARG_I32 = 0x02,       // Signed integer (sign-extended if short)
+  SERIAL_ARG_STR = 0x03,       // UTF-8 string, not NUL-terminated
+  SERIAL_ARG_MAC_LIST = 0x04,  // N x 6-byte MAC addresses
+  SERIAL_ARG_CHAN_MASK = 0x05, // Bit n set = channel n (bit 0 unused)
+  SERIAL_ARG_BLOB = 0x06,      // Opaque bytes (e.g. filter programs)
+} serial_arg_type_t;
+
+typedef struct {
+  uint8_t type;        // serial_arg_type_t
+  uint16_t len;        // Value length in bytes
+  const uint8_t *data; // Points into the RX buffer; valid during the callback
+} serial_arg_t;
+
+/**
+ * @brief Decoded binary command
+ *
+ * Wire layout after COBS decoding (little-endian):
+ *   [0x10][opcode:1][req_id:2][argc:1] + argc x [type:1][len:2][value]
+ */
+typedef struct {
+  uint8_t opcode;
+  uint16_t req_id; // Host-chosen id, echoed in replies
+  uint8_t argc;
+  serial_arg_t argv[SERIAL_MAX_BIN_ARGS];
+} serial_bin_cmd_t;
+
+typedef void (*serial_bin_handler_t)(const serial_bin_cmd_t *cmd);
+
+/**
+ * @brief RX pipeline counters
+ */
+typedef struct {
+  uint32_t bytes;      // Raw bytes read from the driver
+  uint32_t text_cmds;  // Text commands dispatched
+  uint32_t bin_cmds;   // Binary commands dispatched
+  uint32_t bad_frames; // COBS/parse failures
+  uint32_t overflows;  // Frames longer than the RX buffer
+} serial_rx_stats_t;
+
+// Scatter/gather element for building a message from several buffers
+typedef struct {
+  const void *data;
+  size_t len;
+} serial_iov_t;
+
+/**
+ * @brief TX traffic classes
+ *
+ * Each class has its own ring; the drain task always empties a higher class
+ * before touching a lower one. Under congestion CRITICAL and STATE reject
+ * new messages, while TELEMETRY evicts its oldest queued messages.
+ */
+typedef enum {
+  SERIAL_CLASS_CRITICAL = 0, // Handshakes, command replies, status text
+  SERIAL_CLASS_STATE,        // Scan tables, probe/beacon sightings
+  SERIAL_CLASS_TELEMETRY,    // Pulse, stats, sys_status, logs, printf
+  SERIAL_CLASS_COUNT
+} serial_class_t;
+
+/**
+ * @brief TX pipeline counters
+ *
+ * Byte counters are free-running and wrap at 2^32.
+ */
+typedef struct {
+  uint32_t bytes_queued;    // Bytes accepted into the TX rings
+  uint32_t bytes_written;   // Bytes handed to the USB/UART driver
+  uint32_t frames_dropped;  // Messages rejected or evicted (all classes)
+  uint32_t ring_used;       // Bytes currently waiting in the rings
+  uint32_t ring_high_water; // Peak total ring occupancy since boot
+  uint32_t ring_size;       // Total ring capacity in bytes
+  uint32_t class_used[SERIAL_CLASS_COUNT];    // Bytes waiting per class
+  uint32_t class_dropped[SERIAL_CLASS_COUNT]; // Messages lost per class
+  bool fc_enabled;      // Host has granted credit
+  uint32_t fc_credit;   // Bytes the device may still write
+  uint32_t fc_grants;   // Credit frames received
+  uint32_t fc_stalls;   // Times TX ran out of credit
+  uint32_t retx_sent;   // Critical frames re-sent on host request
+  uint32_t retx_missed; // Requested frames no longer retained
+} serial_tx_stats_t;
+
+/**
+ * @brief Record aggregation counters and settings
+ *
+ * records / batches is the aggregation ratio; latency is the time from the
+ * first record of a batch until the batch is queued for transmission.
+ */
+typedef struct {
+  uint32_t records;        // Records packed into batches
+  uint32_t batches;        // Batch frames closed
+  uint32_t latency_avg_us; // Mean added latency per batch
+  uint32_t latency_max_us; // Worst added latency since boot
+  uint32_t max_latency_us; // Configured latency bound (0 = disabled)
+  uint32_t flush_bytes;    // Configured size threshold
+} serial_agg_stats_t;
+
 /**
  * @brief Initialize serial communication
  * @return ESP_OK on success
@@ -51,6 +183,18 @@ void serial_send_json(const char *type, const char *data);
  */
 void serial_send_json_raw(const char *json_str);
 
+/**
+ * @brief Send a JSON message in a specific traffic class
+ *
+ * serial_send_json() and serial_send_json_raw() use SERIAL_CLASS_CRITICAL.
+ * Periodic updates go in SERIAL_CLASS_TELEMETRY so that, when the link is
+ * slow, they shed instead of filling the critical ring and crowding out
+ * command replies.
+ */
+void serial_send_json_class(serial_class_t cls, const char *type,
+                            const char *data);
+void serial_send_json_raw_class(serial_class_t cls, const char *json_str);
+
 /**
  * @brief Encode data using COBS
  * @param input Input buffer
@@ -60,6 +204,23 @@ void serial_send_json_raw(const char *json_str);
  */
 size_t cobs_encode(const uint8_t *input, size_t length, uint8_t *output);
 
+/**
+ * @brief Decode COBS data (may be done in place: output == input)
+ * @param input Encoded bytes (without the 0x00 delimiter)
+ * @param length Encoded length
+ * @param output Output buffer (at least length bytes)
+ * @return Decoded length, or 0 if the input is malformed
+ */
+size_t cobs_decode(const uint8_t *input, size_t length, uint8_t *output);
+
+/**
+ * @brief Exact COBS-encoded length of a scatter list (excluding delimiter)
+ * @param iov Scatter list
+ * @param iov_cnt Number of elements
+ * @return Encoded length in bytes
+ */
+size_t cobs_encoded_len(const serial_iov_t *iov, size_t iov_cnt);
+
 /**
  * @brief Send binary data wrapped in COBS
  * @param type Message type (1 byte)
@@ -68,11 +229,68 @@ size_t cobs_encode(const uint8_t *input, size_t length, uint8_t *output);
  */
 void serial_send_cobs(uint8_t type, const uint8_t *data, size_t len);
 
+/**
+ * @brief Send one COBS frame assembled from a scatter list
+ *
+ * On the wire the frame is 0x00 | COBS(data | trailer) | 0x00, where the
+ * trailer carries the class, a per-class sequence number and a CRC-32 (see
+ * chimera_proto.h). The first byte of the first element is the message
+ * type. Encoding streams straight into the CRITICAL ring with no heap
+ * allocation. Frames over 4 KB encoded are streamed directly to the driver;
+ * that path blocks the caller, so keep such frames out of WiFi driver
+ * callbacks.
+ *
+ * @param iov Scatter list
+ * @param iov_cnt Number of elements
+ */
+void serial_send_cobs_iov(const serial_iov_t *iov, size_t iov_cnt);
+
+/**
+ * @brief Send one COBS frame in a specific traffic class
+ *
+ * serial_send_cobs_iov() is this with SERIAL_CLASS_CRITICAL.
+ */
+void serial_send_cobs_iov_class(serial_class_t cls, const serial_iov_t *iov,
+                                size_t iov_cnt);
+
+/**
+ * @brief Send a binary telemetry record (see chimera_proto.h)
+ *
+ * The traffic class is derived from the message type.
+ * @param type Message type (chimera_msg_type_t)
+ * @param version Schema version of the record body
+ * @param body Fixed-layout record body
+ * @param body_len Body length
+ * @param tail Optional variable-length field (may be NULL)
+ * @param tail_len Tail length
+ */
+void serial_send_record(uint8_t type, uint8_t version, const void *body,
+                        size_t body_len, const void *tail, size_t tail_len);
+
+/**
+ * @brief Configure record aggregation
+ *
+ * Small records are packed into one CHIMERA_MSG_BATCH frame that is sent
+ * when it reaches flush_bytes or when its oldest record has waited
+ * max_latency_us, whichever comes first. Any other message flushes the
+ * open batch first, so wire order is preserved.
+ *
+ * @param max_latency_us Latency bound (0 disables aggregation)
+ * @param flush_bytes Size threshold (clamped to the batch buffer)
+ */
+void serial_set_aggregation(uint32_t max_latency_us, size_t flush_bytes);
+
+/**
+ * @brief Snapshot aggregation counters
+ * @param stats Output structure
+ */
+void serial_get_agg_stats(serial_agg_stats_t *stats);
+
 /**
  * @brief Send raw bytes
  * @param data Byte array
  * @param len Length of data
- * @return void (thread-safe)
+ * @return void (thread-safe, never blocks; dropped if the TX ring is full)
  */
 void serial_send_raw(const uint8_t *data, size_t len);
 
@@ -89,6 +307,43 @@ void serial_printf(const char *format, ...);
  */
 void serial_set_cmd_handler(serial_cmd_handler_t handler);
 
+/**
+ * @brief Set binary command handler callback
+ *
+ * Called from the RX task. Argument data points into the RX buffer and is
+ * only valid for the duration of the call.
+ *
+ * @param handler Callback function for decoded binary commands
+ */
+void serial_set_bin_cmd_handler(serial_bin_handler_t handler);
+
+/**
+ * @brief Find the nth argument of a given type
+ * @param cmd Binary command
+ * @param type serial_arg_type_t to look for
+ * @param nth 0 for the first match
+ * @return Argument or NULL if absent
+ */
+const serial_arg_t *serial_bin_arg(const serial_bin_cmd_t *cmd, uint8_t type,
+                                   uint8_t nth);
+
+/**
+ * @brief Read an integer-typed argument (U32, I32 or CHAN_MASK)
+ * @return true if the argument was present and well formed
+ */
+bool serial_arg_u32(const serial_arg_t *arg, uint32_t *out);
+
+/**
+ * @brief Number of MACs in a MAC_LIST argument (0 if malformed)
+ */
+size_t serial_arg_mac_count(const serial_arg_t *arg);
+
+/**
+ * @brief Snapshot the RX pipeline counters
+ * @param stats Output structure
+ */
+void serial_get_rx_stats(serial_rx_stats_t *stats);
+
 /**
  * @brief Escape string for safe JSON inclusion
  * @param input Input string
@@ -99,10 +354,18 @@ void serial_set_cmd_handler(serial_cmd_handler_t handler);
 size_t serial_escape_json(const char *input, char *output, size_t max_len);
 
 /**
- * @brief Flush any pending TX data (ensure immediate send)
+ * @brief Flush any pending TX data
+ *
+ * Waits (bounded) until the TX ring has been handed to the driver.
  */
 void serial_flush(void);
 
+/**
+ * @brief Snapshot the TX pipeline counters
+ * @param stats Output structure
+ */
+void serial_get_tx_stats(serial_tx_stats_t *stats);
+
 /**
  * @brief Process pending serial data (no-op; RX is handled by dedicated task)
  */
@@ -0,0 +1,270 @@
+/**
+ * @file serial_log.c
+ * @brief ESP_LOG capture into framed LOG records
+ *
+ * The vprintf hook formats each log line once into a stack buffer, strips
+ * the colour codes, level letter and timestamp that the ESP_LOG format adds
+ * (they travel as record fields instead), and queues a CHIMERA_MSG_LOG
+ * record. A token bucket bounds the rate; anything logged while the hook is
+ * already running on the same task (e.g. a warning from the serial TX path)
+ * is dropped rather than recursing.
+ */
+#include "serial_log.h"
+
+#include "chimera_proto.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "serial_comm.h"
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+// ---------------- Configuration ----------------
+
+// Longest message kept (tag + text); longer lines are truncated
+#define LOG_LINE_MAX 192
+
+// Token bucket: sustained records per second and burst size
+#define LOG_RATE_PER_SEC 20
+#define LOG_BURST 40
+
+// ---------------- State ----------------
+
+static vprintf_like_t g_prev_vprintf = NULL;
+static volatile bool g_installed = false;
+
+// Set while this task is inside the hook
+static __thread bool s_in_hook = false;
+
+// Token bucket, in 1/1000 tokens. Guarded by g_bucket_lock.
+static int64_t g_bucket_us = 0;
+static uint32_t g_bucket_mtok = LOG_BURST * 1000;
+static uint32_t g_pending_suppressed = 0;
+static portMUX_TYPE g_bucket_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static atomic_uint_fast32_t g_sent = 0;
+static atomic_uint_fast32_t g_suppressed = 0;
+static atomic_uint_fast32_t g_truncated = 0;
+static atomic_uint_fast32_t g_recursive = 0;
+
+// ---------------- Helpers ----------------
+
+/**
+ * @brief Take one token
+ * @param suppressed_out Messages dropped since the last successful take
+ * @return false if the message is over the rate limit
+ */
+static bool bucket_take(uint16_t *suppressed_out) {
+  int64_t now = esp_timer_get_time();
+  bool ok = false;
+
+  portENTER_CRITICAL(&g_bucket_lock);
+  int64_t elapsed = now - g_bucket_us;
+  g_bucket_us = now;
+  // LOG_RATE_PER_SEC tokens per 1e6 us = LOG_RATE_PER_SEC mtok per 1000 us
+  int64_t refill = elapsed * LOG_RATE_PER_SEC / 1000;
+  if (refill > LOG_BURST * 1000 - (int64_t)g_bucket_mtok) {
+    g_bucket_mtok = LOG_BURST * 1000;
+  } else if (refill > 0) {
+    g_bucket_mtok += (uint32_t)refill;
+  }
+
+  if (g_bucket_mtok >= 1000) {
+    g_bucket_mtok -= 1000;
+    *suppressed_out = (g_pending_suppressed > UINT16_MAX)
+                          ? UINT16_MAX
+                          : (uint16_t)g_pending_suppressed;
+    g_pending_suppressed = 0;
+    ok = true;
+  } else {
+    g_pending_suppressed++;
+  }
+  portEXIT_CRITICAL(&g_bucket_lock);
+  return ok;
+}
+
+static uint8_t level_from_letter(char c) {
+  switch (c) {
+  case 'E':
+    return ESP_LOG_ERROR;
+  case 'W':
+    return ESP_LOG_WARN;
+  case 'I':
+    return ESP_LOG_INFO;
+  case 'D':
+    return ESP_LOG_DEBUG;
+  case 'V':
+    return ESP_LOG_VERBOSE;
+  default:
+    return ESP_LOG_NONE;
+  }
+}
+
+/**
+ * @brief Strip the ESP_LOG decoration from a formatted line
+ *
+ * "\033[0;32mI (1234) tag: text\033[0m\n" -> level I, "tag: text".
+ * Lines that do not follow the format are passed through whole.
+ *
+ * @return Start of the message inside line; *len is updated
+ */
+static const char *log_strip(const char *line, size_t *len, uint8_t *level) {
+  const char *p = line;
+  const char *end = line + *len;
+
+  // Trailing newline and colour reset
+  while (end > p && (end[-1] == '\n' || end[-1] == '\r')) {
+    end--;
+  }
+  if (end - p >= 4 && memcmp(end - 4, "\033[0m", 4) == 0) {
+    end -= 4;
+  }
+
+  // Leading colour code
+  if (end - p >= 2 && p[0] == '\033' && p[1] == '[') {
+    const char *m = memchr(p, 'm', (size_t)(end - p));
+    if (m)
+      p = m + 1;
+  }
+
+  *level = ESP_LOG_NONE;
+  if (end - p >= 4 && p[1] == ' ' && p[2] == '(') {
+    const char *close = memchr(p + 3, ')', (size_t)(end - p - 3));
+    uint8_t lvl = level_from_letter(p[0]);
+    if (close && lvl != ESP_LOG_NONE) {
+      *level = lvl;
+      p = close + 1;
+      if (p < end && *p == ' ')
+        p++;
+    }
+  }
+
+  *len = (size_t)(end - p);
+  return p;
+}
+
+// ---------------- Hook ----------------
+
+static int serial_log_vprintf(const char *fmt, va_list args) {
+  if (!serial_is_initialized()) {
+    return g_prev_vprintf ? g_prev_vprintf(fmt, args) : 0;
+  }
+  if (s_in_hook) {
+    atomic_fetch_add(&g_recursive, 1);
+    return 0;
+  }
+  s_in_hook = true;
+
+  char line[LOG_LINE_MAX + 32]; // Room for the decoration that is stripped
+  int n = vsnprintf(line, sizeof(line), fmt, args);
+  if (n <= 0) {
+    s_in_hook = false;
+    return n;
+  }
+
+  size_t len = ((size_t)n < sizeof(line)) ? (size_t)n : sizeof(line) - 1;
+  uint8_t level;
+  const char *text = log_strip(line, &len, &level);
+  if ((size_t)n >= sizeof(line) || len > LOG_LINE_MAX) {
+    atomic_fetch_add(&g_truncated, 1);
+    if (len > LOG_LINE_MAX)
+      len = LOG_LINE_MAX;
+  }
+
+  uint16_t suppressed;
+  if (len > 0 && bucket_take(&suppressed)) {
+    chimera_log_t rec = {
+        .timestamp_ms = esp_log_timestamp(),
+        .level = level,
+        .suppressed = suppressed,
+        .text_len = (uint8_t)len,
+    };
+    serial_send_record(CHIMERA_MSG_LOG, CHIMERA_LOG_VERSION, &rec, sizeof(rec),
+                       text, len);
+    atomic_fetch_add(&g_sent, 1);
+  } else if (len > 0) {
+    atomic_fetch_add(&g_suppressed, 1);
+  }
+
+  s_in_hook = false;
+  return n;
+}
+
+// ---------------- Public API ----------------
+
+esp_err_t serial_log_init(void) {
+  if (g_installed)
+    return ESP_OK;
+
+  g_bucket_us = esp_timer_get_time();
+  g_prev_vprintf = esp_log_set_vprintf(serial_log_vprintf);
+  g_installed = true;
+  return ESP_OK;
+}
+
+void serial_log_deinit(void) {
+  if (!g_installed)
+    return;
+
+  esp_log_set_vprintf(g_prev_vprintf ? g_prev_vprintf : vprintf);
+  g_installed = false;
+}
+
+esp_err_t serial_log_set_level(const char *tag, esp_log_level_t level) {
+  if (level > ESP_LOG_VERBOSE)
+    return ESP_ERR_INVALID_ARG;
+
+  esp_log_level_set((tag && *tag) ? tag : "*", level);
+  return ESP_OK;
+}
+
+bool serial_log_parse_level(const char *s, esp_log_level_t *out) {
+  static const struct {
+    const char *name;
+    esp_log_level_t level;
+  } names[] = {
+      {"none", ESP_LOG_NONE},   {"error", ESP_LOG_ERROR},
+      {"warn", ESP_LOG_WARN},   {"info", ESP_LOG_INFO},
+      {"debug", ESP_LOG_DEBUG}, {"verbose", ESP_LOG_VERBOSE},
+  };
+
+  if (!s || !*s)
+    return false;
+
+  if (isdigit((unsigned char)s[0]) && s[1] == '\0') {
+    if (s[0] - '0' > ESP_LOG_VERBOSE)
+      return false;
+    *out = (esp_log_level_t)(s[0] - '0');
+    return true;
+  }
+
+  if (s[1] == '\0') {
+    uint8_t lvl = level_from_letter((char)toupper((unsigned char)s[0]));
+    if (lvl == ESP_LOG_NONE && toupper((unsigned char)s[0]) != 'N')
+      return false;
+    *out = (esp_log_level_t)lvl;
+    return true;
+  }
+
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if (strcasecmp(s, names[i].name) == 0) {
+      *out = names[i].level;
+      return true;
+    }
+  }
+  return false;
+}
+
+void serial_log_get_stats(serial_log_stats_t *stats) {
+  if (!stats)
+    return;
+
+  stats->sent = atomic_load(&g_sent);
+  stats->suppressed = atomic_load(&g_suppressed);
+  stats->truncated = atomic_load(&g_truncated);
+  stats->recursive = atomic_load(&g_recursive);
+}
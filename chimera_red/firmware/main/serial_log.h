@@ -0,0 +1,63 @@
+/**
+ * @file serial_log.h
+ * @brief ESP_LOG capture into framed LOG records
+ *
+ * Replaces the log vprintf hook so ESP_LOGx output travels as
+ * CHIMERA_MSG_LOG records through the serial TX pipeline instead of being
+ * printed raw onto the same link as JSON lines and COBS frames. Output is
+ * rate limited; messages over the limit are counted and the count rides on
+ * the next record that gets through.
+ */
+#pragma once
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  uint32_t sent;       // Records queued
+  uint32_t suppressed; // Messages dropped by the rate limit
+  uint32_t truncated;  // Messages cut to the record size
+  uint32_t recursive;  // Messages logged from inside the log path (dropped)
+} serial_log_stats_t;
+
+/**
+ * @brief Start capturing ESP_LOG output
+ *
+ * Call after serial_init(). Until then (and whenever serial is down) log
+ * output goes to the previous vprintf hook.
+ */
+esp_err_t serial_log_init(void);
+
+/**
+ * @brief Restore the previous vprintf hook
+ */
+void serial_log_deinit(void);
+
+/**
+ * @brief Set the runtime log level
+ * @param tag Component tag, or NULL / "*" for every tag
+ * @param level ESP_LOG_NONE .. ESP_LOG_VERBOSE; levels above the compiled-in
+ * CONFIG_LOG_MAXIMUM_LEVEL have no effect
+ */
+esp_err_t serial_log_set_level(const char *tag, esp_log_level_t level);
+
+/**
+ * @brief Parse a level name ("warn", "I", "3", ...)
+ * @return true on success
+ */
+bool serial_log_parse_level(const char *s, esp_log_level_t *out);
+
+/**
+ * @brief Snapshot log capture counters
+ */
+void serial_log_get_stats(serial_log_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -334,7 +334,7 @@ esp_err_t cc1101_tx(const uint8_t *data, size_t len) {
 
   cc1101_idle();
 
-  ESP_LOGI(TAG, "TX %d bytes", len);
+  ESP_LOGD(TAG, "TX %d bytes", len);
   return ESP_OK;
 }
 
@@ -0,0 +1,180 @@
+/**
+ * @file survey.c
+ * @brief Per-channel airtime and utilization survey
+ */
+#include "survey.h"
+
+#include "chimera_proto.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "serial_comm.h"
+#include <stdatomic.h>
+#include <string.h>
+
+#define SURVEY_CHANNELS 14
+
+typedef struct {
+  uint32_t frames[3]; // mgmt, ctrl, data
+  uint32_t bytes;
+  uint32_t airtime_us;
+  uint32_t retries;
+  int32_t noise_acc;
+  uint32_t noise_samples;
+  uint16_t rssi_hist[CHIMERA_SURVEY_RSSI_BUCKETS];
+} survey_chan_t;
+
+// Two banks: the callback fills g_bank[g_active] while the worker reads and
+// clears the other. g_busy is set while the callback is inside a bank, so
+// the worker can tell when the bank it retired is no longer written.
+static survey_chan_t g_bank[2][SURVEY_CHANNELS];
+static atomic_int g_active = 0;
+static atomic_bool g_busy = false;
+
+static atomic_uint g_interval_ms = 0; // 0 = off
+static uint32_t g_last_ms = 0;        // Worker only
+static bool g_started = false;        // Worker only
+
+// ---------------- Airtime ----------------
+
+// Legacy rates (rx_ctrl.rate) in 500 kb/s units; 8 and up are OFDM
+static const uint8_t LEGACY_UNITS[16] = {
+    2,  4,  11, 22, 0,   4,  11, 22, // 1/2/5.5/11M long, -, 2/5.5/11M short
+    96, 48, 24, 12, 108, 72, 36, 18, // 48/24/12/6/54/36/18/9M OFDM
+};
+
+// HT data bits per symbol, one stream, MCS 0-7, 20 and 40 MHz
+static const uint16_t HT_NDBPS[2][8] = {
+    {26, 52, 78, 104, 156, 208, 234, 260},
+    {54, 108, 162, 216, 324, 432, 486, 540},
+};
+
+static uint32_t ceil_div(uint32_t a, uint32_t b) { return (a + b - 1) / b; }
+
+/**
+ * @brief Estimate the time a frame held the medium
+ *
+ * Preamble plus payload symbols; no interframe spacing or ACK. Long
+ * preamble is assumed for DSSS, HT-mixed format for HT. VHT/HE are
+ * estimated with the HT table (the 2.4 GHz radio does not see them).
+ */
+static uint32_t frame_airtime_us(const wifi_pkt_rx_ctrl_t *rx, uint32_t len) {
+  uint32_t bits = 16 + 8 * len + 6; // SERVICE + PSDU + tail
+
+  if (rx->sig_mode == 0) {
+    uint8_t idx = rx->rate & 0x0F;
+    uint32_t units = LEGACY_UNITS[idx];
+    if (units == 0) {
+      return 0;
+    }
+    if (idx < 8) {
+      return 192 + ceil_div(8 * len * 2, units); // DSSS/CCK
+    }
+    return 20 + 4 * ceil_div(bits, units * 2); // OFDM: NDBPS = 4 x Mb/s
+  }
+
+  uint32_t streams = (rx->mcs >> 3) + 1;
+  uint32_t ndbps = HT_NDBPS[rx->cwb ? 1 : 0][rx->mcs & 7] * streams;
+  uint32_t symbols = ceil_div(bits, ndbps);
+  // HT-mixed preamble: legacy 20 us + HT-SIG 8 + HT-STF 4 + HT-LTF 4/stream
+  return 32 + 4 * streams + (symbols * (rx->sgi ? 36 : 40) + 9) / 10;
+}
+
+// ---------------- Accounting ----------------
+
+esp_err_t survey_set_interval(uint32_t interval_ms) {
+  if (interval_ms && (interval_ms < SURVEY_INTERVAL_MIN_MS ||
+                      interval_ms > SURVEY_INTERVAL_MAX_MS)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (interval_ms && !atomic_load(&g_interval_ms)) {
+    // Not being written while off; start from clean banks
+    memset(g_bank, 0, sizeof(g_bank));
+  }
+  atomic_store(&g_interval_ms, interval_ms);
+  return ESP_OK;
+}
+
+bool survey_enabled(void) { return atomic_load(&g_interval_ms) != 0; }
+
+void survey_frame(const wifi_promiscuous_pkt_t *pkt,
+                  wifi_promiscuous_pkt_type_t type) {
+  const wifi_pkt_rx_ctrl_t *rx = &pkt->rx_ctrl;
+  if (!atomic_load(&g_interval_ms) || rx->channel >= SURVEY_CHANNELS) {
+    return;
+  }
+
+  atomic_store(&g_busy, true);
+  survey_chan_t *c = &g_bank[atomic_load(&g_active)][rx->channel];
+
+  uint32_t len = rx->sig_len;
+  if (type <= WIFI_PKT_DATA) {
+    c->frames[type]++; // MGMT, CTRL, DATA
+  }
+  c->bytes += len;
+  c->airtime_us += frame_airtime_us(rx, len);
+  if (len >= 2 && (pkt->payload[1] & 0x08)) {
+    c->retries++;
+  }
+  c->noise_acc += rx->noise_floor;
+  c->noise_samples++;
+
+  int bucket = ((int)rx->rssi + 100) / 10;
+  if (bucket < 0) {
+    bucket = 0;
+  } else if (bucket >= CHIMERA_SURVEY_RSSI_BUCKETS) {
+    bucket = CHIMERA_SURVEY_RSSI_BUCKETS - 1;
+  }
+  if (c->rssi_hist[bucket] != UINT16_MAX) {
+    c->rssi_hist[bucket]++;
+  }
+
+  atomic_store(&g_busy, false);
+}
+
+void survey_report(uint32_t now_ms) {
+  uint32_t interval = atomic_load(&g_interval_ms);
+  if (!interval) {
+    g_started = false;
+    return;
+  }
+  if (!g_started) {
+    g_started = true;
+    g_last_ms = now_ms;
+    return;
+  }
+  uint32_t elapsed = now_ms - g_last_ms;
+  if (elapsed < interval) {
+    return;
+  }
+  g_last_ms = now_ms;
+
+  // Retire the bank the callback has been filling
+  int bank = atomic_load(&g_active);
+  atomic_store(&g_active, bank ^ 1);
+  while (atomic_load(&g_busy)) {
+    taskYIELD();
+  }
+
+  for (int ch = 1; ch < SURVEY_CHANNELS; ch++) {
+    survey_chan_t *c = &g_bank[bank][ch];
+    if (!c->noise_samples) {
+      continue;
+    }
+
+    chimera_survey_t rec = {
+        .channel = (uint8_t)ch,
+        .noise_floor = (int8_t)(c->noise_acc / (int32_t)c->noise_samples),
+        .interval_ms = (uint16_t)(elapsed > UINT16_MAX ? UINT16_MAX : elapsed),
+        .mgmt = c->frames[WIFI_PKT_MGMT],
+        .ctrl = c->frames[WIFI_PKT_CTRL],
+        .data = c->frames[WIFI_PKT_DATA],
+        .bytes = c->bytes,
+        .airtime_us = c->airtime_us,
+        .retries = c->retries,
+    };
+    memcpy(rec.rssi_hist, c->rssi_hist, sizeof(rec.rssi_hist));
+    serial_send_record(CHIMERA_MSG_SURVEY, CHIMERA_SURVEY_VERSION, &rec,
+                       sizeof(rec), NULL, 0);
+    memset(c, 0, sizeof(*c));
+  }
+}
@@ -0,0 +1,56 @@
+/**
+ * @file survey.h
+ * @brief Per-channel airtime and utilization survey
+ *
+ * While enabled, every frame the radio hands to the promiscuous callback is
+ * accounted to its channel: frames by type, bytes, airtime estimated from
+ * the PHY rate and length, retries, a 10 dB RSSI histogram and the noise
+ * floor reported by rx_ctrl. Only aggregate counters are kept, so frames
+ * are counted before the scope and filter checks. Every interval the
+ * counters are sent as one fixed-size SURVEY record per channel that heard
+ * anything, then cleared.
+ *
+ * Counters are written by the WiFi driver task only; the packet worker
+ * swaps between two banks to read a consistent interval.
+ */
+#pragma once
+
+#include "esp_err.h"
+#include "esp_wifi.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SURVEY_INTERVAL_MIN_MS 100
+#define SURVEY_INTERVAL_MAX_MS 60000
+
+/**
+ * @brief Start, retime or stop the survey
+ * @param interval_ms Snapshot interval, 0 to stop
+ * @return ESP_OK, ESP_ERR_INVALID_ARG outside
+ *         [SURVEY_INTERVAL_MIN_MS, SURVEY_INTERVAL_MAX_MS]
+ */
+esp_err_t survey_set_interval(uint32_t interval_ms);
+
+/**
+ * @brief Check whether the survey is running
+ */
+bool survey_enabled(void);
+
+/**
+ * @brief Account one received frame (WiFi RX callback)
+ */
+void survey_frame(const wifi_promiscuous_pkt_t *pkt,
+                  wifi_promiscuous_pkt_type_t type);
+
+/**
+ * @brief Send the snapshot when due (packet worker)
+ */
+void survey_report(uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -5,21 +5,32 @@
  * Fixes in v2.2:
  * - Thread-safe statistics with atomic operations
  * - Fixed address extraction for all ToDS/FromDS combinations
- * - Capped scan results to prevent memory exhaustion
+ * - Scan results streamed per channel in fixed chunks, never all held
  * - Better NULL checks and bounds validation
  * - Fixed race condition in sniffer stop
  * - Proper EAPOL frame capture with length validation
  */
 #include "wifi_manager.h"
+#include "ap_table.h"
+#include "chimera_proto.h"
+#include "csi.h"
 #include "esp_event.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
 #include "esp_netif.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "freertos/task.h"
+#include "hop_sched.h"
+#include "hs_table.h"
 #include "nvs_flash.h"
+#include "pcap_store.h"
+#include "pkt_dispatch.h"
+#include "probe_table.h"
+#include "scope.h"
 #include "serial_comm.h"
+#include "survey.h"
 #include <rom/ets_sys.h>
 #include <stdatomic.h>
 #include <stdio.h>
@@ -35,7 +46,7 @@ int ieee80211_raw_frame_sanity_check(int32_t arg, int32_t arg2, int32_t arg3) {
 }
 
 // Global state
-static wifi_sniffer_cb_t g_sniffer_cb = NULL;
+static wifi_sniffer_cb_t g_sniffer_cb = NULL; // See sniffer_cb_frame()
 static wifi_handshake_cb_t g_handshake_cb = NULL;
 static volatile bool g_promiscuous_active = false;
 static volatile bool g_channel_hopping = false;
@@ -45,38 +56,76 @@ static uint8_t g_current_channel = 1;
 static uint16_t g_deauth_seq = 0;
 static TaskHandle_t g_hopper_task = NULL;
 static SemaphoreHandle_t g_wifi_mutex = NULL;
-static SemaphoreHandle_t g_cache_mutex = NULL;
-
-// Static buffers to prevent heap fragmentation
-static char s_scan_json_buf[16384];
+static SemaphoreHandle_t g_scan_lock = NULL; // See scan_event_handler()
+static esp_event_handler_instance_t g_scan_handler = NULL;
+static bool g_driver_up = false; // See radio_driver_up()
+static bool g_csi_on = false;
+static wifi_radio_mode_t g_radio_mode = WIFI_RADIO_IDLE;
+static wifi_radio_stats_t g_radio_stats;
 
 // Statistics (atomic for thread safety)
-static atomic_uint_fast32_t g_m1_count = 0;
-static atomic_uint_fast32_t g_m2_count = 0;
-static atomic_uint_fast32_t g_complete_count = 0;
 static atomic_uint_fast32_t g_pkt_count = 0;
 
-// Smart Hopping Sequence (favors 1, 6, 11)
-static const uint8_t hop_channels[] = {1, 1, 1, 2,  3,  4,  5,  6,  6, 6,
-                                       7, 8, 9, 10, 11, 11, 11, 12, 13};
-static int g_hop_index = 0;
+// ---------------- Packet ring ----------------
+//
+// promisc_rx_cb runs in the WiFi driver task and must not block, so it only
+// copies each wanted frame into the next free slot of a preallocated ring;
+// the packet worker parses frames and talks to serial. One producer (the
+// driver task) and one consumer (the worker), so head/tail need no lock.
 
-// Handshake cache
-#define HANDSHAKE_CACHE_SIZE 16
-#define CACHE_TIMEOUT_MS 10000
+#define PKT_SLOTS 64      // Power of two
+#define PKT_SNAPLEN 1600  // Longer frames are truncated
+#define PKT_WORKER_STACK 4096
+#define PKT_WORKER_PRIO 5
+#define PKT_WORKER_CORE 1 // WiFi driver task runs on core 0
 
 typedef struct {
-  uint8_t bssid[6];
-  uint8_t sta[6];
-  uint8_t anonce[32];
-  uint8_t replay_counter[8];
-  uint8_t key_desc_type;
-  uint8_t key_desc_version;
-  uint32_t last_seen;
-  bool valid;
-} handshake_cache_entry_t;
-
-static handshake_cache_entry_t g_handshake_cache[HANDSHAKE_CACHE_SIZE];
+  uint16_t orig_len; // Length on air (rx_ctrl.sig_len before clamping)
+  uint8_t type;      // wifi_promiscuous_pkt_type_t
+  bool raw;          // Sampled for raw streaming
+  // Laid out as wifi_promiscuous_pkt_t; rx_ctrl.sig_len is the copied length
+  wifi_pkt_rx_ctrl_t rx_ctrl;
+  uint8_t payload[PKT_SNAPLEN];
+} pkt_slot_t;
+
+static pkt_slot_t *g_pkt_slots = NULL;
+static atomic_uint g_pkt_head = 0; // Written by the driver task
+static atomic_uint g_pkt_tail = 0; // Written by the worker
+static TaskHandle_t g_pkt_task = NULL;
+static volatile bool g_pkt_worker_run = false;
+
+static atomic_uint_fast32_t g_pkt_queued = 0;
+static atomic_uint_fast32_t g_pkt_processed = 0;
+static atomic_uint_fast32_t g_pkt_drop_full = 0;
+static atomic_uint_fast32_t g_pkt_filtered = 0;
+static atomic_uint_fast32_t g_pkt_truncated = 0;
+static atomic_uint_fast32_t g_raw_sent = 0;
+
+// Raw streaming: every g_raw_every-th frame, first g_raw_snaplen bytes
+// (0 = off). g_raw_tick is only touched by the driver task.
+static volatile uint16_t g_raw_snaplen = 0;
+static volatile uint16_t g_raw_every = 1;
+static uint16_t g_raw_tick = 0;
+
+// User filter program, run first in the callback. Two slots so a new
+// program can be written while the callback may still be running the old
+// one; wifi_set_filter() waits for g_filter_busy to clear before a slot is
+// reused. Set from the command task only.
+static pkt_filter_t g_filter_slot[2];
+static _Atomic(const pkt_filter_t *) g_filter = NULL;
+static atomic_bool g_filter_busy = false;
+static atomic_uint_fast32_t g_filter_rejected = 0;
+
+// RSSI accumulated by the callback for the pulse record
+static atomic_int g_rssi_acc = 0;
+static atomic_int g_rssi_samples = 0;
+
+// Channel hopping: hop_sched.h plans the dwell on each channel; an
+// esp_timer marks the end of each dwell and wakes the hopper task, which
+// switches the channel (a blocking driver call) and arms the next one.
+#define HOPPER_STACK 3072
+#define HOPPER_PRIO 6 // Above the packet worker: hop timing is the point
+static esp_timer_handle_t g_hop_timer = NULL;
 
 // EAPOL constants
 #define EAPOL_KEY_DESC_TYPE_OFFSET 0
@@ -97,8 +146,17 @@ static const uint8_t LLC_SNAP_EAPOL[] = {0xAA, 0xAA, 0x03, 0x00,
 // Forward declarations
 static void promisc_rx_cb(void *buf, wifi_promiscuous_pkt_type_t type);
 static void channel_hopper_task(void *arg);
-static void process_eapol(const uint8_t *payload, int len, int header_len,
-                          const wifi_pkt_rx_ctrl_t *rx_ctrl);
+static void scan_event_handler(void *arg, esp_event_base_t base, int32_t id,
+                               void *data);
+static void scan_cancel(void);
+static esp_err_t radio_enter(wifi_radio_mode_t mode, uint8_t channel);
+static esp_err_t pkt_worker_start(void);
+static void pkt_worker_stop(void);
+static void process_eapol(const pkt_frame_t *frame);
+static void probe_frame(const pkt_frame_t *frame, void *ctx);
+static void recon_frame(const pkt_frame_t *frame, void *ctx);
+static void eapol_frame(const pkt_frame_t *frame, void *ctx);
+static void sniffer_cb_frame(const pkt_frame_t *frame, void *ctx);
 
 /**
  * @brief Get milliseconds since boot
@@ -219,204 +277,390 @@ esp_err_t wifi_manager_init(void) {
   cfg.rx_ba_win = 16;
   ESP_ERROR_CHECK(esp_wifi_init(&cfg));
   ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+  ESP_ERROR_CHECK(esp_event_handler_instance_register(
+      WIFI_EVENT, WIFI_EVENT_SCAN_DONE, scan_event_handler, NULL,
+      &g_scan_handler));
 
   g_wifi_mutex = xSemaphoreCreateMutex();
-  if (g_wifi_mutex == NULL) {
+  g_scan_lock = xSemaphoreCreateMutex();
+  if (g_wifi_mutex == NULL || g_scan_lock == NULL) {
     ESP_LOGE(TAG, "Failed to create WiFi mutex");
+    if (g_wifi_mutex) {
+      vSemaphoreDelete(g_wifi_mutex);
+      g_wifi_mutex = NULL;
+    }
+    if (g_scan_lock) {
+      vSemaphoreDelete(g_scan_lock);
+      g_scan_lock = NULL;
+    }
     return ESP_FAIL;
   }
 
-  g_cache_mutex = xSemaphoreCreateMutex();
-  if (g_cache_mutex == NULL) {
+  if (hs_table_init() != ESP_OK) {
     vSemaphoreDelete(g_wifi_mutex);
     g_wifi_mutex = NULL;
-    ESP_LOGE(TAG, "Failed to create cache mutex");
-    return ESP_FAIL;
+    vSemaphoreDelete(g_scan_lock);
+    g_scan_lock = NULL;
+    return ESP_ERR_NO_MEM;
   }
 
   wifi_clear_handshake_cache();
+  // Always on; recon and raw callbacks subscribe while enabled
+  pkt_dispatch_subscribe(PKT_FRAME_PROBE_REQ, probe_frame, NULL);
+  pkt_dispatch_subscribe(PKT_FRAME_EAPOL, eapol_frame, NULL);
   ESP_LOGI(TAG, "WiFi Manager initialized successfully");
   return ESP_OK;
 }
 
 void wifi_manager_deinit(void) {
   wifi_sniffer_stop();
+  if (g_wifi_mutex) {
+    xSemaphoreTake(g_wifi_mutex, portMAX_DELAY);
+    scan_cancel();
+    xSemaphoreGive(g_wifi_mutex);
+  }
+  if (g_scan_handler) {
+    esp_event_handler_instance_unregister(WIFI_EVENT, WIFI_EVENT_SCAN_DONE,
+                                          g_scan_handler);
+    g_scan_handler = NULL;
+  }
   esp_wifi_stop();
+  g_driver_up = false;
+  g_csi_on = false;
+  g_radio_mode = WIFI_RADIO_IDLE;
   esp_wifi_deinit();
+  // No more RX callbacks once the driver is gone
+  pkt_worker_stop();
+  csi_deinit();
+  pkt_dispatch_unsubscribe(probe_frame, NULL);
+  pkt_dispatch_unsubscribe(eapol_frame, NULL);
 
   if (g_wifi_mutex) {
     vSemaphoreDelete(g_wifi_mutex);
     g_wifi_mutex = NULL;
   }
-  if (g_cache_mutex) {
-    vSemaphoreDelete(g_cache_mutex);
-    g_cache_mutex = NULL;
+  if (g_scan_lock) {
+    vSemaphoreDelete(g_scan_lock);
+    g_scan_lock = NULL;
   }
+  hs_table_deinit();
 }
 
-void wifi_clear_handshake_cache(void) {
-  if (g_cache_mutex) {
-    xSemaphoreTake(g_cache_mutex, portMAX_DELAY);
-  }
-  memset(g_handshake_cache, 0, sizeof(g_handshake_cache));
-  if (g_cache_mutex) {
-    xSemaphoreGive(g_cache_mutex);
-  }
-  atomic_store(&g_m1_count, 0);
-  atomic_store(&g_m2_count, 0);
-  atomic_store(&g_complete_count, 0);
-}
+void wifi_clear_handshake_cache(void) { hs_table_reset(); }
 
 void wifi_get_handshake_stats(uint32_t *m1_count, uint32_t *m2_count,
                               uint32_t *complete_count) {
+  hs_table_stats_t st;
+  hs_table_get_stats(&st);
   if (m1_count)
-    *m1_count = atomic_load(&g_m1_count);
+    *m1_count = st.m1;
   if (m2_count)
-    *m2_count = atomic_load(&g_m2_count);
+    *m2_count = st.m2;
   if (complete_count)
-    *complete_count = atomic_load(&g_complete_count);
+    *complete_count = st.paired;
 }
 
-esp_err_t wifi_scan_start(wifi_scan_cb_t callback) {
-  if (!g_wifi_mutex) {
-    return ESP_ERR_INVALID_STATE;
-  }
-
-  xSemaphoreTake(g_wifi_mutex, portMAX_DELAY);
-
-  if (g_promiscuous_active) {
-    esp_wifi_set_promiscuous(false);
-    g_promiscuous_active = false;
-  }
-
-  esp_wifi_stop();
-  ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-  ESP_ERROR_CHECK(esp_wifi_start());
-
+// ---------------- Scan ----------------
+//
+// The scan runs one channel at a time without blocking anyone: each
+// channel's SCAN_DONE event (event loop task) pops that channel's results
+// SCAN_CHUNK records at a time, streams them, and starts the next channel.
+// g_scan_channel is the channel being scanned (0 = idle); whoever swaps it
+// to 0 sends the WIFI_SCAN_DONE record, so a cancel racing the event
+// handler terminates the scan exactly once. Changing it and starting or
+// stopping the driver's scan happen together under g_scan_lock, which is
+// held only around those calls so the event task never waits on the
+// WiFi mutex.
+//
+// The driver posts one SCAN_DONE for every scan started, including one
+// that was stopped (scan_cancel) or overridden by a newer start. Those
+// stale events are still queued when the next scan is running, so
+// g_scan_pending counts the scans started here whose event has not been
+// handled; only the event that brings it to zero belongs to the channel
+// now being scanned.
+
+#define SCAN_CHUNK 8
+#define SCAN_LAST_CHANNEL 13
+
+static wifi_scan_cb_t g_scan_cb = NULL;
+static atomic_uint g_scan_channel = 0;
+static atomic_uint g_scan_reported = 0; // WIFI_AP records sent this scan
+static atomic_uint g_scan_pending = 0;  // SCAN_DONE events still to come
+
+// g_scan_lock held
+static esp_err_t scan_channel_start(uint8_t channel) {
   wifi_scan_config_t scan_config = {
       .ssid = NULL,
       .bssid = NULL,
-      .channel = 0,
+      .channel = channel,
       .show_hidden = true,
       .scan_type = WIFI_SCAN_TYPE_ACTIVE,
       .scan_time.active.min = 120,
       .scan_time.active.max = 350,
   };
+  esp_err_t ret = esp_wifi_scan_start(&scan_config, false);
+  if (ret == ESP_OK) {
+    atomic_fetch_add(&g_scan_pending, 1);
+  }
+  return ret;
+}
 
-  esp_err_t ret = esp_wifi_scan_start(&scan_config, true);
-  if (ret != ESP_OK) {
-    ESP_LOGE(TAG, "Scan start failed: %d", ret);
-    xSemaphoreGive(g_wifi_mutex);
-    return ret;
+static void scan_emit(const wifi_ap_record_t *ap) {
+  if (!scope_addr_allowed(ap->bssid) &&
+      !scope_ssid_allowed(ap->ssid, strnlen((const char *)ap->ssid, 32))) {
+    scope_note_hidden();
+    return;
   }
 
-  uint16_t ap_count = 0;
-  esp_wifi_scan_get_ap_num(&ap_count);
+  wifi_scan_result_t result = {0};
+  strncpy(result.ssid, (const char *)ap->ssid, 32);
+  result.ssid[32] = '\0';
+  memcpy(result.bssid, ap->bssid, 6);
+  result.channel = ap->primary;
+  result.rssi = ap->rssi;
+  result.authmode = ap->authmode;
+
+  wifi_scan_cb_t cb = g_scan_cb;
+  if (cb) {
+    cb(&result);
+  }
+
+  chimera_wifi_ap_t rec = {
+      .channel = result.channel,
+      .rssi = result.rssi,
+      .authmode = (uint8_t)result.authmode,
+      .ssid_len = (uint8_t)strlen(result.ssid),
+  };
+  memcpy(rec.bssid, result.bssid, 6);
+  serial_send_record(CHIMERA_MSG_WIFI_AP, CHIMERA_WIFI_AP_VERSION, &rec,
+                     sizeof(rec), result.ssid, rec.ssid_len);
+  atomic_fetch_add(&g_scan_reported, 1);
+}
 
-  // Cap results to prevent memory exhaustion
-  if (ap_count > MAX_SCAN_RESULTS) {
-    ap_count = MAX_SCAN_RESULTS;
+/**
+ * @brief Stream every result of the channel just scanned
+ */
+static void scan_drain(void) {
+  static wifi_ap_record_t chunk[SCAN_CHUNK]; // Off the event task's stack
+  for (;;) {
+    int n = 0;
+    while (n < SCAN_CHUNK && esp_wifi_scan_get_ap_record(&chunk[n]) == ESP_OK) {
+      n++;
+    }
+    for (int i = 0; i < n; i++) {
+      scan_emit(&chunk[i]);
+    }
+    if (n < SCAN_CHUNK) {
+      break;
+    }
   }
+  esp_wifi_clear_ap_list();
+}
 
-  if (ap_count > 0) {
-    wifi_ap_record_t *ap_list = malloc(sizeof(wifi_ap_record_t) * ap_count);
-    if (ap_list) {
-      uint16_t actual_count = ap_count;
-      esp_wifi_scan_get_ap_records(&actual_count, ap_list);
+static void scan_send_done(void) {
+  uint32_t reported = atomic_load(&g_scan_reported);
+  // Always terminate the scan so the host can tell "no networks" from loss
+  chimera_wifi_scan_done_t done = {
+      .count = (uint16_t)(reported > UINT16_MAX ? UINT16_MAX : reported),
+  };
+  serial_send_record(CHIMERA_MSG_WIFI_SCAN_DONE, CHIMERA_WIFI_SCAN_DONE_VERSION,
+                     &done, sizeof(done), NULL, 0);
+  ESP_LOGI(TAG, "Scan complete: %lu APs", (unsigned long)reported);
+}
 
-      // Use static buffer instead of malloc to prevent heap fragmentation
-      char *json_buf = s_scan_json_buf;
+static void scan_event_handler(void *arg, esp_event_base_t base, int32_t id,
+                               void *data) {
+  unsigned pending = atomic_load(&g_scan_pending);
+  do {
+    if (pending == 0) {
+      return; // A scan this module did not start
+    }
+  } while (!atomic_compare_exchange_weak(&g_scan_pending, &pending,
+                                         pending - 1));
+  if (pending > 1) {
+    return; // A stopped or overridden scan; a newer one is running
+  }
 
-      // Clear buffer reuse
-      json_buf[0] = '\0';
+  unsigned channel = atomic_load(&g_scan_channel);
+  if (channel == 0) {
+    return; // Cancelled, or a scan this module did not start
+  }
 
-      int pos = snprintf(json_buf, 16384,
-                         "{\"type\":\"wifi_scan_result\",\"count\":%d,"
-                         "\"networks\":[",
-                         actual_count);
+  scan_drain();
+
+  if (channel < SCAN_LAST_CHANNEL) {
+    unsigned next = channel + 1;
+    // A cancel between the swap and the start would leave the channel
+    // scanning after its WIFI_SCAN_DONE
+    xSemaphoreTake(g_scan_lock, portMAX_DELAY);
+    bool ours = atomic_compare_exchange_strong(&g_scan_channel, &channel, next);
+    esp_err_t err = ours ? scan_channel_start((uint8_t)next) : ESP_OK;
+    xSemaphoreGive(g_scan_lock);
+    if (!ours || err == ESP_OK) {
+      return; // Cancelled while draining, or scanning the next channel
+    }
+    ESP_LOGW(TAG, "Scan of channel %u failed to start", next);
+    channel = next;
+  }
 
-      for (int i = 0; i < actual_count && pos < 15800; i++) {
-        wifi_scan_result_t result = {0};
-        strncpy(result.ssid, (char *)ap_list[i].ssid, 32);
-        result.ssid[32] = '\0';
-        memcpy(result.bssid, ap_list[i].bssid, 6);
-        result.channel = ap_list[i].primary;
-        result.rssi = ap_list[i].rssi;
-        result.authmode = ap_list[i].authmode;
+  if (atomic_compare_exchange_strong(&g_scan_channel, &channel, 0)) {
+    scan_send_done();
+  }
+}
 
-        if (callback) {
-          callback(&result);
-        }
+/**
+ * @brief Stop a running scan (WiFi mutex held)
+ */
+static void scan_cancel(void) {
+  xSemaphoreTake(g_scan_lock, portMAX_DELAY);
+  bool running = atomic_exchange(&g_scan_channel, 0) != 0;
+  if (running) {
+    esp_wifi_scan_stop();
+    esp_wifi_clear_ap_list();
+  }
+  xSemaphoreGive(g_scan_lock);
+  if (running) {
+    scan_send_done();
+  }
+}
 
-        char bssid_str[18];
-        snprintf(bssid_str, sizeof(bssid_str), "%02X:%02X:%02X:%02X:%02X:%02X",
-                 result.bssid[0], result.bssid[1], result.bssid[2],
-                 result.bssid[3], result.bssid[4], result.bssid[5]);
+esp_err_t wifi_scan_start(wifi_scan_cb_t callback) {
+  if (!g_wifi_mutex) {
+    return ESP_ERR_INVALID_STATE;
+  }
 
-        char escaped_ssid[65];
-        serial_escape_json(result.ssid, escaped_ssid, sizeof(escaped_ssid));
+  xSemaphoreTake(g_wifi_mutex, portMAX_DELAY);
 
-        pos += snprintf(json_buf + pos, 16384 - pos,
-                        "{\"ssid\":\"%s\",\"bssid\":\"%s\",\"rssi\":%d,"
-                        "\"channel\":%d,\"encryption\":%d}%s",
-                        escaped_ssid, bssid_str, result.rssi, result.channel,
-                        result.authmode, (i < actual_count - 1) ? "," : "");
-      }
+  radio_enter(WIFI_RADIO_SCAN, 0);
 
-      if (pos < 16382) {
-        strcat(json_buf, "]}");
-      }
-      serial_send_json_raw(json_buf);
-      // No free(json_buf) needed for static buffer
+  g_scan_cb = callback;
+  atomic_store(&g_scan_reported, 0);
+  xSemaphoreTake(g_scan_lock, portMAX_DELAY);
+  atomic_store(&g_scan_channel, 1);
+  esp_err_t ret = scan_channel_start(1);
+  if (ret != ESP_OK) {
+    atomic_store(&g_scan_channel, 0);
+  }
+  xSemaphoreGive(g_scan_lock);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "Scan start failed: %d", ret);
+  }
 
-      free(ap_list);
-    }
+  xSemaphoreGive(g_wifi_mutex);
+  return ret;
+}
+
+esp_err_t wifi_scan_stop(void) {
+  if (!g_wifi_mutex) {
+    return ESP_ERR_INVALID_STATE;
   }
 
+  xSemaphoreTake(g_wifi_mutex, portMAX_DELAY);
+  scan_cancel();
   xSemaphoreGive(g_wifi_mutex);
   return ESP_OK;
 }
 
+static void hop_timer_cb(void *arg) {
+  TaskHandle_t task = g_hopper_task;
+  if (task) {
+    xTaskNotifyGive(task);
+  }
+}
+
 static void channel_hopper_task(void *arg) {
   g_hopper_running = true;
 
+  if (!g_hop_timer) {
+    const esp_timer_create_args_t args = {
+        .callback = hop_timer_cb,
+        .name = "ch_hop",
+    };
+    if (esp_timer_create(&args, &g_hop_timer) != ESP_OK) {
+      ESP_LOGE(TAG, "Failed to create hop timer");
+      g_channel_hopping = false;
+    }
+  }
+
+  hop_sched_reset();
+  int64_t due = esp_timer_get_time();
   while (g_channel_hopping) {
-    g_hop_index =
-        (g_hop_index + 1) % (sizeof(hop_channels) / sizeof(hop_channels[0]));
-    g_current_channel = hop_channels[g_hop_index];
-    esp_wifi_set_channel(g_current_channel, WIFI_SECOND_CHAN_NONE);
-    vTaskDelay(pdMS_TO_TICKS(250));
+    uint8_t channel;
+    uint32_t dwell_ms = hop_sched_next(esp_timer_get_time(), &channel);
+    g_current_channel = channel;
+    esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+    int64_t now = esp_timer_get_time();
+    hop_sched_switched(due, now);
+
+    // Deadlines are absolute so switch time does not stretch the round
+    due += (int64_t)dwell_ms * 1000;
+    if (due - now < 1000) {
+      due = now + 1000;
+    }
+    esp_timer_start_once(g_hop_timer, (uint64_t)(due - now));
+
+    // Short timeout: a stop request is noticed without a wakeup
+    while (g_channel_hopping && !ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(50))) {
+    }
   }
 
+  if (g_hop_timer) {
+    esp_timer_stop(g_hop_timer);
+  }
   g_hopper_running = false;
   g_hopper_task = NULL;
   vTaskDelete(NULL);
 }
 
-esp_err_t wifi_sniffer_start(uint8_t channel) {
-  if (!g_wifi_mutex) {
-    return ESP_ERR_INVALID_STATE;
+/**
+ * @brief Frame types handed to the promiscuous callback
+ */
+static uint32_t promisc_filter_mask(void) {
+  uint32_t mask = WIFI_PROMIS_FILTER_MASK_MGMT | WIFI_PROMIS_FILTER_MASK_DATA;
+  if (survey_enabled()) {
+    mask |= WIFI_PROMIS_FILTER_MASK_CTRL; // ACK/RTS/CTS airtime
   }
+  return mask;
+}
 
-  xSemaphoreTake(g_wifi_mutex, portMAX_DELAY);
+// ---------------- Radio mode ----------------
+//
+// The driver is started once, in APSTA mode, and then left running: the STA
+// interface scans and the hidden AP interface carries injected frames. A
+// mode change only toggles what runs on top of it (the scan, promiscuous
+// RX, CSI), which costs a few milliseconds where a driver restart cost
+// hundreds. Transitions run with the WiFi mutex held.
 
-  ESP_LOGI(TAG, "Starting sniffer on channel %d (0=hopping)", channel);
+static const char *const RADIO_MODE_NAMES[] = {"idle", "scan", "monitor",
+                                               "monitor_csi"};
+CHIMERA_STATIC_ASSERT(WIFI_RADIO_MONITOR_CSI == CHIMERA_RADIO_MONITOR_CSI,
+                      "RADIO_MODE records carry wifi_radio_mode_t values");
 
-  // Stop any existing hopper
-  g_channel_hopping = false;
-  while (g_hopper_running) {
-    vTaskDelay(pdMS_TO_TICKS(10));
+/**
+ * @brief Current mode; a scan that has run to completion is idle
+ */
+static wifi_radio_mode_t radio_mode_now(void) {
+  if (g_radio_mode == WIFI_RADIO_SCAN && atomic_load(&g_scan_channel) == 0) {
+    return WIFI_RADIO_IDLE;
   }
+  return g_radio_mode;
+}
 
-  esp_wifi_stop();
-  ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
+/**
+ * @brief Start the driver with the monitor AP, once
+ */
+static void radio_driver_up(void) {
+  if (g_driver_up) {
+    return;
+  }
 
+  ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
   wifi_config_t ap_config = {
       .ap = {
           .ssid = "chimera_red_mon",
           .ssid_len = 15,
           .password = "security",
-          .channel = (channel > 0 && channel <= 13) ? channel : 1,
+          .channel = g_current_channel,
           .authmode = WIFI_AUTH_WPA2_PSK,
           .ssid_hidden = 1,
           .max_connection = 0,
@@ -426,58 +670,219 @@ esp_err_t wifi_sniffer_start(uint8_t channel) {
   ESP_ERROR_CHECK(esp_wifi_start());
   ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_NONE));
 
-  g_current_channel = (channel > 0 && channel <= 13) ? channel : 1;
-  ESP_ERROR_CHECK(
-      esp_wifi_set_channel(g_current_channel, WIFI_SECOND_CHAN_NONE));
+  g_driver_up = true;
+  g_radio_stats.driver_starts++;
+}
 
-  wifi_promiscuous_filter_t filter = {.filter_mask =
-                                          WIFI_PROMIS_FILTER_MASK_MGMT |
-                                          WIFI_PROMIS_FILTER_MASK_DATA};
+static void hopper_stop(void) {
+  g_channel_hopping = false;
+  TaskHandle_t task = g_hopper_task;
+  if (task) {
+    xTaskNotifyGive(task); // Don't wait out the dwell
+  }
+  int timeout = 500; // 500ms max wait
+  while (g_hopper_running && timeout > 0) {
+    vTaskDelay(1);
+    timeout -= portTICK_PERIOD_MS;
+  }
+}
+
+static esp_err_t csi_set(bool enable) {
+  if (enable == g_csi_on) {
+    return ESP_OK;
+  }
+  if (enable) {
+    esp_err_t ret = csi_start();
+    if (ret != ESP_OK) {
+      return ret;
+    }
+    wifi_csi_config_t csi_config = {
+        .lltf_en = true,
+        .htltf_en = true,
+        .stbc_htltf2_en = true,
+        .ltf_merge_en = true,
+        .channel_filter_en = true,
+        .manu_scale = false,
+    };
+    esp_wifi_set_csi_config(&csi_config);
+  }
+  esp_wifi_set_csi(enable);
+  if (!enable) {
+    csi_stop();
+  }
+  g_csi_on = enable;
+  return ESP_OK;
+}
+
+static esp_err_t monitor_on(void) {
+  if (g_promiscuous_active) {
+    return ESP_OK;
+  }
+
+  esp_err_t ret = pkt_worker_start();
+  if (ret != ESP_OK) {
+    return ret;
+  }
+  probe_table_reset(); // The host gets every probing client as new again
+
+  wifi_promiscuous_filter_t filter = {.filter_mask = promisc_filter_mask()};
   ESP_ERROR_CHECK(esp_wifi_set_promiscuous_filter(&filter));
   ESP_ERROR_CHECK(esp_wifi_set_promiscuous_rx_cb(promisc_rx_cb));
   ESP_ERROR_CHECK(esp_wifi_set_promiscuous(true));
 
   g_promiscuous_active = true;
+  return ESP_OK;
+}
+
+static void monitor_off(void) {
+  hopper_stop();
+  csi_set(false);
+  if (g_promiscuous_active) {
+    esp_wifi_set_promiscuous(false);
+    g_promiscuous_active = false;
+  }
+}
 
+/**
+ * @brief Hop (channel 0) or hold a channel while monitoring
+ */
+static void monitor_tune(uint8_t channel) {
+  if (channel == 0 ? g_channel_hopping
+                   : !g_channel_hopping && channel == g_current_channel) {
+    return; // Already there
+  }
+
+  hopper_stop();
   if (channel == 0) {
     g_channel_hopping = true;
-    xTaskCreate(channel_hopper_task, "ch_hopper", 2048, NULL, 5,
-                &g_hopper_task);
+    xTaskCreate(channel_hopper_task, "ch_hopper", HOPPER_STACK, NULL,
+                HOPPER_PRIO, &g_hopper_task);
     ESP_LOGI(TAG, "Channel hopping enabled");
+    return;
   }
 
-  xSemaphoreGive(g_wifi_mutex);
-  ESP_LOGI(TAG, "Sniffer started successfully");
+  g_current_channel = channel;
+  ESP_ERROR_CHECK(esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE));
+}
+
+/**
+ * @brief Move the radio to a mode by the shortest path (WiFi mutex held)
+ * @param mode Target mode
+ * @param channel Monitor modes: 1-13, or 0 to hop
+ */
+static esp_err_t radio_enter(wifi_radio_mode_t mode, uint8_t channel) {
+  int64_t start = esp_timer_get_time();
+  wifi_radio_mode_t from = radio_mode_now();
+
+  if (mode != WIFI_RADIO_IDLE) {
+    radio_driver_up();
+  }
+  scan_cancel();
+
+  if (mode == WIFI_RADIO_MONITOR || mode == WIFI_RADIO_MONITOR_CSI) {
+    esp_err_t ret = monitor_on();
+    if (ret != ESP_OK) {
+      return ret;
+    }
+    monitor_tune(channel);
+    ret = csi_set(mode == WIFI_RADIO_MONITOR_CSI);
+    if (ret != ESP_OK) {
+      return ret;
+    }
+  } else {
+    monitor_off();
+  }
+
+  uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+  g_radio_mode = mode;
+  g_radio_stats.mode = mode;
+  g_radio_stats.last_from = from;
+  g_radio_stats.transitions++;
+  g_radio_stats.last_us = us;
+  g_radio_stats.avg_us += ((int32_t)us - (int32_t)g_radio_stats.avg_us) / 8;
+  if (us > g_radio_stats.max_us) {
+    g_radio_stats.max_us = us;
+  }
+
+  chimera_radio_mode_t rec = {
+      .from = (uint8_t)from,
+      .to = (uint8_t)mode,
+      .latency_us = us,
+  };
+  serial_send_record(CHIMERA_MSG_RADIO_MODE, CHIMERA_RADIO_MODE_VERSION, &rec,
+                     sizeof(rec), NULL, 0);
+  ESP_LOGI(TAG, "Radio %s -> %s in %lu us", RADIO_MODE_NAMES[from],
+           RADIO_MODE_NAMES[mode], (unsigned long)us);
   return ESP_OK;
 }
 
-esp_err_t wifi_sniffer_stop(void) {
+esp_err_t wifi_sniffer_start(uint8_t channel) {
   if (!g_wifi_mutex) {
     return ESP_ERR_INVALID_STATE;
   }
+  if (channel > 13) {
+    channel = 1;
+  }
 
   xSemaphoreTake(g_wifi_mutex, portMAX_DELAY);
+  ESP_LOGI(TAG, "Starting sniffer on channel %d (0=hopping)", channel);
+  esp_err_t ret = radio_enter(
+      g_csi_on ? WIFI_RADIO_MONITOR_CSI : WIFI_RADIO_MONITOR, channel);
+  xSemaphoreGive(g_wifi_mutex);
+  return ret;
+}
 
-  // Stop channel hopping and wait for task to finish
-  g_channel_hopping = false;
-  int timeout = 50; // 500ms max wait
-  while (g_hopper_running && timeout > 0) {
-    vTaskDelay(pdMS_TO_TICKS(10));
-    timeout--;
+esp_err_t wifi_sniffer_stop(void) {
+  if (!g_wifi_mutex) {
+    return ESP_ERR_INVALID_STATE;
   }
 
-  esp_wifi_set_promiscuous(false);
-  g_promiscuous_active = false;
-
+  xSemaphoreTake(g_wifi_mutex, portMAX_DELAY);
+  if (g_radio_mode == WIFI_RADIO_MONITOR ||
+      g_radio_mode == WIFI_RADIO_MONITOR_CSI) {
+    radio_enter(WIFI_RADIO_IDLE, 0);
+  }
   xSemaphoreGive(g_wifi_mutex);
   return ESP_OK;
 }
 
+esp_err_t wifi_set_csi(bool enable) {
+  if (!g_wifi_mutex) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  xSemaphoreTake(g_wifi_mutex, portMAX_DELAY);
+  // Keep the session as it is; a fresh one holds the current channel, as
+  // CSI is a time series per link
+  uint8_t channel = g_channel_hopping ? 0 : g_current_channel;
+  esp_err_t ret = ESP_OK;
+  if (enable) {
+    ret = radio_enter(WIFI_RADIO_MONITOR_CSI, channel);
+  } else if (g_radio_mode == WIFI_RADIO_MONITOR_CSI) {
+    ret = radio_enter(WIFI_RADIO_MONITOR, channel);
+  }
+  xSemaphoreGive(g_wifi_mutex);
+  return ret;
+}
+
+wifi_radio_mode_t wifi_get_radio_mode(void) { return radio_mode_now(); }
+
+const char *wifi_radio_mode_name(wifi_radio_mode_t mode) {
+  return mode <= WIFI_RADIO_MONITOR_CSI ? RADIO_MODE_NAMES[mode] : "?";
+}
+
+void wifi_get_radio_stats(wifi_radio_stats_t *stats) {
+  if (stats) {
+    *stats = g_radio_stats;
+    stats->mode = radio_mode_now();
+  }
+}
+
 void wifi_set_channel_hopping(bool enable) {
   if (enable && !g_channel_hopping && g_promiscuous_active) {
     g_channel_hopping = true;
-    xTaskCreate(channel_hopper_task, "ch_hopper", 2048, NULL, 5,
-                &g_hopper_task);
+    xTaskCreate(channel_hopper_task, "ch_hopper", HOPPER_STACK, NULL,
+                HOPPER_PRIO, &g_hopper_task);
   } else if (!enable) {
     g_channel_hopping = false;
   }
@@ -501,6 +906,9 @@ esp_err_t wifi_send_deauth_burst(const uint8_t *target_mac,
   if (!ap_mac || !g_wifi_mutex) {
     return ESP_ERR_INVALID_ARG;
   }
+  if (!scope_tx_allowed(ap_mac)) {
+    return ESP_ERR_NOT_ALLOWED;
+  }
 
   ESP_LOGI(TAG, "Deauth BURST(%d) to %02X:%02X... from %02X:%02X... ch%d",
            count, target_mac ? target_mac[0] : 0xFF,
@@ -563,18 +971,37 @@ esp_err_t wifi_send_deauth(const uint8_t *target_mac, const uint8_t *ap_mac,
   return wifi_send_deauth_burst(target_mac, ap_mac, channel, reason, 1);
 }
 
-void wifi_set_sniffer_callback(wifi_sniffer_cb_t cb) { g_sniffer_cb = cb; }
+void wifi_set_sniffer_callback(wifi_sniffer_cb_t cb) {
+  if (cb) {
+    g_sniffer_cb = cb;
+    pkt_dispatch_subscribe(PKT_FRAME_ALL, sniffer_cb_frame, NULL);
+  } else {
+    pkt_dispatch_unsubscribe(sniffer_cb_frame, NULL);
+    g_sniffer_cb = NULL;
+  }
+}
 void wifi_set_handshake_callback(wifi_handshake_cb_t cb) {
   g_handshake_cb = cb;
 }
-void wifi_start_recon_mode(void) { g_recon_mode = true; }
-void wifi_stop_recon_mode(void) { g_recon_mode = false; }
+void wifi_start_recon_mode(void) {
+  ap_table_reset(); // The host gets every AP as new again
+  g_recon_mode = true;
+  pkt_dispatch_subscribe(PKT_FRAME_BEACON, recon_frame, NULL);
+}
+void wifi_stop_recon_mode(void) {
+  pkt_dispatch_unsubscribe(recon_frame, NULL);
+  g_recon_mode = false;
+}
 bool wifi_is_sniffing(void) { return g_promiscuous_active; }
 
 // ======================== EAPOL PROCESSING ========================
 
-static void process_eapol(const uint8_t *payload, int len, int header_len,
-                          const wifi_pkt_rx_ctrl_t *rx_ctrl) {
+static void process_eapol(const pkt_frame_t *frame) {
+  const uint8_t *payload = frame->payload;
+  int len = frame->len;
+  int header_len = frame->header_len;
+  const wifi_pkt_rx_ctrl_t *rx_ctrl = frame->rx_ctrl;
+
   // Minimum: header + LLC/SNAP (8) + EAPOL header (4) + key body
   int min_len = header_len + 8 + 4 + EAPOL_KEY_MIN_LEN;
   if (len < min_len) {
@@ -609,6 +1036,7 @@ static void process_eapol(const uint8_t *payload, int len, int header_len,
   }
 
   const uint8_t *eapol = eapol_hdr + 4; // EAPOL-Key body
+  hop_sched_note_event(rx_ctrl->channel, HOP_EVENT_EAPOL);
 
   uint8_t key_desc_type = eapol[EAPOL_KEY_DESC_TYPE_OFFSET];
   if (key_desc_type != 0x02 && key_desc_type != 0xFE) {
@@ -619,318 +1047,582 @@ static void process_eapol(const uint8_t *payload, int len, int header_len,
       (eapol[EAPOL_KEY_INFO_OFFSET] << 8) | eapol[EAPOL_KEY_INFO_OFFSET + 1];
   uint8_t key_desc_version = key_info & 0x07;
 
+  bool key_pairwise = (key_info & 0x0008) != 0;
   bool key_ack = (key_info & 0x0080) != 0;
   bool key_mic = (key_info & 0x0100) != 0;
   bool key_secure = (key_info & 0x0200) != 0;
 
-  uint8_t fc1 = payload[1];
-  const uint8_t *bssid = NULL;
-  const uint8_t *sta = NULL;
-  extract_data_frame_addrs(payload, fc1, &bssid, &sta, NULL);
+  const uint8_t *bssid = frame->bssid;
+  const uint8_t *sta = frame->sta;
+  if (!bssid || !sta || !key_pairwise) {
+    return; // Group key handshakes carry no PMK material
+  }
+
+  hs_key_msg_t msg = {
+      .bssid = bssid,
+      .sta = sta,
+      .replay_counter = eapol + EAPOL_KEY_REPLAY_OFFSET,
+      .nonce = eapol + EAPOL_KEY_NONCE_OFFSET,
+      .key_desc_type = key_desc_type,
+      .key_desc_version = key_desc_version,
+  };
+  if (key_ack) {
+    msg.msg = key_mic ? HS_MSG_M3 : HS_MSG_M1;
+  } else if (key_mic) {
+    // WPA1 leaves Secure clear in M4; its nonce is zero, M2's never is
+    bool nonce_zero = true;
+    for (int i = 0; i < 32 && nonce_zero; i++) {
+      nonce_zero = msg.nonce[i] == 0;
+    }
+    msg.msg = (key_secure || nonce_zero) ? HS_MSG_M4 : HS_MSG_M2;
+  } else {
+    return;
+  }
 
-  if (!bssid || !sta) {
+  hs_m1_t m1;
+  if (!hs_table_update(&msg, get_timestamp_ms(), &m1)) {
     return;
   }
 
-  if (key_ack && !key_mic) {
-    // ==================== MESSAGE 1/4 ====================
-    atomic_fetch_add(&g_m1_count, 1);
+  // ==================== M1 + M2 PAIRED ====================
+  wifi_handshake_t hs = {0};
 
-    ESP_LOGD(TAG, "EAPOL M1 from %02X:%02X:%02X:%02X:%02X:%02X", bssid[0],
-             bssid[1], bssid[2], bssid[3], bssid[4], bssid[5]);
+  memcpy(hs.bssid, bssid, 6);
+  memcpy(hs.sta, sta, 6);
+  memcpy(hs.anonce, m1.anonce, 32);
+  memcpy(hs.snonce, eapol + EAPOL_KEY_NONCE_OFFSET, 32);
+  memcpy(hs.mic, eapol + EAPOL_KEY_MIC_OFFSET, 16);
+  memcpy(hs.replay_counter, m1.replay_counter, 8);
 
-    if (g_cache_mutex) {
-      xSemaphoreTake(g_cache_mutex, portMAX_DELAY);
-    }
+  hs.key_desc_type = m1.key_desc_type;
+  hs.key_desc_version = m1.key_desc_version;
 
-    // Find slot for caching
-    int slot = -1;
-    uint32_t now = get_timestamp_ms();
-    uint32_t oldest_time = UINT32_MAX;
-    int oldest_slot = 0;
-
-    for (int i = 0; i < HANDSHAKE_CACHE_SIZE; i++) {
-      if (!g_handshake_cache[i].valid) {
-        slot = i;
-        break;
-      }
-      // Expire old entries
-      if ((now - g_handshake_cache[i].last_seen) > CACHE_TIMEOUT_MS) {
-        slot = i;
-        break;
-      }
-      if (g_handshake_cache[i].last_seen < oldest_time) {
-        oldest_time = g_handshake_cache[i].last_seen;
-        oldest_slot = i;
-      }
-    }
+  // Copy FULL EAPOL frame for MIC verification
+  int frame_len = eapol_total_len;
+  if (frame_len > MAX_EAPOL_FRAME_SIZE) {
+    frame_len = MAX_EAPOL_FRAME_SIZE;
+  }
+  memcpy(hs.eapol_frame, eapol_hdr, frame_len);
+  hs.eapol_len = frame_len;
+
+  hs.channel = rx_ctrl->channel;
+  hs.rssi = rx_ctrl->rssi;
+  hs.timestamp = get_timestamp_ms();
+  hs.has_m1 = true;
+  hs.has_m2 = true;
+  hs.complete = true;
+
+  if (g_handshake_cb) {
+    g_handshake_cb(&hs);
+  }
 
-    if (slot == -1) {
-      slot = oldest_slot;
-    }
+  // Format MACs for logging
+  char bssid_s[18], sta_s[18];
+  snprintf(bssid_s, sizeof(bssid_s), "%02X:%02X:%02X:%02X:%02X:%02X",
+           hs.bssid[0], hs.bssid[1], hs.bssid[2], hs.bssid[3], hs.bssid[4],
+           hs.bssid[5]);
+  snprintf(sta_s, sizeof(sta_s), "%02X:%02X:%02X:%02X:%02X:%02X", hs.sta[0],
+           hs.sta[1], hs.sta[2], hs.sta[3], hs.sta[4], hs.sta[5]);
+
+  chimera_handshake_t rec = {
+      .key_desc_type = hs.key_desc_type,
+      .key_desc_version = hs.key_desc_version,
+      .rssi = hs.rssi,
+      .channel = hs.channel,
+      .timestamp_ms = hs.timestamp,
+      .eapol_len = hs.eapol_len,
+  };
+  memcpy(rec.bssid, hs.bssid, 6);
+  memcpy(rec.sta, hs.sta, 6);
+  memcpy(rec.anonce, hs.anonce, 32);
+  memcpy(rec.snonce, hs.snonce, 32);
+  memcpy(rec.mic, hs.mic, 16);
+  memcpy(rec.replay_counter, hs.replay_counter, 8);
+  serial_send_record(CHIMERA_MSG_HANDSHAKE, CHIMERA_HANDSHAKE_VERSION, &rec,
+                     sizeof(rec), hs.eapol_frame, hs.eapol_len);
+
+  hs_table_stats_t st;
+  hs_table_get_stats(&st);
+  ESP_LOGI(TAG, "HANDSHAKE #%lu CAPTURED: %s <-> %s (v%d)",
+           (unsigned long)st.paired, bssid_s, sta_s, hs.key_desc_version);
+}
 
-    // Cache M1 data
-    memcpy(g_handshake_cache[slot].bssid, bssid, 6);
-    memcpy(g_handshake_cache[slot].sta, sta, 6);
-    memcpy(g_handshake_cache[slot].anonce, eapol + EAPOL_KEY_NONCE_OFFSET, 32);
-    memcpy(g_handshake_cache[slot].replay_counter,
-           eapol + EAPOL_KEY_REPLAY_OFFSET, 8);
-    g_handshake_cache[slot].key_desc_type = key_desc_type;
-    g_handshake_cache[slot].key_desc_version = key_desc_version;
-    g_handshake_cache[slot].last_seen = now;
-    g_handshake_cache[slot].valid = true;
-
-    if (g_cache_mutex) {
-      xSemaphoreGive(g_cache_mutex);
-    }
+// ======================== PACKET PATH ========================
 
-  } else if (key_mic && !key_ack && !key_secure) {
-    // ==================== MESSAGE 2/4 ====================
-    atomic_fetch_add(&g_m2_count, 1);
+/**
+ * @brief Classify a frame for the subscribers (pkt_dispatch.h)
+ * @param header_len Set to the 802.11 header length for non-runts, or NULL
+ */
+static uint32_t frame_class(const uint8_t *payload, int len,
+                            wifi_promiscuous_pkt_type_t type,
+                            int *header_len) {
+  if (len < 24 || type == WIFI_PKT_MISC) {
+    return PKT_FRAME_OTHER;
+  }
 
-    ESP_LOGD(TAG, "EAPOL M2 from STA %02X:%02X:%02X:%02X:%02X:%02X", sta[0],
-             sta[1], sta[2], sta[3], sta[4], sta[5]);
+  uint8_t fc0 = payload[0];
+  uint8_t frame_type = (fc0 >> 2) & 0x03;
+  uint8_t frame_subtype = (fc0 >> 4) & 0x0F;
+  int hdr = calc_80211_header_len(fc0, payload[1]);
+  if (hdr > len) {
+    return PKT_FRAME_OTHER;
+  }
+  if (header_len) {
+    *header_len = hdr;
+  }
 
-    if (g_cache_mutex) {
-      xSemaphoreTake(g_cache_mutex, portMAX_DELAY);
+  if (frame_type == 0) {
+    if (frame_subtype == 4) {
+      return PKT_FRAME_PROBE_REQ;
     }
+    if (frame_subtype == 8 || frame_subtype == 5) {
+      return PKT_FRAME_BEACON;
+    }
+    return PKT_FRAME_MGMT;
+  }
+  if (frame_type != 2) {
+    return PKT_FRAME_OTHER;
+  }
+  return len >= hdr + (int)sizeof(LLC_SNAP_EAPOL) &&
+                 memcmp(payload + hdr, LLC_SNAP_EAPOL,
+                        sizeof(LLC_SNAP_EAPOL)) == 0
+             ? PKT_FRAME_EAPOL
+             : PKT_FRAME_DATA;
+}
+
+/**
+ * @brief Cheap pre-filter run in the driver task
+ *
+ * Keeps only the frame classes some subscriber asked for, so the rest
+ * never take a slot. An on-device capture wants every frame.
+ */
+static bool pkt_wanted(const uint8_t *payload, int len,
+                       wifi_promiscuous_pkt_type_t type) {
+  if (pcap_store_active()) {
+    return true;
+  }
+  uint32_t mask = pkt_dispatch_mask();
+  if (mask == PKT_FRAME_ALL) {
+    return true;
+  }
+  return (mask & frame_class(payload, len, type, NULL)) != 0;
+}
+
+/**
+ * @brief Promiscuous RX callback (WiFi driver task)
+ *
+ * Bounds-checked copy into the packet ring and nothing else: no logging,
+ * no locks, no serial I/O.
+ */
+static void promisc_rx_cb(void *buf, wifi_promiscuous_pkt_type_t type) {
+  if (!buf || !g_pkt_slots) {
+    return;
+  }
+
+  const wifi_promiscuous_pkt_t *pkt = (const wifi_promiscuous_pkt_t *)buf;
+  int len = pkt->rx_ctrl.sig_len;
+
+  survey_frame(pkt, type);
+  if (type == WIFI_PKT_CTRL) {
+    return; // Only received while surveying, for the airtime counters
+  }
+
+  atomic_fetch_add(&g_pkt_count, 1);
+  atomic_fetch_add(&g_rssi_acc, pkt->rx_ctrl.rssi);
+  atomic_fetch_add(&g_rssi_samples, 1);
 
-    // Find matching M1
-    for (int i = 0; i < HANDSHAKE_CACHE_SIZE; i++) {
-      if (!g_handshake_cache[i].valid)
-        continue;
-      if (memcmp(g_handshake_cache[i].bssid, bssid, 6) != 0)
-        continue;
-      if (memcmp(g_handshake_cache[i].sta, sta, 6) != 0)
-        continue;
-
-      // ==================== COMPLETE HANDSHAKE ====================
-      atomic_fetch_add(&g_complete_count, 1);
-
-      wifi_handshake_t hs = {0};
-
-      memcpy(hs.bssid, bssid, 6);
-      memcpy(hs.sta, sta, 6);
-      memcpy(hs.anonce, g_handshake_cache[i].anonce, 32);
-      memcpy(hs.snonce, eapol + EAPOL_KEY_NONCE_OFFSET, 32);
-      memcpy(hs.mic, eapol + EAPOL_KEY_MIC_OFFSET, 16);
-      memcpy(hs.replay_counter, g_handshake_cache[i].replay_counter, 8);
-
-      hs.key_desc_type = g_handshake_cache[i].key_desc_type;
-      hs.key_desc_version = g_handshake_cache[i].key_desc_version;
-
-      // Copy FULL EAPOL frame for MIC verification
-      int frame_len = eapol_total_len;
-      if (frame_len > MAX_EAPOL_FRAME_SIZE) {
-        frame_len = MAX_EAPOL_FRAME_SIZE;
-      }
-      memcpy(hs.eapol_frame, eapol_hdr, frame_len);
-      hs.eapol_len = frame_len;
-
-      hs.channel = rx_ctrl->channel;
-      hs.rssi = rx_ctrl->rssi;
-      hs.timestamp = get_timestamp_ms();
-      hs.has_m1 = true;
-      hs.has_m2 = true;
-      hs.complete = true;
-
-      // Invalidate cache entry before releasing mutex
-      g_handshake_cache[i].valid = false;
-
-      if (g_cache_mutex) {
-        xSemaphoreGive(g_cache_mutex);
-      }
-
-      // Callback (outside mutex)
-      if (g_handshake_cb) {
-        g_handshake_cb(&hs);
-      }
-
-      // Format MACs for logging
-      char bssid_s[18], sta_s[18];
-      snprintf(bssid_s, sizeof(bssid_s), "%02X:%02X:%02X:%02X:%02X:%02X",
-               hs.bssid[0], hs.bssid[1], hs.bssid[2], hs.bssid[3], hs.bssid[4],
-               hs.bssid[5]);
-      snprintf(sta_s, sizeof(sta_s), "%02X:%02X:%02X:%02X:%02X:%02X", hs.sta[0],
-               hs.sta[1], hs.sta[2], hs.sta[3], hs.sta[4], hs.sta[5]);
-
-      // Use binary protocol (COBS) for efficiency
-      // Struct:
-      // [BSSID(6)][STA(6)][ANonce(32)][SNonce(32)][MIC(16)][Replay(8)][Type(1)][Ver(1)][Len(2)][Data(n)]
-      // Total fixed: 104 bytes + variable payload
-
-      uint8_t payload_buf[MAX_EAPOL_FRAME_SIZE + 128];
-      int p_idx = 0;
-
-      // Pack data
-      memcpy(payload_buf + p_idx, hs.bssid, 6);
-      p_idx += 6;
-      memcpy(payload_buf + p_idx, hs.sta, 6);
-      p_idx += 6;
-      memcpy(payload_buf + p_idx, hs.anonce, 32);
-      p_idx += 32;
-      memcpy(payload_buf + p_idx, hs.snonce, 32);
-      p_idx += 32;
-      memcpy(payload_buf + p_idx, hs.mic, 16);
-      p_idx += 16;
-      memcpy(payload_buf + p_idx, hs.replay_counter, 8);
-      p_idx += 8;
-
-      payload_buf[p_idx++] = hs.key_desc_type;
-      payload_buf[p_idx++] = hs.key_desc_version;
-
-      // Payload len (Big Endian)
-      payload_buf[p_idx++] = (hs.eapol_len >> 8) & 0xFF;
-      payload_buf[p_idx++] = hs.eapol_len & 0xFF;
-
-      // RSSI and Channel
-      payload_buf[p_idx++] = (uint8_t)(hs.rssi & 0xFF);
-      payload_buf[p_idx++] = hs.channel;
-
-      if (p_idx + hs.eapol_len <= sizeof(payload_buf)) {
-        memcpy(payload_buf + p_idx, hs.eapol_frame, hs.eapol_len);
-        p_idx += hs.eapol_len;
-
-        serial_send_cobs(0x02, payload_buf, p_idx); // Type 0x02 = Handshake
-      } else {
-        ESP_LOGE(TAG, "Handshake too large for binary buffer");
-      }
-
-      ESP_LOGI(TAG, "HANDSHAKE #%lu CAPTURED: %s <-> %s (v%d)",
-               (unsigned long)atomic_load(&g_complete_count), bssid_s, sta_s,
-               hs.key_desc_version);
-
-      return; // Already released mutex and processed
+  if (!scope_frame_allowed(pkt->payload, len)) {
+    atomic_fetch_add(&g_pkt_filtered, 1);
+    return;
+  }
+
+  atomic_store(&g_filter_busy, true);
+  const pkt_filter_t *filter = atomic_load(&g_filter);
+  bool pass = !filter || pkt_filter_match(filter, pkt->payload, len,
+                                          (int8_t)pkt->rx_ctrl.rssi);
+  atomic_store(&g_filter_busy, false);
+  if (!pass) {
+    atomic_fetch_add(&g_filter_rejected, 1);
+    atomic_fetch_add(&g_pkt_filtered, 1);
+    return;
+  }
+  hop_sched_note_frame(pkt->rx_ctrl.channel);
+
+  bool raw = false;
+  if (g_raw_snaplen && ++g_raw_tick >= g_raw_every) {
+    g_raw_tick = 0;
+    raw = true;
+  }
+
+  if (!raw && !pkt_wanted(pkt->payload, len, type)) {
+    atomic_fetch_add(&g_pkt_filtered, 1);
+    return;
+  }
+
+  unsigned head = atomic_load_explicit(&g_pkt_head, memory_order_relaxed);
+  unsigned tail = atomic_load_explicit(&g_pkt_tail, memory_order_acquire);
+  if (head - tail >= PKT_SLOTS) {
+    atomic_fetch_add(&g_pkt_drop_full, 1);
+    return;
+  }
+
+  pkt_slot_t *slot = &g_pkt_slots[head & (PKT_SLOTS - 1)];
+  int copy = len;
+  if (copy > PKT_SNAPLEN) {
+    copy = PKT_SNAPLEN;
+    atomic_fetch_add(&g_pkt_truncated, 1);
+  }
+  slot->orig_len = (uint16_t)len;
+  slot->type = (uint8_t)type;
+  slot->raw = raw;
+  slot->rx_ctrl = pkt->rx_ctrl;
+  slot->rx_ctrl.sig_len = copy;
+  memcpy(slot->payload, pkt->payload, copy);
+
+  atomic_store_explicit(&g_pkt_head, head + 1, memory_order_release);
+  atomic_fetch_add(&g_pkt_queued, 1);
+  xTaskNotifyGive(g_pkt_task);
+}
+
+/**
+ * @brief Legacy rate in 500 kb/s units from rx_ctrl.rate (wifi_phy_rate_t)
+ */
+static uint8_t raw_legacy_rate(uint8_t rate) {
+  static const uint8_t units[16] = {
+      2, 4, 11, 22, 0, 4, 11, 22, // 1/2/5.5/11M long, -, 2/5.5/11M short
+      96, 48, 24, 12, 108, 72, 36, 18, // 48/24/12/6/54/36/18/9M OFDM
+  };
+  return units[rate & 0x0F];
+}
+
+/**
+ * @brief Describe a captured frame as RAW_FRAME metadata (cap_len unset)
+ */
+static void raw_describe(const pkt_slot_t *slot, chimera_raw_frame_t *rec) {
+  const wifi_pkt_rx_ctrl_t *rx_ctrl = &slot->rx_ctrl;
+
+  *rec = (chimera_raw_frame_t){
+      .timestamp_us = rx_ctrl->timestamp,
+      .orig_len = slot->orig_len,
+      .channel = rx_ctrl->channel,
+      .rssi = rx_ctrl->rssi,
+      .noise_floor = rx_ctrl->noise_floor,
+  };
+  // The driver delivers data and management frames with their FCS
+  if (slot->type != WIFI_PKT_MISC) {
+    rec->flags |= CHIMERA_RAW_FCS;
+  }
+  if (rx_ctrl->sig_mode) {
+    rec->flags |= CHIMERA_RAW_HT;
+    rec->mcs = rx_ctrl->mcs;
+    if (rx_ctrl->cwb)
+      rec->flags |= CHIMERA_RAW_40MHZ;
+    if (rx_ctrl->sgi)
+      rec->flags |= CHIMERA_RAW_SHORT_GI;
+  } else {
+    rec->rate = raw_legacy_rate(rx_ctrl->rate);
+    if (rx_ctrl->rate >= 5 && rx_ctrl->rate <= 7)
+      rec->flags |= CHIMERA_RAW_SHORT_PRE;
+  }
+}
+
+/**
+ * @brief Stream one sampled frame to the host as a RAW_FRAME record
+ */
+static void pkt_send_raw(const pkt_slot_t *slot,
+                         const chimera_raw_frame_t *meta) {
+  uint16_t cap_len = slot->rx_ctrl.sig_len;
+  uint16_t snaplen = g_raw_snaplen;
+  if (snaplen == 0) {
+    return; // Turned off since the frame was queued
+  }
+  if (cap_len > snaplen) {
+    cap_len = snaplen;
+  }
+
+  chimera_raw_frame_t rec = *meta;
+  rec.cap_len = cap_len;
+  serial_send_record(CHIMERA_MSG_RAW_FRAME, CHIMERA_RAW_FRAME_VERSION, &rec,
+                     sizeof(rec), slot->payload, cap_len);
+  atomic_fetch_add(&g_raw_sent, 1);
+}
+
+/**
+ * @brief Parse one captured frame and hand it to its subscribers (packet
+ * worker)
+ */
+static void process_frame(pkt_slot_t *slot) {
+  wifi_promiscuous_pkt_type_t type = (wifi_promiscuous_pkt_type_t)slot->type;
+
+  if (slot->raw || pcap_store_active()) {
+    chimera_raw_frame_t meta;
+    raw_describe(slot, &meta);
+    if (slot->raw) {
+      pkt_send_raw(slot, &meta);
     }
+    pcap_store_packet(&meta, slot->payload, slot->rx_ctrl.sig_len);
+  }
 
-    if (g_cache_mutex) {
-      xSemaphoreGive(g_cache_mutex);
+  const uint8_t *payload = slot->payload;
+  int len = slot->rx_ctrl.sig_len;
+  int header_len = 0;
+  pkt_frame_t frame = {
+      .rx_ctrl = &slot->rx_ctrl,
+      .payload = payload,
+      .len = (uint16_t)len,
+      .orig_len = slot->orig_len,
+      .type = type,
+      .frame_class = frame_class(payload, len, type, &header_len),
+  };
+  frame.header_len = (uint8_t)header_len;
+
+  if (header_len) {
+    frame.subtype = (payload[0] >> 4) & 0x0F;
+    if (frame.frame_class & (PKT_FRAME_EAPOL | PKT_FRAME_DATA)) {
+      extract_data_frame_addrs(payload, payload[1], &frame.bssid, &frame.sta,
+                               NULL);
+    } else if (type == WIFI_PKT_MGMT) {
+      frame.bssid = payload + 16;
+      hop_sched_note_event(slot->rx_ctrl.channel, HOP_EVENT_MGMT);
     }
   }
+
+  pkt_dispatch_frame(&frame);
 }
 
-static void promisc_rx_cb(void *buf, wifi_promiscuous_pkt_type_t type) {
-  if (!buf) {
+// ---------------- Built-in subscribers ----------------
+
+/**
+ * @brief Directed probe requests, aggregated per (client, SSID)
+ */
+static void probe_frame(const pkt_frame_t *frame, void *ctx) {
+  const uint8_t *payload = frame->payload;
+  int len = frame->len;
+  int pos = 24;
+  if (pos + 2 > len || payload[pos] != 0) {
     return;
   }
+  int ssid_len = payload[pos + 1];
+  if (ssid_len > 0 && ssid_len <= 32 && (pos + 2 + ssid_len <= len)) {
+    // The table reports the counters
+    probe_table_request(payload + 10, payload + pos + 2, (uint8_t)ssid_len,
+                        frame->rx_ctrl->rssi, frame->rx_ctrl->channel,
+                        get_timestamp_ms());
+  }
+}
 
-  wifi_promiscuous_pkt_t *pkt = (wifi_promiscuous_pkt_t *)buf;
+/**
+ * @brief Beacons and probe responses in recon mode; the AP table reports
+ * changes
+ */
+static void recon_frame(const pkt_frame_t *frame, void *ctx) {
+  ap_table_beacon(frame->payload, frame->len, frame->rx_ctrl->rssi,
+                  frame->rx_ctrl->channel, get_timestamp_ms());
+}
 
-  // Visual feedback with packet stats
-  uint32_t count = atomic_fetch_add(&g_pkt_count, 1) + 1;
-  static int acc_rssi = 0;
-  static int acc_samples = 0;
+static void eapol_frame(const pkt_frame_t *frame, void *ctx) {
+  process_eapol(frame);
+}
 
-  acc_rssi += pkt->rx_ctrl.rssi;
-  acc_samples++;
+/**
+ * @brief Adapter for wifi_set_sniffer_callback()
+ */
+static void sniffer_cb_frame(const pkt_frame_t *frame, void *ctx) {
+  wifi_sniffer_cb_t cb = g_sniffer_cb;
+  if (cb) {
+    cb((void *)frame->rx_ctrl, frame->type);
+  }
+}
 
-  if (acc_samples >= 10) {
-    char pulse_json[80];
-    int avg = acc_rssi / acc_samples;
+/**
+ * @brief Emit the pulse, sniffer statistics, AP/probe table updates and
+ * survey snapshots when due
+ */
+static void pkt_report(uint32_t *last_stats) {
+  if (atomic_load(&g_rssi_samples) >= 10) {
+    int samples = atomic_exchange(&g_rssi_samples, 0);
+    int acc = atomic_exchange(&g_rssi_acc, 0);
+    int avg = acc / samples;
     int val = (avg >= -30) ? 100 : (avg <= -95) ? 0 : (int)((avg + 95) * 1.54);
 
-    snprintf(pulse_json, sizeof(pulse_json),
-             "{\"type\":\"pulse\",\"val\":%d,\"ch\":%d}", val,
-             pkt->rx_ctrl.channel);
-    serial_send_json_raw(pulse_json);
+    chimera_pulse_t rec = {
+        .level = (uint8_t)val,
+        .channel = g_current_channel,
+    };
+    serial_send_record(CHIMERA_MSG_PULSE, CHIMERA_PULSE_VERSION, &rec,
+                       sizeof(rec), NULL, 0);
+  }
+
+  uint32_t count = atomic_load(&g_pkt_count);
+  if (count - *last_stats >= 100) {
+    *last_stats = count;
+    hs_table_stats_t hs;
+    hs_table_get_stats(&hs);
+    chimera_sniff_stats_t rec = {
+        .packets = count,
+        .m1 = hs.m1,
+        .m2 = hs.m2,
+        .complete = hs.paired,
+        .dropped_full = atomic_load(&g_pkt_drop_full),
+        .filtered = atomic_load(&g_pkt_filtered),
+        .m3 = hs.m3,
+        .m4 = hs.m4,
+        .completed = hs.completed,
+        .unmatched = hs.unmatched,
+        .evicted = hs.evicted,
+    };
+    serial_send_record(CHIMERA_MSG_SNIFF_STATS, CHIMERA_SNIFF_STATS_VERSION,
+                       &rec, sizeof(rec), NULL, 0);
+  }
 
-    acc_rssi = 0;
-    acc_samples = 0;
+  uint32_t now = get_timestamp_ms();
+  if (g_recon_mode) {
+    ap_table_report(now);
   }
+  probe_table_report(now);
+  survey_report(now);
+}
+
+static void pkt_worker_task(void *arg) {
+  uint32_t last_stats = atomic_load(&g_pkt_count);
+
+  while (g_pkt_worker_run) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
 
-  if (count % 100 == 0) {
-    char stats[128];
-    snprintf(stats, sizeof(stats),
-             "{\"type\":\"sniff_stats\",\"count\":%lu,\"m1\":%lu,\"m2\":%lu,"
-             "\"complete\":%lu}",
-             (unsigned long)count, (unsigned long)atomic_load(&g_m1_count),
-             (unsigned long)atomic_load(&g_m2_count),
-             (unsigned long)atomic_load(&g_complete_count));
-    serial_send_json_raw(stats);
+    unsigned tail = atomic_load_explicit(&g_pkt_tail, memory_order_relaxed);
+    while (tail != atomic_load_explicit(&g_pkt_head, memory_order_acquire)) {
+      process_frame(&g_pkt_slots[tail & (PKT_SLOTS - 1)]);
+      tail++;
+      // Hand the slot back only after parsing it in place
+      atomic_store_explicit(&g_pkt_tail, tail, memory_order_release);
+      atomic_fetch_add(&g_pkt_processed, 1);
+    }
+
+    pkt_report(&last_stats);
   }
 
-  if (g_sniffer_cb) {
-    g_sniffer_cb(buf, type);
+  g_pkt_task = NULL;
+  vTaskDelete(NULL);
+}
+
+/**
+ * @brief Allocate the packet ring and start the worker (once)
+ */
+static esp_err_t pkt_worker_start(void) {
+  if (g_pkt_task) {
+    return ESP_OK;
   }
 
-  int len = pkt->rx_ctrl.sig_len;
-  uint8_t *payload = pkt->payload;
+  if (!g_pkt_slots) {
+    size_t size = sizeof(pkt_slot_t) * PKT_SLOTS;
+    g_pkt_slots = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!g_pkt_slots) {
+      g_pkt_slots = heap_caps_malloc(size, MALLOC_CAP_8BIT);
+    }
+    if (!g_pkt_slots) {
+      ESP_LOGE(TAG, "Failed to allocate packet ring");
+      return ESP_ERR_NO_MEM;
+    }
+  }
 
-  if (len < 24) {
-    return;
+  if (ap_table_init() != ESP_OK) {
+    ESP_LOGW(TAG, "Recon AP table unavailable");
+  }
+  if (probe_table_init() != ESP_OK) {
+    ESP_LOGW(TAG, "Probe table unavailable");
   }
 
-  uint8_t fc0 = payload[0];
-  uint8_t fc1 = payload[1];
-  uint8_t frame_type = (fc0 >> 2) & 0x03;
-  uint8_t frame_subtype = (fc0 >> 4) & 0x0F;
+  g_pkt_worker_run = true;
+  if (xTaskCreatePinnedToCore(pkt_worker_task, "pkt_worker", PKT_WORKER_STACK,
+                              NULL, PKT_WORKER_PRIO, &g_pkt_task,
+                              PKT_WORKER_CORE) != pdPASS) {
+    g_pkt_worker_run = false;
+    ESP_LOGE(TAG, "Failed to create packet worker");
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
 
-  // Management frames
-  if (type == WIFI_PKT_MGMT) {
-    if (frame_type == 0 && frame_subtype == 4) {
-      // Probe Request
-      char sa_str[18];
-      snprintf(sa_str, sizeof(sa_str), "%02X:%02X:%02X:%02X:%02X:%02X",
-               payload[10], payload[11], payload[12], payload[13], payload[14],
-               payload[15]);
-
-      int pos = 24;
-      if (pos + 2 <= len && payload[pos] == 0) {
-        int ssid_len = payload[pos + 1];
-        if (ssid_len > 0 && ssid_len <= 32 && (pos + 2 + ssid_len <= len)) {
-          char ssid[33] = {0};
-          memcpy(ssid, payload + pos + 2, ssid_len);
-
-          char json[256];
-          char esc_ssid[65];
-          serial_escape_json(ssid, esc_ssid, sizeof(esc_ssid));
-
-          snprintf(json, sizeof(json),
-                   "{\"type\":\"client_probe\",\"mac\":\"%s\","
-                   "\"ssid\":\"%s\",\"rssi\":%d}",
-                   sa_str, esc_ssid, pkt->rx_ctrl.rssi);
-          serial_send_json_raw(json);
-        }
-      }
-    } else if (frame_type == 0 && frame_subtype == 8 && g_recon_mode) {
-      // Beacon in recon mode
-      if (len < 36)
-        return;
-
-      char bssid_str[18];
-      snprintf(bssid_str, sizeof(bssid_str), "%02X:%02X:%02X:%02X:%02X:%02X",
-               payload[16], payload[17], payload[18], payload[19], payload[20],
-               payload[21]);
-
-      int pos = 36;
-      if (pos + 2 <= len && payload[pos] == 0) {
-        int ssid_len = payload[pos + 1];
-        if (ssid_len > 0 && ssid_len <= 32 && (pos + 2 + ssid_len <= len)) {
-          char ssid[33] = {0};
-          memcpy(ssid, payload + pos + 2, ssid_len);
-
-          char json[256];
-          char esc[65];
-          serial_escape_json(ssid, esc, sizeof(esc));
-          snprintf(json, sizeof(json),
-                   "{\"ssid\":\"%s\",\"bssid\":\"%s\",\"rssi\":%d,\"ch\":%d}",
-                   esc, bssid_str, pkt->rx_ctrl.rssi, pkt->rx_ctrl.channel);
-          serial_send_json("recon", json);
-        }
-      }
+/**
+ * @brief Stop the worker and free the ring and AP/probe tables (promiscuous
+ * mode must be off)
+ */
+static void pkt_worker_stop(void) {
+  if (g_pkt_task) {
+    g_pkt_worker_run = false;
+    xTaskNotifyGive(g_pkt_task);
+    int timeout = 50; // 500ms max wait
+    while (g_pkt_task && timeout > 0) {
+      vTaskDelay(pdMS_TO_TICKS(10));
+      timeout--;
     }
-    return;
   }
+  if (!g_pkt_task && g_pkt_slots) {
+    heap_caps_free(g_pkt_slots);
+    g_pkt_slots = NULL;
+    atomic_store(&g_pkt_head, 0);
+    atomic_store(&g_pkt_tail, 0);
+    ap_table_deinit();
+    probe_table_deinit();
+  }
+}
 
-  // Data frames only
-  if (frame_type != 2) {
+void wifi_get_sniffer_stats(wifi_sniffer_stats_t *stats) {
+  if (!stats) {
     return;
   }
+  stats->received = atomic_load(&g_pkt_count);
+  stats->queued = atomic_load(&g_pkt_queued);
+  stats->processed = atomic_load(&g_pkt_processed);
+  stats->dropped_full = atomic_load(&g_pkt_drop_full);
+  stats->filtered = atomic_load(&g_pkt_filtered);
+  stats->truncated = atomic_load(&g_pkt_truncated);
+  stats->raw_sent = atomic_load(&g_raw_sent);
+  stats->filter_rejected = atomic_load(&g_filter_rejected);
+}
 
-  int header_len = calc_80211_header_len(fc0, fc1);
-  if (header_len > len) {
-    return;
+esp_err_t wifi_set_filter(const pkt_filter_t *filter) {
+  if (!filter) {
+    atomic_store(&g_filter, NULL);
+  } else {
+    // The slot not in use; the callback left it when the last set returned
+    const pkt_filter_t *cur = atomic_load(&g_filter);
+    pkt_filter_t *next =
+        (cur == &g_filter_slot[0]) ? &g_filter_slot[1] : &g_filter_slot[0];
+    *next = *filter;
+    atomic_store(&g_filter, next);
   }
 
-  process_eapol(payload, len, header_len, &pkt->rx_ctrl);
-}
\ No newline at end of file
+  // Wait out a callback that may still hold the previous program
+  while (atomic_load(&g_filter_busy)) {
+    taskYIELD();
+  }
+  ESP_LOGI(TAG, "Packet filter %s (%u bytes)", filter ? "set" : "cleared",
+           filter ? filter->code_len : 0);
+  return ESP_OK;
+}
+
+esp_err_t wifi_set_raw_stream(uint16_t snaplen, uint16_t every) {
+  if (snaplen > PKT_SNAPLEN) {
+    snaplen = PKT_SNAPLEN;
+  }
+  g_raw_every = every ? every : 1;
+  g_raw_snaplen = snaplen;
+  ESP_LOGI(TAG, "Raw streaming %s (snaplen %u, 1 in %u)",
+           snaplen ? "on" : "off", snaplen, g_raw_every);
+  return ESP_OK;
+}
+
+esp_err_t wifi_set_survey(uint32_t interval_ms) {
+  esp_err_t ret = survey_set_interval(interval_ms);
+  if (ret != ESP_OK) {
+    return ret;
+  }
+  if (g_promiscuous_active) {
+    wifi_promiscuous_filter_t filter = {.filter_mask = promisc_filter_mask()};
+    esp_wifi_set_promiscuous_filter(&filter);
+  }
+  ESP_LOGI(TAG, "Survey %s (every %lu ms)", interval_ms ? "on" : "off",
+           (unsigned long)interval_ms);
+  return ESP_OK;
+}
@@ -15,6 +15,7 @@
 
 #include "esp_err.h"
 #include "esp_wifi.h"
+#include "pkt_filter.h"
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -26,9 +27,6 @@ extern "C" {
 // Typically ~121 bytes for M2, but can be larger with vendor extensions
 #define MAX_EAPOL_FRAME_SIZE 256
 
-// Maximum WiFi scan results to prevent memory exhaustion
-#define MAX_SCAN_RESULTS 64
-
 // Scan result structure
 typedef struct {
   char ssid[33];
@@ -82,6 +80,37 @@ typedef struct {
   bool complete; // Full handshake captured (M1 + M2 minimum)
 } wifi_handshake_t;
 
+// Sniffer packet path counters
+typedef struct {
+  uint32_t received;        // Frames delivered by the driver
+  uint32_t queued;          // Frames copied into the packet ring
+  uint32_t processed;       // Frames parsed by the packet worker
+  uint32_t dropped_full;    // Wanted frames lost because the ring was full
+  uint32_t filtered;        // Frames skipped before the copy
+  uint32_t truncated;       // Frames cut to the ring slot size
+  uint32_t raw_sent;        // RAW_FRAME records streamed to the host
+  uint32_t filter_rejected; // Frames the user filter rejected (in filtered)
+} wifi_sniffer_stats_t;
+
+// Radio modes; the driver keeps running across all of them
+typedef enum {
+  WIFI_RADIO_IDLE = 0,    // Nothing running
+  WIFI_RADIO_SCAN,        // AP scan in progress
+  WIFI_RADIO_MONITOR,     // Promiscuous capture
+  WIFI_RADIO_MONITOR_CSI, // Promiscuous capture plus CSI
+} wifi_radio_mode_t;
+
+// Radio mode transitions
+typedef struct {
+  wifi_radio_mode_t mode;      // Current mode
+  wifi_radio_mode_t last_from; // Mode the last transition left
+  uint32_t transitions;        // Mode changes and retunes since boot
+  uint32_t driver_starts;      // Full driver starts (normally 1)
+  uint32_t last_us;            // Latency of the last transition
+  uint32_t avg_us;             // Transition latency, moving average
+  uint32_t max_us;             // Worst transition latency
+} wifi_radio_stats_t;
+
 // Callback types
 typedef void (*wifi_sniffer_cb_t)(void *buf, wifi_promiscuous_pkt_type_t type);
 typedef void (*wifi_scan_cb_t)(const wifi_scan_result_t *result);
@@ -99,15 +128,38 @@ esp_err_t wifi_manager_init(void);
 void wifi_manager_deinit(void);
 
 /**
- * @brief Start WiFi network scan
- * @param callback Called for each discovered network
- * @return ESP_OK on success
+ * @brief Start a WiFi network scan (returns immediately)
+ *
+ * Channels 1-13 are scanned one at a time. Each channel's results are
+ * streamed as WIFI_AP records as soon as that channel is done, with no cap
+ * on the number of APs, and the scan ends with WIFI_SCAN_DONE. The WiFi
+ * mutex is only held while the scan is set up. Starting a scan or the
+ * sniffer cancels a running scan; starting a scan stops the sniffer.
+ *
+ * @param callback Called for each discovered network, from the event loop
+ *        task
+ * @return ESP_OK if the scan started
  */
 esp_err_t wifi_scan_start(wifi_scan_cb_t callback);
 
+/**
+ * @brief Cancel a running scan
+ *
+ * The scan ends with WIFI_SCAN_DONE for the results streamed so far.
+ * Does nothing if no scan is running.
+ * @return ESP_OK on success
+ */
+esp_err_t wifi_scan_stop(void);
+
 /**
  * @brief Start promiscuous mode for sniffing
- * @param channel WiFi channel (1-13), or 0 for channel hopping
+ *
+ * Directed probe requests are aggregated per client and SSID
+ * (probe_table.h) and reported as PROBE_UPDATE records. Starting the
+ * sniffer clears the probe table.
+ *
+ * @param channel WiFi channel (1-13), or 0 for activity-weighted channel
+ * hopping (hop_sched.h)
  * @return ESP_OK on success
  */
 esp_err_t wifi_sniffer_start(uint8_t channel);
@@ -118,6 +170,41 @@ esp_err_t wifi_sniffer_start(uint8_t channel);
  */
 esp_err_t wifi_sniffer_stop(void);
 
+/**
+ * @brief Turn CSI capture on or off
+ *
+ * Reports are sent as CSI_FEATURES or CSI_DATA records (csi.h);
+ * csi_configure() picks the transmitters and the decimation,
+ * csi_set_output() the record kind.
+ * Enabling sniffs on the current channel, without hopping, if the sniffer
+ * is not already running, and otherwise joins the running session as it
+ * is. Disabling leaves the sniffer running.
+ *
+ * @param enable true to capture CSI
+ * @return ESP_OK on success
+ */
+esp_err_t wifi_set_csi(bool enable);
+
+/**
+ * @brief Get the radio mode
+ *
+ * The driver is started once and kept running; scan, sniffer and CSI calls
+ * only switch what runs on it. Every transition is timed and reported as a
+ * RADIO_MODE record (chimera_radio_mode_t); the CHIMERA_RADIO_* values are
+ * the wifi_radio_mode_t values.
+ */
+wifi_radio_mode_t wifi_get_radio_mode(void);
+
+/**
+ * @brief Name of a radio mode ("idle", "scan", "monitor", "monitor_csi")
+ */
+const char *wifi_radio_mode_name(wifi_radio_mode_t mode);
+
+/**
+ * @brief Snapshot radio mode transition statistics
+ */
+void wifi_get_radio_stats(wifi_radio_stats_t *stats);
+
 /**
  * @brief Enable/disable channel hopping
  * @param enable true to enable hopping
@@ -164,7 +251,8 @@ esp_err_t wifi_send_deauth(const uint8_t *target_mac, const uint8_t *ap_mac,
  * @param channel Target channel
  * @param reason Deauth reason code
  * @param count Number of packets to send
- * @return ESP_OK if at least one packet was sent
+ * @return ESP_OK if at least one packet was sent, ESP_ERR_NOT_ALLOWED if
+ * ap_mac is outside the engagement scope (scope.h)
  */
 esp_err_t wifi_send_deauth_burst(const uint8_t *target_mac,
                                  const uint8_t *ap_mac, uint8_t channel,
@@ -172,7 +260,13 @@ esp_err_t wifi_send_deauth_burst(const uint8_t *target_mac,
 
 /**
  * @brief Set sniffer callback for raw packet capture
- * @param cb Callback function
+ *
+ * Runs on the packet worker task, not the WiFi driver task. The packet is a
+ * copy; rx_ctrl.sig_len is the captured length. The callback is one
+ * PKT_FRAME_ALL subscriber (pkt_dispatch.h) alongside the others; consumers
+ * that only need some frame classes should subscribe directly.
+ *
+ * @param cb Callback function, or NULL to remove it
  */
 void wifi_set_sniffer_callback(wifi_sniffer_cb_t cb);
 
@@ -184,6 +278,11 @@ void wifi_set_handshake_callback(wifi_handshake_cb_t cb);
 
 /**
  * @brief Start passive reconnaissance mode
+ *
+ * Beacons and probe responses feed the AP table (ap_table.h), which sends
+ * AP_UPDATE records for new and changed APs only. Starting recon clears
+ * the table. Recon subscribes to beacons on whatever sniffer session is
+ * running; it does not start or retune the sniffer.
  */
 void wifi_start_recon_mode(void);
 
@@ -199,8 +298,8 @@ void wifi_stop_recon_mode(void);
 bool wifi_is_sniffing(void);
 
 /**
- * @brief Clear the handshake cache
- * Call this when switching target networks
+ * @brief Forget tracked handshake exchanges and zero their counters
+ * (hs_table.h). Call this when switching target networks
  */
 void wifi_clear_handshake_cache(void);
 
@@ -208,11 +307,52 @@ void wifi_clear_handshake_cache(void);
  * @brief Get statistics about captured handshakes
  * @param m1_count Output: number of M1 messages seen
  * @param m2_count Output: number of M2 messages seen
- * @param complete_count Output: number of complete handshakes
+ * @param complete_count Output: number of M2s paired with their M1
  */
 void wifi_get_handshake_stats(uint32_t *m1_count, uint32_t *m2_count,
                               uint32_t *complete_count);
 
+/**
+ * @brief Stream captured frames to the host as RAW_FRAME records
+ *
+ * Applies while sniffing, alongside the parsed events. Sampled frames
+ * bypass the capture pre-filter, so every frame type is streamed.
+ *
+ * @param snaplen Bytes kept per frame (clamped to the ring slot size), 0 to
+ * turn streaming off
+ * @param every Stream one frame in every (0 or 1 = all)
+ * @return ESP_OK
+ */
+esp_err_t wifi_set_raw_stream(uint16_t snaplen, uint16_t every);
+
+/**
+ * @brief Run the per-channel utilization survey (survey.h)
+ *
+ * Applies while sniffing. Control frames are received while it runs, for
+ * their airtime; nothing else sees them.
+ *
+ * @param interval_ms SURVEY snapshot interval, 0 to stop
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for an out-of-range interval
+ */
+esp_err_t wifi_set_survey(uint32_t interval_ms);
+
+/**
+ * @brief Install a packet filter program
+ *
+ * The program runs in the promiscuous callback before a frame is copied or
+ * parsed; rejected frames only cost the program's instructions. It applies
+ * to every consumer (parsing, raw streaming, on-device capture).
+ *
+ * @param filter Program (copied), or NULL to accept every frame
+ * @return ESP_OK
+ */
+esp_err_t wifi_set_filter(const pkt_filter_t *filter);
+
+/**
+ * @brief Snapshot sniffer packet path counters
+ */
+void wifi_get_sniffer_stats(wifi_sniffer_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
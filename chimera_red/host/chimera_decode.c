@@ -0,0 +1,441 @@
+/**
+ * @file chimera_decode.c
+ * @brief Host-side stream splitter and telemetry record decoder
+ */
+#include "chimera_decode.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+// ---------------- Schema table ----------------
+
+typedef struct {
+  uint8_t type;
+  const char *name;
+  size_t min_len;   // Body size of schema version 1
+  size_t body_len;  // Body size of the newest layout this decoder knows
+  size_t tail_off;  // Offset of the tail length field in the body
+  size_t tail_size; // Width of the tail length field (0 = no tail)
+} chimera_schema_t;
+
+#define SCHEMA(t, n, s, f, w)                                                  \
+  { t, n, sizeof(s), sizeof(s), offsetof(s, f), w }
+#define SCHEMA_NO_TAIL(t, n, s)                                                \
+  { t, n, sizeof(s), sizeof(s), 0, 0 }
+// Layout grew since v1: v1 bodies end where field f starts
+#define SCHEMA_GROWN(t, n, s, f)                                               \
+  { t, n, offsetof(s, f), sizeof(s), 0, 0 }
+
+static const chimera_schema_t SCHEMAS[] = {
+    SCHEMA(CHIMERA_MSG_CSI_DATA, "csi", chimera_csi_t, len, 2),
+    SCHEMA(CHIMERA_MSG_WIFI_AP, "wifi_ap", chimera_wifi_ap_t, ssid_len, 1),
+    SCHEMA_NO_TAIL(CHIMERA_MSG_WIFI_SCAN_DONE, "wifi_scan_done",
+                   chimera_wifi_scan_done_t),
+    SCHEMA(CHIMERA_MSG_CLIENT_PROBE, "client_probe", chimera_client_probe_t,
+           ssid_len, 1),
+    SCHEMA(CHIMERA_MSG_RECON_BEACON, "recon_beacon", chimera_recon_beacon_t,
+           ssid_len, 1),
+    SCHEMA_NO_TAIL(CHIMERA_MSG_PULSE, "pulse", chimera_pulse_t),
+    SCHEMA_GROWN(CHIMERA_MSG_SNIFF_STATS, "sniff_stats", chimera_sniff_stats_t,
+                 dropped_full),
+    SCHEMA_GROWN(CHIMERA_MSG_SYS_STATUS, "sys_status", chimera_sys_status_t,
+                 agg_ratio_x100),
+    SCHEMA(CHIMERA_MSG_BLE_DEVICE, "ble_device", chimera_ble_device_t,
+           name_len, 1),
+    SCHEMA_NO_TAIL(CHIMERA_MSG_BLE_SCAN_DONE, "ble_scan_done",
+                   chimera_ble_scan_done_t),
+    SCHEMA(CHIMERA_MSG_HANDSHAKE, "handshake", chimera_handshake_t, eapol_len,
+           2),
+    SCHEMA(CHIMERA_MSG_LOG, "log", chimera_log_t, text_len, 1),
+    SCHEMA(CHIMERA_MSG_RAW_FRAME, "raw_frame", chimera_raw_frame_t, cap_len,
+           2),
+    SCHEMA(CHIMERA_MSG_FILE_CHUNK, "file_chunk", chimera_file_chunk_t,
+           data_len, 2),
+    SCHEMA(CHIMERA_MSG_AP_UPDATE, "ap_update", chimera_ap_update_t, ssid_len,
+           1),
+    SCHEMA(CHIMERA_MSG_PROBE_UPDATE, "probe_update", chimera_probe_update_t,
+           ssid_len, 1),
+    SCHEMA_NO_TAIL(CHIMERA_MSG_HOP_STATS, "hop_stats", chimera_hop_stats_t),
+    SCHEMA_NO_TAIL(CHIMERA_MSG_SURVEY, "survey", chimera_survey_t),
+    SCHEMA(CHIMERA_MSG_CSI_FEATURES, "csi_features", chimera_csi_features_t,
+           len, 2),
+    SCHEMA_NO_TAIL(CHIMERA_MSG_RADIO_MODE, "radio_mode", chimera_radio_mode_t),
+};
+
+#define SCHEMA_COUNT (sizeof(SCHEMAS) / sizeof(SCHEMAS[0]))
+
+static const chimera_schema_t *find_schema(uint8_t type) {
+  for (size_t i = 0; i < SCHEMA_COUNT; i++) {
+    if (SCHEMAS[i].type == type)
+      return &SCHEMAS[i];
+  }
+  return NULL;
+}
+
+// ---------------- COBS ----------------
+
+size_t chimera_cobs_decode(const uint8_t *input, size_t length,
+                           uint8_t *output) {
+  size_t read = 0;
+  size_t write = 0;
+
+  while (read < length) {
+    uint8_t code = input[read++];
+    if (code == 0 || read + code - 1 > length)
+      return 0;
+
+    for (uint8_t i = 1; i < code; i++) {
+      output[write++] = input[read++];
+    }
+    if (code != 0xFF && read < length) {
+      output[write++] = 0x00;
+    }
+  }
+  return write;
+}
+
+uint32_t chimera_crc32(uint32_t crc, const uint8_t *data, size_t len) {
+  crc = ~crc;
+  while (len--) {
+    crc ^= *data++;
+    for (int k = 0; k < 8; k++)
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+  }
+  return ~crc;
+}
+
+size_t chimera_cobs_encode(const uint8_t *input, size_t length,
+                           uint8_t *output) {
+  size_t read = 0;
+  size_t write = 1;
+  size_t code_pos = 0;
+  uint8_t code = 1;
+
+  while (read < length) {
+    if (input[read] == 0) {
+      output[code_pos] = code;
+      code = 1;
+      code_pos = write++;
+      read++;
+    } else {
+      output[write++] = input[read++];
+      if (++code == 0xFF) {
+        output[code_pos] = code;
+        code = 1;
+        code_pos = write++;
+      }
+    }
+  }
+  output[code_pos] = code;
+  return write;
+}
+
+// ---------------- Host -> device frames ----------------
+
+size_t chimera_credit_frame(uint8_t flags, uint32_t bytes,
+                            uint8_t out[CHIMERA_CREDIT_FRAME_MAX]) {
+  const uint8_t raw[6] = {CHIMERA_FRAME_CREDIT,   flags,
+                          (uint8_t)bytes,         (uint8_t)(bytes >> 8),
+                          (uint8_t)(bytes >> 16), (uint8_t)(bytes >> 24)};
+  size_t n = 0;
+  out[n++] = 0x00;
+  n += chimera_cobs_encode(raw, sizeof(raw), &out[n]);
+  out[n++] = 0x00;
+  return n;
+}
+
+size_t chimera_retransmit_frame(uint16_t seq, uint8_t count,
+                                uint8_t out[CHIMERA_RETRANSMIT_FRAME_MAX]) {
+  const uint8_t raw[4] = {CHIMERA_FRAME_RETRANSMIT, (uint8_t)seq,
+                          (uint8_t)(seq >> 8), count};
+  size_t n = 0;
+  out[n++] = 0x00;
+  n += chimera_cobs_encode(raw, sizeof(raw), &out[n]);
+  out[n++] = 0x00;
+  return n;
+}
+
+// ---------------- Stream splitter ----------------
+
+void chimera_stream_init(chimera_stream_t *st, const chimera_stream_cb_t *cb) {
+  memset(st, 0, sizeof(*st));
+  if (cb)
+    st->cb = *cb;
+}
+
+double chimera_loss_rate(const chimera_seq_stats_t *s) {
+  uint64_t expected = s->frames - s->late + s->lost;
+  return expected ? (double)s->lost / (double)expected : 0.0;
+}
+
+static void stream_track_seq(chimera_stream_t *st, uint8_t cls, uint16_t seq) {
+  chimera_seq_stats_t *s = &st->seq[cls];
+  s->frames++;
+
+  if (!s->started) {
+    s->started = true;
+    s->next_seq = (uint16_t)(seq + 1);
+    return;
+  }
+
+  uint16_t ahead = (uint16_t)(seq - s->next_seq);
+  if (ahead < 0x8000) {
+    if (ahead > 0) {
+      s->lost += ahead;
+      if (st->cb.on_gap)
+        st->cb.on_gap(st->cb.ctx, cls, s->next_seq, ahead);
+    }
+    s->next_seq = (uint16_t)(seq + 1);
+  } else {
+    // Behind the sequence: a re-sent (or reordered) frame filling a gap
+    s->late++;
+    if (s->lost > 0)
+      s->lost--;
+  }
+}
+
+static void stream_emit_frame(chimera_stream_t *st) {
+  size_t n = chimera_cobs_decode(st->buf, st->len, st->buf);
+  if (n <= CHIMERA_FRAME_TRAILER_LEN) {
+    st->bad_frames++;
+    return;
+  }
+
+  n -= CHIMERA_FRAME_TRAILER_LEN;
+  const uint8_t *t = st->buf + n;
+  st->trailer.cls = t[0];
+  st->trailer.seq = (uint16_t)(t[1] | (t[2] << 8));
+  st->trailer.crc = (uint32_t)t[3] | ((uint32_t)t[4] << 8) |
+                    ((uint32_t)t[5] << 16) | ((uint32_t)t[6] << 24);
+
+  if (chimera_crc32(0, st->buf, n + 3) != st->trailer.crc) {
+    st->bad_crc++;
+    return;
+  }
+  if (st->trailer.cls >= CHIMERA_CLASS_COUNT) {
+    st->bad_frames++;
+    return;
+  }
+
+  st->frames++;
+  stream_track_seq(st, st->trailer.cls, st->trailer.seq);
+  if (st->cb.on_frame)
+    st->cb.on_frame(st->cb.ctx, st->buf, n);
+}
+
+static void stream_emit_text(chimera_stream_t *st) {
+  size_t n = st->len;
+  if (n > 0 && st->buf[n - 1] == '\r')
+    n--;
+  if (n == 0)
+    return;
+  st->buf[n] = '\0';
+  st->lines++;
+  if (st->cb.on_text)
+    st->cb.on_text(st->cb.ctx, (const char *)st->buf, n);
+}
+
+void chimera_stream_feed(chimera_stream_t *st, const uint8_t *data,
+                         size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    uint8_t b = data[i];
+
+    switch (st->state) {
+    case CHIMERA_STREAM_IDLE:
+      // A delimiter opens a binary frame; anything else starts a line
+      if (b == 0x00) {
+        st->state = CHIMERA_STREAM_BINARY;
+      } else if (b != '\n') {
+        st->state = CHIMERA_STREAM_TEXT;
+        st->buf[0] = b;
+        st->len = 1;
+      }
+      break;
+
+    case CHIMERA_STREAM_TEXT:
+      if (b == '\n') {
+        stream_emit_text(st);
+        st->len = 0;
+        st->state = CHIMERA_STREAM_IDLE;
+      } else if (b == 0x00) {
+        // Line cut short by a frame (device reset mid-line)
+        stream_emit_text(st);
+        st->len = 0;
+        st->state = CHIMERA_STREAM_BINARY;
+      } else if (st->len < CHIMERA_STREAM_MAX) {
+        st->buf[st->len++] = b;
+      } else {
+        st->overflows++;
+        st->state = CHIMERA_STREAM_DISCARD;
+      }
+      break;
+
+    case CHIMERA_STREAM_BINARY:
+      if (b == 0x00) {
+        // Back-to-back delimiters are empty frames; stay in binary mode
+        if (st->len > 0) {
+          stream_emit_frame(st);
+          st->len = 0;
+          st->state = CHIMERA_STREAM_IDLE;
+        }
+      } else if (st->len < CHIMERA_STREAM_MAX) {
+        st->buf[st->len++] = b;
+      } else {
+        st->overflows++;
+        st->state = CHIMERA_STREAM_DISCARD;
+      }
+      break;
+
+    case CHIMERA_STREAM_DISCARD:
+      if (b == 0x00 || b == '\n') {
+        st->len = 0;
+        st->state = CHIMERA_STREAM_IDLE;
+      }
+      break;
+    }
+  }
+}
+
+// ---------------- Record decoder ----------------
+
+bool chimera_is_record_type(uint8_t type) { return find_schema(type) != NULL; }
+
+const char *chimera_msg_name(uint8_t type) {
+  const chimera_schema_t *s = find_schema(type);
+  return s ? s->name : NULL;
+}
+
+chimera_decode_status_t chimera_decode_record(const uint8_t *frame, size_t len,
+                                              chimera_record_t *out) {
+  memset(out, 0, sizeof(*out));
+  if (len < sizeof(chimera_rec_hdr_t))
+    return CHIMERA_DECODE_SHORT;
+
+  const chimera_schema_t *s = find_schema(frame[0]);
+  if (!s)
+    return CHIMERA_DECODE_UNKNOWN_TYPE;
+
+  out->type = frame[0];
+  out->version = frame[1];
+  if (out->version == 0)
+    return CHIMERA_DECODE_BAD_VERSION;
+
+  const uint8_t *body = frame + sizeof(chimera_rec_hdr_t);
+  size_t avail = len - sizeof(chimera_rec_hdr_t);
+  if (avail < s->min_len)
+    return CHIMERA_DECODE_SHORT;
+
+  // The tail follows the body; newer versions may only append body fields
+  // before it, so its length field is always at the same offset
+  size_t tail_len = 0;
+  if (s->tail_size != 0) {
+    tail_len = body[s->tail_off];
+    if (s->tail_size == 2)
+      tail_len |= (size_t)body[s->tail_off + 1] << 8;
+    if (tail_len > avail - s->min_len)
+      return CHIMERA_DECODE_TAIL_TRUNCATED;
+  }
+
+  // Fields missing from older versions read as zero
+  out->body_len = avail - tail_len;
+  memcpy(&out->u, body,
+         (out->body_len < s->body_len) ? out->body_len : s->body_len);
+  out->tail = tail_len ? frame + len - tail_len : NULL;
+  out->tail_len = tail_len;
+  return CHIMERA_DECODE_OK;
+}
+
+bool chimera_batch_next(const uint8_t *frame, size_t len, size_t *off,
+                        const uint8_t **rec, size_t *rec_len) {
+  if (len < sizeof(chimera_rec_hdr_t) || frame[0] != CHIMERA_MSG_BATCH)
+    return false;
+
+  size_t pos = (*off == 0) ? sizeof(chimera_rec_hdr_t) : *off;
+  if (pos >= len)
+    return false;
+
+  size_t n = frame[pos];
+  if (n == 0 || n > len - pos - 1)
+    return false;
+
+  *rec = frame + pos + 1;
+  *rec_len = n;
+  *off = pos + 1 + n;
+  return true;
+}
+
+// ---------------- Radiotap ----------------
+
+// Radiotap field numbers and flags used below
+#define RT_FLAGS 1
+#define RT_RATE 2
+#define RT_CHANNEL 3
+#define RT_DBM_ANTSIGNAL 5
+#define RT_DBM_ANTNOISE 6
+#define RT_MCS 19
+
+#define RT_F_SHORTPRE 0x02
+#define RT_F_FCS 0x10
+#define RT_CHAN_CCK 0x0020
+#define RT_CHAN_OFDM 0x0040
+#define RT_CHAN_2GHZ 0x0080
+#define RT_MCS_HAVE_BW 0x01
+#define RT_MCS_HAVE_MCS 0x02
+#define RT_MCS_HAVE_GI 0x04
+#define RT_MCS_BW_40 0x01
+#define RT_MCS_SGI 0x04
+
+static void put_le16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+size_t chimera_radiotap_header(const chimera_raw_frame_t *f,
+                               uint8_t out[CHIMERA_RADIOTAP_MAX]) {
+  uint32_t present = (1u << RT_FLAGS) | (1u << RT_CHANNEL) |
+                     (1u << RT_DBM_ANTSIGNAL) | (1u << RT_DBM_ANTNOISE);
+  bool ht = (f->flags & CHIMERA_RAW_HT) != 0;
+  present |= ht ? (1u << RT_MCS) : (1u << RT_RATE);
+
+  // Fields follow the 8-byte header in bit order, each naturally aligned
+  size_t n = 8;
+  uint8_t flags = 0;
+  if (f->flags & CHIMERA_RAW_FCS)
+    flags |= RT_F_FCS;
+  if (f->flags & CHIMERA_RAW_SHORT_PRE)
+    flags |= RT_F_SHORTPRE;
+  out[n++] = flags;
+  out[n++] = ht ? 0 : f->rate; // Pad byte when RATE is absent
+
+  uint16_t freq = (f->channel == 14) ? 2484 : (uint16_t)(2407 + 5 * f->channel);
+  bool cck = !ht && (f->rate == 2 || f->rate == 4 || f->rate == 11 ||
+                     f->rate == 22);
+  put_le16(out + n, freq);
+  put_le16(out + n + 2,
+           RT_CHAN_2GHZ | (cck ? RT_CHAN_CCK : RT_CHAN_OFDM));
+  n += 4;
+  out[n++] = (uint8_t)f->rssi;
+  out[n++] = (uint8_t)f->noise_floor;
+
+  if (ht) {
+    out[n++] = RT_MCS_HAVE_BW | RT_MCS_HAVE_MCS | RT_MCS_HAVE_GI;
+    out[n++] = ((f->flags & CHIMERA_RAW_40MHZ) ? RT_MCS_BW_40 : 0) |
+               ((f->flags & CHIMERA_RAW_SHORT_GI) ? RT_MCS_SGI : 0);
+    out[n++] = f->mcs;
+  }
+
+  out[0] = 0; // Version
+  out[1] = 0; // Pad
+  put_le16(out + 2, (uint16_t)n);
+  out[4] = (uint8_t)present;
+  out[5] = (uint8_t)(present >> 8);
+  out[6] = (uint8_t)(present >> 16);
+  out[7] = (uint8_t)(present >> 24);
+  return n;
+}
+
+void chimera_format_mac(const uint8_t mac[6], char out[18]) {
+  snprintf(out, 18, "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2],
+           mac[3], mac[4], mac[5]);
+}
@@ -0,0 +1,266 @@
+/**
+ * @file chimera_decode.h
+ * @brief Host-side decoder for the Chimera Red serial stream
+ *
+ * Splits the device byte stream into text lines (JSON status / log output)
+ * and COBS frames, and decodes binary telemetry records defined in
+ * chimera_proto.h. Also builds the few host -> device frames the tools need
+ * (flow-control credit). Plain C11, no dependencies beyond libc; usable from
+ * C++.
+ */
+#pragma once
+
+#include "chimera_proto.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest frame or text line the stream splitter will buffer
+#define CHIMERA_STREAM_MAX 4096
+
+// ---------------- Stream splitter ----------------
+
+typedef enum {
+  CHIMERA_STREAM_IDLE = 0,
+  CHIMERA_STREAM_TEXT,
+  CHIMERA_STREAM_BINARY,
+  CHIMERA_STREAM_DISCARD,
+} chimera_stream_state_t;
+
+/**
+ * @brief Stream callbacks
+ *
+ * on_frame receives the COBS-decoded frame with its integrity trailer
+ * checked and stripped (first byte is the frame type); the trailer is in
+ * chimera_stream_t.trailer during the call. on_text receives one line
+ * without the trailing newline. on_gap reports count frames of class cls
+ * that never arrived, starting at sequence number first_seq. Pointers are
+ * only valid during the call. Any callback may be NULL.
+ */
+typedef struct {
+  void (*on_frame)(void *ctx, const uint8_t *frame, size_t len);
+  void (*on_text)(void *ctx, const char *line, size_t len);
+  void (*on_gap)(void *ctx, uint8_t cls, uint16_t first_seq, uint16_t count);
+  void *ctx;
+} chimera_stream_cb_t;
+
+// Per-class sequence tracking
+typedef struct {
+  bool started;
+  uint16_t next_seq; // Sequence number expected next
+  uint64_t frames;   // Frames received (including late ones)
+  uint64_t lost;     // Frames missing from the sequence
+  uint64_t late;     // Frames that arrived behind the sequence (re-sent)
+} chimera_seq_stats_t;
+
+typedef struct {
+  chimera_stream_state_t state;
+  size_t len;
+  uint8_t buf[CHIMERA_STREAM_MAX + 1];
+  chimera_stream_cb_t cb;
+  chimera_frame_trailer_t trailer; // Of the frame being delivered
+
+  // Counters
+  uint64_t frames;
+  uint64_t lines;
+  uint64_t bad_frames; // COBS decode failures, missing trailers
+  uint64_t bad_crc;    // Trailer CRC mismatches
+  uint64_t overflows;  // Frames/lines longer than CHIMERA_STREAM_MAX
+  chimera_seq_stats_t seq[CHIMERA_CLASS_COUNT];
+} chimera_stream_t;
+
+/**
+ * @brief Reset a stream splitter
+ */
+void chimera_stream_init(chimera_stream_t *st, const chimera_stream_cb_t *cb);
+
+/**
+ * @brief Feed raw bytes read from the device
+ */
+void chimera_stream_feed(chimera_stream_t *st, const uint8_t *data,
+                         size_t len);
+
+/**
+ * @brief Decode COBS (may be done in place: output == input)
+ * @return Decoded length, or 0 if the input is malformed
+ */
+size_t chimera_cobs_decode(const uint8_t *input, size_t length,
+                           uint8_t *output);
+
+/**
+ * @brief CRC-32 as used in frame trailers (IEEE, zlib-compatible chaining)
+ * @param crc 0 to start, or the result of a previous call to continue
+ */
+uint32_t chimera_crc32(uint32_t crc, const uint8_t *data, size_t len);
+
+/**
+ * @brief Fraction of a class's frames lost so far (0.0 - 1.0)
+ */
+double chimera_loss_rate(const chimera_seq_stats_t *s);
+
+/**
+ * @brief COBS-encode length bytes (output needs length + length/254 + 1)
+ * @return Encoded length
+ */
+size_t chimera_cobs_encode(const uint8_t *input, size_t length,
+                           uint8_t *output);
+
+// ---------------- Host -> device frames ----------------
+
+// Frame types and flags (mirror serial_comm.h in the firmware)
+#define CHIMERA_FRAME_CREDIT 0x11
+#define CHIMERA_FRAME_RETRANSMIT 0x12
+#define CHIMERA_CREDIT_RESET 0x01
+#define CHIMERA_CREDIT_OFF 0x02
+
+// Largest frame the builders below produce, delimiters included
+#define CHIMERA_CREDIT_FRAME_MAX 10
+#define CHIMERA_RETRANSMIT_FRAME_MAX 7
+
+// Most frames one retransmit request may ask for
+#define CHIMERA_RETRANSMIT_MAX 8
+
+/**
+ * @brief Build a flow-control credit frame, ready to write to the device
+ *
+ * Open a session with CHIMERA_CREDIT_RESET and the host receive window,
+ * then grant (flags 0) the bytes consumed since the last grant.
+ *
+ * @param out Buffer of at least CHIMERA_CREDIT_FRAME_MAX bytes
+ * @return Frame length
+ */
+size_t chimera_credit_frame(uint8_t flags, uint32_t bytes,
+                            uint8_t out[CHIMERA_CREDIT_FRAME_MAX]);
+
+/**
+ * @brief Build a request to re-send critical frames seq .. seq + count - 1
+ *
+ * The device only retains its last few critical frames; anything older is
+ * gone. Re-sent frames arrive with their original sequence number.
+ *
+ * @param count 1 to CHIMERA_RETRANSMIT_MAX
+ * @param out Buffer of at least CHIMERA_RETRANSMIT_FRAME_MAX bytes
+ * @return Frame length
+ */
+size_t chimera_retransmit_frame(uint16_t seq, uint8_t count,
+                                uint8_t out[CHIMERA_RETRANSMIT_FRAME_MAX]);
+
+// ---------------- Record decoder ----------------
+
+typedef enum {
+  CHIMERA_DECODE_OK = 0,
+  CHIMERA_DECODE_SHORT,         // Body shorter than the v1 layout
+  CHIMERA_DECODE_UNKNOWN_TYPE,  // Not a chimera_msg_type_t
+  CHIMERA_DECODE_BAD_VERSION,   // Schema version 0
+  CHIMERA_DECODE_TAIL_TRUNCATED // Tail length exceeds the frame
+} chimera_decode_status_t;
+
+/**
+ * @brief Decoded telemetry record
+ *
+ * The body is copied out of the frame into the matching union member, so
+ * fields can be read directly. Fields added after the sender's schema
+ * version read as zero; fields from newer versions than this decoder knows
+ * are skipped. body_len reports the body size that was on the wire.
+ */
+typedef struct {
+  uint8_t type;    // chimera_msg_type_t
+  uint8_t version; // Schema version on the wire
+  size_t body_len;
+  union {
+    chimera_wifi_ap_t wifi_ap;
+    chimera_wifi_scan_done_t wifi_scan_done;
+    chimera_client_probe_t client_probe;
+    chimera_recon_beacon_t recon_beacon;
+    chimera_pulse_t pulse;
+    chimera_sniff_stats_t sniff_stats;
+    chimera_sys_status_t sys_status;
+    chimera_ble_device_t ble_device;
+    chimera_ble_scan_done_t ble_scan_done;
+    chimera_handshake_t handshake;
+    chimera_log_t log;
+    chimera_raw_frame_t raw_frame;
+    chimera_file_chunk_t file_chunk;
+    chimera_ap_update_t ap_update;
+    chimera_probe_update_t probe_update;
+    chimera_hop_stats_t hop_stats;
+    chimera_survey_t survey;
+    chimera_csi_t csi;
+    chimera_csi_features_t csi_features;
+    chimera_radio_mode_t radio_mode;
+  } u;
+  const uint8_t *tail; // Points into the frame (SSID, name, EAPOL, log
+                       // text, 802.11 frame, file data, CSI data or
+                       // amplitude profile), or NULL
+  size_t tail_len;
+} chimera_record_t;
+
+/**
+ * @brief Decode one binary record
+ * @param frame COBS-decoded frame (as passed to on_frame)
+ * @param len Frame length
+ * @param out Decoded record; tail points into frame
+ * @return CHIMERA_DECODE_OK on success
+ */
+chimera_decode_status_t chimera_decode_record(const uint8_t *frame, size_t len,
+                                              chimera_record_t *out);
+
+/**
+ * @brief Iterate the records packed in a CHIMERA_MSG_BATCH frame
+ *
+ * Each record returned can be passed to chimera_decode_record().
+ *
+ * @param frame Batch frame (first byte CHIMERA_MSG_BATCH)
+ * @param len Frame length
+ * @param off Cursor; set to 0 before the first call
+ * @param rec Output: start of the next record
+ * @param rec_len Output: record length
+ * @return true if a record was returned, false at the end of the batch (or
+ * if the frame is not a well-formed batch)
+ */
+bool chimera_batch_next(const uint8_t *frame, size_t len, size_t *off,
+                        const uint8_t **rec, size_t *rec_len);
+
+/**
+ * @brief Check whether a frame type is a telemetry record
+ */
+bool chimera_is_record_type(uint8_t type);
+
+/**
+ * @brief Short name of a message type ("wifi_ap", ...), or NULL if unknown
+ */
+const char *chimera_msg_name(uint8_t type);
+
+// ---------------- Capture files ----------------
+
+// pcap link type for chimera_radiotap_header() + 802.11 frame
+#define CHIMERA_LINKTYPE_RADIOTAP 127
+
+// Longest header chimera_radiotap_header() produces
+#define CHIMERA_RADIOTAP_MAX 24
+
+/**
+ * @brief Build the radiotap header for a RAW_FRAME record
+ *
+ * Write it followed by the record tail to get one pcap/pcapng packet of
+ * link type CHIMERA_LINKTYPE_RADIOTAP.
+ *
+ * @param out Buffer of at least CHIMERA_RADIOTAP_MAX bytes
+ * @return Header length
+ */
+size_t chimera_radiotap_header(const chimera_raw_frame_t *f,
+                               uint8_t out[CHIMERA_RADIOTAP_MAX]);
+
+/**
+ * @brief Format a 6-byte MAC as "AA:BB:CC:DD:EE:FF"
+ * @param out Buffer of at least 18 bytes
+ */
+void chimera_format_mac(const uint8_t mac[6], char out[18]);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,472 @@
+/**
+ * @file chimera_dump.c
+ * @brief Print the Chimera Red serial stream as one line per message
+ *
+ * Usage: chimera_dump [-w capture.pcap] [-d dir] [-r stream.bin]
+ *                     [/dev/ttyACM0]
+ *        (reads stdin when no device is given)
+ *
+ * When reading a device, the tool enables flow control: it grants a
+ * DUMP_WINDOW byte receive window and returns credit as it consumes data,
+ * so a slow terminal throttles the device instead of losing frames. Gaps
+ * in the critical frame sequence are requested again from the device.
+ *
+ * With -w, RAW_FRAME records (see the SNIFF_RAW command) are also written
+ * to a pcap file with radiotap headers, ready for Wireshark. With -d,
+ * stored captures pulled from the device (CAPTURE_PULL) are reassembled
+ * into dir/capNNNN.pcapng (and .idx). With -r, the received bytes are
+ * saved as they are, for replay (e.g. CSI through csi_bench).
+ */
+#include "chimera_decode.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <termios.h>
+#include <unistd.h>
+
+// Host receive window advertised to the device
+#define DUMP_WINDOW (16 * 1024)
+
+// ---------------- pcap output ----------------
+
+static FILE *g_pcap = NULL;
+
+// Device timestamps are 32-bit microseconds; unwrap and anchor them to the
+// host clock at the first frame
+static bool g_ts_started = false;
+static uint32_t g_ts_last = 0;
+static uint64_t g_ts_wraps = 0;
+static uint64_t g_ts_base_us = 0;
+
+// Directory for pulled capture files, or NULL
+static const char *g_pull_dir = NULL;
+
+// Raw copy of the input stream (-r), or NULL
+static FILE *g_record = NULL;
+
+static void put_u32(FILE *f, uint32_t v) { fwrite(&v, 4, 1, f); }
+
+static bool pcap_open(const char *path) {
+  g_pcap = fopen(path, "wb");
+  if (!g_pcap)
+    return false;
+
+  // Classic pcap global header, microsecond timestamps, host byte order
+  put_u32(g_pcap, 0xA1B2C3D4);
+  uint16_t ver[2] = {2, 4};
+  fwrite(ver, sizeof(ver), 1, g_pcap);
+  put_u32(g_pcap, 0); // thiszone
+  put_u32(g_pcap, 0); // sigfigs
+  put_u32(g_pcap, CHIMERA_STREAM_MAX);
+  put_u32(g_pcap, CHIMERA_LINKTYPE_RADIOTAP);
+  return true;
+}
+
+static void pcap_write(const chimera_record_t *r) {
+  const chimera_raw_frame_t *f = &r->u.raw_frame;
+
+  if (!g_ts_started) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    g_ts_base_us = (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec -
+                   f->timestamp_us;
+    g_ts_started = true;
+  } else if (f->timestamp_us < g_ts_last &&
+             g_ts_last - f->timestamp_us > 0x80000000u) {
+    g_ts_wraps++;
+  }
+  g_ts_last = f->timestamp_us;
+  uint64_t ts = g_ts_base_us + (g_ts_wraps << 32) + f->timestamp_us;
+
+  uint8_t rt[CHIMERA_RADIOTAP_MAX];
+  size_t rt_len = chimera_radiotap_header(f, rt);
+  put_u32(g_pcap, (uint32_t)(ts / 1000000));
+  put_u32(g_pcap, (uint32_t)(ts % 1000000));
+  put_u32(g_pcap, (uint32_t)(rt_len + r->tail_len));
+  put_u32(g_pcap, (uint32_t)(rt_len + f->orig_len));
+  fwrite(rt, rt_len, 1, g_pcap);
+  fwrite(r->tail, r->tail_len, 1, g_pcap);
+}
+
+// ---------------- Pulled files ----------------
+
+static void pull_write(const chimera_record_t *r) {
+  const chimera_file_chunk_t *c = &r->u.file_chunk;
+  char path[512];
+  snprintf(path, sizeof(path), "%s/cap%04u.%s", g_pull_dir, c->file_id,
+           (c->flags & CHIMERA_FILE_INDEX) ? "idx" : "pcapng");
+
+  int fd = open(path, O_WRONLY | O_CREAT | (c->offset == 0 ? O_TRUNC : 0),
+                0644);
+  if (fd < 0) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return;
+  }
+  if (r->tail_len &&
+      pwrite(fd, r->tail, r->tail_len, c->offset) != (ssize_t)r->tail_len)
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+  close(fd);
+  if (r->tail_len == 0)
+    fprintf(stderr, "pulled %s (%u bytes)\n", path, c->total);
+}
+
+static void print_ssid(const char *key, const uint8_t *s, size_t len) {
+  printf(" %s=\"", key);
+  for (size_t i = 0; i < len; i++) {
+    if (s[i] >= 0x20 && s[i] < 0x7F && s[i] != '"' && s[i] != '\\')
+      putchar(s[i]);
+    else
+      printf("\\x%02X", s[i]);
+  }
+  putchar('"');
+}
+
+static void print_record(const chimera_record_t *r) {
+  char mac[18];
+  char mac2[18];
+
+  printf("%s v%u", chimera_msg_name(r->type), r->version);
+
+  switch (r->type) {
+  case CHIMERA_MSG_WIFI_AP:
+    chimera_format_mac(r->u.wifi_ap.bssid, mac);
+    printf(" bssid=%s ch=%u rssi=%d auth=%u", mac, r->u.wifi_ap.channel,
+           r->u.wifi_ap.rssi, r->u.wifi_ap.authmode);
+    print_ssid("ssid", r->tail, r->tail_len);
+    break;
+  case CHIMERA_MSG_WIFI_SCAN_DONE:
+    printf(" count=%u", r->u.wifi_scan_done.count);
+    break;
+  case CHIMERA_MSG_CLIENT_PROBE:
+    chimera_format_mac(r->u.client_probe.mac, mac);
+    printf(" mac=%s ch=%u rssi=%d", mac, r->u.client_probe.channel,
+           r->u.client_probe.rssi);
+    print_ssid("ssid", r->tail, r->tail_len);
+    break;
+  case CHIMERA_MSG_RECON_BEACON:
+    chimera_format_mac(r->u.recon_beacon.bssid, mac);
+    printf(" bssid=%s ch=%u rssi=%d", mac, r->u.recon_beacon.channel,
+           r->u.recon_beacon.rssi);
+    print_ssid("ssid", r->tail, r->tail_len);
+    break;
+  case CHIMERA_MSG_PULSE:
+    printf(" level=%u ch=%u", r->u.pulse.level, r->u.pulse.channel);
+    break;
+  case CHIMERA_MSG_SNIFF_STATS:
+    printf(" packets=%u m1=%u m2=%u complete=%u dropped_full=%u filtered=%u "
+           "m3=%u m4=%u completed=%u unmatched=%u evicted=%u",
+           r->u.sniff_stats.packets, r->u.sniff_stats.m1, r->u.sniff_stats.m2,
+           r->u.sniff_stats.complete, r->u.sniff_stats.dropped_full,
+           r->u.sniff_stats.filtered, r->u.sniff_stats.m3,
+           r->u.sniff_stats.m4, r->u.sniff_stats.completed,
+           r->u.sniff_stats.unmatched, r->u.sniff_stats.evicted);
+    break;
+  case CHIMERA_MSG_SYS_STATUS:
+    printf(" heap=%u min_heap=%u rssi=%d tx_queued=%u tx_written=%u "
+           "tx_dropped=%u tx_high_water=%u agg_ratio=%.2f agg_lat_avg=%uus "
+           "agg_lat_max=%uus drop_crit=%u drop_state=%u drop_telem=%u",
+           r->u.sys_status.heap, r->u.sys_status.min_heap,
+           r->u.sys_status.rssi, r->u.sys_status.tx_queued,
+           r->u.sys_status.tx_written, r->u.sys_status.tx_dropped,
+           r->u.sys_status.tx_high_water,
+           r->u.sys_status.agg_ratio_x100 / 100.0,
+           r->u.sys_status.agg_latency_avg_us,
+           r->u.sys_status.agg_latency_max_us, r->u.sys_status.drop_critical,
+           r->u.sys_status.drop_state, r->u.sys_status.drop_telemetry);
+    if (r->u.sys_status.fc_credit == UINT32_MAX)
+      printf(" fc=off");
+    else
+      printf(" fc_credit=%u", r->u.sys_status.fc_credit);
+    printf(" fc_stalls=%u", r->u.sys_status.fc_stalls);
+    break;
+  case CHIMERA_MSG_BLE_DEVICE:
+    chimera_format_mac(r->u.ble_device.addr, mac);
+    printf(" addr=%s type=%u rssi=%d mfg=0x%04X", mac,
+           r->u.ble_device.addr_type, r->u.ble_device.rssi,
+           r->u.ble_device.manufacturer_id);
+    print_ssid("name", r->tail, r->tail_len);
+    break;
+  case CHIMERA_MSG_BLE_SCAN_DONE:
+    printf(" count=%u", r->u.ble_scan_done.count);
+    break;
+  case CHIMERA_MSG_HANDSHAKE:
+    chimera_format_mac(r->u.handshake.bssid, mac);
+    chimera_format_mac(r->u.handshake.sta, mac2);
+    printf(" bssid=%s sta=%s ch=%u rssi=%d ver=%u eapol=%u", mac, mac2,
+           r->u.handshake.channel, r->u.handshake.rssi,
+           r->u.handshake.key_desc_version, r->u.handshake.eapol_len);
+    break;
+  case CHIMERA_MSG_LOG:
+    printf(" %c t=%ums", "NEWIDV"[r->u.log.level < 6 ? r->u.log.level : 0],
+           r->u.log.timestamp_ms);
+    if (r->u.log.suppressed)
+      printf(" suppressed=%u", r->u.log.suppressed);
+    printf(" %.*s", (int)r->tail_len, (const char *)r->tail);
+    break;
+  case CHIMERA_MSG_RAW_FRAME:
+    printf(" ch=%u rssi=%d noise=%d len=%u cap=%u", r->u.raw_frame.channel,
+           r->u.raw_frame.rssi, r->u.raw_frame.noise_floor,
+           r->u.raw_frame.orig_len, r->u.raw_frame.cap_len);
+    if (r->u.raw_frame.flags & CHIMERA_RAW_HT)
+      printf(" mcs=%u", r->u.raw_frame.mcs);
+    else
+      printf(" rate=%.1f", r->u.raw_frame.rate / 2.0);
+    if (g_pcap)
+      pcap_write(r);
+    break;
+  case CHIMERA_MSG_FILE_CHUNK:
+    printf(" id=%u%s off=%u len=%u total=%u", r->u.file_chunk.file_id,
+           (r->u.file_chunk.flags & CHIMERA_FILE_INDEX) ? " index" : "",
+           r->u.file_chunk.offset, r->u.file_chunk.data_len,
+           r->u.file_chunk.total);
+    if (g_pull_dir)
+      pull_write(r);
+    break;
+  case CHIMERA_MSG_AP_UPDATE:
+    chimera_format_mac(r->u.ap_update.bssid, mac);
+    printf(" bssid=%s ch=%u auth=%u flags=0x%02X rssi=%d/%d/%d beacons=%u "
+           "seen=%u-%ums",
+           mac, r->u.ap_update.channel, r->u.ap_update.authmode,
+           r->u.ap_update.flags, r->u.ap_update.rssi_min,
+           r->u.ap_update.rssi_avg, r->u.ap_update.rssi_max,
+           r->u.ap_update.beacons, r->u.ap_update.first_seen_ms,
+           r->u.ap_update.last_seen_ms);
+    print_ssid("ssid", r->tail, r->tail_len);
+    break;
+  case CHIMERA_MSG_PROBE_UPDATE:
+    chimera_format_mac(r->u.probe_update.mac, mac);
+    printf(" mac=%s ch=%u flags=0x%02X rssi=%d/%d/%d count=%u seen=%u-%ums",
+           mac, r->u.probe_update.channel, r->u.probe_update.flags,
+           r->u.probe_update.rssi_min, r->u.probe_update.rssi_avg,
+           r->u.probe_update.rssi_max, r->u.probe_update.count,
+           r->u.probe_update.first_seen_ms, r->u.probe_update.last_seen_ms);
+    print_ssid("ssid", r->tail, r->tail_len);
+    break;
+  case CHIMERA_MSG_HOP_STATS:
+    printf(" hops=%u round=%ums latency=%u/%uus lost=%uus dwell=",
+           r->u.hop_stats.hops, r->u.hop_stats.round_ms,
+           r->u.hop_stats.latency_us, r->u.hop_stats.latency_max_us,
+           r->u.hop_stats.lost_us);
+    for (int i = 0; i < 13; i++) {
+      printf("%s%u", i ? "," : "", r->u.hop_stats.dwell_ms[i]);
+    }
+    break;
+  case CHIMERA_MSG_SURVEY:
+    printf(" ch=%u noise=%d interval=%ums mgmt=%u ctrl=%u data=%u bytes=%u "
+           "airtime=%uus retries=%u rssi_hist=",
+           r->u.survey.channel, r->u.survey.noise_floor,
+           r->u.survey.interval_ms, r->u.survey.mgmt, r->u.survey.ctrl,
+           r->u.survey.data, r->u.survey.bytes, r->u.survey.airtime_us,
+           r->u.survey.retries);
+    for (int i = 0; i < CHIMERA_SURVEY_RSSI_BUCKETS; i++) {
+      printf("%s%u", i ? "," : "", r->u.survey.rssi_hist[i]);
+    }
+    break;
+  case CHIMERA_MSG_CSI_DATA:
+    chimera_format_mac(r->u.csi.mac, mac);
+    printf(" mac=%s ch=%u rssi=%d noise=%d seq=%u len=%u dropped=%u", mac,
+           r->u.csi.channel, r->u.csi.rssi, r->u.csi.noise_floor,
+           r->u.csi.rx_seq, r->u.csi.len, r->u.csi.dropped);
+    if (r->u.csi.flags & CHIMERA_CSI_HT)
+      printf(" mcs=%u", r->u.csi.mcs);
+    if (r->u.csi.flags & CHIMERA_CSI_TRUNCATED)
+      printf(" truncated");
+    break;
+  case CHIMERA_MSG_CSI_FEATURES: {
+    const chimera_csi_features_t *f = &r->u.csi_features;
+    chimera_format_mac(f->mac, mac);
+    printf(" mac=%s ch=%u rssi=%d noise=%d reports=%u score=%u max=%u "
+           "amp=%.2f phase_rms=%.3f cycles=%u dropped=%u",
+           mac, f->channel, f->rssi, f->noise_floor, f->reports, f->score,
+           f->score_max, f->amp_mean / 16.0, f->phase_rms / 4096.0, f->cycles,
+           f->dropped);
+    if (f->flags & CHIMERA_CSI_MOTION)
+      printf(" motion");
+    if (f->flags & CHIMERA_CSI_EVENT)
+      printf(" event");
+    printf(" profile=");
+    for (size_t i = 0; i < r->tail_len; i++) {
+      printf("%s%u", i ? "," : "", r->tail[i]);
+    }
+    break;
+  }
+  case CHIMERA_MSG_RADIO_MODE: {
+    static const char *const modes[] = {"idle", "scan", "monitor",
+                                        "monitor_csi"};
+    const chimera_radio_mode_t *m = &r->u.radio_mode;
+    printf(" from=%s to=%s latency=%uus",
+           m->from < 4 ? modes[m->from] : "?", m->to < 4 ? modes[m->to] : "?",
+           m->latency_us);
+    break;
+  }
+  }
+  putchar('\n');
+}
+
+static void on_frame(void *ctx, const uint8_t *frame, size_t len) {
+  if (frame[0] == CHIMERA_MSG_BATCH) {
+    size_t off = 0;
+    const uint8_t *rec;
+    size_t rec_len;
+    while (chimera_batch_next(frame, len, &off, &rec, &rec_len)) {
+      on_frame(ctx, rec, rec_len);
+    }
+    return;
+  }
+
+  if (!chimera_is_record_type(frame[0])) {
+    printf("frame type=0x%02X len=%zu\n", frame[0], len);
+    return;
+  }
+
+  chimera_record_t rec;
+  chimera_decode_status_t st = chimera_decode_record(frame, len, &rec);
+  if (st != CHIMERA_DECODE_OK) {
+    printf("bad %s record (status %d, len %zu)\n", chimera_msg_name(frame[0]),
+           (int)st, len);
+    return;
+  }
+  print_record(&rec);
+}
+
+static void on_text(void *ctx, const char *line, size_t len) {
+  (void)ctx;
+  printf("text %.*s\n", (int)len, line);
+}
+
+static void send_credit(int fd, uint8_t flags, uint32_t bytes) {
+  uint8_t frame[CHIMERA_CREDIT_FRAME_MAX];
+  size_t n = chimera_credit_frame(flags, bytes, frame);
+  if (write(fd, frame, n) != (ssize_t)n)
+    fprintf(stderr, "credit write failed: %s\n", strerror(errno));
+}
+
+// ctx: device fd, or -1 when reading a capture from stdin
+static void on_gap(void *ctx, uint8_t cls, uint16_t first_seq,
+                   uint16_t count) {
+  int fd = *(const int *)ctx;
+  printf("gap class=%u seq=%u lost=%u\n", cls, first_seq, count);
+  if (fd < 0 || cls != CHIMERA_CLASS_CRITICAL)
+    return;
+
+  // Only the newest frames are still retained on the device
+  if (count > CHIMERA_RETRANSMIT_MAX) {
+    first_seq = (uint16_t)(first_seq + count - CHIMERA_RETRANSMIT_MAX);
+    count = CHIMERA_RETRANSMIT_MAX;
+  }
+  uint8_t frame[CHIMERA_RETRANSMIT_FRAME_MAX];
+  size_t n = chimera_retransmit_frame(first_seq, (uint8_t)count, frame);
+  if (write(fd, frame, n) != (ssize_t)n)
+    fprintf(stderr, "retransmit write failed: %s\n", strerror(errno));
+}
+
+static int open_tty(const char *path) {
+  int fd = open(path, O_RDWR | O_NOCTTY);
+  if (fd < 0)
+    return -1;
+
+  struct termios tio;
+  if (tcgetattr(fd, &tio) == 0) {
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, B115200);
+    cfsetospeed(&tio, B115200);
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+  return fd;
+}
+
+int main(int argc, char **argv) {
+  int fd = STDIN_FILENO;
+  int dev_fd = -1;
+  bool flow_control = false;
+  int arg = 1;
+  while (arg + 1 < argc && argv[arg][0] == '-') {
+    if (strcmp(argv[arg], "-w") == 0) {
+      if (!pcap_open(argv[arg + 1])) {
+        fprintf(stderr, "%s: %s\n", argv[arg + 1], strerror(errno));
+        return 1;
+      }
+    } else if (strcmp(argv[arg], "-d") == 0) {
+      g_pull_dir = argv[arg + 1];
+    } else if (strcmp(argv[arg], "-r") == 0) {
+      g_record = fopen(argv[arg + 1], "wb");
+      if (!g_record) {
+        fprintf(stderr, "%s: %s\n", argv[arg + 1], strerror(errno));
+        return 1;
+      }
+    } else {
+      fprintf(stderr,
+              "usage: %s [-w capture.pcap] [-d dir] [-r stream.bin] "
+              "[device]\n",
+              argv[0]);
+      return 1;
+    }
+    arg += 2;
+  }
+  if (arg < argc) {
+    fd = open_tty(argv[arg]);
+    if (fd < 0) {
+      fprintf(stderr, "%s: %s\n", argv[arg], strerror(errno));
+      return 1;
+    }
+    send_credit(fd, CHIMERA_CREDIT_RESET, DUMP_WINDOW);
+    flow_control = true;
+    dev_fd = fd;
+  }
+
+  static chimera_stream_t stream;
+  chimera_stream_cb_t cb = {.on_frame = on_frame,
+                            .on_text = on_text,
+                            .on_gap = on_gap,
+                            .ctx = &dev_fd};
+  chimera_stream_init(&stream, &cb);
+
+  uint8_t buf[4096];
+  uint32_t consumed = 0; // Bytes processed since the last grant
+  for (;;) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    if (g_record)
+      fwrite(buf, 1, (size_t)n, g_record);
+    chimera_stream_feed(&stream, buf, (size_t)n);
+    fflush(stdout);
+    if (g_pcap)
+      fflush(g_pcap);
+
+    // Grant back in half-window steps to keep credit frames rare
+    consumed += (uint32_t)n;
+    if (flow_control && consumed >= DUMP_WINDOW / 2) {
+      send_credit(fd, 0, consumed);
+      consumed = 0;
+    }
+  }
+
+  fprintf(stderr,
+          "frames=%llu lines=%llu bad=%llu bad_crc=%llu overflows=%llu\n",
+          (unsigned long long)stream.frames, (unsigned long long)stream.lines,
+          (unsigned long long)stream.bad_frames,
+          (unsigned long long)stream.bad_crc,
+          (unsigned long long)stream.overflows);
+  static const char *const class_names[CHIMERA_CLASS_COUNT] = {
+      "critical", "state", "telemetry"};
+  for (int c = 0; c < CHIMERA_CLASS_COUNT; c++) {
+    const chimera_seq_stats_t *s = &stream.seq[c];
+    if (s->frames == 0 && s->lost == 0)
+      continue;
+    fprintf(stderr, "%s: frames=%llu lost=%llu late=%llu loss=%.2f%%\n",
+            class_names[c], (unsigned long long)s->frames,
+            (unsigned long long)s->lost, (unsigned long long)s->late,
+            100.0 * chimera_loss_rate(s));
+  }
+  if (g_pcap)
+    fclose(g_pcap);
+  if (g_record)
+    fclose(g_record);
+  return 0;
+}
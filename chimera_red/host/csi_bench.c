@@ -0,0 +1,233 @@
+/**
+ * @file csi_bench.c
+ * @brief Replay recorded CSI through the firmware's feature kernels
+ *
+ * Usage: csi_bench [-v] [-n passes] [-t on,off] [capture.bin]
+ *        (reads stdin when no file is given)
+ *
+ * The input is a recording of the device's serial stream taken with CSI in
+ * raw mode (CSI_OUTPUT:raw), e.g. chimera_dump -r capture.bin. Every
+ * CSI_DATA record goes through the same csi_dsp.c the firmware runs, and
+ * one line per report is printed: the reference output to diff against
+ * after changing a kernel. -v adds the amplitude (Q4) and sanitized phase
+ * (Q12 radians) vectors. The summary on stderr gives the kernel time per
+ * report; -n replays the capture several times for a steadier figure.
+ *
+ * test/csi_capture.bin and its reference output are checked by ctest.
+ */
+#include "chimera_decode.h"
+#include "csi_dsp.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_SOURCES 64 // Transmitters with their own motion window
+
+typedef struct {
+  chimera_csi_t rec;
+  int8_t *data;
+} bench_report_t;
+
+typedef struct {
+  uint8_t mac[6];
+  csi_motion_t motion;
+} bench_source_t;
+
+static bench_report_t *g_reports = NULL;
+static size_t g_count = 0;
+static size_t g_cap = 0;
+
+static bench_source_t g_sources[BENCH_SOURCES];
+static int g_source_count = 0;
+
+// ---------------- Capture ----------------
+
+static void on_frame(void *ctx, const uint8_t *frame, size_t len) {
+  if (frame[0] == CHIMERA_MSG_BATCH) {
+    size_t off = 0;
+    const uint8_t *rec;
+    size_t rec_len;
+    while (chimera_batch_next(frame, len, &off, &rec, &rec_len)) {
+      on_frame(ctx, rec, rec_len);
+    }
+    return;
+  }
+  if (frame[0] != CHIMERA_MSG_CSI_DATA)
+    return;
+
+  chimera_record_t r;
+  if (chimera_decode_record(frame, len, &r) != CHIMERA_DECODE_OK)
+    return;
+  if (g_count == g_cap) {
+    g_cap = g_cap ? g_cap * 2 : 1024;
+    g_reports = realloc(g_reports, g_cap * sizeof(*g_reports));
+    if (!g_reports) {
+      perror("realloc");
+      exit(1);
+    }
+  }
+  bench_report_t *b = &g_reports[g_count++];
+  b->rec = r.u.csi;
+  b->rec.len = (uint16_t)r.tail_len;
+  b->data = malloc(r.tail_len ? r.tail_len : 1);
+  if (!b->data) {
+    perror("malloc");
+    exit(1);
+  }
+  memcpy(b->data, r.tail, r.tail_len);
+}
+
+static bool load(FILE *in) {
+  static chimera_stream_t stream;
+  chimera_stream_cb_t cb = {.on_frame = on_frame};
+  chimera_stream_init(&stream, &cb);
+
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+    chimera_stream_feed(&stream, buf, n);
+  }
+  return !ferror(in);
+}
+
+// ---------------- Replay ----------------
+
+static csi_motion_t *motion_for(const uint8_t *mac) {
+  for (int i = 0; i < g_source_count; i++) {
+    if (memcmp(g_sources[i].mac, mac, 6) == 0)
+      return &g_sources[i].motion;
+  }
+  if (g_source_count == BENCH_SOURCES)
+    return NULL;
+  bench_source_t *s = &g_sources[g_source_count++];
+  memcpy(s->mac, mac, 6);
+  csi_motion_reset(&s->motion);
+  return &s->motion;
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void print_report(const chimera_csi_t *rec, const uint16_t *amp,
+                         const int16_t *phase, uint16_t phase_rms,
+                         const csi_motion_t *m, bool verbose) {
+  char mac[18];
+  chimera_format_mac(rec->mac, mac);
+  uint32_t total = 0;
+  for (int k = 0; k < CSI_DSP_SC; k++) {
+    total += amp[k];
+  }
+  printf("ts=%u mac=%s seq=%u rssi=%d amp=%u phase_rms=%u score=%u%s",
+         rec->timestamp_us, mac, rec->rx_seq, rec->rssi, total / CSI_DSP_SC,
+         phase_rms, m->score, m->active ? " motion" : "");
+  if (verbose) {
+    printf(" amp=");
+    for (int k = 0; k < CSI_DSP_SC; k++) {
+      printf("%s%u", k ? "," : "", amp[k]);
+    }
+    printf(" phase=");
+    for (int k = 0; k < CSI_DSP_SC; k++) {
+      printf("%s%d", k ? "," : "", phase[k]);
+    }
+  }
+  putchar('\n');
+}
+
+/**
+ * @brief Run every report through the kernels once
+ * @return Nanoseconds spent in the kernels
+ */
+static uint64_t replay(bool print, bool verbose, uint16_t on, uint16_t off,
+                       size_t *done, size_t *skipped) {
+  uint64_t ns = 0;
+  g_source_count = 0;
+  for (size_t i = 0; i < g_count; i++) {
+    const bench_report_t *b = &g_reports[i];
+    csi_motion_t *m = motion_for(b->rec.mac);
+    int8_t iq[CSI_DSP_SC][2];
+    uint16_t amp[CSI_DSP_SC];
+    int16_t phase[CSI_DSP_SC];
+
+    uint64_t t0 = now_ns();
+    if (!m || b->rec.secondary != 0 ||
+        !csi_dsp_lltf(b->data, b->rec.len,
+                      b->rec.flags & CHIMERA_CSI_FIRST_INVALID, iq)) {
+      (*skipped)++;
+      continue;
+    }
+    csi_dsp_polar(iq, amp, phase);
+    uint16_t phase_rms = csi_dsp_sanitize(phase);
+    csi_motion_update(m, amp, on, off);
+    ns += now_ns() - t0;
+    (*done)++;
+
+    if (print)
+      print_report(&b->rec, amp, phase, phase_rms, m, verbose);
+  }
+  return ns;
+}
+
+int main(int argc, char **argv) {
+  bool verbose = false;
+  long passes = 1;
+  unsigned on = CSI_MOTION_ON;
+  unsigned off = CSI_MOTION_OFF;
+  int arg = 1;
+  while (arg < argc && argv[arg][0] == '-' && argv[arg][1]) {
+    if (strcmp(argv[arg], "-v") == 0) {
+      verbose = true;
+      arg++;
+    } else if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc) {
+      passes = strtol(argv[arg + 1], NULL, 10);
+      arg += 2;
+    } else if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc &&
+               sscanf(argv[arg + 1], "%u,%u", &on, &off) == 2) {
+      arg += 2;
+    } else {
+      fprintf(stderr, "usage: %s [-v] [-n passes] [-t on,off] [capture]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  if (passes < 1 || on > UINT16_MAX || off > on) {
+    fprintf(stderr, "invalid -n or -t\n");
+    return 1;
+  }
+
+  FILE *in = stdin;
+  if (arg < argc) {
+    in = fopen(argv[arg], "rb");
+    if (!in) {
+      fprintf(stderr, "%s: %s\n", argv[arg], strerror(errno));
+      return 1;
+    }
+  }
+  if (!load(in)) {
+    fprintf(stderr, "read failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  uint64_t ns = 0;
+  size_t done = 0;
+  size_t skipped = 0;
+  for (long p = 0; p < passes; p++) {
+    ns += replay(p == 0, verbose, (uint16_t)on, (uint16_t)off, &done,
+                 &skipped);
+  }
+
+  fprintf(stderr,
+          "reports=%zu sources=%d skipped=%zu passes=%ld ns/report=%.1f\n",
+          g_count, g_source_count, skipped / passes, passes,
+          done ? (double)ns / done : 0.0);
+  for (size_t i = 0; i < g_count; i++) {
+    free(g_reports[i].data);
+  }
+  free(g_reports);
+  return 0;
+}
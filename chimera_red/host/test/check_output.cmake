@@ -0,0 +1,17 @@
+# Runs COMMAND on INPUT and fails unless its stdout matches EXPECTED.
+# Usage: cmake -DCOMMAND=... -DINPUT=... -DEXPECTED=... -DOUTPUT=...
+#              -P check_output.cmake
+execute_process(COMMAND ${COMMAND} ${INPUT}
+                OUTPUT_FILE ${OUTPUT}
+                RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "${COMMAND} ${INPUT} failed: ${result}")
+endif()
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT} ${EXPECTED}
+                RESULT_VARIABLE differs)
+if(differs)
+  message(FATAL_ERROR "${OUTPUT} differs from ${EXPECTED}\n"
+                      "If the change is intended, copy it over the "
+                      "expected file.")
+endif()